@@ -13,9 +13,11 @@
 #pragma once
 
 #include "common/errcode.h"
+#include "common/span.h"
 #include "common/types.h"
 #include "common/value.h"
 #include "loader/filemgr.h"
+#include "support/arena.h"
 #include "support/variant.h"
 
 #include <memory>
@@ -25,8 +27,12 @@ namespace SSVM {
 namespace AST {
 
 /// Type aliasing
+///
+/// Instruction nodes and sequences are allocated in the arena of the file
+/// manager when loading, which is the arena of module. They are released with
+/// the arena without destruction.
 class Instruction;
-using InstrVec = std::vector<std::unique_ptr<Instruction>>;
+using InstrVec = Span<Instruction *const>;
 using InstrIter = InstrVec::const_iterator;
 
 /// Loader class of Instruction node.
@@ -249,8 +255,8 @@ class BlockControlInstruction : public Instruction {
 public:
   /// Call base constructor to initialize OpCode.
   BlockControlInstruction(const OpCode &Byte) : Instruction(Byte) {}
-  /// Copy constructor.
-  BlockControlInstruction(const BlockControlInstruction &Instr);
+  /// Copy constructor. The body in arena is shared by the copies.
+  BlockControlInstruction(const BlockControlInstruction &Instr) = default;
 
   /// Load binary from file manager.
   ///
@@ -281,8 +287,8 @@ class IfElseControlInstruction : public Instruction {
 public:
   /// Call base constructor to initialize OpCode.
   IfElseControlInstruction(const OpCode &Byte) : Instruction(Byte) {}
-  /// Copy constructor.
-  IfElseControlInstruction(const IfElseControlInstruction &Instr);
+  /// Copy constructor. The statements in arena are shared by the copies.
+  IfElseControlInstruction(const IfElseControlInstruction &Instr) = default;
 
   /// Load binary from file manager.
   ///
@@ -312,6 +318,18 @@ private:
   /// @}
 };
 
+/// Branch target resolved by the validator.
+struct BranchTarget {
+  /// Value stack height of the target label, relative to the frame.
+  uint32_t Height = 0;
+  /// Count of values kept when branching.
+  uint32_t Arity = 0;
+  /// Loop label branches backward to the start of loop body.
+  bool IsLoop = false;
+  /// Set by the validator. Unresolved targets must not be branched to.
+  bool Resolved = false;
+};
+
 /// Derived branch control instruction node.
 class BrControlInstruction : public Instruction {
 public:
@@ -319,7 +337,8 @@ public:
   BrControlInstruction(const OpCode &Byte) : Instruction(Byte) {}
   /// Copy constructor.
   BrControlInstruction(const BrControlInstruction &Instr)
-      : Instruction(Instr.Code), LabelIdx(Instr.LabelIdx) {}
+      : Instruction(Instr.Code), LabelIdx(Instr.LabelIdx),
+        Target(Instr.Target) {}
 
   /// Load binary from file manager.
   ///
@@ -334,9 +353,17 @@ public:
   /// Get label index
   uint32_t getLabelIndex() const { return LabelIdx; }
 
+  /// Getter of branch target. Valid after validation, when it is resolved.
+  const BranchTarget &getTarget() const { return Target; }
+
+  /// Setter of branch target. Called by the validator.
+  void setTarget(const BranchTarget &T) const { Target = T; }
+
 private:
   /// Branch-to label index.
   uint32_t LabelIdx = 0;
+  /// Target of the label, resolved in validation.
+  mutable BranchTarget Target;
 };
 
 /// Derived branch table control instruction node.
@@ -344,10 +371,9 @@ class BrTableControlInstruction : public Instruction {
 public:
   /// Call base constructor to initialize OpCode.
   BrTableControlInstruction(const OpCode &Byte) : Instruction(Byte) {}
-  /// Copy constructor.
-  BrTableControlInstruction(const BrTableControlInstruction &Instr)
-      : Instruction(Instr.Code), LabelTable(Instr.LabelTable),
-        LabelIdx(Instr.LabelIdx) {}
+  /// Copy constructor. The label table and targets in arena are shared by
+  /// the copies.
+  BrTableControlInstruction(const BrTableControlInstruction &Instr) = default;
 
   /// Load binary from file manager.
   ///
@@ -360,17 +386,29 @@ public:
   Expect<void> loadBinary(FileMgr &Mgr) override;
 
   /// Getter of label table
-  const std::vector<uint32_t> &getLabelTable() const { return LabelTable; }
+  Span<const uint32_t> getLabelTable() const { return LabelTable; }
 
   /// Getter of label index
   uint32_t getLabelIndex() const { return LabelIdx; }
 
+  /// Getter of branch targets of label table, followed by the target of
+  /// default label. Valid after validation.
+  Span<const BranchTarget> getTargets() const { return Targets; }
+
+  /// Setter of branch target of label table at index, or default label at
+  /// the size of label table. Called by the validator.
+  void setTarget(const uint32_t Idx, const BranchTarget &T) const {
+    Targets[Idx] = T;
+  }
+
 private:
   /// \name Data of branch instruction: label vector and defalt label.
   /// @{
-  std::vector<uint32_t> LabelTable;
+  Span<const uint32_t> LabelTable;
   uint32_t LabelIdx = 0;
   /// @}
+  /// Targets of the labels in arena, resolved in validation.
+  Span<BranchTarget> Targets;
 };
 
 /// Derived call control instruction node.
@@ -719,24 +757,50 @@ auto dispatchInstruction(Instruction::OpCode Code, T &&Visitor) {
 /// Make the new instruction node.
 ///
 /// Select the node type corresponding to the input Code.
-/// Create the derived instruction class and return pointer.
+/// Create the derived instruction class in arena and return pointer.
 ///
 /// \param Code the OpCode of instruction to make.
+/// \param A the arena to allocate the node in.
 ///
-/// \returns unique pointer of instruction node if success, ErrMsg when failed.
-Expect<std::unique_ptr<Instruction>>
-makeInstructionNode(const Instruction::OpCode &Code);
+/// \returns pointer of instruction node if success, ErrMsg when failed.
+Expect<Instruction *> makeInstructionNode(const Instruction::OpCode &Code,
+                                          Support::Arena &A);
 
 /// Make the new instruction node from old one.
 ///
 /// Select the node type corresponding to the input Code.
-/// Create the duplicated instruction node and return pointer.
+/// Create the duplicated instruction node in arena and return pointer.
 ///
 /// \param Instr the instruction to duplicate.
+/// \param A the arena to allocate the node in.
+///
+/// \returns pointer of instruction node if success, ErrMsg when failed.
+Expect<Instruction *> makeInstructionNode(const Instruction &Instr,
+                                          Support::Arena &A);
+
+/// Builder of instruction sequences in arena.
 ///
-/// \returns unique pointer of instruction node if success, ErrMsg when failed.
-Expect<std::unique_ptr<Instruction>>
-makeInstructionNode(const Instruction &Instr);
+/// The loaded nodes are collected in a scratch stack shared by the nested
+/// sequences of the thread, and copied into arena when the sequence ends.
+class InstrSeqBuilder {
+public:
+  InstrSeqBuilder() : Mark(Pending.size()) {}
+  ~InstrSeqBuilder() { Pending.resize(Mark); }
+
+  /// Append the loaded instruction node.
+  void push(Instruction *Instr) { Pending.push_back(Instr); }
+
+  /// Copy the collected nodes into arena and start a new sequence.
+  InstrVec build(Support::Arena &A) {
+    InstrVec Seq = A.copy(Pending.data() + Mark, Pending.size() - Mark);
+    Pending.resize(Mark);
+    return Seq;
+  }
+
+private:
+  static thread_local std::vector<Instruction *> Pending;
+  const size_t Mark;
+};
 
 } // namespace AST
 } // namespace SSVM
@@ -14,8 +14,10 @@
 
 #include "base.h"
 #include "section.h"
+#include "support/sha256.h"
 
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace SSVM {
@@ -35,6 +37,24 @@ public:
   /// \returns void when success, ErrMsg when failed.
   virtual Expect<void> loadBinary(FileMgr &Mgr);
 
+  /// Setter of thread count for loading function bodies. 0 for hardware
+  /// threads.
+  void setThreadCount(const uint32_t Count) { ThreadCount = Count; }
+
+  /// Setter of lazy loading function bodies, which are decoded and validated
+  /// on first use.
+  void setLazyFunctionBody(const bool IsLazy) { LazyFunctionBody = IsLazy; }
+
+  /// Getter of bytes of the arena which instruction nodes are allocated in.
+  size_t getArenaSize() const { return Arena.getUsedSize(); }
+
+  /// Getter and setter of the SHA-256 digest of the binary loaded from. The
+  /// digest is only computed if the loader is set to.
+  const std::optional<Support::SHA256::Digest> &getHash() const {
+    return Hash;
+  }
+  void setHash(const std::optional<Support::SHA256::Digest> &D) { Hash = D; }
+
   /// Getter of pointer to sections.
   CustomSection *getCustomSection() const { return CustomSec.get(); }
   TypeSection *getTypeSection() const { return TypeSec.get(); }
@@ -54,10 +74,18 @@ protected:
   Attr NodeAttr = Attr::Module;
 
 private:
+  /// Load the contents in the arena of this module.
+  Expect<void> loadSections(FileMgr &Mgr);
+
   /// \name Data of Module node.
   /// @{
   Bytes Magic;
   Bytes Version;
+  uint32_t ThreadCount = 1;
+  bool LazyFunctionBody = false;
+  std::optional<Support::SHA256::Digest> Hash;
+  /// Arena of instruction nodes, released after the sections.
+  Support::Arena Arena;
   /// @}
 
   /// \name Section nodes of Module node.
@@ -18,6 +18,7 @@
 #include "type.h"
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace SSVM {
@@ -93,8 +94,9 @@ protected:
   Attr NodeAttr = Attr::Sec_Custom;
 
 private:
-  /// Vector of raw bytes of content.
-  Bytes Content;
+  /// View of raw bytes of content and its owner.
+  Span<const Byte> Content;
+  std::shared_ptr<const void> ContentOwner;
 };
 
 /// AST TypeSection node.
@@ -281,8 +283,30 @@ public:
     return Content;
   }
 
+  /// Setter of thread count for loading function bodies. 0 for hardware
+  /// threads.
+  void setThreadCount(const uint32_t Count) { ThreadCount = Count; }
+
+  /// Setter of lazy loading. Function bodies are decoded and validated on
+  /// first use instead of in loading and validating the module.
+  void setLazy(const bool IsLazy) { LazyLoad = IsLazy; }
+
+  /// Getter of checking the function bodies are lazily loaded.
+  bool isLazy() const { return Lazy != nullptr; }
+
+  /// Setter of the validator of lazily loaded function bodies. The bodies
+  /// decoded before are validated on their next decoding.
+  void setLazyChecker(LazyCode::Checker Check) const {
+    std::lock_guard<std::mutex> Lock(Lazy->Mutex);
+    Lazy->Check = std::move(Check);
+  }
+
 protected:
   /// Overrided content loading of code section.
+  ///
+  /// With more than one thread, the function bodies are split by their sizes
+  /// first and decoded concurrently. The error of the first failed function
+  /// body is returned. With lazy loading, the function bodies are only split.
   virtual Expect<void> loadContent(FileMgr &Mgr);
 
   /// The node type should be Attr::Sec_Code.
@@ -291,6 +315,10 @@ protected:
 private:
   /// Vector of CodeSegment nodes.
   std::vector<std::unique_ptr<CodeSegment>> Content;
+  uint32_t ThreadCount = 1;
+  bool LazyLoad = false;
+  /// Lazy context shared by the segments. Nullptr if loaded eagerly.
+  std::unique_ptr<LazyCode> Lazy;
 };
 
 /// AST DataSection node.
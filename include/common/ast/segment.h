@@ -17,7 +17,10 @@
 #include "instruction.h"
 #include "type.h"
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
 
 namespace SSVM {
 namespace AST {
@@ -105,6 +108,22 @@ private:
   /// @}
 };
 
+class CodeSegment;
+
+/// Shared context of the lazily loaded function bodies in a code section.
+struct LazyCode {
+  /// Validator of the decoded function body of the index in code section.
+  using Checker =
+      std::function<Expect<void>(const CodeSegment &, const uint32_t)>;
+
+  /// Serializes decoding and validating function bodies.
+  std::mutex Mutex;
+  /// Arena of the instruction nodes of decoded function bodies.
+  Support::Arena Arena;
+  /// Validator set by validating the module. Empty if not validated.
+  Checker Check;
+};
+
 /// AST CodeSegment node.
 class CodeSegment : public Segment {
 public:
@@ -118,6 +137,47 @@ public:
   /// \returns void when success, ErrMsg when failed.
   virtual Expect<void> loadBinary(FileMgr &Mgr);
 
+  /// Load the locals and function body of the given segment size.
+  ///
+  /// \param Mgr the file manager reference.
+  /// \param Size the code segment size.
+  ///
+  /// \returns void when success, ErrMsg when failed.
+  Expect<void> loadBody(FileMgr &Mgr, const uint32_t Size);
+
+  /// Keep the function body of the given index in code section undecoded.
+  ///
+  /// The locals and instructions are empty until `decodeBody` is called. The
+  /// body is referenced instead of copied, and is kept alive by the owner.
+  ///
+  /// \param Code the locals and function body of this segment.
+  /// \param Owner the owner of code.
+  /// \param Idx the index of this segment in code section.
+  /// \param Ctx the lazy context of code section.
+  void setLazyBody(Span<const Byte> Code, std::shared_ptr<const void> Owner,
+                   const uint32_t Idx, LazyCode &Ctx);
+
+  /// Decode and validate the lazily loaded function body once. Thread-safe.
+  ///
+  /// Concurrent callers wait for the first one and get the same result. The
+  /// locals and instructions must not be accessed before success. A body
+  /// decoded before the validator is set is validated on the first call
+  /// after, and the result is final only after validating.
+  ///
+  /// \returns void when success or loaded eagerly, ErrMsg when failed.
+  Expect<void> decodeBody() const {
+    if (Lazy != nullptr && !Done.load(std::memory_order_acquire)) {
+      return decodeLazyBody();
+    }
+    if (Status != ErrCode::Success) {
+      return Unexpect(Status);
+    }
+    return {};
+  }
+
+  /// Getter of checking the function body is lazily loaded.
+  bool isLazy() const { return Lazy != nullptr; }
+
   /// Getter of locals vector.
   const std::vector<std::pair<uint32_t, ValType>> &getLocals() const {
     return Locals;
@@ -128,10 +188,27 @@ protected:
   Attr NodeAttr = Attr::Seg_Code;
 
 private:
+  /// Decode and validate the function body under the lock of lazy context.
+  Expect<void> decodeLazyBody() const;
+
   /// \name Data of CodeSegment node.
   /// @{
   uint32_t SegSize = 0;
-  std::vector<std::pair<uint32_t, ValType>> Locals;
+  /// Locals are mutable to be filled on decoding lazily.
+  mutable std::vector<std::pair<uint32_t, ValType>> Locals;
+  /// @}
+
+  /// \name Data of lazily loaded function body.
+  /// @{
+  LazyCode *Lazy = nullptr;
+  uint32_t Index = 0;
+  Span<const Byte> Body;
+  std::shared_ptr<const void> BodyOwner;
+  /// Decoded, guarded by the lock of lazy context.
+  mutable bool Decoded = false;
+  /// Decoded and validated, or failed. The status is final.
+  mutable std::atomic<bool> Done{false};
+  mutable ErrCode Status = ErrCode::Success;
   /// @}
 };
 
@@ -151,8 +228,8 @@ public:
   /// Getter of memory index.
   uint32_t getIdx() const { return MemoryIdx; }
 
-  /// Getter of data.
-  const Bytes &getData() const { return Data; }
+  /// Getter of data. The view is valid as long as this node is alive.
+  Span<const Byte> getData() const { return Data; }
 
 protected:
   /// The node type should be Attr::Seg_Data.
@@ -162,7 +239,8 @@ private:
   /// \name Data of DataSegment node.
   /// @{
   uint32_t MemoryIdx = 0;
-  Bytes Data;
+  Span<const Byte> Data;
+  std::shared_ptr<const void> DataOwner;
   /// @}
 };
 
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/common/span.h - Span definition --------------------*- C++ -*-===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the definition of Span, a non-owning view of contiguous
+/// elements.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace SSVM {
+
+/// Non-owning view of contiguous elements. The viewed buffer must outlive the
+/// span.
+template <typename T> class Span {
+public:
+  using element_type = T;
+  using value_type = std::remove_cv_t<T>;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  constexpr Span() noexcept = default;
+  constexpr Span(T *Ptr, size_t Size) noexcept : Ptr(Ptr), Length(Size) {}
+  template <typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+  Span(const std::vector<value_type> &Vec) noexcept
+      : Ptr(Vec.data()), Length(Vec.size()) {}
+  template <typename U,
+            typename = std::enable_if_t<std::is_same_v<const U, T> &&
+                                        !std::is_same_v<U, T>>>
+  constexpr Span(const Span<U> &Other) noexcept
+      : Ptr(Other.data()), Length(Other.size()) {}
+
+  constexpr T *data() const noexcept { return Ptr; }
+  constexpr size_t size() const noexcept { return Length; }
+  constexpr bool empty() const noexcept { return Length == 0; }
+  constexpr T &operator[](size_t Idx) const noexcept { return Ptr[Idx]; }
+
+  constexpr iterator begin() const noexcept { return Ptr; }
+  constexpr iterator end() const noexcept { return Ptr + Length; }
+  constexpr const_iterator cbegin() const noexcept { return Ptr; }
+  constexpr const_iterator cend() const noexcept { return Ptr + Length; }
+
+  /// Get the sub-view of [Offset, Offset + Count).
+  constexpr Span subspan(size_t Offset, size_t Count) const noexcept {
+    return Span(Ptr + Offset, Count);
+  }
+
+private:
+  T *Ptr = nullptr;
+  size_t Length = 0;
+};
+
+} // namespace SSVM
@@ -24,6 +24,8 @@ enum class ErrCode : unsigned int {
   Unreachable,         /// Get a unreachable instruction
   FunctionInvalid,     /// Invalid operation to function instance.
   Terminated,          /// Forced terminated by program and return success.
+  MemoryOutOfBounds,   /// Memory access out of bounds.
+  CostLimitExceeded,   /// Exceeded cost limit (out of gas).
 };
 
 template <typename T> class Span {
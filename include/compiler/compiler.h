@@ -13,6 +13,8 @@
 
 #include "common.h"
 #include "loader/loader.h"
+#include "support/sha256.h"
+#include "support/time.h"
 #include "vm/envmgr.h"
 #include "vm/configure.h"
 #include <memory>
@@ -41,6 +43,19 @@ public:
     return ErrCode::Success;
   }
 
+  /// Enable the native code cache of wasm file.
+  ///
+  /// Compiled code is written as a shared object next to the wasm file, named
+  /// by the SHA-256 of the wasm bytes, the compiler version and the code
+  /// generation flags. The digest and the digest of the shared object are
+  /// stored in the file and checked before loading. Later runs load the
+  /// shared object and skip loading and LLVM compilation. The cache is not
+  /// written when the system compiler driver `cc` is not found.
+  ErrCode setCacheEnabled(const bool Enabled) {
+    CacheEnabled = Enabled;
+    return ErrCode::Success;
+  }
+
   /// Getter of Environment.
   template <typename T> T *getEnvironment(VM::Configure::VMType Type) {
     return EnvMgr.getEnvironment<T>(Type);
@@ -52,11 +67,21 @@ public:
   /// Get compiled result
   Library &getLibrary();
 
+  /// Getter of compile time in microseconds, summed over compile threads for
+  /// CPU time. Code compiled by JIT on first call counts after the call.
+  uint64_t getCompileWallTime() { return CompileTimer.getWallTime(); }
+  uint64_t getCompileCPUTime() { return CompileTimer.getCPUTime(); }
+
   struct CompileContext;
 
 private:
   /// Functions for running.
   ErrCode runLoader();
+  ErrCode registerHostFunctions();
+
+  /// Get the path of cached shared object and its key, or empty if not
+  /// available.
+  std::string getCachePath(Support::SHA256::Digest &Key);
 
   /// Compile module
   ErrCode compile(const AST::Module &Module);
@@ -76,7 +101,9 @@ private:
   Loader::Loader LoaderEngine;
   std::string WasmPath;
   std::vector<uint8_t> WasmCode;
+  bool CacheEnabled = false;
   std::unique_ptr<AST::Module> Mod;
+  Support::WorkTimer CompileTimer;
   std::unique_ptr<Library> Lib;
   CompileContext *Context = nullptr;
 };
@@ -14,14 +14,19 @@
 #include "common.h"
 #include "common/value.h"
 #include "hostfunc.h"
+#include "support/time.h"
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace llvm {
 class LLVMContext;
 class Module;
 class StringRef;
+namespace orc {
+class JITTargetMachineBuilder;
+} // namespace orc
 } // namespace llvm
 
 namespace SSVM {
@@ -31,10 +36,30 @@ namespace Compiler {
 class Library {
 private:
   friend class Compiler;
-  Library();
-  void setModule(std::unique_ptr<llvm::Module> Module);
+  /// Module with its own context, or with the context of library if null.
+  using Partition = std::pair<std::unique_ptr<llvm::LLVMContext>,
+                              std::unique_ptr<llvm::Module>>;
+
+  /// Create library compiled by JIT on count of threads. Compilation is
+  /// accounted in timer.
+  Library(llvm::orc::JITTargetMachineBuilder TMBuilder, const uint32_t Threads,
+          Support::WorkTimer &Timer);
+  /// Add partitions, and compile the functions of speculated names in
+  /// background before they are called.
+  void setModule(std::vector<Partition> Partitions,
+                 const std::vector<std::string> &Speculated);
   llvm::LLVMContext &getContext();
 
+  /// Split module in the context of library into at most count partitions.
+  /// Internal symbols become hidden to be referenced across partitions.
+  static std::vector<Partition> splitModule(std::unique_ptr<llvm::Module> Module,
+                                            const uint32_t Count);
+
+  /// Load native code from shared object. Every library loads its own copy,
+  /// so that libraries of the same shared object do not share memory, costs,
+  /// and host functions. Return nullptr when failed.
+  static std::unique_ptr<Library> loadSharedObject(const std::string &Path);
+
 public:
   Library(const Library &) = delete;
   ~Library() noexcept;
@@ -58,6 +83,12 @@ public:
     return ErrCode::Success;
   }
 
+  /// Setter of cost limit. Only metered code is limited.
+  void setCostLimit(const uint64_t Limit) { CostLimit = Limit; }
+
+  /// Getter of cost sum.
+  uint64_t getCostSum() const { return CostSum; }
+
   /// Get start function return values.
   const std::vector<ValVariant> &getReturnValue() const { return Returns; }
 
@@ -68,23 +99,36 @@ public:
   void terminate();
 
   template <typename T> T &getMemory(uint32_t Offset) {
-    return *reinterpret_cast<T *>(Memory.data() + Offset);
+    return *reinterpret_cast<T *>(Memory + Offset);
   }
 
   template <typename T> Span<T *> getMemory(uint32_t Offset, uint32_t Length) {
-    const auto Begin = reinterpret_cast<T *>(Memory.data() + Offset);
+    const auto Begin = reinterpret_cast<T *>(Memory + Offset);
     const auto End = Begin + Length;
     return {Begin, End};
   }
 
 private:
   class Engine;
+  class JITEngine;
+  class SharedEngine;
+  explicit Library(Engine *E);
+
+  /// Bind runtime symbols to the slots in compiled code.
+  void bindSymbols();
+  /// Set the slot of symbol if exists.
+  void setSymbol(const std::string &Name, void *Value);
+
   Engine *ExecutionEngine;
   std::vector<ValVariant> Arguments;
   std::vector<ValVariant> Returns;
   std::vector<std::unique_ptr<HostFunction>> HostFuncs;
-  std::vector<uint8_t> Memory;
-  void *MemoryPtr;
+  /// Guarded linear memory. The base address never moves on growing.
+  uint8_t *Memory;
+  uint32_t MemoryPages;
+  /// Costs charged by metered code.
+  uint64_t CostSum = 0;
+  uint64_t CostLimit = UINT64_MAX;
 
   void trap(ErrCode Status);
   uint32_t memorySize();
@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include "common/span.h"
 #include "common/value.h"
 #include "executor/common.h"
 #include "executor/instance/entity.h"
@@ -44,8 +45,8 @@ public:
   ErrCode getBytes(Bytes &Slice, unsigned int Offset, unsigned int Length);
 
   /// Replace the bytes of Data[Offset :] by Slice[Start : Start + Legnth - 1]
-  ErrCode setBytes(const Bytes &Slice, unsigned int Offset, unsigned int Start,
-                   unsigned int Length);
+  ErrCode setBytes(Span<const Byte> Slice, unsigned int Offset,
+                   unsigned int Start, unsigned int Length);
 
   /// Get an uint8 array from Data[Offset : Offset + Length - 1]
   ErrCode getArray(uint8_t *Arr, unsigned int Offset, unsigned int Length,
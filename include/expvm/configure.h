@@ -23,6 +23,10 @@ public:
   /// VM type enum class.
   enum class VMType : uint8_t { Wasm = 0, Ewasm, Wasi, ONNC };
 
+  /// Interpreter engine enum class. Tiered engine starts in AST, and
+  /// promotes hot functions to flat code.
+  enum class EngineType : uint8_t { AST = 0, Flat, Tiered };
+
   Configure() { Types.insert(VMType::Wasm); }
   ~Configure() = default;
 
@@ -34,8 +38,42 @@ public:
     return ((Types.find(Type) != Types.end()) ? true : false);
   }
 
+  void setEngineType(const EngineType Type) { Engine = Type; }
+
+  EngineType getEngineType() const { return Engine; }
+
+  /// Thread count for loading and validating function bodies. 0 for hardware
+  /// threads.
+  void setThreadCount(const uint32_t Count) { ThreadCount = Count; }
+
+  uint32_t getThreadCount() const { return ThreadCount; }
+
+  /// Count of calls and loop iterations after which functions are promoted
+  /// in tiered engine.
+  void setTierUpThreshold(const uint32_t Count) { TierUpThreshold = Count; }
+
+  uint32_t getTierUpThreshold() const { return TierUpThreshold; }
+
+  /// Lazy loading of function bodies, which are decoded and validated on
+  /// first call instead of in loading and validating. Invalid function bodies
+  /// fail their calls instead of the validation.
+  void setLazyFunctionBody(const bool IsLazy) { LazyFunctionBody = IsLazy; }
+
+  bool isLazyFunctionBody() const { return LazyFunctionBody; }
+
+  /// Computing the digest of loaded modules, which is required for writing
+  /// and loading images and snapshots of the instantiated module.
+  void setModuleHash(const bool IsHash) { ModuleHash = IsHash; }
+
+  bool isModuleHash() const { return ModuleHash; }
+
 private:
   std::unordered_set<VMType> Types;
+  EngineType Engine = EngineType::AST;
+  uint32_t ThreadCount = 1;
+  uint32_t TierUpThreshold = 1000;
+  bool LazyFunctionBody = false;
+  bool ModuleHash = false;
 };
 
 } // namespace ExpVM
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/expvm/snapshot.h - Binary VM snapshot definition -------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file is the definition of the binary snapshot of VM states.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "common/errcode.h"
+#include "common/span.h"
+#include "common/types.h"
+#include "runtime/storemgr.h"
+#include "support/sha256.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace SSVM {
+namespace ExpVM {
+
+/// Binary snapshot of the mutable globals, tables, and memories of the
+/// active module.
+///
+/// The snapshot records the SHA-256 digest of the module binary, and is
+/// restored only into instances of the same module. The module must be
+/// loaded with the digest computed, or scanning and restoring fail with
+/// `WrongVMWorkflow`. Globals carry their
+/// value types, and table elements are the function indices of the module
+/// plus one, or zero if uninitialized.
+///
+/// Memories are split into chunks of `kChunkSize` bytes, and consecutive
+/// chunks of the same kind are encoded as one run. A zero run carries only
+/// its range, and a data run carries the raw bytes of its chunks. All
+/// integers are unsigned LEB128 encoded:
+///
+///   Snapshot := Magic Version ModuleHash Globals Tables Memories
+///   Globals  := Count (Index ValType Bits)*
+///   Tables   := Count (Index Size Element*)*
+///   Memories := Count (Index PageCount RunCount Run*)*
+///   Run      := FirstChunk ChunkCount Kind Bytes?
+///
+/// A mapped run is a data run of which the bytes start at the next offset of
+/// the encoding aligned to chunks, after zero padding. Snapshots written as
+/// mappable files carry mapped runs instead of data runs, which restoring
+/// from the file maps copy-on-write into memories instead of copying.
+///
+/// Restoring grows memories to the recorded page counts and writes every
+/// run. A full snapshot covers all chunks, so it can be restored into a
+/// freshly instantiated module. A delta snapshot covers only the chunks
+/// written since tracking started, and is restored on top of the states it
+/// was tracked from.
+class Snapshot {
+public:
+  /// Bytes of a memory chunk.
+  static inline constexpr const uint64_t kChunkSize = 4096ULL;
+  /// Magic number of snapshot.
+  static inline constexpr const char kMagic[4] = {'\0', 's', 's', 'n'};
+  /// Version of snapshot format.
+  static inline constexpr const uint32_t kVersion = 2;
+
+  Snapshot() = default;
+  ~Snapshot() = default;
+
+  /// Scan the states of the active module in store. The memories are
+  /// referenced until written, and must not be modified in between.
+  Expect<void> scan(Runtime::StoreManager &StoreMgr);
+
+  /// Scan the states of the active module in store as a delta snapshot.
+  /// Memories not tracking dirty pages are scanned fully.
+  Expect<void> scanDirty(Runtime::StoreManager &StoreMgr);
+
+  /// Start tracking the dirty pages of memories of the active module, or
+  /// clear the dirty pages when tracking, as the base of delta snapshots.
+  static Expect<void> track(Runtime::StoreManager &StoreMgr);
+
+  /// Get the encoded size in bytes, without mapped runs.
+  uint64_t getSize() const;
+
+  /// Write the encoded snapshot to stream or file. Files can be written with
+  /// mapped runs, and are replaced by renaming instead of truncating.
+  Expect<void> write(std::ostream &OS) const;
+  Expect<void> write(const std::string &Path,
+                     const bool Mappable = false) const;
+
+  /// Restore the states of the active module from the snapshot file, which is
+  /// memory mapped and read in place. Mapped runs are mapped into memories.
+  static Expect<void> restore(Runtime::StoreManager &StoreMgr,
+                              const std::string &Path);
+
+  /// Restore the states of the active module from the encoded snapshot.
+  static Expect<void> restore(Runtime::StoreManager &StoreMgr,
+                              Span<const Byte> Data);
+
+private:
+  enum class RunKind : uint8_t { Zero = 0x00, Data = 0x01, Mapped = 0x02 };
+
+  struct Run {
+    uint32_t First;
+    uint32_t Count;
+    RunKind Kind;
+  };
+
+  struct Global {
+    uint32_t Index;
+    ValType Type;
+    uint64_t Bits;
+  };
+
+  struct Table {
+    uint32_t Index;
+    std::vector<uint32_t> Elems;
+  };
+
+  struct Memory {
+    uint32_t Index;
+    uint32_t PageCount;
+    const Byte *Data;
+    std::vector<Run> Runs;
+  };
+
+  /// Scan states with memory chunks in full or dirty only.
+  Expect<void> scanChunks(Runtime::StoreManager &StoreMgr, bool DirtyOnly);
+
+  /// Write the encoded snapshot, with data runs as mapped runs if mappable.
+  Expect<void> writeRuns(std::ostream &OS, const bool Mappable) const;
+
+  /// Append the chunk to the runs of memory.
+  static void appendChunk(Memory &Mem, uint32_t Chunk);
+
+  /// Digest of the module binary.
+  Support::SHA256::Digest ModuleHash{};
+  /// Mutable globals with values in bits.
+  std::vector<Global> Globals;
+  /// Tables with encoded elements.
+  std::vector<Table> Tables;
+  /// Scanned memories.
+  std::vector<Memory> Memories;
+};
+
+} // namespace ExpVM
+} // namespace SSVM
@@ -37,7 +37,7 @@ public:
   VM() = delete;
   VM(Configure &InputConfig);
   VM(Configure &InputConfig, Runtime::StoreManager &S);
-  ~VM() = default;
+  ~VM() { InterpreterEngine.stopTierUp(); }
 
   /// ======= Functions can be called before instantiated stage. =======
   /// Register wasm modules and host modules.
@@ -65,11 +65,28 @@ public:
   /// Instantiate validated wasm module.
   Expect<void> instantiate();
 
+  /// Instantiate a shared validated wasm module, which is kept alive by the
+  /// instantiated instance. VMs instantiating the same module share its code.
+  Expect<void> instantiate(std::shared_ptr<const AST::Module> Module);
+
+  /// Instantiate by forking the template made by a VM with the same
+  /// configuration. Memories are shared copy-on-write with the template.
+  Expect<void> fork(const Runtime::StoreTemplate &Tmpl);
+
   /// ======= Functions can be called after instantiated stage. =======
+  /// Restore the states of instantiated module from the pre-initialized image
+  /// written by `ssvm-preinit`, instead of running the initialization again.
+  /// The module must be loaded with `Configure::setModuleHash` set.
+  Expect<void> loadImage(const std::string &Path);
+
   /// Execute wasm with given input.
   Expect<std::vector<ValVariant>>
   execute(const std::string &Func, const std::vector<ValVariant> &Params = {});
 
+  /// Make template from the instantiated module in current states, which
+  /// VMs with the same configuration fork from.
+  Expect<std::shared_ptr<const Runtime::StoreTemplate>> makeTemplate();
+
   /// ======= Functions which are stageless. =======
   /// Clean up VM status
   void cleanup();
@@ -98,10 +115,10 @@ private:
 
   void initVM();
   Expect<void> registerModule(const std::string &Name,
-                              const AST::Module &Module);
+                              std::shared_ptr<const AST::Module> Module);
   Expect<std::vector<ValVariant>>
-  runWasmFile(const AST::Module &Module, const std::string &Func,
-              const std::vector<ValVariant> &Params);
+  runWasmFile(std::shared_ptr<const AST::Module> Module,
+              const std::string &Func, const std::vector<ValVariant> &Params);
 
   /// VM environment.
   Configure &Config;
@@ -115,7 +132,7 @@ private:
   /// TODO: Add AOT here.
 
   /// VM Storage.
-  std::unique_ptr<AST::Module> Mod;
+  std::shared_ptr<const AST::Module> Mod;
   std::unique_ptr<Runtime::StoreManager> Store;
   Runtime::StoreManager &StoreRef;
   std::map<Configure::VMType, std::unique_ptr<Runtime::ImportObject>> ImpObjs;
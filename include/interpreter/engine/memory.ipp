@@ -11,29 +11,32 @@ namespace Interpreter {
 
 template <typename T>
 TypeT<T> Interpreter::runLoadOp(Runtime::Instance::MemoryInstance &MemInst,
-                                const AST::MemoryInstruction &Instr,
+                                const uint32_t Offset,
                                 const uint32_t BitWidth) {
-  /// Calculate EA
+  /// Calculate EA. Out of bound accesses trap in the guard region.
   ValVariant &Val = StackMgr.getTop();
-  uint32_t EA = retrieveValue<uint32_t>(Val) + Instr.getMemoryOffset();
+  const uint64_t EA =
+      static_cast<uint64_t>(retrieveValue<uint32_t>(Val)) + Offset;
 
   /// Value = Mem.Data[EA : N / 8]
-  return MemInst.loadValue(retrieveValue<T>(Val), EA, BitWidth / 8);
+  MemInst.loadValueUnsafe(retrieveValue<T>(Val), EA, BitWidth / 8);
+  return {};
 }
 
 template <typename T>
 TypeB<T> Interpreter::runStoreOp(Runtime::Instance::MemoryInstance &MemInst,
-                                 const AST::MemoryInstruction &Instr,
+                                 const uint32_t Offset,
                                  const uint32_t BitWidth) {
   /// Pop the value t.const c from the Stack
-  ValVariant C = StackMgr.pop();
+  const T C = StackMgr.popAs<T>();
 
-  /// Calculate EA = i + offset
-  ValVariant I = StackMgr.pop();
-  uint32_t EA = retrieveValue<uint32_t>(I) + Instr.getMemoryOffset();
+  /// Calculate EA = i + offset. Out of bound accesses trap in the guard region.
+  const uint64_t EA =
+      static_cast<uint64_t>(StackMgr.popAs<uint32_t>()) + Offset;
 
   /// Store value to bytes.
-  return MemInst.storeValue(retrieveValue<T>(C), EA, BitWidth / 8);
+  MemInst.storeValueUnsafe(C, EA, BitWidth / 8);
+  return {};
 }
 
 } // namespace Interpreter
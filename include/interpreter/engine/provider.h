@@ -51,15 +51,27 @@ public:
   /// Pop instruction sequence.
   Expect<void> popInstrs();
 
+  /// Unsafe pop the top count of instruction sequences at once.
+  void popInstrs(const uint32_t Cnt) {
+    Iters.erase(Iters.end() - Cnt, Iters.end());
+  }
+
+  /// Unsafe pop instruction sequences until the top function call popped.
+  void popFunction();
+
+  /// Unsafe jump back to the start of the top instruction sequence.
+  void restartInstrs() { Iters.back().Curr = Iters.back().Begin; }
+
   /// Reset instruction provider.
   void reset() { Iters.clear(); }
 
 private:
   /// Stack of instruction sequences.
   struct InstrScope {
-    InstrScope(const SeqType Type, AST::InstrIter Curr, AST::InstrIter End)
-        : Type(Type), Curr(Curr), End(End) {}
+    InstrScope(const SeqType Type, AST::InstrIter Begin, AST::InstrIter End)
+        : Type(Type), Begin(Begin), Curr(Begin), End(End) {}
     SeqType Type;
+    AST::InstrIter Begin;
     AST::InstrIter Curr;
     AST::InstrIter End;
   };
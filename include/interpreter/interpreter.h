@@ -17,15 +17,22 @@
 #include "common/errcode.h"
 #include "common/value.h"
 #include "engine/provider.h"
+#include "runtime/flatcode.h"
 #include "runtime/importobj.h"
+#include "runtime/nativecode.h"
 #include "runtime/stackmgr.h"
 #include "runtime/storemgr.h"
 #include "support/log.h"
 #include "support/measure.h"
 #include "support/time.h"
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace SSVM {
@@ -89,21 +96,58 @@ using TypeBB = typename std::enable_if_t<Support::IsWasmBuiltInV<T1> &&
 /// Executor flow control class.
 class Interpreter {
 public:
-  Interpreter(Support::Measurement *M = nullptr) : Measure(M) {}
-  ~Interpreter() = default;
-
-  /// Instantiate Wasm Module.
+  /// Execution engine kinds.
+  enum class EngineKind : uint8_t {
+    /// Walk the AST instruction tree.
+    AST = 0,
+    /// Run the flat code lowered at instantiation.
+    Flat,
+    /// Walk the AST instruction tree first, and run the flat code of hot
+    /// functions lowered on a background thread, then the native code compiled
+    /// from the flat code.
+    Tiered
+  };
+
+  Interpreter(Support::Measurement *M = nullptr,
+              const EngineKind Kind = EngineKind::AST)
+      : Engine(Kind), Measure(M) {}
+  ~Interpreter() { stopTierUp(); }
+
+  /// Setter of execution engine. Should be set before instantiation.
+  void setEngineKind(const EngineKind Kind) { Engine = Kind; }
+
+  /// Getter of execution engine.
+  EngineKind getEngineKind() const { return Engine; }
+
+  /// Setter of the count of calls and loop iterations, after which functions
+  /// are promoted to flat code and native code in tiered engine.
+  void setTierUpThreshold(const uint32_t Count) { TierUpThreshold = Count; }
+
+  /// Stop lowering functions in background. Should be called before the
+  /// instances in store are changed. Functions waiting for lowering stay in
+  /// the AST tier until they become hot again.
+  void stopTierUp();
+
+  /// Instantiate shared Wasm Module. Function instances reference the code of
+  /// the module and keep it alive, so that instances in many stores share the
+  /// code.
   Expect<void> instantiateModule(Runtime::StoreManager &StoreMgr,
-                                 const AST::Module &Mod,
+                                 std::shared_ptr<const AST::Module> Mod,
                                  const std::string &Name = "");
 
+  /// Instantiate Wasm Module by forking the template of a store manager with
+  /// the same registered modules. The start function is not run again.
+  Expect<void> forkModule(Runtime::StoreManager &StoreMgr,
+                          const Runtime::StoreTemplate &Tmpl);
+
   /// Register host module.
   Expect<void> registerModule(Runtime::StoreManager &StoreMgr,
                               const Runtime::ImportObject &Obj);
 
-  /// Register Wasm module.
+  /// Register shared Wasm module kept alive by the instances.
   Expect<void> registerModule(Runtime::StoreManager &StoreMgr,
-                              const AST::Module &Mod, const std::string &Name);
+                              std::shared_ptr<const AST::Module> Mod,
+                              const std::string &Name);
 
   /// Invoke function by function name.
   Expect<std::vector<ValVariant>> invoke(Runtime::StoreManager &StoreMgr,
@@ -111,6 +155,9 @@ public:
                                          const std::vector<ValVariant> &Params);
 
 private:
+  struct FrameContext;
+  struct NativeContext;
+
   /// Run Wasm bytecode expression for initialization.
   Expect<void> runExpression(Runtime::StoreManager &StoreMgr,
                              const AST::InstrVec &Instrs);
@@ -121,9 +168,11 @@ private:
 
   /// \name Functions for instantiation.
   /// @{
-  /// Instantiation of Module Instance.
+  /// Instantiation of Module Instance. The owner of module is null if the
+  /// caller keeps the module alive.
   Expect<void> instantiate(Runtime::StoreManager &StoreMgr,
-                           const AST::Module &Mod, const std::string &Name);
+                           const AST::Module &Mod, const std::string &Name,
+                           const std::shared_ptr<const AST::Module> &Owner);
 
   /// Instantiation of Import Section.
   Expect<void> instantiate(Runtime::StoreManager &StoreMgr,
@@ -134,7 +183,8 @@ private:
   Expect<void> instantiate(Runtime::StoreManager &StoreMgr,
                            Runtime::Instance::ModuleInstance &ModInst,
                            const AST::FunctionSection &FuncSec,
-                           const AST::CodeSection &CodeSec);
+                           const AST::CodeSection &CodeSec,
+                           const std::shared_ptr<const AST::Module> &Owner);
 
   /// Instantiation of Global Instances.
   Expect<void> instantiate(Runtime::StoreManager &StoreMgr,
@@ -169,7 +219,9 @@ private:
 
   /// \name Functions for instruction dispatchers.
   /// @{
-  Expect<void> execute(Runtime::StoreManager &StoreMgr);
+  /// Run instructions until the instruction sequences are popped to depth.
+  Expect<void> execute(Runtime::StoreManager &StoreMgr,
+                       const uint32_t Depth = 0);
   Expect<void> execute(Runtime::StoreManager &StoreMgr,
                        const AST::ControlInstruction &Instr);
   Expect<void> execute(Runtime::StoreManager &StoreMgr,
@@ -196,12 +248,120 @@ private:
                        const AST::BinaryNumericInstruction &Instr);
   /// @}
 
+  /// \name Functions for flat code engine.
+  /// @{
+  /// Lower function body into flat code. Safe to be called on other threads.
+  Expect<Runtime::FlatCode>
+  lowerFunction(Runtime::StoreManager &StoreMgr,
+                const Runtime::Instance::ModuleInstance &ModInst,
+                const Runtime::Instance::FunctionInstance &FuncInst) const;
+
+  /// Decode and lower the lazily loaded function body on first call.
+  Expect<void>
+  lowerLazyFunction(Runtime::StoreManager &StoreMgr,
+                    const Runtime::Instance::FunctionInstance &Func);
+
+  /// Run flat code until the entered function returns.
+  Expect<void> executeFlat(Runtime::StoreManager &StoreMgr,
+                           const Runtime::FlatInstr *PC);
+
+  /// Helper function for calling native functions. Return the entry of code.
+  const Runtime::FlatInstr *
+  enterFlatFunction(Runtime::StoreManager &StoreMgr,
+                    const Runtime::Instance::FunctionInstance &Func,
+                    const Runtime::FlatInstr *RetPC);
+
+  /// Helper function for return from native functions. Return the caller PC.
+  const Runtime::FlatInstr *leaveFlatFunction();
+
+  /// Charge the basic block of metering entry. Return false if exceeded.
+  bool chargeFlatBlock(const Runtime::FlatInstr *Meter);
+
+  /// Get the extra cost of basic block besides the instruction costs.
+  uint64_t getFlatBlockExtra(const Runtime::FlatInstr *Meter);
+
+  /// Refund the unexecuted rest of basic block when trapped at PC.
+  void refundFlatBlock(const Runtime::FlatInstr *PC);
+  /// @}
+
+  /// \name Functions for tiered engine.
+  /// @{
+  /// Count a call or a loop iteration of function, and request lowering the
+  /// function when it becomes hot.
+  void countTierUp(const Runtime::Instance::FunctionInstance &Func);
+
+  /// Run the entered function until it returns, from flat code at PC or by
+  /// walking AST if PC is null. Calls across tiers leave the running engine
+  /// and are resumed by this loop, so the native stack does not grow with the
+  /// calls. Functions called from native code are run in nested loops, which
+  /// stop when the instruction sequences are popped to depth.
+  Expect<void> executeTiered(Runtime::StoreManager &StoreMgr,
+                             const Runtime::FlatInstr *PC,
+                             const uint32_t Depth = 0);
+
+  /// Loop of the background thread lowering and compiling requested
+  /// functions.
+  void runTierUpWorker();
+  /// @}
+
+  /// \name Functions for native code of tiered engine.
+  /// @{
+  /// Compile the published flat code of function into native code, which
+  /// accesses the instances in store through the context of module. Safe to
+  /// be called on other threads.
+  Expect<Runtime::NativeCode>
+  compileFunction(Runtime::StoreManager &StoreMgr,
+                  const Runtime::Instance::ModuleInstance &ModInst,
+                  const Runtime::Instance::FunctionInstance &FuncInst) const;
+
+  /// Get the native code of function if it can be run with the current
+  /// measurement and native stack depth, or nullptr.
+  const Runtime::NativeCode *
+  getNativeCode(const Runtime::Instance::FunctionInstance &Func) const;
+
+  /// Call the native code of function with the arguments on stack. Return
+  /// the return address if it returns, or the address in flat code to resume
+  /// the function if it bails out.
+  Expect<const Runtime::FlatInstr *>
+  callNativeFunction(Runtime::StoreManager &StoreMgr,
+                     const Runtime::Instance::FunctionInstance &Func,
+                     const Runtime::NativeCode &Code,
+                     const Runtime::FlatInstr *RetPC);
+
+  /// Call function from native code of the module of context. Return the
+  /// status of native code.
+  uint32_t callFromNative(NativeContext &Ctx,
+                          const Runtime::Instance::FunctionInstance &Func,
+                          const uint64_t *Args, uint64_t *Ret);
+
+  /// Push the frame left by bailed out native code and return the address in
+  /// flat code to resume the function.
+  const Runtime::FlatInstr *
+  resumeNativeFunction(Runtime::StoreManager &StoreMgr,
+                       const Runtime::Instance::FunctionInstance &Func,
+                       const Runtime::FlatInstr *RetPC);
+
+  /// Refresh the memory size of context after memory may be grown.
+  static void refreshNativeContext(NativeContext &Ctx);
+
+  /// \name Helper functions called by native code.
+  /// @{
+  static uint32_t nativeCall(NativeContext *Ctx, const uint32_t FuncIdx,
+                             const uint64_t *Args, uint64_t *Ret);
+  static uint32_t nativeCallIndirect(NativeContext *Ctx,
+                                     const uint32_t TypeId, const uint32_t Idx,
+                                     const uint64_t *Args, uint64_t *Ret);
+  static uint32_t nativeMemoryGrow(NativeContext *Ctx,
+                                   const uint32_t Count);
+  static void nativeBailOut(NativeContext *Ctx, const uint64_t *Slots,
+                            const uint32_t PC, const uint32_t Height);
+  /// @}
+  /// @}
+
   /// \name Helper Functions for block controls.
   /// @{
   /// Helper function for entering blocks.
-  Expect<void> enterBlock(const uint32_t Arity,
-                          const AST::BlockControlInstruction *Instr,
-                          const AST::InstrVec &Seq);
+  Expect<void> enterBlock(const AST::InstrVec &Seq);
 
   /// Helper function for leaving blocks.
   Expect<void> leaveBlock();
@@ -213,23 +373,33 @@ private:
   /// Helper function for return from functions.
   Expect<void> leaveFunction();
 
-  /// Helper function for branching to label.
-  Expect<void> branchToLabel(const uint32_t Cnt);
+  /// Helper function for branching to label with the target resolved in
+  /// validation. Fails if the target is not resolved.
+  Expect<void> branchToLabel(const uint32_t Cnt,
+                             const AST::BranchTarget &Target);
   /// @}
 
-  /// \name Helper Functions for getting instances.
+  /// \name Helper Functions for frame contexts.
   /// @{
-  /// Helper function for get table instance by index.
-  Runtime::Instance::TableInstance *
-  getTabInstByIdx(Runtime::StoreManager &StoreMgr, const uint32_t Idx);
-
-  /// Helper function for get memory instance by index.
-  Runtime::Instance::MemoryInstance *
-  getMemInstByIdx(Runtime::StoreManager &StoreMgr, const uint32_t Idx);
-
-  /// Helper function for get global instance by index.
-  Runtime::Instance::GlobalInstance *
-  getGlobInstByIdx(Runtime::StoreManager &StoreMgr, const uint32_t Idx);
+  /// Get the context of the module. The context is resolved at the first use,
+  /// and stays at the same address until reset.
+  FrameContext &getFrameContext(Runtime::StoreManager &StoreMgr,
+                                       const uint32_t ModAddr);
+
+  /// Switch to the context of the module of top frame after pushing frame.
+  void switchFrameContext(Runtime::StoreManager &StoreMgr) {
+    CurrCtx = &getFrameContext(StoreMgr, StackMgr.getModuleAddr());
+  }
+
+  /// Switch back to the context of the caller frame after popping frame.
+  void restoreFrameContext() {
+    CurrCtx =
+        StackMgr.hasFrame() ? &FrameCtxs[StackMgr.getModuleAddr()] : nullptr;
+  }
+
+  /// Drop the resolved contexts. Called when the instances in store may be
+  /// changed.
+  void resetFrameContexts();
   /// @}
 
   /// \name Run instructions functions
@@ -250,18 +420,16 @@ private:
   Expect<void> runLocalGetOp(const uint32_t Idx);
   Expect<void> runLocalSetOp(const uint32_t Idx);
   Expect<void> runLocalTeeOp(const uint32_t Idx);
-  Expect<void> runGlobalGetOp(Runtime::StoreManager &StoreMgr,
-                              const uint32_t Idx);
-  Expect<void> runGlobalSetOp(Runtime::StoreManager &StoreMgr,
-                              const uint32_t Idx);
+  Expect<void> runGlobalGetOp(const uint32_t Idx);
+  Expect<void> runGlobalSetOp(const uint32_t Idx);
   /// ======= Memory instructions =======
   template <typename T>
   TypeT<T> runLoadOp(Runtime::Instance::MemoryInstance &MemInst,
-                     const AST::MemoryInstruction &Instr,
+                     const uint32_t Offset,
                      const uint32_t BitWidth = sizeof(T) * 8);
   template <typename T>
   TypeB<T> runStoreOp(Runtime::Instance::MemoryInstance &MemInst,
-                      const AST::MemoryInstruction &Instr,
+                      const uint32_t Offset,
                       const uint32_t BitWidth = sizeof(T) * 8);
   Expect<void> runMemorySizeOp(Runtime::Instance::MemoryInstance &MemInst);
   Expect<void> runMemoryGrowOp(Runtime::Instance::MemoryInstance &MemInst);
@@ -342,10 +510,74 @@ private:
 
   /// Instantiate mode
   InstantiateMode InsMode;
+  /// Execution engine
+  EngineKind Engine;
   /// Stack
   Runtime::StackManager StackMgr;
   /// Instruction provider
   InstrProvider InstrPdr;
+  /// Context passed to native code of a module. Native code reads the fields
+  /// at fixed offsets.
+  struct NativeContext {
+    Interpreter *Interp = nullptr;
+    FrameContext *Frame = nullptr;
+    Runtime::StoreManager *StoreMgr = nullptr;
+    /// Data of memory and the size in bytes, refreshed after calls and growing.
+    uint8_t *MemBase = nullptr;
+    uint64_t MemSize = 0;
+    /// Values of globals indexed in module.
+    ValVariant *const *Globals = nullptr;
+    /// Counters of measurement. Null if not measured.
+    uint64_t *CostSum = nullptr;
+    const uint64_t *CostLimit = nullptr;
+    uint64_t *InstrCnt = nullptr;
+    /// Returned value of function.
+    uint64_t Ret = 0;
+  };
+  /// Instances used by the frames of a module.
+  struct FrameContext {
+    const Runtime::Instance::ModuleInstance *ModInst = nullptr;
+    Runtime::Instance::MemoryInstance *MemInst = nullptr;
+    Runtime::Instance::TableInstance *TabInst = nullptr;
+    std::vector<Runtime::Instance::GlobalInstance *> GlobInsts;
+    std::vector<ValVariant *> GlobVals;
+    NativeContext Native;
+  };
+  /// Frame contexts indexed by module address. Native contexts are referenced
+  /// by address, so the contexts are not moved on growing.
+  std::deque<FrameContext> FrameCtxs;
+  /// Context of the top frame, switched on call and return.
+  FrameContext *CurrCtx = nullptr;
+  /// Return addresses of flat code engine
+  std::vector<const Runtime::FlatInstr *> FlatRetStack;
+  /// Last memory accessing instruction of flat code, for refunding on fault.
+  const Runtime::FlatInstr *FlatFaultPC = nullptr;
+  /// Flat code engine is charging instructions one by one.
+  bool FlatStepping = false;
+  /// Functions running in the AST tier of tiered engine, for counting loop
+  /// iterations.
+  std::vector<const Runtime::Instance::FunctionInstance *> TierFuncStack;
+  /// Functions in the AST tier called from flat code, as the instruction
+  /// sequence depths to return to and the return addresses.
+  std::vector<std::pair<uint32_t, const Runtime::FlatInstr *>> TierASTCalls;
+  /// Entry of the function in the flat code tier called from the AST tier.
+  const Runtime::FlatInstr *TierFlatPC = nullptr;
+  /// Depth of native code calls on the native stack, and the limit of it.
+  static inline constexpr const uint32_t kNativeDepthLimit = 256;
+  uint32_t NativeDepth = 0;
+  /// Frame left by bailed out native code, as the locals and operands and the
+  /// index of instruction in flat code to resume at.
+  std::vector<ValVariant> NativeBailSlots;
+  uint32_t NativeBailPC = 0;
+  /// Threshold of calls and loop iterations for promoting functions.
+  uint32_t TierUpThreshold = 1000;
+  /// Background lowering of tiered engine.
+  std::thread TierUpWorker;
+  std::mutex TierUpMutex;
+  std::condition_variable TierUpCond;
+  std::deque<const Runtime::Instance::FunctionInstance *> TierUpQueue;
+  Runtime::StoreManager *TierUpStore = nullptr;
+  bool TierUpStopping = false;
   /// Pointer to measurement.
   Support::Measurement *Measure;
 };
@@ -13,11 +13,17 @@
 #pragma once
 
 #include "common/errcode.h"
+#include "common/span.h"
 #include "common/value.h"
 #include "common/types.h"
+#include "support/arena.h"
+#include "support/sha256.h"
 
+#include <ctime>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace SSVM {
@@ -37,6 +43,29 @@ public:
   /// Read number of bytes into a vector.
   virtual Expect<Bytes> readBytes(size_t SizeToRead) = 0;
 
+  /// Read number of bytes as a view.
+  ///
+  /// The returned span is valid as long as the owner is alive. File managers
+  /// which can not reference their input copy the bytes into a new buffer
+  /// owned by the owner.
+  ///
+  /// \param SizeToRead the number of bytes to read.
+  /// \param [out] Owner the owner of the viewed buffer, may be null if the
+  /// buffer is owned by the caller of the file manager.
+  ///
+  /// \returns span of bytes when success, ErrCode when failed.
+  virtual Expect<Span<const Byte>>
+  readSpan(size_t SizeToRead, std::shared_ptr<const void> &Owner) {
+    if (auto Res = readBytes(SizeToRead)) {
+      auto Buf = std::make_shared<const Bytes>(std::move(*Res));
+      Span<const Byte> View(*Buf);
+      Owner = std::move(Buf);
+      return View;
+    } else {
+      return Unexpect(Res);
+    }
+  }
+
   /// Read an unsigned int.
   virtual Expect<uint32_t> readU32() = 0;
 
@@ -58,9 +87,29 @@ public:
   /// Read a string, which is size(unsigned int) + bytes.
   virtual Expect<std::string> readName() = 0;
 
+  /// Get the offset of the next byte to read.
+  virtual uint64_t getOffset() = 0;
+
+  /// Getter of the arena which the loaded instruction nodes are allocated in.
+  /// Nodes loaded out of a module are kept in the arena of file manager.
+  Support::Arena &getArena() { return CurrArena ? *CurrArena : OwnArena; }
+
+  /// Setter of the arena which the loaded instruction nodes are allocated in.
+  ///
+  /// \param A the arena, nullptr for the arena of file manager.
+  ///
+  /// \returns the previous arena.
+  Support::Arena *setArena(Support::Arena *A) {
+    return std::exchange(CurrArena, A);
+  }
+
 protected:
   /// File manager status.
   ErrCode Status = ErrCode::InvalidPath;
+
+private:
+  Support::Arena OwnArena;
+  Support::Arena *CurrArena = nullptr;
 };
 
 /// File stream version of file manager.
@@ -83,6 +132,7 @@ public:
   virtual Expect<float> readF32();
   virtual Expect<double> readF64();
   virtual Expect<std::string> readName();
+  virtual uint64_t getOffset();
 
 private:
   /// file stream.
@@ -110,6 +160,8 @@ public:
   virtual Expect<double> readF64();
   virtual Expect<std::string> readName();
 
+  virtual uint64_t getOffset() { return Pos; }
+
   uint32_t getRemainSize() const { return Code.size() - Pos; }
   void clearBuffer() {
     Code.clear();
@@ -123,4 +175,100 @@ private:
   uint32_t Pos = 0;
 };
 
+/// Memory mapped version of file manager.
+///
+/// The input is either a read-only mapping of the file or a byte buffer, and
+/// is never copied when decoding. Spans kept by `readSpan` reference a byte
+/// buffer directly, but are copied out of a file mapping, so that nothing
+/// references the mapping after the buffer is reset. Reading the mapping
+/// raises SIGBUS if the file is truncated meanwhile, so the file must not
+/// be truncated in place before the buffer is reset; `checkSource` detects
+/// the other changes of size and modification time.
+class FileMgrMap : public FileMgr {
+public:
+  FileMgrMap() = default;
+  virtual ~FileMgrMap() noexcept { closeSource(); }
+
+  /// Inheritted from FileMgr.
+  virtual Expect<void> setPath(const std::string &FilePath);
+  virtual Expect<void> setCode(const Bytes &CodeData);
+  virtual Expect<Byte> readByte();
+  virtual Expect<Bytes> readBytes(size_t SizeToRead);
+  virtual Expect<Span<const Byte>>
+  readSpan(size_t SizeToRead, std::shared_ptr<const void> &SpanOwner);
+  virtual Expect<uint32_t> readU32();
+  virtual Expect<uint64_t> readU64();
+  virtual Expect<int32_t> readS32();
+  virtual Expect<int64_t> readS64();
+  virtual Expect<float> readF32();
+  virtual Expect<double> readF64();
+  virtual Expect<std::string> readName();
+  virtual uint64_t getOffset() { return Pos; }
+
+  /// Set the binary data without copying.
+  ///
+  /// The buffer must outlive the file manager and all spans read from it.
+  Expect<void> setCode(Span<const Byte> CodeData);
+
+  /// Read number of bytes as a view without copying. The view is only valid
+  /// until the buffer is reset.
+  Expect<Span<const Byte>> readView(size_t SizeToRead);
+
+  /// Check the mapped file is not changed since mapping.
+  Expect<void> checkSource() const;
+
+  /// Get the descriptor of the mapped file, or -1 if the input is not a
+  /// mapped file. The descriptor is closed when the buffer is reset.
+  int getSourceFd() const { return SourceFd; }
+
+  /// Get the SHA-256 digest of the whole input.
+  Support::SHA256::Digest getDigest() const {
+    return Support::SHA256::hash(Data, Size);
+  }
+
+  size_t getRemainSize() const { return Size - Pos; }
+  void clearBuffer() {
+    setBuffer(nullptr, 0, nullptr);
+    Status = ErrCode::EndOfFile;
+  }
+
+private:
+  /// Close the mapped file.
+  void closeSource() noexcept;
+
+  /// Reset the input buffer.
+  void setBuffer(const Byte *Ptr, size_t Length,
+                 std::shared_ptr<const void> BufOwner);
+
+  /// Decode LEB128 encoded integer.
+  template <typename T, bool IsSigned> Expect<T> readLEB128();
+
+  /// Check the remain size and move the position to the end if not enough.
+  bool checkRemain(size_t SizeToRead) {
+    if (SizeToRead > Size - Pos) {
+      Pos = Size;
+      Status = ErrCode::EndOfFile;
+      return false;
+    }
+    return true;
+  }
+
+  /// \name Data of input buffer.
+  /// @{
+  const Byte *Data = nullptr;
+  size_t Size = 0;
+  size_t Pos = 0;
+  /// Owner of the mapping or the copied buffer.
+  std::shared_ptr<const void> Owner;
+  /// @}
+
+  /// \name Data of mapped file.
+  /// @{
+  int SourceFd = -1;
+  struct timespec SourceMTime = {};
+  /// Spans copied out of the mapping.
+  std::shared_ptr<Support::Arena> Copies;
+  /// @}
+};
+
 } // namespace SSVM
@@ -34,9 +34,34 @@ public:
   Expect<std::unique_ptr<AST::Module>>
   parseModule(const std::vector<uint8_t> &Code);
 
+  /// Parse module from byte code without copying.
+  ///
+  /// Data and custom sections and lazily loaded function bodies of the module
+  /// reference the code directly, so the code must outlive the returned
+  /// module.
+  Expect<std::unique_ptr<AST::Module>> parseModule(Span<const Byte> Code);
+
+  /// Setter of thread count for loading function bodies. 0 for hardware
+  /// threads.
+  void setThreadCount(const uint32_t Count) { ThreadCount = Count; }
+
+  /// Setter of lazy loading function bodies. The function bodies are decoded
+  /// and validated on first use instead of in loading and validating.
+  void setLazyFunctionBody(const bool IsLazy) { LazyFunctionBody = IsLazy; }
+
+  /// Setter of computing the SHA-256 digest of the module binary, which the
+  /// saved states of images and snapshots are bound to. Not computed by
+  /// default, since hashing takes time in proportion to the binary size.
+  void setModuleHash(const bool IsHash) { ModuleHash = IsHash; }
+
 private:
-  FileMgrFStream FSMgr;
-  FileMgrVector FVMgr;
+  /// Parse module from the file manager.
+  Expect<std::unique_ptr<AST::Module>> parseModule(FileMgr &Mgr);
+
+  FileMgrMap FMgr;
+  uint32_t ThreadCount = 1;
+  bool LazyFunctionBody = false;
+  bool ModuleHash = false;
 };
 
 } // namespace Loader
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace SSVM {
@@ -14,11 +15,17 @@ public:
   const std::string &getInputJSONPath() { return InputJSONPath; }
   const std::string &getOutputJSONPath() { return OutputJSONPath; }
   const std::string &getWasmPath() { return WasmPath; }
+  const std::string &getSocketPath() { return SocketPath; }
+  const std::string &getWasmRoot() { return WasmRoot; }
+  uint32_t getWorkerCount() { return WorkerCount; }
 
 private:
   std::string InputJSONPath;
   std::string OutputJSONPath;
   std::string WasmPath;
+  std::string SocketPath;
+  std::string WasmRoot;
+  uint32_t WorkerCount = 0;
 };
 
 } // namespace Proxy
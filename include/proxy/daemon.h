@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/proxy/daemon.h - Proxy daemon on Unix domain socket ----------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the daemon serving proxy requests on a Unix domain
+/// socket with a pool of workers.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "proxy/modulecache.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace SSVM {
+namespace Proxy {
+
+/// Daemon serving proxy requests.
+///
+/// Every frame on a connection is a 32-bit big-endian length followed by the
+/// JSON text, in both directions. A request is the input JSON of the proxy,
+/// optionally with `wasm_path`, and is answered by the output JSON. Requests
+/// on a connection are answered in order. A request `{"command": "metrics"}`
+/// is answered by the metrics of the daemon.
+///
+/// The dispatcher thread, which calls `run`, accepts connections and reads
+/// requests into the queue. Connections are non-blocking and buffer partial
+/// frames, so that slow clients never stall the others, and are closed when
+/// idle in the middle of a frame for too long. Workers with their own VMs run
+/// the requests and write the responses.
+///
+/// The `wasm_path` of requests is loaded only from the files under the wasm
+/// root, and refused without one.
+class Daemon {
+public:
+  /// Maximum length of a frame.
+  static inline constexpr const uint32_t kMaxFrameSize = 64U * 1024U * 1024U;
+
+  Daemon(const std::string &Socket, const uint32_t Workers,
+         const std::string &DefaultWasm = "",
+         const std::string &WasmRoot = "");
+  ~Daemon();
+  Daemon(const Daemon &) = delete;
+  Daemon &operator=(const Daemon &) = delete;
+
+  /// Listen on the socket path and serve until `stop` is called. A stale
+  /// socket left at the path is replaced, but a socket still accepting
+  /// connections or a file of other types is kept.
+  ///
+  /// \returns false if failed to listen.
+  bool run();
+
+  /// Stop serving. Safe to be called from signal handlers.
+  void stop() noexcept;
+
+  /// Get the metrics in JSON.
+  std::string getMetricsJSON();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /// Latency statistics with a histogram of power of 2 microseconds.
+  struct LatencyStat {
+    void add(const Clock::duration D);
+    uint64_t getPercentile(const double P) const;
+    uint64_t Count = 0;
+    uint64_t TotalUs = 0;
+    uint64_t MaxUs = 0;
+    std::array<uint64_t, 32> Buckets{};
+  };
+
+  /// Request waiting for a worker.
+  struct Request {
+    int Fd;
+    std::string Payload;
+    Clock::time_point Arrival;
+  };
+
+  /// Connection owned by the dispatcher.
+  struct Connection {
+    /// Received bytes of the following frames.
+    std::string Buffer;
+    /// Time of the last received bytes.
+    Clock::time_point LastRead;
+    /// A request of the connection is in flight.
+    bool Busy = false;
+  };
+
+  /// Check the socket path is free to bind, and remove the stale socket.
+  bool claimSocketPath();
+
+  /// Receive the available bytes of connection.
+  ///
+  /// \returns false if the connection is closed or failed.
+  bool receive(const int Fd, Connection &Conn);
+
+  /// Queue the request if a whole frame is buffered in connection.
+  ///
+  /// \returns false if the frame is too long.
+  bool dispatchFrame(const int Fd, Connection &Conn);
+
+  void runWorker();
+  void finishRequest(const int Fd, const bool KeepAlive);
+
+  std::string SocketPath;
+  std::string DefaultWasmPath;
+  std::string WasmRootPath;
+  uint32_t WorkerCount;
+  int ListenFd = -1;
+  /// Identity of the bound socket file, which is removed on exit only if it
+  /// is not replaced.
+  uint64_t SocketDev = 0;
+  uint64_t SocketIno = 0;
+  /// Self pipe to wake up the dispatcher.
+  int WakeFds[2] = {-1, -1};
+  std::atomic<bool> StopRequested{false};
+  ModuleCache Cache;
+  std::vector<std::thread> Workers;
+
+  std::mutex Mutex;
+  std::condition_variable QueueCond;
+  std::deque<Request> Queue;
+  /// Connections answered by workers, and whether to keep them.
+  std::vector<std::pair<int, bool>> DoneFds;
+  bool Stopping = false;
+
+  /// Metrics.
+  uint64_t MaxQueueDepth = 0;
+  uint64_t Requests = 0;
+  uint64_t InvalidRequests = 0;
+  uint64_t Connections = 0;
+  LatencyStat QueueLatency;
+  LatencyStat ServiceLatency;
+};
+
+} // namespace Proxy
+} // namespace SSVM
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/proxy/modulecache.h - Validated module cache -----------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the cache of loaded and validated wasm modules.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "common/ast/module.h"
+#include "common/errcode.h"
+#include "common/types.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace SSVM {
+namespace Proxy {
+
+/// Cache of validated modules keyed by file path.
+///
+/// Entries are checked against the modification time and size of the file
+/// on every lookup, and reloaded when the file changed. Entries are evicted
+/// in LRU order. Cached modules are shared, so evicted ones live until the
+/// last VM instantiated from them is cleaned up. Modules are loaded with
+/// their digests, which the snapshots of instances are bound to.
+class ModuleCache {
+public:
+  /// Validated module with its code.
+  struct Entry {
+    std::string Path;
+    int64_t MTime;
+    uint64_t Size;
+    /// Code is referenced by the module, so it is destroyed after the module.
+    Bytes Code;
+    std::unique_ptr<AST::Module> Module;
+  };
+
+  ModuleCache(const uint32_t Cap = 64) : Capacity(Cap) {}
+
+  /// Get the validated module of file. Loads and validates the module if it
+  /// is not cached or the file changed.
+  Expect<std::shared_ptr<const Entry>> get(const std::string &Path);
+
+  /// Getters of lookup statistics.
+  uint64_t getHits() const;
+  uint64_t getMisses() const;
+
+private:
+  uint32_t Capacity;
+  mutable std::mutex Mutex;
+  std::list<std::shared_ptr<const Entry>> LRU;
+  std::unordered_map<std::string, decltype(LRU)::iterator> Index;
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+};
+
+} // namespace Proxy
+} // namespace SSVM
@@ -4,6 +4,7 @@
 #include "rapidjson/document.h"
 #include "expvm/configure.h"
 #include "expvm/vm.h"
+#include "proxy/modulecache.h"
 
 #include <boost/filesystem.hpp>
 #include <memory>
@@ -44,25 +45,55 @@ public:
   }
   void setWasmPath(const std::string &S) { WasmPath = getAbsPath(S); }
 
+  /// Restrict the `wasm_path` and the snapshot files of requests to the files
+  /// under the directory. Requests with `wasm_path` or snapshot files are
+  /// refused if the directory is empty.
+  void setWasmRoot(const std::string &S) {
+    WasmRoot = getAbsPath(S);
+    RestrictWasmPath = true;
+  }
+
   const std::string &getInputJSONPath() { return InputJSONPath; }
   const std::string &getOutputJSONPath() { return OutputJSONPath; }
   const std::string &getWasmPath() { return WasmPath; }
 
+  /// Setter of validated module cache. Modules are loaded from the cache
+  /// instead of the file, and the VM is reused between requests of the same
+  /// configuration. Requests of the same module fork the instance from the
+  /// template made by the first request instead of instantiating it.
+  void setModuleCache(ModuleCache *Cache) { ModCache = Cache; }
+
+  /// Run the request in input JSON file and write the output JSON file.
   void runRequest();
 
+  /// Run the request in input JSON document and return the output JSON. The
+  /// input document is consumed. The wasm path can be overridden by the
+  /// `wasm_path` member of the request, restricted by `setWasmRoot`.
+  std::string runRequest(rapidjson::Document &Input);
+
 private:
   void prepareOutputJSON();
   void parseInputJSON();
+  void parseInputDoc();
   void executeVM();
   void exportOutputJSON();
+  std::string writeOutputJSON();
 
   std::string InputJSONPath;
   std::string OutputJSONPath;
   std::string WasmPath;
+  std::string RequestWasmPath;
+  std::string WasmRoot;
+  bool RestrictWasmPath = false;
   rapidjson::Document InputDoc;
   rapidjson::Document OutputDoc;
-  std::unique_ptr<ExpVM::VM> VMUnit;
+  ModuleCache *ModCache = nullptr;
+  /// The configuration outlives the VM using it.
   ExpVM::Configure VMConf;
+  std::unique_ptr<ExpVM::VM> VMUnit;
+  /// Template of the cached module made by the VM.
+  std::shared_ptr<const ModuleCache::Entry> TmplEntry;
+  std::shared_ptr<const Runtime::StoreTemplate> Tmpl;
 };
 
 } // namespace Proxy
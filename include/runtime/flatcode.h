@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/runtime/flatcode.h - Flat instruction code definition --------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the definition of flat instruction code, which is the
+/// pre-decoded form of function bodies with resolved branch targets and
+/// immediates.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "common/ast/instruction.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace SSVM {
+namespace Runtime {
+
+/// Flat instruction entry.
+///
+/// OpCodes are reused from AST instructions with the following meanings.
+/// Jump offsets are relative to the jumping instruction.
+///   Nop:         With `Meter` flag, charge the following basic block, where
+///                `Index` is the instruction count, `Num` is the cost, and
+///                `Arity` is the ID of the cost table summing the cost. With
+///                `Enter` flag, the cost includes entering the statement of
+///                if instruction.
+///   Block, Loop: No operation. Kept for instruction counting and costs.
+///   If:          Pop condition and jump by `Index` if it is zero.
+///   Else:        Jump by `Index` unconditionally.
+///   End:         Return from function.
+///   Br, Br_if:   Keep top `Arity` values, restore the value stack to
+///                `Height`, and jump by `Index`.
+///   Br_table:    `Index` is the count N of label table. Followed by N + 1
+///                Br entries, the last one is the default label.
+///   Call:        `Index` is the function index in module.
+///   Call_indirect: `Index` is the canonical function type ID.
+///   Variables:   `Index` is the local or global index.
+///   Memory:      `Index` is the memory offset.
+///   Const:       `Num` is the raw bits of the constant value.
+struct FlatInstr {
+  using OpCode = AST::Instruction::OpCode;
+
+  /// Flags of flat instruction.
+  enum Flag : uint8_t {
+    /// Generated by lowering, not counted nor charged.
+    Internal = 0x01U,
+    /// Metering entry at the start of a basic block.
+    Meter = 0x02U,
+    /// Metering entry of the basic block entering a statement.
+    Enter = 0x04U
+  };
+
+  FlatInstr(const OpCode C, const uint8_t F = 0)
+      : Code(C), Flags(F), Arity(0), Index(0), Num(0) {}
+
+  OpCode Code;
+  uint8_t Flags;
+  uint16_t Arity;
+  uint32_t Index;
+  union {
+    /// Value stack height relative to the frame base for branches.
+    uint32_t Height;
+    /// Raw bits of constant value, or cost of basic block.
+    uint64_t Num;
+  };
+};
+
+static_assert(sizeof(FlatInstr) == 16, "Flat instruction should be compact.");
+
+/// Lowered function body.
+using FlatCode = std::vector<FlatInstr>;
+
+} // namespace Runtime
+} // namespace SSVM
@@ -108,16 +108,12 @@ private:
     static inline constexpr const bool hasReturn = false;
   };
 
-  template <typename U>
-  static U getBottomN(StackManager &StackMgr, std::size_t N) {
-    return retrieveValue<U>(StackMgr.getBottomN(N));
-  }
   template <typename Tuple, std::size_t... Indices>
   static Tuple popTuple(StackManager &StackMgr, std::size_t N,
                         std::index_sequence<Indices...>) {
-    Tuple Result(getBottomN<std::tuple_element_t<Indices, Tuple>>(
-        StackMgr, N + Indices)...);
-    ((StackMgr.pop(), (void)Indices), ...);
+    Tuple Result(StackMgr.getBottomNAs<std::tuple_element_t<Indices, Tuple>>(
+        N + Indices)...);
+    StackMgr.popN(sizeof...(Indices));
     return Result;
   }
   template <typename Tuple, std::size_t... Indices>
@@ -12,9 +12,13 @@
 #pragma once
 
 #include "common/ast/instruction.h"
+#include "common/ast/segment.h"
 #include "module.h"
+#include "runtime/flatcode.h"
 #include "runtime/hostfunc.h"
+#include "runtime/nativecode.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -26,23 +30,39 @@ namespace Instance {
 class FunctionInstance {
 public:
   FunctionInstance() = delete;
-  /// Constructor for native function.
+  /// Constructor for native function. The locals and instructions are
+  /// referenced from the immutable code of module, which is kept alive by the
+  /// owner. The canonical type ID is interned by the module instance.
   FunctionInstance(const uint32_t ModAddr, const FType &Type,
-                   const std::vector<std::pair<uint32_t, ValType>> &Locs,
-                   const AST::InstrVec &Expr)
-      : IsHostFunction(false), FuncType(Type), ModuleAddr(ModAddr),
-        Locals(Locs) {
-    /// Copy instructions
-    for (auto &It : Expr) {
-      if (auto Res = makeInstructionNode(*It.get())) {
-        Instrs.push_back(std::move(*Res));
+                   const uint32_t TypeId, const AST::CodeSegment &CodeSeg,
+                   std::shared_ptr<const void> Owner)
+      : IsHostFunction(false), FuncTypeId(TypeId), FuncType(Type),
+        ModuleAddr(ModAddr), Locals(CodeSeg.getLocals()),
+        Instrs(CodeSeg.getInstrs()),
+        LazySeg(CodeSeg.isLazy() ? &CodeSeg : nullptr),
+        CodeOwner(std::move(Owner)) {}
+  /// Constructor for native function forked from the function at the same
+  /// address of a forked store. The code and the compiled native code are
+  /// shared, and the lowered code is copied, since the function addresses of
+  /// both stores are the same.
+  FunctionInstance(const FunctionInstance &Tmpl, const FType &Type)
+      : IsHostFunction(false), FuncTypeId(Tmpl.FuncTypeId), FuncType(Type),
+        ModuleAddr(Tmpl.ModuleAddr), Locals(Tmpl.Locals), Instrs(Tmpl.Instrs),
+        LazySeg(Tmpl.LazySeg), CodeOwner(Tmpl.CodeOwner) {
+    if (Tmpl.getTieredCode() != nullptr) {
+      setTieredCode(FlatCode(Tmpl.Code));
+      if (const auto *NCode = Tmpl.getNativeCode()) {
+        setNativeCode(NativeCode(*NCode));
       }
+    } else {
+      Code = Tmpl.Code;
     }
   }
   /// Constructor for host function. Module address will not be used.
   FunctionInstance(std::unique_ptr<HostFunctionBase> &Func)
-      : IsHostFunction(true), FuncType(Func->getFuncType()), ModuleAddr(0),
-        HostFunc(std::move(Func)) {}
+      : IsHostFunction(true), FuncTypeId(internFuncType(Func->getFuncType())),
+        FuncType(Func->getFuncType()), ModuleAddr(0),
+        Locals(EmptyLocals), Instrs(EmptyInstrs), HostFunc(std::move(Func)) {}
   virtual ~FunctionInstance() = default;
 
   /// Getter of checking is host function.
@@ -54,6 +74,9 @@ public:
   /// Getter of function type.
   const FType &getFuncType() const { return FuncType; }
 
+  /// Getter of canonical function type ID.
+  uint32_t getFuncTypeId() const { return FuncTypeId; }
+
   /// Getter of function body instrs.
   const std::vector<std::pair<uint32_t, ValType>> &getLocals() const {
     return Locals;
@@ -62,23 +85,95 @@ public:
   /// Getter of function body instrs.
   const AST::InstrVec &getInstrs() const { return Instrs; }
 
+  /// Getter of checking the function body is lazily loaded.
+  bool isLazy() const { return LazySeg != nullptr; }
+
+  /// Decode and validate the lazily loaded function body on first call. The
+  /// locals and instructions must not be accessed before success.
+  Expect<void> loadBody() const {
+    if (LazySeg != nullptr) {
+      return LazySeg->decodeBody();
+    }
+    return {};
+  }
+
+  /// Getter of lowered flat code. Empty if not lowered.
+  const FlatCode &getFlatCode() const { return Code; }
+
+  /// Setter of lowered flat code.
+  void setFlatCode(FlatCode &&FCode) { Code = std::move(FCode); }
+
+  /// Count a call or a loop iteration in tiered execution. Safe to be called
+  /// by interpreters on other threads, and only one of them sees the count
+  /// reach the threshold.
+  ///
+  /// \returns true when the count just reaches the threshold.
+  bool countHotness(const uint32_t Threshold) const {
+    return Hotness.fetch_add(1, std::memory_order_relaxed) + 1 == Threshold;
+  }
+
+  /// Reset the count of a function dropped before being promoted, so that it
+  /// reaches the threshold and is requested again.
+  void resetHotness() const { Hotness.store(0, std::memory_order_relaxed); }
+
+  /// Getter of flat code published in tiered execution. Nullptr if not
+  /// published yet. Safe to be called while lowering on another thread.
+  const FlatInstr *getTieredCode() const {
+    return TieredCode.load(std::memory_order_acquire);
+  }
+
+  /// Publish lowered flat code in tiered execution or on first call of lazily
+  /// loaded function. Only called once.
+  void setTieredCode(FlatCode &&FCode) const {
+    Code = std::move(FCode);
+    TieredCode.store(Code.data(), std::memory_order_release);
+  }
+
+  /// Getter of native code published in tiered execution. Nullptr if not
+  /// compiled yet. Safe to be called while compiling on another thread.
+  const NativeCode *getNativeCode() const {
+    return Native.load(std::memory_order_acquire);
+  }
+
+  /// Publish native code compiled from the published flat code. Only called
+  /// once.
+  void setNativeCode(NativeCode &&NCode) const {
+    NativeStore = std::move(NCode);
+    Native.store(&NativeStore, std::memory_order_release);
+  }
+
   /// Getter of host function.
   HostFunctionBase &getHostFunc() const { return *HostFunc.get(); }
 
 private:
   const bool IsHostFunction;
+  const uint32_t FuncTypeId;
   const FType &FuncType;
 
   /// \name Data of function instance for native function.
   /// @{
   const uint32_t ModuleAddr;
-  const std::vector<std::pair<uint32_t, ValType>> Locals;
-  AST::InstrVec Instrs;
+  const std::vector<std::pair<uint32_t, ValType>> &Locals;
+  const AST::InstrVec &Instrs;
+  const AST::CodeSegment *LazySeg = nullptr;
+  std::shared_ptr<const void> CodeOwner;
+  /// Flat code is mutable to be published to the functions in execution.
+  mutable FlatCode Code;
+  /// @}
+
+  /// \name Data of function instance for tiered execution.
+  /// @{
+  mutable std::atomic<uint32_t> Hotness{0};
+  mutable std::atomic<const FlatInstr *> TieredCode{nullptr};
+  mutable NativeCode NativeStore;
+  mutable std::atomic<const NativeCode *> Native{nullptr};
   /// @}
 
   /// \name Data of function instance for host function.
   /// @{
   std::unique_ptr<HostFunctionBase> HostFunc;
+  static inline const std::vector<std::pair<uint32_t, ValType>> EmptyLocals;
+  static inline const AST::InstrVec EmptyInstrs;
   /// @}
 };
 
@@ -13,8 +13,11 @@
 
 #include "common/ast/type.h"
 #include "common/errcode.h"
+#include "common/span.h"
 #include "common/value.h"
+#include "support/allocator.h"
 #include "support/casting.h"
+#include "support/pagetracker.h"
 
 #include <algorithm>
 #include <cstring>
@@ -30,8 +33,26 @@ public:
   MemoryInstance() = delete;
   MemoryInstance(const AST::Limit &Lim)
       : HasMaxPage(Lim.hasMax()), MinPage(Lim.getMin()), MaxPage(Lim.getMax()),
-        CurrPage(Lim.getMin()) {}
-  virtual ~MemoryInstance() = default;
+        CurrPage(Lim.getMin()), DataPtr(Support::Allocator::allocate(MinPage)) {
+  }
+  /// Constructor of memory forked from the image of a memory with the same
+  /// limit. The pages of image are shared until written.
+  MemoryInstance(const bool HasMax, const uint32_t Min, const uint32_t Max,
+                 const Support::MemoryImage &Image)
+      : HasMaxPage(HasMax), MinPage(Min), MaxPage(Max),
+        CurrPage(static_cast<uint32_t>(Image.getSize() /
+                                       Support::Allocator::kPageSize)),
+        MappedSize(Image.getSize()),
+        DataPtr(Support::Allocator::allocate(Image, CurrPage)) {}
+  MemoryInstance(const MemoryInstance &) = delete;
+  MemoryInstance &operator=(const MemoryInstance &) = delete;
+  virtual ~MemoryInstance() {
+    Tracker.stop();
+    Support::Allocator::release(DataPtr);
+  }
+
+  /// Check the guarded range is allocated.
+  bool isAllocated() const { return DataPtr != nullptr; }
 
   /// Get page size of memory.data
   uint32_t getDataPageSize() const { return CurrPage; }
@@ -51,33 +72,64 @@ public:
         Count + CurrPage > 65536) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
+    if (!Support::Allocator::resize(DataPtr, CurrPage, CurrPage + Count)) {
+      return Unexpect(ErrCode::MemorySizeExceeded);
+    }
     CurrPage += Count;
+    Tracker.grow(getDataSize());
     return {};
   }
 
-  /// Get memory length.
-  const Bytes &getDataVector() const { return Data; }
+  /// Getter of dirty page size in bytes.
+  static uint64_t getDirtyPageSize() {
+    return Support::PageTracker::getPageSize();
+  }
+
+  /// Check the dirty pages are tracked.
+  bool isDirtyTracking() const { return Tracker.isTracking(); }
+
+  /// Start tracking dirty pages, or clear the dirty pages when tracking.
+  Expect<void> clearDirtyPages() {
+    if (!Tracker.reset(DataPtr, getDataSize())) {
+      return Unexpect(ErrCode::MemorySizeExceeded);
+    }
+    return {};
+  }
+
+  /// Get indices of pages written since `clearDirtyPages` in ascending order.
+  std::vector<uint64_t> getDirtyPages() const {
+    return Tracker.getDirtyPages();
+  }
+
+
+  /// Getter of data pointer. The base address is fixed after allocation.
+  const uint8_t *getDataPtr() const { return DataPtr; }
+  uint8_t *getDataPtr() { return DataPtr; }
+
+  /// Getter of data size in bytes.
+  uint64_t getDataSize() const {
+    return CurrPage * Support::Allocator::kPageSize;
+  }
 
   /// Get slice of Data[Offset : Offset + Length - 1]
   Expect<Bytes> getBytes(const uint32_t Offset, const uint32_t Length) {
     /// Check memory boundary.
-    if (!checkDataSize(Offset, Length)) {
+    if (!checkAccessBound(Offset, Length)) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
     Bytes Slice;
     if (Length > 0) {
       Slice.resize(Length);
-      std::copy(Data.begin() + Offset, Data.begin() + Offset + Length,
-                Slice.begin());
+      std::copy(DataPtr + Offset, DataPtr + Offset + Length, Slice.begin());
     }
     return Slice;
   }
 
   /// Replace the bytes of Data[Offset :] by Slice[Start : Start + Legnth - 1]
-  Expect<void> setBytes(const Bytes &Slice, const uint32_t Offset,
+  Expect<void> setBytes(Span<const Byte> Slice, const uint32_t Offset,
                         const uint32_t Start, const uint32_t Length) {
     /// Check memory boundary.
-    if (!checkDataSize(Offset, Length)) {
+    if (!checkAccessBound(Offset, Length)) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
 
@@ -87,10 +139,50 @@ public:
       return Unexpect(ErrCode::AccessForbidMemory);
     }
 
-    /// Copy data.
+    /// Copy data. Mark the pages dirty ahead instead of faulting on them.
     if (Length > 0) {
+      Tracker.markDirty(Offset, Length);
       std::copy(Slice.begin() + Start, Slice.begin() + Start + Length,
-                Data.begin() + Offset);
+                DataPtr + Offset);
+    }
+    return {};
+  }
+
+  /// Fill Data[Offset : Offset + Length - 1] with zeros.
+  Expect<void> clearBytes(const uint64_t Offset, const uint64_t Length) {
+    /// Check memory boundary.
+    if (Offset + Length > getDataSize()) {
+      return Unexpect(ErrCode::MemorySizeExceeded);
+    }
+    if (Length > 0) {
+      /// Dropped pages are not written through the tracked protection.
+      Tracker.markDirty(Offset, Length);
+      /// Dropped pages mapped from files read as the files again, so fill
+      /// them.
+      const uint64_t Filled =
+          (Offset < MappedSize) ? std::min(Length, MappedSize - Offset) : 0;
+      std::memset(DataPtr + Offset, 0, Filled);
+      Support::Allocator::zero(DataPtr + Offset + Filled, Length - Filled);
+    }
+    return {};
+  }
+
+  /// Map the file bytes at file offset copy-on-write over
+  /// Data[Offset : Offset + Length - 1]. The offsets and the length must be
+  /// aligned to system pages.
+  Expect<void> mapBytes(const int Fd, const uint64_t FileOffset,
+                        const uint64_t Offset, const uint64_t Length) {
+    /// Check memory boundary.
+    if (Offset + Length > getDataSize()) {
+      return Unexpect(ErrCode::MemorySizeExceeded);
+    }
+    if (Length > 0) {
+      if (!Support::Allocator::map(DataPtr + Offset, Length, Fd, FileOffset)) {
+        return Unexpect(ErrCode::ReadError);
+      }
+      /// Mapped pages are writable and not tracked any more.
+      Tracker.markDirty(Offset, Length);
+      MappedSize = std::max(MappedSize, Offset + Length);
     }
     return {};
   }
@@ -99,17 +191,17 @@ public:
   Expect<void> getArray(uint8_t *Arr, const uint32_t Offset,
                         const uint32_t Length, const bool IsReverse = false) {
     /// Check memory boundary.
-    if (!checkDataSize(Offset, Length)) {
+    if (!checkAccessBound(Offset, Length)) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
     if (Length > 0) {
       /// Copy data.
       if (IsReverse) {
         for (uint32_t I = 0; I < Length; I++) {
-          Arr[I] = Data[Offset + Length - I - 1];
+          Arr[I] = DataPtr[Offset + Length - I - 1];
         }
       } else {
-        std::copy(Data.begin() + Offset, Data.begin() + Offset + Length, Arr);
+        std::copy(DataPtr + Offset, DataPtr + Offset + Length, Arr);
       }
     }
     return {};
@@ -119,17 +211,18 @@ public:
   Expect<void> setArray(const uint8_t *Arr, const uint32_t Offset,
                         const uint32_t Length, const bool IsReverse = false) {
     /// Check memory boundary.
-    if (!checkDataSize(Offset, Length)) {
+    if (!checkAccessBound(Offset, Length)) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
     if (Length > 0) {
-      /// Copy data.
+      /// Copy data. Mark the pages dirty ahead instead of faulting on them.
+      Tracker.markDirty(Offset, Length);
       if (IsReverse) {
         for (uint32_t I = 0; I < Length; I++) {
-          Data[Offset + Length - I - 1] = Arr[I];
+          DataPtr[Offset + Length - I - 1] = Arr[I];
         }
       } else {
-        std::copy(Arr, Arr + Length, Data.begin() + Offset);
+        std::copy(Arr, Arr + Length, DataPtr + Offset);
       }
     }
     return {};
@@ -139,20 +232,26 @@ public:
   template <typename T>
   typename std::enable_if_t<std::is_pointer_v<T>, T>
   getPointerOrNull(const uint32_t Offset) {
-    if (Offset >= Data.size() || Offset == 0) {
+    if (Offset >= getDataSize() || Offset == 0) {
       return nullptr;
     }
-    return reinterpret_cast<T>(&Data[Offset]);
+    return reinterpret_cast<T>(DataPtr + Offset);
   }
 
-  /// Get pointer to specific offset of memory.
+  /// Get pointer to specific offset of memory, or null when out of bound.
+  ///
+  /// Data[Offset : Offset + Length - 1] is bound checked and marked dirty, so
+  /// that writes through the pointer which do not fault on clean pages, such
+  /// as system calls, are tracked. Writes by the host code beyond `Length`
+  /// are still tracked by faulting.
   template <typename T>
   typename std::enable_if_t<std::is_pointer_v<T>, T>
-  getPointer(const uint32_t Offset) {
-    if (Offset >= Data.size()) {
+  getPointer(const uint32_t Offset, const uint32_t Length = 0) {
+    if (Offset >= getDataSize() || !checkAccessBound(Offset, Length)) {
       return nullptr;
     }
-    return reinterpret_cast<T>(&Data[Offset]);
+    Tracker.markDirty(Offset, Length);
+    return reinterpret_cast<T>(DataPtr + Offset);
   }
 
   /// Template of loading bytes and convert to a value.
@@ -174,27 +273,11 @@ public:
       return Unexpect(ErrCode::AccessForbidMemory);
     }
     /// Check memory boundary.
-    if (!checkDataSize(Offset, Length)) {
+    if (!checkAccessBound(Offset, Length)) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
     /// Load data to a value.
-    if (Length > 0) {
-      if (std::is_floating_point_v<T>) {
-        /// Floating case. Do memory copy.
-        std::memcpy(&Value, &Data[Offset], sizeof(T));
-      } else {
-        uint64_t LoadVal = 0;
-        /// Integer case. Extends to result type.
-        std::memcpy(&LoadVal, &Data[Offset], Length);
-        if (std::is_signed_v<T> && (LoadVal >> (Length * 8 - 1))) {
-          /// Signed extend.
-          for (unsigned int I = Length; I < 8; I++) {
-            LoadVal |= 0xFFULL << (I * 8);
-          }
-        }
-        Value = static_cast<T>(LoadVal);
-      }
-    }
+    loadValueUnsafe(Value, Offset, Length);
     return {};
   }
 
@@ -216,39 +299,59 @@ public:
       return Unexpect(ErrCode::AccessForbidMemory);
     }
     /// Check memory boundary.
-    if (!checkDataSize(Offset, Length)) {
+    if (!checkAccessBound(Offset, Length)) {
       return Unexpect(ErrCode::MemorySizeExceeded);
     }
     /// Copy store data to value.
-    if (Length > 0) {
-      std::memcpy(&Data[Offset], &Value, Length);
-    }
+    storeValueUnsafe(Value, Offset, Length);
     return {};
   }
 
-private:
-  /// Check access size is valid and adjust vector.
-  bool checkDataSize(uint32_t Offset, uint32_t Length) {
-    uint64_t AccessLen =
-        static_cast<uint64_t>(Offset) + static_cast<uint64_t>(Length);
-    if (AccessLen > CurrPage * 65536ULL) {
-      return false;
-    }
-    /// Note: the vector size will <= CurrPage * 65536
-    if (Data.size() < Offset + Length) {
-      uint32_t TargetSize = (Offset + Length) / 8 + 1;
-      if (TargetSize < 32 * 65536) {
-        TargetSize *= 2;
-      } else {
-        TargetSize *= 1.1;
-      }
-      if (TargetSize * 8 > CurrPage * 65536) {
-        Data.resize(CurrPage * 65536);
+  /// Unsafe load bytes and convert to a value without boundary checking.
+  ///
+  /// Accesses out of the current pages hit the guard region. Callers must run
+  /// in a `Support::Fault` scope, and the length must <= sizeof(T).
+  template <typename T>
+  typename std::enable_if_t<Support::IsWasmTypeV<T>, void>
+  loadValueUnsafe(T &Value, const uint64_t Offset, const uint32_t Length) {
+    if (Length > 0) {
+      if (std::is_floating_point_v<T>) {
+        /// Floating case. Do memory copy.
+        std::memcpy(&Value, DataPtr + Offset, sizeof(T));
       } else {
-        Data.resize(TargetSize * 8);
+        uint64_t LoadVal = 0;
+        /// Integer case. Extends to result type.
+        std::memcpy(&LoadVal, DataPtr + Offset, Length);
+        if (std::is_signed_v<T> && (LoadVal >> (Length * 8 - 1))) {
+          /// Signed extend.
+          for (unsigned int I = Length; I < 8; I++) {
+            LoadVal |= 0xFFULL << (I * 8);
+          }
+        }
+        Value = static_cast<T>(LoadVal);
       }
     }
-    return true;
+  }
+
+  /// Unsafe destruct and store the value without boundary checking.
+  ///
+  /// Accesses out of the current pages hit the guard region. Callers must run
+  /// in a `Support::Fault` scope, and the length must <= sizeof(T).
+  template <typename T>
+  typename std::enable_if_t<Support::IsWasmBuiltInV<T>, void>
+  storeValueUnsafe(const T &Value, const uint64_t Offset,
+                   const uint32_t Length) {
+    if (Length > 0) {
+      std::memcpy(DataPtr + Offset, &Value, Length);
+    }
+  }
+
+private:
+  /// Check access size is in the current pages.
+  bool checkAccessBound(uint32_t Offset, uint32_t Length) const {
+    const uint64_t AccessLen =
+        static_cast<uint64_t>(Offset) + static_cast<uint64_t>(Length);
+    return AccessLen <= getDataSize();
   }
 
   /// \name Data of memory instance.
@@ -257,7 +360,10 @@ private:
   const uint32_t MinPage;
   const uint32_t MaxPage;
   uint32_t CurrPage;
-  Bytes Data;
+  /// Size from the base in bytes which may be mapped from files.
+  uint64_t MappedSize = 0;
+  uint8_t *DataPtr;
+  Support::PageTracker Tracker;
   /// @}
 };
 
@@ -13,6 +13,7 @@
 
 #include "common/errcode.h"
 #include "common/types.h"
+#include "support/sha256.h"
 #include "type.h"
 
 #include <map>
@@ -31,10 +32,20 @@ public:
 
   const std::string &getModuleName() const { return ModName; }
 
-  /// Copy the function types in type section to module instance.
+  /// Getter and setter of the SHA-256 digest of the module binary, which
+  /// identifies the module of saved states. Empty if not computed in loading.
+  const std::optional<Support::SHA256::Digest> &getHash() const {
+    return Hash;
+  }
+  void setHash(const std::optional<Support::SHA256::Digest> &D) { Hash = D; }
+
+  /// Copy the function types in type section to module instance. The
+  /// canonical type IDs are interned once here, and taken by the function
+  /// instances of the module.
   void addFuncType(const std::vector<ValType> &Params,
                    const std::vector<ValType> &Returns) {
     FuncTypes.emplace_back(Params, Returns);
+    FuncTypeIds.push_back(internFuncType(FuncTypes.back()));
   }
 
   /// Map the external instences between Module and Store.
@@ -80,6 +91,21 @@ public:
     }
     return &FuncTypes[Idx];
   }
+  /// Get canonical function type ID by index. See "runtime/instance/type.h".
+  Expect<uint32_t> getFuncTypeId(const uint32_t Idx) const {
+    if (Idx >= FuncTypeIds.size()) {
+      return Unexpect(ErrCode::WrongInstanceAddress);
+    }
+    return FuncTypeIds[Idx];
+  }
+  /// Get index of function type which is in this module instance.
+  Expect<uint32_t> getFuncTypeIdx(const FType &Type) const {
+    if (FuncTypes.empty() || &Type < &FuncTypes.front() ||
+        &Type > &FuncTypes.back()) {
+      return Unexpect(ErrCode::WrongInstanceAddress);
+    }
+    return static_cast<uint32_t>(&Type - FuncTypes.data());
+  }
   /// Get the external values by index. Addr will be address in Store.
   Expect<uint32_t> getFuncAddr(const uint32_t Idx) const {
     if (Idx >= FuncAddrs.size()) {
@@ -132,9 +158,11 @@ public:
 private:
   /// Module name.
   const std::string ModName;
+  std::optional<Support::SHA256::Digest> Hash;
 
   /// Function types.
   std::vector<FType> FuncTypes;
+  std::vector<uint32_t> FuncTypeIds;
 
   /// Elements address index in this module in Store.
   std::vector<uint32_t> FuncAddrs;
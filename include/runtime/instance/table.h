@@ -14,6 +14,7 @@
 #include "common/ast/type.h"
 #include "common/errcode.h"
 #include "common/types.h"
+#include "type.h"
 
 #include <algorithm>
 #include <cstdint>
@@ -25,12 +26,19 @@ namespace Instance {
 
 class TableInstance {
 public:
+  /// Table element of function address with its canonical function type ID.
+  /// Uninitialized elements have the null function type ID.
+  struct FuncElem {
+    uint32_t Addr = 0;
+    uint32_t TypeId = NullFuncTypeId;
+  };
+
   TableInstance() = delete;
   TableInstance(const ElemType &Elem, const AST::Limit &Lim)
       : Type(Elem), HasMaxSize(Lim.hasMax()), MinSize(Lim.getMin()),
         MaxSize(Lim.getMax()) {
-    if (FuncElem.size() < MinSize) {
-      FuncElem.resize(MinSize);
+    if (FuncElems.size() < MinSize) {
+      FuncElems.resize(MinSize);
     }
   };
   virtual ~TableInstance() = default;
@@ -47,25 +55,28 @@ public:
   /// Getter of limit definition.
   uint32_t getMax() const { return MaxSize; }
 
-  /// Set the function index initialization list.
+  /// Getter of table size.
+  uint32_t getSize() const { return FuncElems.size(); }
+
+  /// Set the function element initialization list.
   Expect<void> setInitList(const uint32_t Offset,
-                           const std::vector<uint32_t> &Addrs) {
-    if (HasMaxSize && Offset + Addrs.size() > MaxSize) {
+                           const std::vector<FuncElem> &Elems) {
+    if (HasMaxSize && Offset + Elems.size() > MaxSize) {
       return Unexpect(ErrCode::TableSizeExceeded);
     }
-    if (FuncElem.size() < Offset + Addrs.size()) {
-      FuncElem.resize(Offset + Addrs.size());
+    if (FuncElems.size() < Offset + Elems.size()) {
+      FuncElems.resize(Offset + Elems.size());
     }
-    std::copy(Addrs.begin(), Addrs.end(), FuncElem.begin() + Offset);
+    std::copy(Elems.begin(), Elems.end(), FuncElems.begin() + Offset);
     return {};
   }
 
-  /// Get the elem address.
-  Expect<uint32_t> getElemAddr(const uint32_t Idx) const {
-    if (Idx >= FuncElem.size()) {
+  /// Get the function element.
+  Expect<const FuncElem *> getElem(const uint32_t Idx) const {
+    if (Idx >= FuncElems.size()) {
       return Unexpect(ErrCode::AccessForbidMemory);
     }
-    return FuncElem[Idx];
+    return &FuncElems[Idx];
   }
 
 private:
@@ -75,7 +86,7 @@ private:
   const bool HasMaxSize;
   const uint32_t MinSize = 0;
   const uint32_t MaxSize = 0;
-  std::vector<uint32_t> FuncElem;
+  std::vector<FuncElem> FuncElems;
   /// @}
 };
 
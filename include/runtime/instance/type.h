@@ -11,6 +11,13 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include "common/types.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 namespace SSVM {
@@ -26,6 +33,24 @@ struct FType {
   std::vector<ValType> Returns;
 };
 
+/// Function type ID of no function, such as uninitialized table elements.
+inline constexpr uint32_t NullFuncTypeId = std::numeric_limits<uint32_t>::max();
+
+/// Intern function type into the canonical function type ID. Function types
+/// with the same parameters and results get the same ID in the process, so
+/// checking the signature of function instances from any store or module
+/// compares the IDs only. Serialized by a lock, so it is called per type of
+/// module instances and per host function, not per function instance.
+inline uint32_t internFuncType(const FType &Type) {
+  static std::mutex Mutex;
+  static std::map<std::pair<std::vector<ValType>, std::vector<ValType>>,
+                  uint32_t>
+      TypeIds;
+  std::lock_guard<std::mutex> Lock(Mutex);
+  const uint32_t NewId = static_cast<uint32_t>(TypeIds.size());
+  return TypeIds.try_emplace({Type.Params, Type.Returns}, NewId).first->second;
+}
+
 } // namespace Instance
 } // namespace Runtime
 } // namespace SSVM
\ No newline at end of file
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/runtime/nativecode.h - Native code definition ----------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the definition of native code, which is compiled from
+/// the flat code of hot functions in tiered execution.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace SSVM {
+namespace Runtime {
+
+/// Native code of function.
+///
+/// The entry is called with the context of the module of function and the
+/// arguments in 8-byte value slots. The memory, globals, and tables are the
+/// instances in store, reached through the context. It returns:
+///   0:         The function returned, and the result is left in the context.
+///   kBailOut:  Stopped before an instruction which traps, or before a basic
+///              block which exceeds the cost limit. The frame is left to be
+///              resumed in flat code at the instruction.
+///   Others:    The error code of a callee.
+struct NativeCode {
+  using EntryFunc = uint32_t (*)(void *Ctx, const uint64_t *Args);
+
+  /// Returned status of bailing out to flat code.
+  static inline constexpr const uint32_t kBailOut = 0x100U;
+
+  EntryFunc Entry = nullptr;
+  /// Costs of basic blocks are compiled in, summed by the cost table of ID.
+  bool Metered = false;
+  uint16_t CostTableId = 0;
+  /// Owner of the compiled code, shared by the forked function instances.
+  std::shared_ptr<const void> Owner;
+};
+
+} // namespace Runtime
+} // namespace SSVM
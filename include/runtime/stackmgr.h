@@ -15,6 +15,7 @@
 #include "common/value.h"
 #include "support/casting.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -23,24 +24,12 @@ namespace Runtime {
 
 class StackManager {
 public:
-  struct Label {
-    Label() = delete;
-    Label(const uint32_t S, const uint32_t C,
-          const AST::BlockControlInstruction *Instr)
-        : StackSize(S), Coarity(C), Target(Instr) {}
-    uint32_t StackSize;
-    uint32_t Coarity;
-    const AST::BlockControlInstruction *Target;
-  };
-
   struct Frame {
     Frame() = delete;
-    Frame(const uint32_t Addr, const uint32_t VS, const uint32_t LS,
-          const uint32_t C)
-        : ModAddr(Addr), VStackSize(VS), LStackSize(LS), Coarity(C) {}
+    Frame(const uint32_t Addr, const uint32_t VS, const uint32_t C)
+        : ModAddr(Addr), VStackSize(VS), Coarity(C) {}
     uint32_t ModAddr;
     uint32_t VStackSize;
-    uint32_t LStackSize;
     uint32_t Coarity;
   };
 
@@ -49,67 +38,79 @@ public:
   /// Stack manager provides the stack control for Wasm execution with VALIDATED
   /// modules. All operations of instructions passed validation, therefore no
   /// unexpect operations will occur.
-  StackManager() {
-    ValueStack.reserve(2048U);
-    LabelStack.reserve(64U);
+  ///
+  /// Values are stored in untagged 8-byte slots of one preallocated buffer.
+  /// The buffer only grows when the top reaches the end.
+  ///
+  /// No label is kept. Branches restore the stack heights resolved in
+  /// validation or lowering.
+  StackManager()
+      : Slots(new Value[kInitSlots]), Top(Slots.get()),
+        End(Slots.get() + kInitSlots) {
     FrameStack.reserve(16U);
   };
   ~StackManager() = default;
 
   /// Getter of stack size.
-  size_t size() const { return ValueStack.size(); }
+  size_t size() const { return Top - Slots.get(); }
 
   /// Unsafe Getter of top entry of stack.
-  Value &getTop() { return ValueStack.back(); }
+  Value &getTop() { return *(Top - 1); }
 
   /// Unsafe Getter of bottom N-th value entry of stack.
-  Value &getBottomN(uint32_t N) { return ValueStack[N]; }
+  Value &getBottomN(uint32_t N) { return Slots[N]; }
+
+  /// Unsafe getter of the top N value entries as an array. Invalidated by
+  /// pushing.
+  Value *getTopN(uint32_t N) { return Top - N; }
+
+  /// Unsafe typed getter of top entry of stack.
+  template <typename T> T &getTopAs() { return retrieveValue<T>(*(Top - 1)); }
+
+  /// Unsafe typed getter of bottom N-th value entry of stack.
+  template <typename T> T &getBottomNAs(uint32_t N) {
+    return retrieveValue<T>(Slots[N]);
+  }
 
   /// Push a new value entry to stack.
   template <typename T> void push(T &&Val) {
-    ValueStack.push_back(std::forward<T>(Val));
+    /// Construct the value first because it may refer to a slot.
+    const Value V(std::forward<T>(Val));
+    if (Top == End) {
+      growValueStack();
+    }
+    *Top++ = V;
   }
 
   /// Unsafe Pop and return the top entry.
-  Value pop() {
-    Value V = std::move(ValueStack.back());
-    ValueStack.pop_back();
-    return V;
-  }
+  Value pop() { return *--Top; }
+
+  /// Unsafe typed pop and return the top entry.
+  template <typename T> T popAs() { return retrieveValue<T>(*--Top); }
+
+  /// Unsafe pop the top N entries.
+  void popN(const uint32_t N) { Top -= N; }
 
   /// Push a new frame entry to stack.
   void pushFrame(const uint32_t ModuleAddr, const uint32_t Arity,
                  const uint32_t Coarity) {
-    FrameStack.emplace_back(ModuleAddr, ValueStack.size() - Arity,
-                            LabelStack.size(), Coarity);
+    FrameStack.emplace_back(ModuleAddr, size() - Arity, Coarity);
   }
 
-  /// Unsafe pop top frame. Return number of popped label.
-  uint32_t popFrame() {
-    uint32_t LabelPopped = LabelStack.size() - FrameStack.back().LStackSize;
-    LabelStack.erase(LabelStack.begin() + FrameStack.back().LStackSize,
-                     LabelStack.end());
-    ValueStack.erase(ValueStack.begin() + FrameStack.back().VStackSize,
-                     ValueStack.end() - FrameStack.back().Coarity);
+  /// Unsafe pop top frame.
+  void popFrame() {
+    eraseValueTo(FrameStack.back().VStackSize, FrameStack.back().Coarity);
     FrameStack.pop_back();
-    return LabelPopped;
   }
 
-  /// Push a new label entry to stack.
-  void pushLabel(const uint32_t Coarity,
-                 const AST::BlockControlInstruction *Instr = nullptr) {
-    LabelStack.emplace_back(ValueStack.size(), Coarity, Instr);
+  /// Unsafe erase values between the frame-relative height and the top arity
+  /// values. Used by branches with precomputed stack heights.
+  void eraseValue(const uint32_t Height, const uint32_t Arity) {
+    eraseValueTo(FrameStack.back().VStackSize + Height, Arity);
   }
 
-  /// Unsafe pop top label.
-  void popLabel(const uint32_t Cnt = 1) {
-    const auto &L = getLabelWithCount(Cnt - 1);
-    ValueStack.erase(ValueStack.begin() + L.StackSize,
-                     ValueStack.end() - L.Coarity);
-    for (uint32_t I = 0; I < Cnt; ++I) {
-      LabelStack.pop_back();
-    }
-  }
+  /// Check if any frame is in stack.
+  bool hasFrame() const { return !FrameStack.empty(); }
 
   /// Unsafe getter of module address.
   uint32_t getModuleAddr() const { return FrameStack.back().ModAddr; }
@@ -119,23 +120,40 @@ public:
     return FrameStack.back().VStackSize + Idx;
   }
 
-  /// Unsafe getter of the top count of label which index start from 0.
-  const Label &getLabelWithCount(const uint32_t Count) const {
-    return LabelStack[LabelStack.size() - Count - 1];
-  }
-
   /// Reset stack.
   void reset() {
-    ValueStack.clear();
-    LabelStack.clear();
+    Top = Slots.get();
     FrameStack.clear();
   }
 
 private:
+  /// Initial count of value slots.
+  static inline constexpr const size_t kInitSlots = 2048U;
+
+  /// Unsafe move the top arity values to the offset and drop the values
+  /// between them.
+  void eraseValueTo(const uint32_t Offset, const uint32_t Arity) {
+    Value *Dst = Slots.get() + Offset;
+    std::copy(Top - Arity, Top, Dst);
+    Top = Dst + Arity;
+  }
+
+  /// Double the value slot buffer.
+  void growValueStack() {
+    const size_t Size = size();
+    const size_t Capacity = (End - Slots.get()) * 2;
+    std::unique_ptr<Value[]> NewSlots(new Value[Capacity]);
+    std::copy(Slots.get(), Top, NewSlots.get());
+    Slots = std::move(NewSlots);
+    Top = Slots.get() + Size;
+    End = Slots.get() + Capacity;
+  }
+
   /// \name Data of stack manager.
   /// @{
-  std::vector<Value> ValueStack;
-  std::vector<Label> LabelStack;
+  std::unique_ptr<Value[]> Slots;
+  Value *Top;
+  Value *End;
   std::vector<Frame> FrameStack;
   /// @}
 };
@@ -39,6 +39,48 @@ inline constexpr const bool IsInstanceV =
     IsEntityV<T> || std::is_same_v<T, Instance::ModuleInstance>;
 } // namespace
 
+/// Template of the instantiated module in a store manager.
+///
+/// Store managers with the same registered instances fork the instantiated
+/// module from the template instead of instantiating it again. Globals and
+/// tables are copied, and the memory pages are shared copy-on-write. The
+/// template keeps the shared code of module alive.
+class StoreTemplate {
+public:
+  StoreTemplate() = default;
+  StoreTemplate(const StoreTemplate &) = delete;
+  StoreTemplate &operator=(const StoreTemplate &) = delete;
+
+private:
+  friend class StoreManager;
+
+  /// Image of memory instance with its limit.
+  struct MemoryImage {
+    bool HasMax;
+    uint32_t Min;
+    uint32_t Max;
+    Support::MemoryImage Image;
+  };
+
+  /// \name Counts of the registered instances before the module.
+  /// @{
+  uint32_t BaseMod = 0;
+  uint32_t BaseFunc = 0;
+  uint32_t BaseTab = 0;
+  uint32_t BaseMem = 0;
+  uint32_t BaseGlob = 0;
+  /// @}
+
+  /// \name Instances of the instantiated module.
+  /// @{
+  std::vector<std::unique_ptr<Instance::ModuleInstance>> ModInsts;
+  std::vector<std::unique_ptr<Instance::FunctionInstance>> FuncInsts;
+  std::vector<std::unique_ptr<Instance::TableInstance>> TabInsts;
+  std::vector<MemoryImage> MemImages;
+  std::vector<std::unique_ptr<Instance::GlobalInstance>> GlobInsts;
+  /// @}
+};
+
 class StoreManager {
 public:
   StoreManager() : NumMod(0), NumFunc(0), NumTab(0), NumMem(0), NumGlob(0) {}
@@ -169,6 +211,102 @@ public:
     return Unexpect(ErrCode::WrongInstanceAddress);
   }
 
+  /// Make template from the instances of the instantiated module, which may
+  /// be initialized by executions. The instances should not be changed in
+  /// between.
+  Expect<std::shared_ptr<const StoreTemplate>> makeTemplate() const {
+    auto Tmpl = std::make_shared<StoreTemplate>();
+    Tmpl->BaseMod = ModInsts.size() - NumMod;
+    Tmpl->BaseFunc = FuncInsts.size() - NumFunc;
+    Tmpl->BaseTab = TabInsts.size() - NumTab;
+    Tmpl->BaseMem = MemInsts.size() - NumMem;
+    Tmpl->BaseGlob = GlobInsts.size() - NumGlob;
+    for (uint32_t I = Tmpl->BaseMod; I < ModInsts.size(); ++I) {
+      Tmpl->ModInsts.push_back(
+          std::make_unique<Instance::ModuleInstance>(*ModInsts[I]));
+    }
+    for (uint32_t I = Tmpl->BaseFunc; I < FuncInsts.size(); ++I) {
+      /// Functions of the instantiated module are in the copied modules.
+      const uint32_t ModAddr = FuncInsts[I]->getModuleAddr();
+      if (ModAddr < Tmpl->BaseMod || ModAddr >= ModInsts.size()) {
+        return Unexpect(ErrCode::WrongInstanceAddress);
+      }
+      auto Type =
+          getForkedFuncType(*FuncInsts[I], *ModInsts[ModAddr],
+                            *Tmpl->ModInsts[ModAddr - Tmpl->BaseMod]);
+      if (!Type) {
+        return Unexpect(Type);
+      }
+      Tmpl->FuncInsts.push_back(
+          std::make_unique<Instance::FunctionInstance>(*FuncInsts[I], **Type));
+    }
+    for (uint32_t I = Tmpl->BaseTab; I < TabInsts.size(); ++I) {
+      Tmpl->TabInsts.push_back(
+          std::make_unique<Instance::TableInstance>(*TabInsts[I]));
+    }
+    for (uint32_t I = Tmpl->BaseMem; I < MemInsts.size(); ++I) {
+      const auto &MemInst = *MemInsts[I];
+      StoreTemplate::MemoryImage MemImage{MemInst.getHasMax(),
+                                          MemInst.getMin(), MemInst.getMax(),
+                                          Support::MemoryImage()};
+      if (!MemImage.Image.capture(MemInst.getDataPtr(),
+                                  MemInst.getDataSize())) {
+        return Unexpect(ErrCode::MemorySizeExceeded);
+      }
+      Tmpl->MemImages.push_back(std::move(MemImage));
+    }
+    for (uint32_t I = Tmpl->BaseGlob; I < GlobInsts.size(); ++I) {
+      Tmpl->GlobInsts.push_back(
+          std::make_unique<Instance::GlobalInstance>(*GlobInsts[I]));
+    }
+    return Tmpl;
+  }
+
+  /// Fork the instantiated module from template. The registered instances
+  /// should be the same as the ones of the store manager of template.
+  Expect<void> fork(const StoreTemplate &Tmpl) {
+    reset();
+    if (ModInsts.size() != Tmpl.BaseMod || FuncInsts.size() != Tmpl.BaseFunc ||
+        TabInsts.size() != Tmpl.BaseTab || MemInsts.size() != Tmpl.BaseMem ||
+        GlobInsts.size() != Tmpl.BaseGlob) {
+      return Unexpect(ErrCode::WrongInstanceAddress);
+    }
+    for (auto &It : Tmpl.ModInsts) {
+      auto NewModInst = std::make_unique<Instance::ModuleInstance>(*It);
+      pushModule(NewModInst);
+    }
+    for (auto &It : Tmpl.FuncInsts) {
+      const uint32_t ModAddr = It->getModuleAddr();
+      auto Type = getForkedFuncType(
+          *It, *Tmpl.ModInsts[ModAddr - Tmpl.BaseMod], *ModInsts[ModAddr]);
+      if (!Type) {
+        reset();
+        return Unexpect(Type);
+      }
+      auto NewFuncInst =
+          std::make_unique<Instance::FunctionInstance>(*It, **Type);
+      pushFunction(NewFuncInst);
+    }
+    for (auto &It : Tmpl.TabInsts) {
+      auto NewTabInst = std::make_unique<Instance::TableInstance>(*It);
+      pushTable(NewTabInst);
+    }
+    for (auto &It : Tmpl.MemImages) {
+      auto NewMemInst = std::make_unique<Instance::MemoryInstance>(
+          It.HasMax, It.Min, It.Max, It.Image);
+      if (!NewMemInst->isAllocated()) {
+        reset();
+        return Unexpect(ErrCode::MemorySizeExceeded);
+      }
+      pushMemory(NewMemInst);
+    }
+    for (auto &It : Tmpl.GlobInsts) {
+      auto NewGlobInst = std::make_unique<Instance::GlobalInstance>(*It);
+      pushGlobal(NewGlobInst);
+    }
+    return {};
+  }
+
   /// Reset store.
   void reset(bool IsResetRegistered = false) {
     if (IsResetRegistered) {
@@ -238,6 +376,19 @@ private:
     return Addr;
   }
 
+  /// Helper function for getting the function type of forked function in the
+  /// forked module instance.
+  static Expect<const Instance::FType *>
+  getForkedFuncType(const Instance::FunctionInstance &Func,
+                    const Instance::ModuleInstance &SrcMod,
+                    const Instance::ModuleInstance &DstMod) {
+    if (auto Idx = SrcMod.getFuncTypeIdx(Func.getFuncType())) {
+      return DstMod.getFuncType(*Idx);
+    } else {
+      return Unexpect(Idx);
+    }
+  }
+
   /// Helper function for getting instance from instance vector.
   template <typename T>
   std::enable_if_t<IsInstanceV<T>, Expect<T *>>
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/allocator.h - Linear memory allocator ----------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the guarded allocator of wasm linear memory.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "support/fault.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace SSVM {
+namespace Support {
+
+/// Image of linear memory in an anonymous memory file.
+///
+/// Memories forked from the image map the file privately, so the pages are
+/// shared until written, and then copied on write.
+class MemoryImage {
+public:
+  MemoryImage() = default;
+  MemoryImage(const MemoryImage &) = delete;
+  MemoryImage &operator=(const MemoryImage &) = delete;
+  MemoryImage(MemoryImage &&Other) noexcept
+      : Fd(Other.Fd), Size(Other.Size) {
+    Other.Fd = -1;
+    Other.Size = 0;
+  }
+  ~MemoryImage() noexcept {
+    if (Fd >= 0) {
+      close(Fd);
+    }
+  }
+
+  /// Copy the committed bytes into a new memory file. Zero system pages are
+  /// left as holes of the file.
+  ///
+  /// \returns true when success.
+  bool capture(const uint8_t *Ptr, const uint64_t Len) noexcept {
+    int NewFd = memfd_create("ssvm-memory", MFD_CLOEXEC);
+    if (NewFd < 0) {
+      return false;
+    }
+    if (ftruncate(NewFd, static_cast<off_t>(Len)) != 0) {
+      close(NewFd);
+      return false;
+    }
+    const uint64_t SysPage = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    for (uint64_t Off = 0; Off < Len; Off += SysPage) {
+      const uint64_t Cnt = std::min(SysPage, Len - Off);
+      const uint8_t *Page = Ptr + Off;
+      if (Page[0] == 0 && std::memcmp(Page, Page + 1, Cnt - 1) == 0) {
+        continue;
+      }
+      for (uint64_t Done = 0; Done < Cnt;) {
+        ssize_t Res = pwrite(NewFd, Page + Done, Cnt - Done,
+                             static_cast<off_t>(Off + Done));
+        if (Res <= 0) {
+          close(NewFd);
+          return false;
+        }
+        Done += static_cast<uint64_t>(Res);
+      }
+    }
+    if (Fd >= 0) {
+      close(Fd);
+    }
+    Fd = NewFd;
+    Size = Len;
+    return true;
+  }
+
+  /// Getter of file descriptor, or -1 when not captured.
+  int getFd() const noexcept { return Fd; }
+
+  /// Getter of image size in bytes.
+  uint64_t getSize() const noexcept { return Size; }
+
+private:
+  int Fd = -1;
+  uint64_t Size = 0;
+};
+
+/// Allocator of linear memory with guard region.
+///
+/// The whole addressable range of a wasm memory, 4 GiB for the index plus
+/// 4 GiB for the static offset of memory instructions, is reserved as
+/// inaccessible virtual memory. Pages are committed by changing protection
+/// when memory grows, so the base address never moves. Any access with
+/// 32-bit index and 32-bit offset out of the committed pages lands in the
+/// guard region and raises SIGSEGV, which is handled by `Support::Fault`.
+/// The reserved range is registered as a guard region until released.
+class Allocator {
+public:
+  /// Wasm page size.
+  static inline constexpr const uint64_t kPageSize = 65536ULL;
+  /// Maximum page count of wasm memory.
+  static inline constexpr const uint64_t kMaxPageCount = 65536ULL;
+  /// Reserved bytes: index range, offset range, and access length.
+  static inline constexpr const uint64_t kReserveSize =
+      kPageSize * kMaxPageCount * 2 + kPageSize;
+
+  /// Reserve guarded range and commit the first pages.
+  ///
+  /// \param PageCount the initial page count.
+  ///
+  /// \returns base pointer, or nullptr when failed.
+  static uint8_t *allocate(const uint32_t PageCount) noexcept {
+    void *Ptr = mmap(nullptr, kReserveSize, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (Ptr == MAP_FAILED) {
+      return nullptr;
+    }
+    uint8_t *Base = static_cast<uint8_t *>(Ptr);
+    if (!Fault::addGuard(Base, kReserveSize)) {
+      munmap(Ptr, kReserveSize);
+      return nullptr;
+    }
+    if (!resize(Base, 0, PageCount)) {
+      release(Base);
+      return nullptr;
+    }
+    return Base;
+  }
+
+  /// Reserve guarded range, map the image copy-on-write at the base, and
+  /// commit the pages after the image up to the page count.
+  ///
+  /// \returns base pointer, or nullptr when failed.
+  static uint8_t *allocate(const MemoryImage &Image,
+                           const uint32_t PageCount) noexcept {
+    uint8_t *Base = allocate(0);
+    if (Base == nullptr) {
+      return nullptr;
+    }
+    const uint32_t ImagePageCount =
+        static_cast<uint32_t>(Image.getSize() / kPageSize);
+    if (Image.getSize() > 0 &&
+        !map(Base, Image.getSize(), Image.getFd(), 0)) {
+      release(Base);
+      return nullptr;
+    }
+    if (!resize(Base, ImagePageCount, PageCount)) {
+      release(Base);
+      return nullptr;
+    }
+    return Base;
+  }
+
+  /// Commit pages from old page count to new page count.
+  ///
+  /// \returns true when success.
+  static bool resize(uint8_t *Base, const uint32_t OldPageCount,
+                     const uint32_t NewPageCount) noexcept {
+    if (NewPageCount > kMaxPageCount) {
+      return false;
+    }
+    if (NewPageCount <= OldPageCount) {
+      return true;
+    }
+    return mprotect(Base + OldPageCount * kPageSize,
+                    (NewPageCount - OldPageCount) * kPageSize,
+                    PROT_READ | PROT_WRITE) == 0;
+  }
+
+  /// Map the bytes of file copy-on-write over the committed bytes. The
+  /// pointer and the file offset must be aligned to system pages.
+  ///
+  /// \returns true when success.
+  static bool map(uint8_t *Ptr, const uint64_t Size, const int Fd,
+                  const uint64_t FileOffset) noexcept {
+    return mmap(Ptr, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                Fd, static_cast<off_t>(FileOffset)) != MAP_FAILED;
+  }
+
+  /// Fill committed bytes with zeros.
+  ///
+  /// Whole system pages in the range are returned to the system and read as
+  /// zeros again, so that clearing large ranges neither touches nor keeps
+  /// the pages resident. Pages mapped from files would read as the files
+  /// again, so they must not be cleared by this function.
+  static void zero(uint8_t *Ptr, const uint64_t Size) noexcept {
+    const uint64_t SysPage = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t Begin = reinterpret_cast<uintptr_t>(Ptr);
+    const uint64_t End = Begin + Size;
+    const uint64_t AlignedBegin = (Begin + SysPage - 1) / SysPage * SysPage;
+    const uint64_t AlignedEnd = End / SysPage * SysPage;
+    if (AlignedBegin >= AlignedEnd ||
+        madvise(reinterpret_cast<void *>(AlignedBegin),
+                AlignedEnd - AlignedBegin, MADV_DONTNEED) != 0) {
+      std::memset(Ptr, 0, Size);
+      return;
+    }
+    std::memset(Ptr, 0, AlignedBegin - Begin);
+    std::memset(reinterpret_cast<void *>(AlignedEnd), 0, End - AlignedEnd);
+  }
+
+  /// Release the whole reserved range.
+  static void release(uint8_t *Base) noexcept {
+    if (Base != nullptr) {
+      Fault::removeGuard(Base);
+      munmap(Base, kReserveSize);
+    }
+  }
+};
+
+} // namespace Support
+} // namespace SSVM
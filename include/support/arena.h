@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/arena.h - Arena allocator ----------------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the arena allocator, which bumps objects into chunks
+/// and releases them all at once.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "common/span.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace SSVM {
+namespace Support {
+
+/// Bump allocator of chunks.
+///
+/// Objects in arena are never destructed. They must not own resources out of
+/// the arena, and are released with the chunks when the arena is destroyed.
+/// Not thread-safe. Concurrent users allocate in their own arenas and merge
+/// them afterwards.
+class Arena {
+public:
+  /// Size of chunk. Larger allocations get chunks of their own.
+  static inline constexpr size_t ChunkSize = 64 * 1024;
+
+  Arena() noexcept = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  Arena(Arena &&) noexcept = default;
+  Arena &operator=(Arena &&) noexcept = default;
+
+  /// Allocate uninitialized bytes.
+  void *allocate(const size_t Size, const size_t Align) {
+    uintptr_t Addr = (reinterpret_cast<uintptr_t>(Curr) + Align - 1) &
+                     ~static_cast<uintptr_t>(Align - 1);
+    if (Curr == nullptr || Addr + Size > reinterpret_cast<uintptr_t>(End)) {
+      if (Size + Align > ChunkSize / 4) {
+        /// Keep the current chunk for the following small allocations.
+        Chunks.push_back(std::make_unique<std::byte[]>(Size + Align));
+        Used += Size + Align;
+        Addr = (reinterpret_cast<uintptr_t>(Chunks.back().get()) + Align - 1) &
+               ~static_cast<uintptr_t>(Align - 1);
+        return reinterpret_cast<void *>(Addr);
+      }
+      Chunks.push_back(std::make_unique<std::byte[]>(ChunkSize));
+      Used += ChunkSize;
+      Curr = Chunks.back().get();
+      End = Curr + ChunkSize;
+      Addr = (reinterpret_cast<uintptr_t>(Curr) + Align - 1) &
+             ~static_cast<uintptr_t>(Align - 1);
+    }
+    Curr = reinterpret_cast<std::byte *>(Addr + Size);
+    return reinterpret_cast<void *>(Addr);
+  }
+
+  /// Construct an object in arena.
+  template <typename T, typename... ArgsT> T *make(ArgsT &&... Args) {
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<ArgsT>(Args)...);
+  }
+
+  /// Copy the elements into arena.
+  template <typename T> Span<T> copy(const T *Ptr, const size_t Size) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Only trivially copyable elements are copied.");
+    if (Size == 0) {
+      return {};
+    }
+    T *Buf = static_cast<T *>(allocate(sizeof(T) * Size, alignof(T)));
+    std::memcpy(Buf, Ptr, sizeof(T) * Size);
+    return Span<T>(Buf, Size);
+  }
+  template <typename T> Span<T> copy(const std::vector<T> &Vec) {
+    return copy(Vec.data(), Vec.size());
+  }
+
+  /// Take over the chunks of other arena.
+  void merge(Arena &&Other) {
+    Chunks.insert(Chunks.end(), std::make_move_iterator(Other.Chunks.begin()),
+                  std::make_move_iterator(Other.Chunks.end()));
+    Used += Other.Used;
+    Other.Chunks.clear();
+    Other.Curr = Other.End = nullptr;
+    Other.Used = 0;
+  }
+
+  /// Getter of bytes of chunks.
+  size_t getUsedSize() const noexcept { return Used; }
+
+private:
+  std::vector<std::unique_ptr<std::byte[]>> Chunks;
+  std::byte *Curr = nullptr;
+  std::byte *End = nullptr;
+  size_t Used = 0;
+};
+
+} // namespace Support
+} // namespace SSVM
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/fault.h - Memory fault handler -----------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the handler which turns faults in the guard region of
+/// linear memory into error codes.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "common/errcode.h"
+
+#include <csetjmp>
+#include <cstdint>
+
+namespace SSVM {
+namespace Support {
+
+/// Scope of fault protection.
+///
+/// Construct a Fault object in the protected frame, and call `sigsetjmp` on
+/// its buffer with `savesigs` 0. A SIGSEGV or SIGBUS raised by the current
+/// thread in the scope jumps back with the error code as the return value:
+///
+///   Support::Fault FaultHandler;
+///   if (const int Err = sigsetjmp(FaultHandler.getBuffer(), 0); Err != 0) {
+///     return Unexpect(static_cast<ErrCode>(Err));
+///   }
+///
+/// Only faults in the guard regions registered by `addGuard` are turned into
+/// error codes. The other faults, and faults out of any scope, go to the
+/// handler installed before, except the first writes to pages tracked by
+/// `Support::PageTracker`. Jumping back skips the frames in between, so the
+/// frames must not own resources, and code which does, such as host
+/// functions, must run in a `FaultBlocker` scope.
+class Fault {
+public:
+  Fault();
+  ~Fault() noexcept;
+  Fault(const Fault &) = delete;
+  Fault &operator=(const Fault &) = delete;
+
+  /// Getter of jump buffer.
+  sigjmp_buf &getBuffer() noexcept { return Buffer; }
+
+  /// Install the handler of current process once.
+  static void install();
+
+  /// Jump back to the innermost fault scope of current thread.
+  [[noreturn]] static void emitFault(const ErrCode Error);
+
+  /// Register the guard region [Base, Base + Size).
+  ///
+  /// \returns false when too many regions are registered.
+  static bool addGuard(const void *Base, const uint64_t Size) noexcept;
+
+  /// Unregister the guard region starting from base.
+  static void removeGuard(const void *Base) noexcept;
+
+private:
+  Fault *Prev;
+  sigjmp_buf Buffer;
+};
+
+/// Scope without fault protection.
+///
+/// Faults raised by the current thread in the scope are not turned into error
+/// codes even in an outer fault scope.
+class FaultBlocker {
+public:
+  FaultBlocker() noexcept;
+  ~FaultBlocker() noexcept;
+  FaultBlocker(const FaultBlocker &) = delete;
+  FaultBlocker &operator=(const FaultBlocker &) = delete;
+
+private:
+  Fault *Saved;
+};
+
+} // namespace Support
+} // namespace SSVM
@@ -2,8 +2,13 @@
 #pragma once
 
 #include "common/ast/instruction.h"
+#include "profile.h"
 #include "time.h"
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 namespace SSVM {
@@ -11,28 +16,54 @@ namespace Support {
 
 class Measurement {
 public:
+  /// ID of cost tables which are not interned.
+  static inline constexpr const uint16_t kUnknownCostTable = UINT16_MAX;
+
   Measurement(const uint64_t Lim = UINT64_MAX)
-      : CostTab(256, 0ULL), InstrCnt(0), CostLimit(Lim), CostSum(0) {}
+      : CostTab(256, 0ULL), CostTabId(internCostTable(CostTab)), InstrCnt(0),
+        CostLimit(Lim), CostSum(0) {}
   Measurement(const std::vector<uint64_t> &Tab, const uint64_t Lim = UINT64_MAX)
       : CostTab(Tab), InstrCnt(0), CostLimit(Lim), CostSum(0) {
     if (CostTab.size() < 256) {
       CostTab.resize(256);
     }
+    CostTabId = internCostTable(CostTab);
   }
   ~Measurement() = default;
 
   /// Increament of instruction counter.
   void incInstrCnt() { ++InstrCnt; }
 
+  /// Increament of instruction counter by count.
+  void addInstrCnt(const uint64_t Cnt) { InstrCnt += Cnt; }
+
+  /// Decreament of instruction counter by count.
+  void subInstrCnt(const uint64_t Cnt) { InstrCnt -= Cnt; }
+
   /// Getter of instruction counter.
   uint64_t getInstrCnt() const { return InstrCnt; }
 
-  /// Setter of cost table.
+  /// Getter reference of instruction counter, for compiled code counting in
+  /// place.
+  uint64_t &getInstrCounter() { return InstrCnt; }
+
+  /// Setter of cost table. Costs charged afterwards follow the new table,
+  /// including the code lowered with the old one.
   void setCostTable(const std::vector<uint64_t> &NewTable) {
     CostTab = NewTable;
     if (CostTab.size() < 256) {
       CostTab.resize(256);
     }
+    CostTabId = internCostTable(CostTab);
+  }
+
+  /// Getter of cost table ID. Tables with the same costs have the same ID,
+  /// so that costs summed by a table are valid while the ID is unchanged.
+  uint16_t getCostTableId() const { return CostTabId; }
+
+  /// Getter of instruction cost.
+  uint64_t getInstrCost(const AST::Instruction::OpCode &Code) const {
+    return CostTab[static_cast<uint64_t>(Code)];
   }
 
   /// Adder for instruction costs.
@@ -69,19 +100,55 @@ public:
   /// Getter of time recorder.
   Support::TimeRecord &getTimeRecorder() { return TimeRecorder; }
 
+  /// Enable profiling of opcodes and function calls. The profile is written
+  /// into `<OutputPath>.json` and `<OutputPath>.folded` after execution if
+  /// the output path is not empty.
+  void enableProfile(const std::string &OutputPath = "") {
+    if (!Prof) {
+      Prof = std::make_unique<Profile>();
+    }
+    Prof->setOutputPath(OutputPath);
+  }
+
+  /// Disable profiling and drop the profile.
+  void disableProfile() { Prof.reset(); }
+
+  /// Getter of profile. Return nullptr if profiling is disabled.
+  Profile *getProfile() { return Prof.get(); }
+
   /// Clear measurement data for instructions.
   void clear() {
     TimeRecorder.reset();
     InstrCnt = 0;
+    if (Prof) {
+      Prof->clear();
+    }
   }
 
 private:
+  /// Get the ID of cost table, or kUnknownCostTable if too many tables.
+  static uint16_t internCostTable(const std::vector<uint64_t> &Table) {
+    static std::mutex Mutex;
+    static std::map<std::vector<uint64_t>, uint16_t> IDs;
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (auto It = IDs.find(Table); It != IDs.end()) {
+      return It->second;
+    }
+    if (IDs.size() >= kUnknownCostTable) {
+      return kUnknownCostTable;
+    }
+    const uint16_t ID = static_cast<uint16_t>(IDs.size());
+    IDs.emplace(Table, ID);
+    return ID;
+  }
+
   Support::TimeRecord TimeRecorder;
   std::vector<uint64_t> CostTab;
+  uint16_t CostTabId;
   uint64_t InstrCnt;
   uint64_t CostLimit;
   uint64_t CostSum;
-  /// TODO: Can add a instruction statistics for OpCodes.
+  std::unique_ptr<Profile> Prof;
 };
 
 } // namespace Support
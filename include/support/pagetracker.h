@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/pagetracker.h - Dirty page tracker -------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the tracker of written pages in linear memory.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace SSVM {
+namespace Support {
+
+/// Tracker of written system pages in a committed range.
+///
+/// Clean pages are write-protected. The first write to a clean page raises
+/// SIGSEGV, which the handler of `Support::Fault` resolves by marking the
+/// page dirty and unprotecting it, and then the write is retried. So writes
+/// from every path, including compiled code and host functions, are recorded
+/// and only the first write of each page pays for it.
+///
+/// System calls writing into clean pages fail with EFAULT instead of
+/// faulting, so the ranges are marked dirty ahead with `markDirty` when
+/// memory instances hand out pointers or copy bytes in.
+class PageTracker {
+public:
+  PageTracker() = default;
+  ~PageTracker() noexcept { stop(); }
+  PageTracker(const PageTracker &) = delete;
+  PageTracker &operator=(const PageTracker &) = delete;
+
+  /// Getter of tracked page size, which is the system page size.
+  static uint64_t getPageSize() noexcept;
+
+  /// Check the tracking is started.
+  bool isTracking() const noexcept { return Slot >= 0; }
+
+  /// Start tracking the committed range, or clear the dirty pages when
+  /// tracking. All pages are clean afterwards.
+  ///
+  /// \returns true when success.
+  bool reset(uint8_t *Base, const uint64_t Size) noexcept;
+
+  /// Extend the tracked range after the committed range grows. The new pages
+  /// are clean.
+  void grow(const uint64_t NewSize) noexcept;
+
+  /// Mark the pages in range dirty, for writes which do not fault.
+  void markDirty(const uint64_t Offset, const uint64_t Length) noexcept;
+
+  /// Get the indices of dirty pages in ascending order.
+  std::vector<uint64_t> getDirtyPages() const;
+
+  /// Stop tracking. The whole range is writable afterwards.
+  void stop() noexcept;
+
+  /// Resolve the fault at address in signal handler.
+  ///
+  /// \returns true when the address is in a clean tracked page, which is
+  /// writable then.
+  static bool resolveFault(const void *Addr) noexcept;
+
+private:
+  /// Index of registered slot, or -1 when not tracking.
+  int32_t Slot = -1;
+};
+
+} // namespace Support
+} // namespace SSVM
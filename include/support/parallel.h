@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/parallel.h - Parallel loop helpers -------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the helpers to run independent tasks on worker threads.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace SSVM {
+namespace Support {
+
+/// Get the worker count for running tasks.
+///
+/// \param Threads the requested thread count, 0 for hardware threads.
+/// \param Count the task count.
+///
+/// \returns worker count, at least 1.
+inline uint32_t getWorkerCount(uint32_t Threads, const size_t Count) {
+  if (Threads == 0) {
+    Threads = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+  return static_cast<uint32_t>(
+      std::max<size_t>(std::min<size_t>(Threads, Count), 1));
+}
+
+/// Run tasks of indices [0, Count) on worker threads.
+///
+/// Workers claim indices in increasing order and call `Func(Worker, Index)`,
+/// where `Worker` is in [0, Workers) and identifies the calling thread, so
+/// that callers can keep per-worker state. A task fails when `Func` returns
+/// false. After a failure, tasks with larger indices are skipped while the
+/// smaller ones still run, so the result is the same as running in order.
+///
+/// \param Count the task count.
+/// \param Workers the worker count. Tasks run on the caller thread if 1.
+/// \param Func the task function.
+///
+/// \returns the smallest failed index, or Count if all tasks succeeded.
+template <typename FuncT>
+size_t parallelFor(const size_t Count, const uint32_t Workers, FuncT &&Func) {
+  if (Workers <= 1) {
+    for (size_t Idx = 0; Idx < Count; ++Idx) {
+      if (!Func(0U, Idx)) {
+        return Idx;
+      }
+    }
+    return Count;
+  }
+
+  std::atomic<size_t> Next(0);
+  std::atomic<size_t> Failed(Count);
+  auto Worker = [&](const uint32_t Id) {
+    while (true) {
+      const size_t Idx = Next.fetch_add(1, std::memory_order_relaxed);
+      if (Idx >= Count || Idx > Failed.load(std::memory_order_relaxed)) {
+        break;
+      }
+      if (!Func(Id, Idx)) {
+        size_t Prev = Failed.load(std::memory_order_relaxed);
+        while (Idx < Prev && !Failed.compare_exchange_weak(Prev, Idx)) {
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  Threads.reserve(Workers - 1);
+  for (uint32_t Id = 1; Id < Workers; ++Id) {
+    Threads.emplace_back(Worker, Id);
+  }
+  Worker(0U);
+  for (auto &Thread : Threads) {
+    Thread.join();
+  }
+  return Failed.load();
+}
+
+} // namespace Support
+} // namespace SSVM
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/profile.h - Execution profile ------------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the profile of executed opcodes and function calls.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SSVM {
+namespace Support {
+
+/// Profile of an execution.
+///
+/// Records the histogram of executed opcodes, and the calls, instruction
+/// counts and time of functions. Functions are identified by opaque keys,
+/// which are the addresses of function instances, and named by
+/// `setFunctionName` before dumping.
+///
+/// The inclusive figures of a function count its callees, and the exclusive
+/// ones do not. The inclusive figures of recursive calls are counted at the
+/// outermost call only.
+class Profile {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Count executed instructions of opcode.
+  void countInstr(const uint8_t Code, const uint64_t Cnt = 1) {
+    OpCodeCnt[Code] += Cnt;
+  }
+
+  /// Revert counted instructions of opcode, which are not executed.
+  void uncountInstr(const uint8_t Code, const uint64_t Cnt = 1) {
+    OpCodeCnt[Code] -= Cnt;
+  }
+
+  /// Record entering the function with the current instruction count.
+  void enterFunction(const void *Func, const uint64_t InstrCnt);
+
+  /// Record leaving the current function with the current instruction count.
+  void leaveFunction(const uint64_t InstrCnt);
+
+  /// Leave all entered functions, such as after traps.
+  void leaveAllFunctions(const uint64_t InstrCnt);
+
+  /// Record the call of host function and its latency.
+  void recordHostCall(const void *Func, const Clock::duration Latency);
+
+  /// Setter of the name of function in outputs.
+  void setFunctionName(const void *Func, std::string Name) {
+    Names[Func] = std::move(Name);
+  }
+
+  /// Getter and setter of the output path prefix. Interpreter writes the
+  /// profile into `<Path>.json` and `<Path>.folded` after execution if set.
+  const std::string &getOutputPath() const { return OutputPath; }
+  void setOutputPath(std::string Path) { OutputPath = std::move(Path); }
+
+  /// Write the profile in JSON.
+  void dumpJSON(std::ostream &OS) const;
+
+  /// Write the call stacks in collapsed format, which is one line of
+  /// semicolon separated frames and exclusive instruction count per stack,
+  /// for flame graph tools.
+  void dumpCollapsed(std::ostream &OS) const;
+
+  /// Clear recorded data. Names and output path are kept.
+  void clear();
+
+private:
+  /// Statistics of a native function.
+  struct FuncStat {
+    uint64_t Calls = 0;
+    uint64_t InclInstr = 0;
+    uint64_t ExclInstr = 0;
+    Clock::duration InclTime{};
+    Clock::duration ExclTime{};
+    /// Count of active calls, for recursions.
+    uint32_t Active = 0;
+  };
+  /// Statistics of a host function.
+  struct HostStat {
+    uint64_t Calls = 0;
+    Clock::duration Time{};
+  };
+  /// Node of call tree, which is a unique call stack.
+  struct StackNode {
+    uint32_t Parent;
+    const void *Func;
+    uint64_t ExclInstr;
+  };
+  /// Active call.
+  struct Frame {
+    const void *Func;
+    uint32_t Node;
+    uint64_t StartInstr;
+    Clock::time_point StartTime;
+    uint64_t ChildInstr;
+    Clock::duration ChildTime;
+  };
+
+  std::string getName(const void *Func) const;
+
+  std::array<uint64_t, 256> OpCodeCnt{};
+  std::unordered_map<const void *, FuncStat> Funcs;
+  std::unordered_map<const void *, HostStat> Hosts;
+  std::unordered_map<const void *, std::string> Names;
+  /// Call tree nodes and the index of children. Node 0 is the root.
+  std::vector<StackNode> Nodes{{0, nullptr, 0}};
+  std::map<std::pair<uint32_t, const void *>, uint32_t> Children;
+  std::vector<Frame> Frames;
+  std::string OutputPath;
+};
+
+} // namespace Support
+} // namespace SSVM
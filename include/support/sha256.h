@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/support/sha256.h - SHA-256 digest ----------------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contains the SHA-256 digest used to name and verify cached and
+/// saved artifacts.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SSVM {
+namespace Support {
+
+/// Incremental SHA-256 as specified in FIPS 180-4.
+class SHA256 {
+public:
+  using Digest = std::array<uint8_t, 32>;
+
+  SHA256() noexcept;
+
+  /// Append bytes to the message.
+  void update(const void *Data, const size_t Size) noexcept;
+  void update(const std::string &Str) noexcept {
+    update(Str.data(), Str.size());
+  }
+
+  /// Pad the message and get the digest. The object must not be updated
+  /// afterwards.
+  Digest finalize() noexcept;
+
+  /// Digest of the bytes.
+  static Digest hash(const void *Data, const size_t Size) noexcept {
+    SHA256 Hasher;
+    Hasher.update(Data, Size);
+    return Hasher.finalize();
+  }
+
+  /// Lower case hex string of the digest.
+  static std::string toHex(const Digest &D);
+
+private:
+  void compress(const uint8_t *Block) noexcept;
+
+  std::array<uint32_t, 8> State;
+  std::array<uint8_t, 64> Buffer;
+  uint64_t Length = 0;
+};
+
+} // namespace Support
+} // namespace SSVM
@@ -1,60 +1,234 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
 #include <string>
-#include <sys/time.h>
 #include <unordered_map>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
 namespace SSVM {
 namespace Support {
 
-class TimeRecord {
+/// Monotonic clock source of timers.
+///
+/// Ticks are TSC cycles on x86-64 with invariant TSC, which are read in a few
+/// nanoseconds, or nanoseconds of CLOCK_MONOTONIC otherwise. TSC cycles are
+/// calibrated against CLOCK_MONOTONIC from the first use of the clock, when
+/// converting to nanoseconds.
+class TickClock {
 public:
-  void startRecord(const uint32_t &ID) {
-    struct timeval TStart;
-    gettimeofday(&TStart, NULL);
-    StartTime.insert(
-        std::make_pair(ID, (uint64_t)1000000 * TStart.tv_sec + TStart.tv_usec));
+  /// Read the current ticks.
+  static uint64_t now() noexcept {
+#if defined(__x86_64__)
+    if (getSource().UseTSC) {
+      return __rdtsc();
+    }
+#endif
+    return getMonotonicTime();
   }
 
-  uint64_t stopRecord(const uint32_t &ID) {
-    std::unordered_map<uint32_t, uint64_t>::iterator It;
-    uint64_t NDiff = 0;
-    if ((It = StartTime.find(ID)) != StartTime.end()) {
-      struct timeval TEnd;
-      gettimeofday(&TEnd, NULL);
-      NDiff = (uint64_t)1000000 * TEnd.tv_sec + TEnd.tv_usec - It->second;
-      StartTime.erase(ID);
+  /// Convert the ticks to nanoseconds.
+  static uint64_t toNanoseconds(const uint64_t Ticks) noexcept {
+    const Source &Src = getSource();
+    if (!Src.UseTSC) {
+      return Ticks;
     }
+#if defined(__x86_64__)
+    const uint64_t TSCElapsed = __rdtsc() - Src.TSCStart;
+    const uint64_t MonoElapsed = getMonotonicTime() - Src.MonoStart;
+    if (TSCElapsed == 0) {
+      return 0;
+    }
+    return static_cast<uint64_t>(static_cast<long double>(Ticks) *
+                                 MonoElapsed / TSCElapsed);
+#else
+    return Ticks;
+#endif
+  }
 
-    if (RecTime.find(ID) != RecTime.end()) {
-      RecTime[ID] += NDiff;
-    } else {
-      RecTime.insert(std::make_pair(ID, NDiff));
+private:
+  struct Source {
+    Source() noexcept : MonoStart(getMonotonicTime()) {
+#if defined(__x86_64__)
+      /// Invariant TSC is reported in CPUID.80000007H:EDX[8].
+      uint32_t EAX, EBX, ECX, EDX;
+      if (__get_cpuid(0x80000007U, &EAX, &EBX, &ECX, &EDX) &&
+          (EDX & (1U << 8))) {
+        UseTSC = true;
+        TSCStart = __rdtsc();
+      }
+#endif
     }
-    return RecTime[ID];
+    bool UseTSC = false;
+    uint64_t TSCStart = 0;
+    uint64_t MonoStart;
+  };
+
+  static const Source &getSource() noexcept {
+    static const Source Src;
+    return Src;
+  }
+
+  static uint64_t getMonotonicTime() noexcept {
+    struct timespec TS;
+    clock_gettime(CLOCK_MONOTONIC, &TS);
+    return UINT64_C(1000000000) * TS.tv_sec + TS.tv_nsec;
+  }
+};
+
+/// Accumulated time of timers identified by tags.
+///
+/// Tags less than `kFixedSlots` are indexed into fixed slots without lookup.
+/// Larger tags are kept in a map.
+class TimeRecord {
+public:
+  static inline constexpr const uint32_t kFixedSlots = 16;
+
+  /// Start the timer. A running timer keeps its start time.
+  void startRecord(const uint32_t &ID) { startRecordAt(ID, TickClock::now()); }
+
+  /// Stop the timer and return its accumulated time in microseconds.
+  uint64_t stopRecord(const uint32_t &ID) {
+    stopRecordAt(ID, TickClock::now());
+    return getRecord(ID);
+  }
+
+  /// Stop a timer and start another one at the same time, such as around
+  /// calling host functions.
+  void switchRecord(const uint32_t &StopID, const uint32_t &StartID) {
+    const uint64_t Now = TickClock::now();
+    stopRecordAt(StopID, Now);
+    startRecordAt(StartID, Now);
   }
 
   void clearRecord(const uint32_t &ID) {
-    StartTime.erase(ID);
-    RecTime.erase(ID);
+    if (ID < kFixedSlots) {
+      Fixed[ID] = Slot();
+    } else {
+      Others.erase(ID);
+    }
   }
 
-  uint64_t getRecord(const uint32_t &ID) {
-    if (RecTime.find(ID) != RecTime.end()) {
-      return RecTime[ID];
+  /// Getter of accumulated time in microseconds.
+  uint64_t getRecord(const uint32_t &ID) const {
+    return getRecordNano(ID) / 1000;
+  }
+
+  /// Getter of accumulated time in nanoseconds.
+  uint64_t getRecordNano(const uint32_t &ID) const {
+    if (ID < kFixedSlots) {
+      return TickClock::toNanoseconds(Fixed[ID].Ticks);
+    }
+    if (auto It = Others.find(ID); It != Others.end()) {
+      return TickClock::toNanoseconds(It->second.Ticks);
     }
     return 0;
   }
 
   void reset() {
-    StartTime.clear();
-    RecTime.clear();
+    Fixed.fill(Slot());
+    Others.clear();
   }
 
 private:
-  std::unordered_map<uint32_t, uint64_t> StartTime;
-  std::unordered_map<uint32_t, uint64_t> RecTime;
+  struct Slot {
+    uint64_t Start = 0;
+    uint64_t Ticks = 0;
+    bool Running = false;
+  };
+
+  Slot &getSlot(const uint32_t ID) {
+    return (ID < kFixedSlots) ? Fixed[ID] : Others[ID];
+  }
+
+  void startRecordAt(const uint32_t ID, const uint64_t Now) {
+    Slot &S = getSlot(ID);
+    if (!S.Running) {
+      S.Start = Now;
+      S.Running = true;
+    }
+  }
+
+  void stopRecordAt(const uint32_t ID, const uint64_t Now) {
+    Slot &S = getSlot(ID);
+    if (S.Running) {
+      S.Ticks += Now - S.Start;
+      S.Running = false;
+    }
+  }
+
+  std::array<Slot, kFixedSlots> Fixed;
+  std::unordered_map<uint32_t, Slot> Others;
+};
+
+/// Time accounting of work running on multiple threads.
+///
+/// Wall time counts the periods in which any work is running, so that
+/// concurrent work is counted once. CPU time sums the thread CPU time of all
+/// work.
+class WorkTimer {
+public:
+  /// Run the function as work in current thread and account its time.
+  template <typename FuncT> decltype(auto) measure(FuncT &&Func) {
+    Scope Work(*this);
+    return Func();
+  }
+
+  /// Getter of wall time in microseconds.
+  uint64_t getWallTime() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return std::chrono::duration_cast<std::chrono::microseconds>(Wall).count();
+  }
+
+  /// Getter of CPU time in microseconds.
+  uint64_t getCPUTime() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return CPU / 1000;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  static uint64_t getThreadCPUTime() {
+    struct timespec TS;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &TS);
+    return UINT64_C(1000000000) * TS.tv_sec + TS.tv_nsec;
+  }
+
+  /// Running work.
+  struct Scope {
+    Scope(WorkTimer &T) : Timer(T), CPUStart(getThreadCPUTime()) {
+      std::lock_guard<std::mutex> Lock(Timer.Mutex);
+      if (Timer.Running++ == 0) {
+        Timer.Start = Clock::now();
+      }
+    }
+    ~Scope() {
+      const uint64_t CPUEnd = getThreadCPUTime();
+      std::lock_guard<std::mutex> Lock(Timer.Mutex);
+      Timer.CPU += CPUEnd - CPUStart;
+      if (--Timer.Running == 0) {
+        Timer.Wall += Clock::now() - Timer.Start;
+      }
+    }
+    WorkTimer &Timer;
+    const uint64_t CPUStart;
+  };
+
+  std::mutex Mutex;
+  uint32_t Running = 0;
+  Clock::time_point Start;
+  Clock::duration Wall = Clock::duration::zero();
+  /// CPU time in nanoseconds.
+  uint64_t CPU = 0;
 };
 
 } // namespace Support
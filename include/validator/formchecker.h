@@ -61,6 +61,7 @@ private:
     std::vector<VType> EndTypes;
     size_t Height;
     bool IsUnreachable;
+    bool IsLoop;
   };
 
   /// Instruction iteration
@@ -80,6 +81,7 @@ private:
 
   /// Helper function
   VType ASTToVType(const ValType &V);
+  AST::BranchTarget getBranchTarget(const uint32_t N) const;
 
   /// Stack operations
   void pushType(VType);
@@ -87,7 +89,8 @@ private:
   Expect<VType> popType();
   Expect<VType> popType(VType E);
   Expect<void> popTypes(const std::vector<VType> &Input);
-  void pushCtrl(const std::vector<VType> &Label, const std::vector<VType> &Out);
+  void pushCtrl(const std::vector<VType> &Label, const std::vector<VType> &Out,
+                const bool IsLoop = false);
   Expect<std::vector<VType>> popCtrl();
   Expect<void> unreachable();
   Expect<void> StackTrans(const std::vector<VType> &Take,
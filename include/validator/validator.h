@@ -27,9 +27,14 @@ public:
   Validator() = default;
   ~Validator() = default;
 
-  /// Validate AST::Module.
+  /// Validate AST::Module. Lazily loaded function bodies are validated on
+  /// their first use instead.
   Expect<void> validate(const AST::Module &Mod);
 
+  /// Setter of thread count for validating function bodies. 0 for hardware
+  /// threads.
+  void setThreadCount(const uint32_t Count) { ThreadCount = Count; }
+
 private:
   /// Validate AST::Types
   Expect<void> validate(const AST::Limit &Lim, const uint32_t K);
@@ -41,8 +46,9 @@ private:
   /// Validate AST::Segments
   Expect<void> validate(const AST::GlobalSegment &GlobSeg);
   Expect<void> validate(const AST::ElementSegment &ElemSeg);
-  Expect<void> validate(const AST::CodeSegment &CodeSeg,
-                        const uint32_t TypeIdx);
+  static Expect<void> validate(FormChecker &FuncChecker,
+                               const AST::CodeSegment &CodeSeg,
+                               const uint32_t TypeIdx);
   Expect<void> validate(const AST::DataSegment &DataSeg);
 
   /// Validate AST::Desc
@@ -69,6 +75,7 @@ private:
   const uint32_t LIMIT_TABLETYPE = UINT32_MAX; // 2^32-1
   const uint32_t LIMIT_MEMORYTYPE = 1U << 16;
   FormChecker Checker;
+  uint32_t ThreadCount = 1;
 };
 
 } // namespace Validator
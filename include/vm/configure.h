@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_set>
@@ -23,6 +24,9 @@ public:
   /// VM type enum class.
   enum class VMType : unsigned int { Wasm = 0, Ewasm, Wasi, ONNC };
 
+  /// Optimization level of compiled code.
+  enum class OptimizationLevel : uint8_t { O0 = 0, O1, O2, O3 };
+
   Configure() { Types.insert(VMType::Wasm); }
   ~Configure() = default;
 
@@ -36,9 +40,37 @@ public:
 
   void setStartFuncName(const std::string &Name) { StartFuncName = Name; }
 
+  /// Getter and setter of optimization level of compiled code. Higher levels
+  /// spend more compile time for faster code.
+  OptimizationLevel getOptimizationLevel() const { return OptLevel; }
+  void setOptimizationLevel(const OptimizationLevel Level) { OptLevel = Level; }
+
+  /// Getter and setter of compiling for the host CPU and its features, such
+  /// as AVX2, instead of a generic CPU of the host architecture.
+  bool isHostCPU() const { return HostCPU; }
+  void setHostCPU(const bool Enabled) { HostCPU = Enabled; }
+
+  /// Getter and setter of thread count for compiling the module in
+  /// partitions. 0 for hardware threads.
+  uint32_t getCompileThreadCount() const { return CompileThreadCount; }
+  void setCompileThreadCount(const uint32_t Count) {
+    CompileThreadCount = Count;
+  }
+
+  /// Getter and setter of compiling the functions reachable from the exports
+  /// in background before they are called.
+  bool isSpeculativeCompile() const { return SpeculativeCompile; }
+  void setSpeculativeCompile(const bool Enabled) {
+    SpeculativeCompile = Enabled;
+  }
+
 private:
   std::unordered_set<VMType> Types;
   std::string StartFuncName;
+  OptimizationLevel OptLevel = OptimizationLevel::O1;
+  bool HostCPU = true;
+  uint32_t CompileThreadCount = 1;
+  bool SpeculativeCompile = false;
 };
 
 } // namespace VM
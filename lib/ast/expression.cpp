@@ -7,6 +7,7 @@ namespace AST {
 /// Load to construct Expression node. See "include/common/ast/expression.h".
 Expect<void> Expression::loadBinary(FileMgr &Mgr) {
   /// Read opcode until the End code.
+  InstrSeqBuilder Seq;
   while (true) {
     Instruction::OpCode Code;
 
@@ -22,18 +23,19 @@ Expect<void> Expression::loadBinary(FileMgr &Mgr) {
       break;
 
     /// Create the instruction node and load contents.
-    std::unique_ptr<Instruction> NewInst;
-    if (auto Res = makeInstructionNode(Code)) {
-      NewInst = std::move(*Res);
+    Instruction *NewInst;
+    if (auto Res = makeInstructionNode(Code, Mgr.getArena())) {
+      NewInst = *Res;
     } else {
       return Unexpect(Res);
     }
     if (auto Res = NewInst->loadBinary(Mgr)) {
-      Instrs.push_back(std::move(NewInst));
+      Seq.push(NewInst);
     } else {
       return Unexpect(Res);
     }
   }
+  Instrs = Seq.build(Mgr.getArena());
 
   return {};
 }
@@ -4,16 +4,9 @@
 namespace SSVM {
 namespace AST {
 
-/// Copy construtor. See "include/common/ast/instruction.h".
-BlockControlInstruction::BlockControlInstruction(
-    const BlockControlInstruction &Instr)
-    : Instruction(Instr.Code), BlockType(Instr.BlockType) {
-  for (auto &It : Instr.Body) {
-    if (auto Res = makeInstructionNode(*It.get())) {
-      Body.push_back(std::move(*Res));
-    }
-  }
-}
+/// Scratch stack of instruction sequence builders. See
+/// "include/common/ast/instruction.h".
+thread_local std::vector<Instruction *> InstrSeqBuilder::Pending;
 
 /// Load binary of block instructions. See "include/common/ast/instruction.h".
 Expect<void> BlockControlInstruction::loadBinary(FileMgr &Mgr) {
@@ -35,6 +28,7 @@ Expect<void> BlockControlInstruction::loadBinary(FileMgr &Mgr) {
   }
 
   /// Read instructions and make nodes until Opcode::End.
+  InstrSeqBuilder Seq;
   while (true) {
     OpCode Code;
 
@@ -51,38 +45,23 @@ Expect<void> BlockControlInstruction::loadBinary(FileMgr &Mgr) {
     }
 
     /// Create the instruction node and load contents.
-    std::unique_ptr<Instruction> NewInst;
-    if (auto Res = makeInstructionNode(Code)) {
-      NewInst = std::move(*Res);
+    Instruction *NewInst;
+    if (auto Res = makeInstructionNode(Code, Mgr.getArena())) {
+      NewInst = *Res;
     } else {
       return Unexpect(Res);
     }
     if (auto Res = NewInst->loadBinary(Mgr)) {
-      Body.push_back(std::move(NewInst));
+      Seq.push(NewInst);
     } else {
       return Unexpect(Res);
     }
   }
+  Body = Seq.build(Mgr.getArena());
 
   return {};
 }
 
-/// Copy construtor. See "include/common/ast/instruction.h".
-IfElseControlInstruction::IfElseControlInstruction(
-    const IfElseControlInstruction &Instr)
-    : Instruction(Instr.Code), BlockType(Instr.BlockType) {
-  for (auto &It : Instr.IfStatement) {
-    if (auto Res = makeInstructionNode(*It.get())) {
-      IfStatement.push_back(std::move(*Res));
-    }
-  }
-  for (auto &It : Instr.ElseStatement) {
-    if (auto Res = makeInstructionNode(*It.get())) {
-      ElseStatement.push_back(std::move(*Res));
-    }
-  }
-}
-
 /// Load binary of if-else instructions. See "include/common/ast/instruction.h".
 Expect<void> IfElseControlInstruction::loadBinary(FileMgr &Mgr) {
   /// Read the block return type.
@@ -104,6 +83,7 @@ Expect<void> IfElseControlInstruction::loadBinary(FileMgr &Mgr) {
 
   /// Read instructions and make nodes until OpCode::End.
   bool IsElseStatement = false;
+  InstrSeqBuilder Seq;
   while (true) {
     OpCode Code;
 
@@ -121,27 +101,31 @@ Expect<void> IfElseControlInstruction::loadBinary(FileMgr &Mgr) {
 
     /// If an OpCode::Else read, switch to Else statement.
     if (Code == OpCode::Else) {
+      if (!IsElseStatement) {
+        IfStatement = Seq.build(Mgr.getArena());
+      }
       IsElseStatement = true;
       continue;
     }
 
     /// Create the instruction node and load contents.
-    std::unique_ptr<Instruction> NewInst;
-    if (auto Res = makeInstructionNode(Code)) {
-      NewInst = std::move(*Res);
+    Instruction *NewInst;
+    if (auto Res = makeInstructionNode(Code, Mgr.getArena())) {
+      NewInst = *Res;
     } else {
       return Unexpect(Res);
     }
     if (auto Res = NewInst->loadBinary(Mgr)) {
-      if (IsElseStatement) {
-        ElseStatement.push_back(std::move(NewInst));
-      } else {
-        IfStatement.push_back(std::move(NewInst));
-      }
+      Seq.push(NewInst);
     } else {
       return Unexpect(Res);
     }
   }
+  if (IsElseStatement) {
+    ElseStatement = Seq.build(Mgr.getArena());
+  } else {
+    IfStatement = Seq.build(Mgr.getArena());
+  }
 
   return {};
 }
@@ -166,9 +150,10 @@ Expect<void> BrTableControlInstruction::loadBinary(FileMgr &Mgr) {
   } else {
     return Unexpect(Res);
   }
+  std::vector<uint32_t> Labels;
   for (uint32_t i = 0; i < VecCnt; ++i) {
     if (auto Res = Mgr.readU32()) {
-      LabelTable.push_back(*Res);
+      Labels.push_back(*Res);
     } else {
       return Unexpect(Res);
     }
@@ -180,6 +165,12 @@ Expect<void> BrTableControlInstruction::loadBinary(FileMgr &Mgr) {
   } else {
     return Unexpect(Res);
   }
+
+  /// Copy the label table and reserve the targets in arena.
+  auto &A = Mgr.getArena();
+  LabelTable = A.copy(Labels);
+  const std::vector<BranchTarget> Reserved(Labels.size() + 1);
+  Targets = A.copy(Reserved);
   return {};
 }
 
@@ -284,35 +275,33 @@ Expect<void> ConstInstruction::loadBinary(FileMgr &Mgr) {
 }
 
 /// Instruction node maker. See "include/common/ast/instruction.h".
-Expect<std::unique_ptr<Instruction>>
-makeInstructionNode(const Instruction::OpCode &Code) {
+Expect<Instruction *> makeInstructionNode(const Instruction::OpCode &Code,
+                                          Support::Arena &A) {
   return dispatchInstruction(
-      Code, [&Code](auto &&Arg) -> Expect<std::unique_ptr<Instruction>> {
+      Code, [&Code, &A](auto &&Arg) -> Expect<Instruction *> {
         if constexpr (std::is_void_v<
                           typename std::decay_t<decltype(Arg)>::type>) {
           /// If the Code not matched, return null pointer.
           return Unexpect(ErrCode::InvalidGrammar);
         } else {
           /// Make the instruction node according to Code.
-          return std::make_unique<typename std::decay_t<decltype(Arg)>::type>(
-              Code);
+          return A.make<typename std::decay_t<decltype(Arg)>::type>(Code);
         }
       });
 }
 
 /// Instruction node duplicater. See "include/common/ast/instruction.h".
-Expect<std::unique_ptr<Instruction>>
-makeInstructionNode(const Instruction &Instr) {
+Expect<Instruction *> makeInstructionNode(const Instruction &Instr,
+                                          Support::Arena &A) {
   return dispatchInstruction(
-      Instr.getOpCode(),
-      [&Instr](auto &&Arg) -> Expect<std::unique_ptr<Instruction>> {
+      Instr.getOpCode(), [&Instr, &A](auto &&Arg) -> Expect<Instruction *> {
         if constexpr (std::is_void_v<
                           typename std::decay_t<decltype(Arg)>::type>) {
           /// If the Code not matched, return null pointer.
           return Unexpect(ErrCode::InvalidGrammar);
         } else {
           /// Make the instruction node according to Code.
-          return std::make_unique<typename std::decay_t<decltype(Arg)>::type>(
+          return A.make<typename std::decay_t<decltype(Arg)>::type>(
               static_cast<const typename std::decay_t<decltype(Arg)>::type &>(
                   Instr));
         }
@@ -6,6 +6,15 @@ namespace AST {
 
 /// Load binary to construct Module node. See "include/ast/module.h".
 Expect<void> Module::loadBinary(FileMgr &Mgr) {
+  /// Allocate instruction nodes in the arena of this module.
+  Support::Arena *PrevArena = Mgr.setArena(&Arena);
+  auto Res = loadSections(Mgr);
+  Mgr.setArena(PrevArena);
+  return Res;
+}
+
+/// Load magic, version, and sections. See "include/ast/module.h".
+Expect<void> Module::loadSections(FileMgr &Mgr) {
   /// Read Magic and Version sequences.
   if (auto Res = Mgr.readBytes(4)) {
     Magic = *Res;
@@ -95,6 +104,8 @@ Expect<void> Module::loadBinary(FileMgr &Mgr) {
       break;
     case 0x0A:
       CodeSec = std::make_unique<CodeSection>();
+      CodeSec->setThreadCount(ThreadCount);
+      CodeSec->setLazy(LazyFunctionBody);
       if (auto Res = CodeSec->loadBinary(Mgr); !Res) {
         return Unexpect(Res);
       }
@@ -1,16 +1,25 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "common/ast/section.h"
+#include "support/parallel.h"
 
 namespace SSVM {
 namespace AST {
 
 /// Load binary to construct Section node. See "include/ast/section.h".
 Expect<void> Section::loadBinary(FileMgr &Mgr) {
-  if (auto Res = loadSize(Mgr)) {
-    return loadContent(Mgr);
-  } else {
+  if (auto Res = loadSize(Mgr); !Res) {
+    return Unexpect(Res);
+  }
+
+  /// The content must be consumed exactly.
+  const uint64_t Start = Mgr.getOffset();
+  if (auto Res = loadContent(Mgr); !Res) {
     return Unexpect(Res);
   }
+  if (Mgr.getOffset() - Start != ContentSize) {
+    return Unexpect(ErrCode::InvalidGrammar);
+  }
+  return {};
 }
 
 /// Load content size. See "include/ast/section.h".
@@ -26,7 +35,7 @@ Expect<void> Section::loadSize(FileMgr &Mgr) {
 /// Load content of custom section. See "include/ast/section.h".
 Expect<void> CustomSection::loadContent(FileMgr &Mgr) {
   /// Read all raw bytes.
-  if (auto Res = Mgr.readBytes(ContentSize)) {
+  if (auto Res = Mgr.readSpan(ContentSize, ContentOwner)) {
     Content = *Res;
   } else {
     return Unexpect(Res);
@@ -100,7 +109,79 @@ Expect<void> ElementSection::loadContent(FileMgr &Mgr) {
 
 /// Load vector of code section. See "include/ast/section.h".
 Expect<void> CodeSection::loadContent(FileMgr &Mgr) {
-  return Section::loadToVector(Mgr, Content);
+  if (ThreadCount == 1 && !LazyLoad) {
+    return Section::loadToVector(Mgr, Content);
+  }
+
+  /// Split the function bodies by their sizes.
+  uint32_t VecCnt = 0;
+  if (auto Res = Mgr.readU32()) {
+    VecCnt = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+  std::vector<Span<const Byte>> Bodies;
+  std::vector<std::shared_ptr<const void>> Owners(VecCnt);
+  Bodies.reserve(VecCnt);
+  for (uint32_t I = 0; I < VecCnt; ++I) {
+    uint32_t SegSize = 0;
+    if (auto Res = Mgr.readU32()) {
+      SegSize = *Res;
+    } else {
+      return Unexpect(Res);
+    }
+    if (auto Res = Mgr.readSpan(SegSize, Owners[I])) {
+      Bodies.push_back(*Res);
+    } else {
+      return Unexpect(Res);
+    }
+  }
+
+  /// Keep the function bodies undecoded until the first use.
+  if (LazyLoad) {
+    Lazy = std::make_unique<LazyCode>();
+    Content.reserve(VecCnt);
+    for (uint32_t I = 0; I < VecCnt; ++I) {
+      Content.push_back(std::make_unique<CodeSegment>());
+      Content.back()->setLazyBody(Bodies[I], std::move(Owners[I]), I, *Lazy);
+    }
+    return {};
+  }
+
+  /// Decode the function bodies concurrently. Each body must be consumed
+  /// exactly. Workers allocate instruction nodes in their own arenas, which
+  /// are merged into the arena of file manager afterwards.
+  Content.resize(VecCnt);
+  std::vector<ErrCode> Errors(VecCnt, ErrCode::Success);
+  const uint32_t Workers = Support::getWorkerCount(ThreadCount, VecCnt);
+  std::vector<Support::Arena> Arenas(Workers);
+  const size_t Failed = Support::parallelFor(
+      VecCnt, Workers, [&](uint32_t Worker, size_t I) {
+        FileMgrMap BodyMgr;
+        BodyMgr.setArena(&Arenas[Worker]);
+        auto Seg = std::make_unique<CodeSegment>();
+        if (!Bodies[I].empty()) {
+          BodyMgr.setCode(Bodies[I]);
+        }
+        if (auto Res = Seg->loadBody(BodyMgr, Bodies[I].size()); !Res) {
+          Errors[I] = Res.error();
+          return false;
+        }
+        if (BodyMgr.getRemainSize() != 0) {
+          Errors[I] = ErrCode::InvalidGrammar;
+          return false;
+        }
+        Content[I] = std::move(Seg);
+        return true;
+      });
+  for (auto &A : Arenas) {
+    Mgr.getArena().merge(std::move(A));
+  }
+  if (Failed < VecCnt) {
+    Content.clear();
+    return Unexpect(Errors[Failed]);
+  }
+  return {};
 }
 
 /// Load vector of data section. See "include/ast/section.h".
@@ -4,6 +4,37 @@
 namespace SSVM {
 namespace AST {
 
+namespace {
+
+/// Read the vector of local variable counts and types.
+Expect<void> loadLocals(FileMgr &Mgr,
+                        std::vector<std::pair<uint32_t, ValType>> &Locals) {
+  uint32_t VecCnt = 0;
+  if (auto Res = Mgr.readU32()) {
+    VecCnt = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+  for (uint32_t i = 0; i < VecCnt; ++i) {
+    uint32_t LocalCnt = 0;
+    ValType LocalType = ValType::None;
+    if (auto Res = Mgr.readU32()) {
+      LocalCnt = *Res;
+    } else {
+      return Unexpect(Res);
+    }
+    if (auto Res = Mgr.readByte()) {
+      LocalType = static_cast<ValType>(*Res);
+    } else {
+      return Unexpect(Res);
+    }
+    Locals.push_back(std::make_pair(LocalCnt, LocalType));
+  }
+  return {};
+}
+
+} // namespace
+
 /// Load expression binary in segment. See "include/common/ast/segment.h".
 Expect<void> Segment::loadExpression(FileMgr &Mgr) {
   Expr = std::make_unique<Expression>();
@@ -57,39 +88,89 @@ Expect<void> ElementSegment::loadBinary(FileMgr &Mgr) {
 /// Load binary of CodeSegment node. See "include/common/ast/segment.h".
 Expect<void> CodeSegment::loadBinary(FileMgr &Mgr) {
   /// Read the code segment size.
+  uint32_t Size = 0;
   if (auto Res = Mgr.readU32()) {
-    SegSize = *Res;
+    Size = *Res;
   } else {
     return Unexpect(Res);
   }
 
-  /// Read the vector of local variable counts and types.
-  uint32_t VecCnt = 0;
-  if (auto Res = Mgr.readU32()) {
-    VecCnt = *Res;
-  } else {
+  /// The body must be consumed exactly, the same as in parallel loading.
+  const uint64_t Start = Mgr.getOffset();
+  if (auto Res = loadBody(Mgr, Size); !Res) {
     return Unexpect(Res);
   }
-  for (uint32_t i = 0; i < VecCnt; ++i) {
-    uint32_t LocalCnt = 0;
-    ValType LocalType = ValType::None;
-    if (auto Res = Mgr.readU32()) {
-      LocalCnt = *Res;
-    } else {
-      return Unexpect(Res);
-    }
-    if (auto Res = Mgr.readByte()) {
-      LocalType = static_cast<ValType>(*Res);
-    } else {
-      return Unexpect(Res);
-    }
-    Locals.push_back(std::make_pair(LocalCnt, LocalType));
+  if (Mgr.getOffset() - Start != Size) {
+    return Unexpect(ErrCode::InvalidGrammar);
+  }
+  return {};
+}
+
+/// Load function body of CodeSegment node. See "include/common/ast/segment.h".
+Expect<void> CodeSegment::loadBody(FileMgr &Mgr, const uint32_t Size) {
+  SegSize = Size;
+
+  /// Read the vector of local variable counts and types.
+  if (auto Res = loadLocals(Mgr, Locals); !Res) {
+    return Unexpect(Res);
   }
 
   /// Read function body.
   return Segment::loadExpression(Mgr);
 }
 
+/// Keep function body undecoded. See "include/common/ast/segment.h".
+void CodeSegment::setLazyBody(Span<const Byte> Code,
+                              std::shared_ptr<const void> Owner,
+                              const uint32_t Idx, LazyCode &Ctx) {
+  SegSize = Code.size();
+  Lazy = &Ctx;
+  Index = Idx;
+  Body = Code;
+  BodyOwner = std::move(Owner);
+  /// The expression node is kept at the same address after decoding, since
+  /// the function instances reference its instructions.
+  Expr = std::make_unique<Expression>();
+}
+
+/// Decode lazily loaded function body. See "include/common/ast/segment.h".
+Expect<void> CodeSegment::decodeLazyBody() const {
+  std::lock_guard<std::mutex> Lock(Lazy->Mutex);
+  if (!Done.load(std::memory_order_relaxed)) {
+    if (!Decoded) {
+      /// The body must be consumed exactly.
+      FileMgrMap BodyMgr;
+      BodyMgr.setArena(&Lazy->Arena);
+      if (!Body.empty()) {
+        BodyMgr.setCode(Body);
+      }
+      Status = ErrCode::Success;
+      if (auto Res = loadLocals(BodyMgr, Locals); !Res) {
+        Status = Res.error();
+      } else if (auto Res = Expr->loadBinary(BodyMgr); !Res) {
+        Status = Res.error();
+      } else if (BodyMgr.getRemainSize() != 0) {
+        Status = ErrCode::InvalidGrammar;
+      }
+      Decoded = true;
+    }
+    if (Status == ErrCode::Success && !Lazy->Check) {
+      /// Not final until validated by the validator set later.
+      return {};
+    }
+    if (Status == ErrCode::Success) {
+      if (auto Res = Lazy->Check(*this, Index); !Res) {
+        Status = Res.error();
+      }
+    }
+    Done.store(true, std::memory_order_release);
+  }
+  if (Status != ErrCode::Success) {
+    return Unexpect(Status);
+  }
+  return {};
+}
+
 /// Load binary of DataSegment node. See "include/common/ast/segment.h".
 Expect<void> DataSegment::loadBinary(FileMgr &Mgr) {
   /// Read target memory index.
@@ -112,7 +193,7 @@ Expect<void> DataSegment::loadBinary(FileMgr &Mgr) {
   } else {
     return Unexpect(Res);
   }
-  if (auto Res = Mgr.readBytes(VecCnt)) {
+  if (auto Res = Mgr.readSpan(VecCnt, DataOwner)) {
     Data = *Res;
   } else {
     return Unexpect(Res);
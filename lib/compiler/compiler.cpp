@@ -27,35 +27,67 @@
 #include "compiler/hostfunc/wasi/path_Open.h"
 #include "compiler/hostfunc/wasi/proc_Exit.h"
 #include "compiler/library.h"
+#include "support/parallel.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Target/TargetMachine.h>
+#include <unistd.h>
 
 namespace SSVM {
 namespace Compiler {
 
-static llvm::Function *createCtxCall(llvm::Function *F,
-                                     llvm::GlobalVariable *Ctx) {
+/// Version of generated code. Bump it when the generated code changes, so that
+/// stale cached shared objects are not loaded.
+static const constexpr char kCacheVersion[] = "ssvm-aot-2";
+
+/// Create a pointer slot which is bound by Library after loading.
+static llvm::GlobalVariable *createSlot(llvm::Module &Module, llvm::Type *Ty,
+                                        const std::string &Name) {
+  llvm::PointerType *PtrTy = llvm::PointerType::getUnqual(Ty);
+  return new llvm::GlobalVariable(Module, PtrTy, false,
+                                  llvm::GlobalValue::ExternalLinkage,
+                                  llvm::ConstantPointerNull::get(PtrTy), Name);
+}
+
+/// Fill body of F by calling the function in slot Name with context in Ctx.
+static llvm::GlobalVariable *createCtxCall(llvm::Function *F,
+                                           llvm::GlobalVariable *Ctx,
+                                           const std::string &Name) {
   std::vector<llvm::Type *> ArgTy;
-  ArgTy.push_back(Ctx->getType());
+  ArgTy.push_back(Ctx->getValueType());
   for (auto &Arg : F->args()) {
     ArgTy.push_back(Arg.getType());
   }
   llvm::FunctionType *FTy =
       llvm::FunctionType::get(F->getReturnType(), ArgTy, false);
 
-  llvm::Function *Result = llvm::Function::Create(
-      FTy, llvm::GlobalValue::ExternalLinkage, "", F->getParent());
+  llvm::GlobalVariable *Result = createSlot(*F->getParent(), FTy, Name);
 
   llvm::BasicBlock *OK =
       llvm::BasicBlock::Create(Ctx->getContext(), "entry", F);
   llvm::IRBuilder<> Builder(OK);
   std::vector<llvm::Value *> Args;
-  Args.push_back(Ctx);
+  Args.push_back(Builder.CreateLoad(Ctx));
   std::transform(F->arg_begin(), F->arg_end(), std::back_inserter(Args),
                  [](llvm::Argument &Arg) { return &Arg; });
-  llvm::Value *Ret = Builder.CreateCall(Result, Args);
+  llvm::Value *Ret = Builder.CreateCall(Builder.CreateLoad(Result), Args);
   if (!F->getReturnType()->isVoidTy()) {
     Builder.CreateRet(Ret);
   } else {
@@ -80,6 +112,10 @@ struct Compiler::CompileContext {
   llvm::Function *MemorySize;
   llvm::Function *MemoryGrow;
   llvm::GlobalVariable *Memory;
+  /// Cost table and slots of costs, if the code is metered.
+  const std::vector<uint64_t> *CostTable = nullptr;
+  llvm::GlobalVariable *CostSum = nullptr;
+  llvm::GlobalVariable *CostLimit = nullptr;
   CompileContext(llvm::Module &M)
       : Context(M.getContext()), Module(M),
         Trap(llvm::Function::Create(
@@ -93,16 +129,22 @@ struct Compiler::CompileContext {
             llvm::FunctionType::get(llvm::Type::getInt32Ty(Context),
                                     {llvm::Type::getInt32Ty(Context)}, false),
             llvm::GlobalValue::InternalLinkage, "$memory.grow.", Module)),
-        LibCtx(new llvm::GlobalVariable(
-            Module, llvm::Type::getInt8Ty(Context), false,
-            llvm::GlobalValue::ExternalLinkage, nullptr, "$lib.ctx")),
-        Memory(new llvm::GlobalVariable(
-            Module, llvm::Type::getInt8PtrTy(Context), false,
-            llvm::GlobalValue::ExternalLinkage, nullptr, "$memory")) {
+        LibCtx(
+            createSlot(Module, llvm::Type::getInt8Ty(Context), "$lib.ctx")),
+        Memory(
+            createSlot(Module, llvm::Type::getInt8Ty(Context), "$memory")) {
     Trap->addFnAttr(llvm::Attribute::NoReturn);
-    createCtxCall(Trap, LibCtx)->setName("$trap");
-    createCtxCall(MemorySize, LibCtx)->setName("$memory.size");
-    createCtxCall(MemoryGrow, LibCtx)->setName("$memory.grow");
+    createCtxCall(Trap, LibCtx, "$trap");
+    createCtxCall(MemorySize, LibCtx, "$memory.size");
+    createCtxCall(MemoryGrow, LibCtx, "$memory.grow");
+  }
+
+  /// Meter the compiled code with the cost table.
+  void setCostTable(const std::vector<uint64_t> &Table) {
+    CostTable = &Table;
+    CostSum = createSlot(Module, llvm::Type::getInt64Ty(Context), "$cost.sum");
+    CostLimit =
+        createSlot(Module, llvm::Type::getInt64Ty(Context), "$cost.limit");
   }
 };
 } // namespace Compiler
@@ -197,6 +239,7 @@ public:
 
   ErrCode compile(const SSVM::AST::InstrVec &Instrs) {
     for (const auto &Instr : Instrs) {
+      charge(Instr->getOpCode());
       if (ErrCode Status = SSVM::AST::dispatchInstruction(
               Instr->getOpCode(),
               [this, &Instr](const auto &&Arg) {
@@ -209,7 +252,7 @@ public:
                   return compile(
                       *static_cast<
                           const typename std::decay_t<decltype(Arg)>::type *>(
-                          Instr.get()));
+                          Instr));
                 }
               });
           Status != ErrCode::Success) {
@@ -281,15 +324,18 @@ public:
       auto *Then = llvm::BasicBlock::Create(VMContext, "then", F);
       auto *Else = llvm::BasicBlock::Create(VMContext, "else", F);
       auto *EndIf = llvm::BasicBlock::Create(VMContext, "if.end", F);
-      Builder.CreateCondBr(Cond, Then, EndIf);
+      Builder.CreateCondBr(Cond, Then, Else);
 
-      enterBlock(EndIf, Else);
+      enterBlock(EndIf, EndIf);
       Builder.SetInsertPoint(Then);
+      chargeStatement(Instr.getIfStatement());
       compile(Instr.getIfStatement());
       leaveBlock();
 
       enterBlock(EndIf, EndIf);
-      compile(Instr.getIfStatement());
+      Builder.SetInsertPoint(Else);
+      chargeStatement(Instr.getElseStatement());
+      compile(Instr.getElseStatement());
       leaveBlock();
 
       break;
@@ -326,7 +372,7 @@ public:
     return ErrCode::Success;
   }
   ErrCode compile(const SSVM::AST::BrTableControlInstruction &Instr) {
-    const std::vector<unsigned int> &LabelTable = Instr.getLabelTable();
+    const auto LabelTable = Instr.getLabelTable();
     switch (Instr.getOpCode()) {
     case OpCode::Br_table: {
       llvm::SwitchInst *Switch = Builder.CreateSwitch(
@@ -872,6 +918,9 @@ public:
     } else {
       Builder.CreateRet(Stack.back());
     }
+    if (Context.CostTable) {
+      meter();
+    }
   }
 
   static llvm::Constant *
@@ -965,10 +1014,12 @@ private:
 
   ErrCode compileLoadOp(unsigned int Offset, llvm::Type *LoadTy) {
     llvm::Value *O = Stack.back();
+    /// Extend before adding offset, so out of bound accesses never wrap and
+    /// always fault in the guard region of memory.
+    O = Builder.CreateZExt(O, Builder.getInt64Ty());
     if (Offset != 0) {
-      O = Builder.CreateAdd(O, Builder.getInt32(Offset));
+      O = Builder.CreateAdd(O, Builder.getInt64(Offset));
     }
-    O = Builder.CreateZExt(O, Builder.getInt64Ty());
     llvm::Value *VPtr =
         Builder.CreateInBoundsGEP(Builder.CreateLoad(Context.Memory), {O});
     llvm::Value *Ptr =
@@ -996,10 +1047,12 @@ private:
 
     llvm::Value *O = Stack.back();
     Stack.pop_back();
+    /// Extend before adding offset, so out of bound accesses never wrap and
+    /// always fault in the guard region of memory.
+    O = Builder.CreateZExt(O, Builder.getInt64Ty());
     if (Offset != 0) {
-      O = Builder.CreateAdd(O, Builder.getInt32(Offset));
+      O = Builder.CreateAdd(O, Builder.getInt64(Offset));
     }
-    O = Builder.CreateZExt(O, Builder.getInt64Ty());
 
     llvm::Value *VPtr =
         Builder.CreateInBoundsGEP(Builder.CreateLoad(Context.Memory), {O});
@@ -1009,6 +1062,67 @@ private:
     return ErrCode::Success;
   }
 
+  /// Add the instruction cost into the current basic block.
+  void charge(const OpCode Op) {
+    if (Context.CostTable && F) {
+      BlockCosts[Builder.GetInsertBlock()] +=
+          (*Context.CostTable)[static_cast<uint8_t>(Op)];
+    }
+  }
+
+  /// Add the cost of entering the non-empty statement of if instruction.
+  void chargeStatement(const SSVM::AST::InstrVec &Statement) {
+#ifndef ONNC_WASM
+    if (!Statement.empty()) {
+      charge(OpCode::Else);
+    }
+#endif
+  }
+
+  /// Charge the summed costs at the entry of every basic block, and trap when
+  /// the cost limit exceeded.
+  void meter() {
+    llvm::BasicBlock *Exceeded = nullptr;
+    std::vector<llvm::BasicBlock *> Blocks;
+    for (auto &BB : *F) {
+      Blocks.push_back(&BB);
+    }
+    for (llvm::BasicBlock *BB : Blocks) {
+      const auto It = BlockCosts.find(BB);
+      if (It == BlockCosts.end() || It->second == 0) {
+        continue;
+      }
+      if (!Exceeded) {
+        Exceeded = llvm::BasicBlock::Create(VMContext, "cost.exceeded", F);
+        llvm::IRBuilder<> TrapBuilder(Exceeded);
+        TrapBuilder.CreateStore(
+            TrapBuilder.CreateLoad(TrapBuilder.CreateLoad(Context.CostLimit)),
+            TrapBuilder.CreateLoad(Context.CostSum));
+        TrapBuilder.CreateCall(Context.Trap,
+                               {TrapBuilder.getInt32(
+                                   uint32_t(ErrCode::CostLimitExceeded))});
+        TrapBuilder.CreateUnreachable();
+      }
+
+      llvm::Instruction *First = &*BB->getFirstInsertionPt();
+      llvm::IRBuilder<> MeterBuilder(First);
+      llvm::Value *SumPtr = MeterBuilder.CreateLoad(Context.CostSum);
+      llvm::Value *Sum = MeterBuilder.CreateAdd(
+          MeterBuilder.CreateLoad(SumPtr), MeterBuilder.getInt64(It->second));
+      llvm::Value *Limit =
+          MeterBuilder.CreateLoad(MeterBuilder.CreateLoad(Context.CostLimit));
+      MeterBuilder.CreateStore(Sum, SumPtr);
+      llvm::Value *IsExceeded = MeterBuilder.CreateICmpUGT(Sum, Limit);
+
+      llvm::BasicBlock *Rest = BB->splitBasicBlock(First);
+      BB->getTerminator()->eraseFromParent();
+      MeterBuilder.SetInsertPoint(BB);
+      MeterBuilder.CreateCondBr(
+          IsExceeded, Exceeded, Rest,
+          llvm::MDBuilder(VMContext).createBranchWeights(1, 1 << 20));
+    }
+  }
+
   void enterBlock(llvm::BasicBlock *JumpTarget, llvm::BasicBlock *NextTarget) {
     ControlStack.emplace_back(Stack.size(), JumpTarget, NextTarget);
   }
@@ -1032,13 +1146,292 @@ private:
       ControlStack;
   llvm::Function *F;
   llvm::IRBuilder<> Builder;
+  /// Summed instruction costs of basic blocks.
+  std::unordered_map<llvm::BasicBlock *, uint64_t> BlockCosts;
 };
 
+using OptLevel = SSVM::VM::Configure::OptimizationLevel;
+
+/// Create the target machine builder of configured CPU and level.
+static llvm::orc::JITTargetMachineBuilder
+createTargetBuilder(const SSVM::VM::Configure &Config) {
+  llvm::orc::JITTargetMachineBuilder TMBuilder(
+      llvm::Triple(llvm::sys::getProcessTriple()));
+  if (Config.isHostCPU()) {
+    TMBuilder.setCPU(llvm::sys::getHostCPUName().str());
+    llvm::StringMap<bool> Features;
+    if (llvm::sys::getHostCPUFeatures(Features)) {
+      for (auto &Feature : Features) {
+        TMBuilder.getFeatures().AddFeature(Feature.first(), Feature.second);
+      }
+    }
+  }
+  switch (Config.getOptimizationLevel()) {
+  case OptLevel::O0:
+    TMBuilder.setCodeGenOptLevel(llvm::CodeGenOpt::None);
+    break;
+  case OptLevel::O1:
+    TMBuilder.setCodeGenOptLevel(llvm::CodeGenOpt::Less);
+    break;
+  case OptLevel::O2:
+    TMBuilder.setCodeGenOptLevel(llvm::CodeGenOpt::Default);
+    break;
+  case OptLevel::O3:
+    TMBuilder.setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+    break;
+  }
+  return TMBuilder;
+}
+
+/// Optimize module by the default pipeline of level, which covers SROA,
+/// GVN, LICM, and inlining, and loop and SLP vectorization from O2. The
+/// target machine provides the costs of vectorized code.
+static void optimizeModule(llvm::Module &Module, llvm::TargetMachine &TM,
+                           const OptLevel Level) {
+  if (Level == OptLevel::O0) {
+    return;
+  }
+  llvm::PipelineTuningOptions PTO;
+  PTO.LoopVectorization = Level >= OptLevel::O2;
+  PTO.SLPVectorization = Level >= OptLevel::O2;
+  llvm::PassBuilder PB(&TM, PTO);
+  llvm::LoopAnalysisManager LAM(false);
+  llvm::FunctionAnalysisManager FAM(false);
+  llvm::CGSCCAnalysisManager CGAM(false);
+  llvm::ModuleAnalysisManager MAM(false);
+  FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  const auto PassLevel = Level == OptLevel::O1   ? llvm::PassBuilder::O1
+                         : Level == OptLevel::O2 ? llvm::PassBuilder::O2
+                                                 : llvm::PassBuilder::O3;
+  PB.buildPerModuleDefaultPipeline(PassLevel).run(Module, MAM);
+}
+
+/// Collect names of functions reachable from the exported ones, through
+/// calls and tables. Internal functions are only visible after being split.
+static std::vector<std::string> collectReachable(const llvm::Module &Module,
+                                                 const bool Split) {
+  std::vector<const llvm::Value *> Worklist;
+  std::unordered_set<const llvm::Value *> Visited;
+  const auto Visit = [&Worklist, &Visited](const llvm::Value *V) {
+    if (llvm::isa<llvm::Constant>(V) && Visited.insert(V).second) {
+      Worklist.push_back(V);
+    }
+  };
+  for (const auto &F : Module) {
+    if (!F.isDeclaration() && !F.hasLocalLinkage()) {
+      Visit(&F);
+    }
+  }
+
+  std::vector<std::string> Names;
+  while (!Worklist.empty()) {
+    const llvm::Value *V = Worklist.back();
+    Worklist.pop_back();
+    if (const auto *F = llvm::dyn_cast<llvm::Function>(V)) {
+      if (F->isDeclaration()) {
+        continue;
+      }
+      if (F->hasName() && (Split || !F->hasLocalLinkage())) {
+        Names.push_back(F->getName().str());
+      }
+      for (const auto &I : llvm::instructions(F)) {
+        for (const auto &Op : I.operands()) {
+          Visit(Op.get());
+        }
+      }
+    } else if (const auto *G = llvm::dyn_cast<llvm::GlobalVariable>(V)) {
+      if (G->hasInitializer()) {
+        Visit(G->getInitializer());
+      }
+    } else if (const auto *C = llvm::dyn_cast<llvm::Constant>(V)) {
+      for (const auto &Op : C->operands()) {
+        Visit(Op.get());
+      }
+    }
+  }
+  return Names;
+}
+
+/// Trailer of cached shared objects, which the dynamic loader ignores: the
+/// magic, the cache key, and the SHA-256 of the bytes before the trailer.
+static const constexpr char kCacheMagic[8] = {'S', 'S', 'V', 'M',
+                                              'A', 'O', 'T', '\0'};
+static const constexpr size_t kCacheTrailerSize =
+    sizeof(kCacheMagic) + 2 * std::tuple_size_v<SSVM::Support::SHA256::Digest>;
+
+/// Append the trailer to the shared object.
+static bool appendCacheTrailer(const std::string &Path,
+                               const SSVM::Support::SHA256::Digest &Key) {
+  std::fstream File(Path, std::ios::in | std::ios::out | std::ios::binary);
+  if (!File) {
+    return false;
+  }
+  SSVM::Support::SHA256 Hasher;
+  char Buffer[65536];
+  while (File.read(Buffer, sizeof(Buffer)) || File.gcount() > 0) {
+    Hasher.update(Buffer, static_cast<size_t>(File.gcount()));
+  }
+  const auto Digest = Hasher.finalize();
+  File.clear();
+  File.seekp(0, std::ios::end);
+  File.write(kCacheMagic, sizeof(kCacheMagic));
+  File.write(reinterpret_cast<const char *>(Key.data()), Key.size());
+  File.write(reinterpret_cast<const char *>(Digest.data()), Digest.size());
+  File.close();
+  return !File.fail();
+}
+
+/// Check the trailer of the cached shared object against the key and the
+/// bytes, so that colliding, stale, or corrupted files are never loaded.
+static bool verifyCacheTrailer(const std::string &Path,
+                               const SSVM::Support::SHA256::Digest &Key) {
+  std::ifstream File(Path, std::ios::binary);
+  if (!File) {
+    return false;
+  }
+  const std::vector<char> Bytes((std::istreambuf_iterator<char>(File)),
+                                std::istreambuf_iterator<char>());
+  if (Bytes.size() < kCacheTrailerSize) {
+    return false;
+  }
+  const char *Trailer = Bytes.data() + Bytes.size() - kCacheTrailerSize;
+  const char *StoredKey = Trailer + sizeof(kCacheMagic);
+  const char *StoredDigest = StoredKey + Key.size();
+  const auto Digest = SSVM::Support::SHA256::hash(
+      Bytes.data(), Bytes.size() - kCacheTrailerSize);
+  return std::memcmp(Trailer, kCacheMagic, sizeof(kCacheMagic)) == 0 &&
+         std::memcmp(StoredKey, Key.data(), Key.size()) == 0 &&
+         std::memcmp(StoredDigest, Digest.data(), Digest.size()) == 0;
+}
+
+/// Emit modules as a native shared object to path. Modules are emitted into
+/// object files on threads and linked together.
+static SSVM::Compiler::ErrCode
+emitSharedObject(const std::vector<llvm::Module *> &Modules,
+                 llvm::orc::JITTargetMachineBuilder TMBuilder,
+                 const uint32_t Threads, SSVM::Support::WorkTimer &Timer,
+                 const std::string &Driver, const std::string &Path,
+                 const SSVM::Support::SHA256::Digest &Key) {
+  using SSVM::Compiler::ErrCode;
+  TMBuilder.setRelocationModel(llvm::Reloc::PIC_);
+
+  /// Traps throw through compiled frames, which need unwind tables.
+  for (auto *Module : Modules) {
+    for (auto &F : *Module) {
+      if (!F.isDeclaration()) {
+        F.addFnAttr(llvm::Attribute::UWTable);
+      }
+    }
+  }
+
+  /// Write into temporary files and rename at last, so that concurrent runs
+  /// never load a partial shared object.
+  const std::string TempPath = Path + '.' + std::to_string(getpid());
+  std::vector<std::string> ObjectPaths;
+  for (size_t I = 0; I < Modules.size(); ++I) {
+    ObjectPaths.push_back(TempPath + '.' + std::to_string(I) + ".o");
+  }
+  const auto RemoveObjects = [&ObjectPaths]() {
+    for (const auto &ObjectPath : ObjectPaths) {
+      llvm::sys::fs::remove(ObjectPath);
+    }
+  };
+
+  /// Each module has its own target machine, which is not thread safe.
+  const size_t Failed = SSVM::Support::parallelFor(
+      Modules.size(), SSVM::Support::getWorkerCount(Threads, Modules.size()),
+      [&](uint32_t, const size_t Idx) {
+        return Timer.measure([&]() {
+          llvm::orc::JITTargetMachineBuilder Builder = TMBuilder;
+          auto Res = Builder.createTargetMachine();
+          if (!Res) {
+            llvm::consumeError(Res.takeError());
+            return false;
+          }
+          std::unique_ptr<llvm::TargetMachine> TM = std::move(*Res);
+          std::error_code EC;
+          llvm::raw_fd_ostream OS(ObjectPaths[Idx], EC, llvm::sys::fs::F_None);
+          if (EC) {
+            return false;
+          }
+          llvm::legacy::PassManager PM;
+          if (TM->addPassesToEmitFile(PM, OS, nullptr,
+                                      llvm::TargetMachine::CGFT_ObjectFile)) {
+            return false;
+          }
+          PM.run(*Modules[Idx]);
+          return true;
+        });
+      });
+  if (Failed != Modules.size()) {
+    llvm::errs() << "Failed to emit object file.\n";
+    RemoveObjects();
+    return ErrCode::Failed;
+  }
+
+  /// Link objects into shared object by the system compiler driver.
+  std::vector<llvm::StringRef> Args = {Driver, "-shared", "-o", TempPath};
+  Args.insert(Args.end(), ObjectPaths.begin(), ObjectPaths.end());
+  std::string ErrMsg;
+  const int Status = llvm::sys::ExecuteAndWait(Driver, Args, llvm::None, {},
+                                               0, 0, &ErrMsg);
+  RemoveObjects();
+  if (Status != 0) {
+    llvm::errs() << "Failed to link shared object: " << ErrMsg << '\n';
+    llvm::sys::fs::remove(TempPath);
+    return ErrCode::Failed;
+  }
+  if (!appendCacheTrailer(TempPath, Key) ||
+      llvm::sys::fs::rename(TempPath, Path)) {
+    llvm::sys::fs::remove(TempPath);
+    return ErrCode::Failed;
+  }
+  return ErrCode::Success;
+}
+
 } // namespace
 
 namespace SSVM {
 namespace Compiler {
 
+std::string Compiler::getCachePath(Support::SHA256::Digest &Key) {
+  if (WasmPath.empty()) {
+    return {};
+  }
+  std::ifstream File(WasmPath, std::ios::binary);
+  if (!File) {
+    return {};
+  }
+  const std::vector<char> Code((std::istreambuf_iterator<char>(File)),
+                               std::istreambuf_iterator<char>());
+
+  /// SHA-256 of wasm bytes, compiler version, and code generation flags.
+  Support::SHA256 Hasher;
+  std::string Version =
+      std::string(kCacheVersion) + ' ' + LLVM_VERSION_STRING + ' ' +
+      llvm::sys::getProcessTriple() + " O" +
+      std::to_string(static_cast<int>(Config.getOptimizationLevel()));
+  if (Config.isHostCPU()) {
+    /// Host tuned code depends on the CPU and its features.
+    Version += ' ' + llvm::sys::getHostCPUName().str() + ' ' +
+               createTargetBuilder(Config).getFeatures().getString();
+  }
+  Hasher.update(Code.data(), Code.size());
+  Hasher.update(Version.data(), Version.size() + 1);
+  if (Config.hasVMType(VM::Configure::VMType::Ewasm)) {
+    /// Metered code depends on the cost table.
+    const auto &Table = EnvMgr.getCostTable();
+    Hasher.update(Table.data(), Table.size() * sizeof(uint64_t));
+  }
+  Key = Hasher.finalize();
+  return WasmPath + '.' + Support::SHA256::toHex(Key) + ".so";
+}
+
 ErrCode Compiler::runLoader() {
   Expect<std::unique_ptr<AST::Module>> Res;
   if (WasmPath == "") {
@@ -1055,14 +1448,48 @@ ErrCode Compiler::runLoader() {
 }
 
 ErrCode Compiler::compile() {
+  /// Load cached native code. Loading and compilation are skipped.
+  std::string CachePath;
+  Support::SHA256::Digest CacheKey;
+  if (CacheEnabled) {
+    CachePath = getCachePath(CacheKey);
+  }
+  if (!CachePath.empty() && verifyCacheTrailer(CachePath, CacheKey)) {
+    if (auto Cached = Library::loadSharedObject(CachePath)) {
+      Lib = std::move(Cached);
+      return registerHostFunctions();
+    }
+  }
+
+  /// Cache is written by linking with the system compiler driver.
+  std::string Driver;
+  if (!CachePath.empty()) {
+    if (auto Res = llvm::sys::findProgramByName("cc")) {
+      Driver = std::move(*Res);
+    } else {
+      llvm::errs() << "Compiler driver cc not found, native code is not "
+                      "cached.\n";
+      CachePath.clear();
+    }
+  }
+
   /// Load code.
   if (ErrCode Status = runLoader(); Status != ErrCode::Success) {
     return Status;
   }
 
-  Lib.reset(new Library);
+  llvm::orc::JITTargetMachineBuilder TMBuilder = createTargetBuilder(Config);
+  Lib.reset(new Library(TMBuilder,
+                        Support::getWorkerCount(
+                            Config.getCompileThreadCount(),
+                            std::numeric_limits<size_t>::max()),
+                        CompileTimer));
   auto Module = std::make_unique<llvm::Module>("wasm.ll", Lib->getContext());
   CompileContext NewContext(*Module);
+  if (Config.hasVMType(VM::Configure::VMType::Ewasm)) {
+    /// Ewasm contracts are metered by gas.
+    NewContext.setCostTable(EnvMgr.getCostTable());
+  }
   struct RAIICleanup {
     RAIICleanup(CompileContext *&Context, CompileContext &NewContext)
         : Context(Context) {
@@ -1095,20 +1522,18 @@ ErrCode Compiler::compile() {
 
   llvm::verifyModule(*Module, &llvm::errs());
 
-  // optimize
+  /// Optimize with the target of code generator.
   {
-    llvm::PassBuilder PB;
-    llvm::LoopAnalysisManager LAM(false);
-    llvm::FunctionAnalysisManager FAM(false);
-    llvm::CGSCCAnalysisManager CGAM(false);
-    llvm::ModuleAnalysisManager MAM(false);
-    FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
-    PB.registerModuleAnalyses(MAM);
-    PB.registerCGSCCAnalyses(CGAM);
-    PB.registerFunctionAnalyses(FAM);
-    PB.registerLoopAnalyses(LAM);
-    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
-    PB.buildPerModuleDefaultPipeline(llvm::PassBuilder::O1).run(*Module, MAM);
+    auto TM = TMBuilder.createTargetMachine();
+    if (!TM) {
+      llvm::errs() << llvm::toString(TM.takeError()) << '\n';
+      return ErrCode::Failed;
+    }
+    Module->setTargetTriple((*TM)->getTargetTriple().str());
+    Module->setDataLayout((*TM)->createDataLayout());
+    CompileTimer.measure([&]() {
+      optimizeModule(*Module, **TM, Config.getOptimizationLevel());
+    });
   }
 
   // write module for debug
@@ -1119,8 +1544,43 @@ ErrCode Compiler::compile() {
     Module->print(OS, nullptr);
   }
 
-  Lib->setModule(std::move(Module));
+  /// Split module to compile partitions on threads.
+  size_t FunctionCount = 0;
+  for (const auto &F : *Module) {
+    if (!F.isDeclaration()) {
+      ++FunctionCount;
+    }
+  }
+  const uint32_t PartitionCount =
+      Support::getWorkerCount(Config.getCompileThreadCount(), FunctionCount);
+  std::vector<std::string> Speculated;
+  if (Config.isSpeculativeCompile()) {
+    Speculated = collectReachable(*Module, PartitionCount > 1);
+  }
+  auto Partitions = Library::splitModule(std::move(Module), PartitionCount);
+
+  /// Emit native code to cache and run it from the shared object.
+  if (!CachePath.empty()) {
+    std::vector<llvm::Module *> Modules;
+    for (auto &Part : Partitions) {
+      Modules.push_back(Part.second.get());
+    }
+    if (emitSharedObject(Modules, TMBuilder, PartitionCount, CompileTimer,
+                         Driver, CachePath, CacheKey) == ErrCode::Success) {
+      Partitions.clear();
+      if (auto Cached = Library::loadSharedObject(CachePath)) {
+        Lib = std::move(Cached);
+        return registerHostFunctions();
+      }
+      return ErrCode::Failed;
+    }
+  }
+
+  Lib->setModule(std::move(Partitions), Speculated);
+  return registerHostFunctions();
+}
 
+ErrCode Compiler::registerHostFunctions() {
   if (Config.hasVMType(SSVM::VM::Configure::VMType::Ewasm)) {
     /// Ewasm case, insert EEI host functions.
     auto *EVMEnv = getEnvironment<SSVM::VM::EVMEnvironment>(
@@ -1276,12 +1736,11 @@ ErrCode Compiler::compile(const AST::ImportSection &ImportSec) {
           llvm::Function::Create(FTy, llvm::GlobalValue::InternalLinkage,
                                  FullName + ".wrap", Context->Module);
 
-      llvm::GlobalVariable *Ctx = new llvm::GlobalVariable(
-          Context->Module, llvm::Type::getInt8Ty(Context->Context), false,
-          llvm::GlobalValue::ExternalLinkage, nullptr, FullCtxName);
+      llvm::GlobalVariable *Ctx = createSlot(
+          Context->Module, llvm::Type::getInt8Ty(Context->Context),
+          FullCtxName);
 
-      llvm::Function *FE = createCtxCall(F, Ctx);
-      FE->setName(FullName);
+      createCtxCall(F, Ctx, FullName);
 
       Context->Functions.emplace_back(*TypeIdx, F, nullptr);
     }
@@ -1344,7 +1803,7 @@ ErrCode Compiler::compile(const AST::MemorySection &MemorySection,
     llvm::Constant *Temp =
         FunctionCompiler::evaluate(DataSeg->getInstrs(), *Context);
     const uint64_t Offset = llvm::cast<llvm::ConstantInt>(Temp)->getZExtValue();
-    const auto &Data = DataSeg->getData();
+    const auto Data = DataSeg->getData();
 
     if (ResultData.size() < Offset + Data.size()) {
       ResultData.resize(Offset + Data.size());
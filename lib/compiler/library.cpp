@@ -1,28 +1,75 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "compiler/library.h"
+#include "support/allocator.h"
+#include "support/fault.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dlfcn.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
 #include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
 
 namespace {
-static const constexpr uint32_t kPageSize = 65536;
+static const constexpr uint32_t kInitPages = 2;
 }
 
 namespace SSVM {
 namespace Compiler {
 
+/// Interface of compiled code.
 class Library::Engine {
+public:
+  virtual ~Engine() noexcept = default;
+
+  /// Get address of symbol, or nullptr if not found.
+  virtual void *lookup(const std::string &Name) = 0;
+};
+
+/// Code compiled by LLVM JIT in process.
+///
+/// Modules in their own contexts are compiled concurrently on the compile
+/// threads when looked up.
+class Library::JITEngine : public Library::Engine {
 private:
   llvm::orc::ThreadSafeContext TSCtx;
-  std::unique_ptr<llvm::orc::LLLazyJIT> JIT;
+  std::unique_ptr<llvm::orc::LLJIT> JIT;
+  /// Thread of speculative compilation.
+  std::thread Speculator;
 
 public:
-  Engine()
+  JITEngine(llvm::orc::JITTargetMachineBuilder TMBuilder,
+            const uint32_t Threads, Support::WorkTimer &Timer)
       : TSCtx(std::make_unique<llvm::LLVMContext>()),
-        JIT(llvm::cantFail(llvm::orc::LLLazyJITBuilder().create())) {
+        JIT(llvm::cantFail(
+            llvm::orc::LLJITBuilder()
+                .setJITTargetMachineBuilder(std::move(TMBuilder))
+                .setNumCompileThreads(Threads > 1 ? Threads : 0)
+                .setCompileFunctionCreator(
+                    [&Timer](llvm::orc::JITTargetMachineBuilder JTMB)
+                        -> llvm::Expected<
+                            llvm::orc::IRCompileLayer::CompileFunction> {
+                      return [&Timer, Compile = llvm::orc::ConcurrentIRCompiler(
+                                          std::move(JTMB))](
+                                 llvm::Module &Module) mutable {
+                        return Timer.measure(
+                            [&Compile, &Module] { return Compile(Module); });
+                      };
+                    })
+                .create())) {
     static_cast<llvm::orc::RTDyldObjectLinkingLayer &>(
         JIT->getObjLinkingLayer())
         .setNotifyLoaded(
@@ -35,11 +82,21 @@ public:
             });
   }
 
+  ~JITEngine() noexcept override {
+    if (Speculator.joinable()) {
+      Speculator.join();
+    }
+  }
+
   llvm::LLVMContext &getContext() { return *TSCtx.getContext(); }
 
-  llvm::Error addModule(std::unique_ptr<llvm::Module> Module) {
+  llvm::Error addModule(Partition Part) {
+    if (Part.first) {
+      return JIT->addIRModule(llvm::orc::ThreadSafeModule(
+          std::move(Part.second), std::move(Part.first)));
+    }
     return JIT->addIRModule(
-        llvm::orc::ThreadSafeModule(std::move(Module), TSCtx));
+        llvm::orc::ThreadSafeModule(std::move(Part.second), TSCtx));
   }
 
   llvm::Error defineAbsolute(llvm::StringRef Name,
@@ -47,65 +104,177 @@ public:
     return JIT->defineAbsolute(Name, Address);
   }
 
-  llvm::Expected<llvm::JITEvaluatedSymbol> lookup(llvm::StringRef Name) {
-    return JIT->lookup(Name);
+  /// Look up symbols of names in background, which compiles their modules.
+  void speculate(const std::vector<std::string> &Names) {
+    llvm::orc::MangleAndInterner Mangle(JIT->getExecutionSession(),
+                                        JIT->getDataLayout());
+    llvm::orc::SymbolNameSet Symbols;
+    for (const auto &Name : Names) {
+      Symbols.insert(Mangle(Name));
+    }
+    Speculator = std::thread([this, Symbols = std::move(Symbols)]() {
+      const llvm::orc::JITDylibSearchList SearchList = {
+          {&JIT->getMainJITDylib(), true}};
+      if (auto Res = JIT->getExecutionSession().lookup(SearchList, Symbols);
+          !Res) {
+        llvm::consumeError(Res.takeError());
+      }
+    });
+  }
+
+  void *lookup(const std::string &Name) override {
+    if (auto Symbol = JIT->lookup(Name)) {
+      return reinterpret_cast<void *>(Symbol->getAddress());
+    } else {
+      llvm::consumeError(Symbol.takeError());
+    }
+    return nullptr;
   }
 };
 
-Library::Library() : ExecutionEngine(nullptr) {
+/// Code loaded from shared object without LLVM.
+class Library::SharedEngine : public Library::Engine {
+private:
+  void *Handle;
+
+public:
+  SharedEngine(void *H) : Handle(H) {}
+  ~SharedEngine() noexcept override { dlclose(Handle); }
+
+  void *lookup(const std::string &Name) override {
+    return dlsym(Handle, Name.c_str());
+  }
+};
+
+Library::Library(Engine *E)
+    : ExecutionEngine(E), Memory(Support::Allocator::allocate(kInitPages)),
+      MemoryPages(kInitPages) {}
+
+Library::Library(llvm::orc::JITTargetMachineBuilder TMBuilder,
+                 const uint32_t Threads, Support::WorkTimer &Timer)
+    : Library(nullptr) {
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
   llvm::InitializeNativeTargetAsmParser();
-  ExecutionEngine = new Engine;
-  Memory.resize(kPageSize * 2);
-  Memory.reserve(1048576);
-  MemoryPtr = Memory.data();
+  ExecutionEngine = new JITEngine(std::move(TMBuilder), Threads, Timer);
+}
+
+std::unique_ptr<Library> Library::loadSharedObject(const std::string &Path) {
+  /// Loading the same path again returns the same handle, of which the symbol
+  /// slots of memory, costs, and host functions are bound by every library.
+  /// Each library loads its own copy in an anonymous file instead.
+  std::ifstream File(Path, std::ios::binary);
+  if (!File) {
+    return nullptr;
+  }
+  const int Fd = memfd_create("ssvm-aot", MFD_CLOEXEC);
+  if (Fd < 0) {
+    return nullptr;
+  }
+  bool Copied = true;
+  char Buffer[65536];
+  while (Copied && File.read(Buffer, sizeof(Buffer)).gcount() > 0) {
+    const std::streamsize Size = File.gcount();
+    for (std::streamsize Written = 0; Written < Size;) {
+      const ssize_t Ret = write(Fd, Buffer + Written, Size - Written);
+      if (Ret < 0 && errno != EINTR) {
+        Copied = false;
+        break;
+      }
+      Written += std::max(Ret, ssize_t(0));
+    }
+  }
+  void *Handle = nullptr;
+  if (Copied && File.eof()) {
+    const std::string FdPath = "/proc/self/fd/" + std::to_string(Fd);
+    Handle = dlopen(FdPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+  }
+  close(Fd);
+  if (Handle == nullptr) {
+    return nullptr;
+  }
+  std::unique_ptr<Library> Lib(new Library(new SharedEngine(Handle)));
+  Lib->bindSymbols();
+  return Lib;
 }
 
 llvm::LLVMContext &Library::getContext() {
-  return ExecutionEngine->getContext();
+  return static_cast<JITEngine *>(ExecutionEngine)->getContext();
+}
+
+std::vector<Library::Partition>
+Library::splitModule(std::unique_ptr<llvm::Module> Module,
+                     const uint32_t Count) {
+  std::vector<Partition> Partitions;
+  if (Count <= 1) {
+    Partitions.emplace_back(nullptr, std::move(Module));
+    return Partitions;
+  }
+  /// Move each part into its own context through bitcode, since a context
+  /// can only be used by one thread at a time.
+  llvm::SplitModule(
+      std::move(Module), Count,
+      [&Partitions](std::unique_ptr<llvm::Module> Part) {
+        llvm::SmallString<0> Buffer;
+        {
+          llvm::raw_svector_ostream OS(Buffer);
+          llvm::WriteBitcodeToFile(*Part, OS);
+        }
+        auto Context = std::make_unique<llvm::LLVMContext>();
+        auto Res = llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(Buffer.str(), Part->getModuleIdentifier()),
+            *Context);
+        Partitions.emplace_back(std::move(Context),
+                                llvm::cantFail(std::move(Res)));
+      });
+  return Partitions;
 }
 
-void Library::setModule(std::unique_ptr<llvm::Module> Module) {
-  llvm::cantFail(ExecutionEngine->addModule(std::move(Module)));
+void Library::setModule(std::vector<Partition> Partitions,
+                        const std::vector<std::string> &Speculated) {
+  auto *JIT = static_cast<JITEngine *>(ExecutionEngine);
+  for (auto &Part : Partitions) {
+    llvm::cantFail(JIT->addModule(std::move(Part)));
+  }
 
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
+  llvm::cantFail(JIT->defineAbsolute(
       "memset",
       llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&std::memset),
                                llvm::JITSymbolFlags::Exported |
                                    llvm::JITSymbolFlags::Callable)));
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
+  llvm::cantFail(JIT->defineAbsolute(
       "memcpy",
       llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&std::memcpy),
                                llvm::JITSymbolFlags::Exported |
                                    llvm::JITSymbolFlags::Callable)));
 
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      "$trap",
-      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&trapProxy),
-                               llvm::JITSymbolFlags::Exported |
-                                   llvm::JITSymbolFlags::Callable)));
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      "$memory.size",
-      llvm::JITEvaluatedSymbol(
-          llvm::pointerToJITTargetAddress(&memorySizeProxy),
-          llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable)));
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      "$memory.grow",
-      llvm::JITEvaluatedSymbol(
-          llvm::pointerToJITTargetAddress(&memoryGrowProxy),
-          llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable)));
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      "$lib.ctx",
-      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(this),
-                               llvm::JITSymbolFlags::Exported)));
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      "$memory",
-      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&MemoryPtr),
-                               llvm::JITSymbolFlags::Exported)));
+  /// Binding symbols waits for compilation, which speculation overlaps.
+  if (!Speculated.empty()) {
+    JIT->speculate(Speculated);
+  }
+  bindSymbols();
 }
 
-Library::~Library() noexcept { delete ExecutionEngine; }
+void Library::bindSymbols() {
+  setSymbol("$trap", reinterpret_cast<void *>(&trapProxy));
+  setSymbol("$memory.size", reinterpret_cast<void *>(&memorySizeProxy));
+  setSymbol("$memory.grow", reinterpret_cast<void *>(&memoryGrowProxy));
+  setSymbol("$lib.ctx", this);
+  setSymbol("$memory", Memory);
+  setSymbol("$cost.sum", &CostSum);
+  setSymbol("$cost.limit", &CostLimit);
+}
+
+void Library::setSymbol(const std::string &Name, void *Value) {
+  if (auto *Slot = static_cast<void **>(ExecutionEngine->lookup(Name))) {
+    *Slot = Value;
+  }
+}
+
+Library::~Library() noexcept {
+  delete ExecutionEngine;
+  Support::Allocator::release(Memory);
+}
 
 ErrCode Library::execute() {
   using namespace std::literals;
@@ -113,19 +282,25 @@ ErrCode Library::execute() {
 }
 
 ErrCode Library::execute(const std::string &FuncName) {
-  if (auto Function = ExecutionEngine->lookup("$ctor")) {
-    reinterpret_cast<void (*)()>(Function->getAddress())();
-  } else {
-    llvm::errs() << Function.takeError() << '\n';
+  if (Memory == nullptr) {
+    return ErrCode::MemoryOutOfBounds;
+  }
+  if (auto *Function = ExecutionEngine->lookup("$ctor")) {
+    reinterpret_cast<void (*)()>(Function)();
   }
-  if (auto Function = ExecutionEngine->lookup(FuncName)) {
+  if (auto *Function = ExecutionEngine->lookup(FuncName)) {
+    /// Memory accesses out of bound fault in the guard region and jump back.
+    Support::Fault FaultHandler;
+    if (sigsetjmp(FaultHandler.getBuffer(), 0) != 0) {
+      return ErrCode::MemoryOutOfBounds;
+    }
     try {
-      reinterpret_cast<void (*)()>(Function->getAddress())();
+      reinterpret_cast<void (*)()>(Function)();
     } catch (const ErrCode &Status) {
       return Status;
     }
   } else {
-    llvm::errs() << Function.takeError() << '\n';
+    llvm::errs() << "Function " << FuncName << " not found.\n";
     return ErrCode::Failed;
   }
   return ErrCode::Success;
@@ -135,15 +310,16 @@ void Library::trap(ErrCode Status) {
   throw Status;
 }
 
-uint32_t Library::memorySize() {
-  const uint32_t Size = Memory.size() / kPageSize;
-  return Size;
-}
+uint32_t Library::memorySize() { return MemoryPages; }
 
 uint32_t Library::memoryGrow(uint32_t NewSize) {
-  const uint32_t OldSize = Memory.size() / kPageSize;
-  Memory.resize(Memory.size() + NewSize * kPageSize);
-  MemoryPtr = Memory.data();
+  const uint32_t OldSize = MemoryPages;
+  if (static_cast<uint64_t>(OldSize) + NewSize >
+          Support::Allocator::kMaxPageCount ||
+      !Support::Allocator::resize(Memory, OldSize, OldSize + NewSize)) {
+    return UINT32_C(-1);
+  }
+  MemoryPages += NewSize;
   return OldSize;
 }
 
@@ -152,17 +328,10 @@ void Library::terminate() { throw ErrCode::Terminated; }
 ErrCode Library::setHostFunction(std::unique_ptr<HostFunction> Func,
                                  const std::string &ModName,
                                  const std::string &FuncName) {
+  /// Slots only exist for the imported host functions.
   const std::string FullName = ModName + '.' + FuncName;
-  const std::string FullCtxName = FullName + ".ctx";
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      FullName,
-      llvm::JITEvaluatedSymbol(
-          llvm::pointerToJITTargetAddress(Func->getFunction()),
-          llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable)));
-  llvm::cantFail(ExecutionEngine->defineAbsolute(
-      FullCtxName,
-      llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(Func.get()),
-                               llvm::JITSymbolFlags::Exported)));
+  setSymbol(FullName, Func->getFunction());
+  setSymbol(FullName + ".ctx", Func.get());
 
   HostFuncs.emplace_back(std::move(Func));
   return ErrCode::Success;
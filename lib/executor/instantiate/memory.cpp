@@ -70,7 +70,7 @@ ErrCode Executor::instantiate(AST::MemorySection *MemSec,
     }
 
     /// Copy data to memory instance
-    const std::vector<unsigned char> &Data = (*DataSeg)->getData();
+    const auto Data = (*DataSeg)->getData();
     if ((Status = MemInst->setBytes(Data, Offset, 0, Data.size())) !=
         ErrCode::Success) {
       return Status;
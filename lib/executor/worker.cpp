@@ -624,14 +624,12 @@ ErrCode Worker::invokeFunction(unsigned int FuncAddr) {
     }
 #endif
     /// Set start time.
-    TimeRecorder.stopRecord(TIMER_TAG_EXECUTION);
-    TimeRecorder.startRecord(TIMER_TAG_HOSTFUNC);
+    TimeRecorder.switchRecord(TIMER_TAG_EXECUTION, TIMER_TAG_HOSTFUNC);
 
     /// Run host function.
     ErrCode Status = HostFunc->run(EnvMgr, StackMgr, *MemoryInst);
 
-    TimeRecorder.stopRecord(TIMER_TAG_HOSTFUNC);
-    TimeRecorder.startRecord(TIMER_TAG_EXECUTION);
+    TimeRecorder.switchRecord(TIMER_TAG_HOSTFUNC, TIMER_TAG_EXECUTION);
 #ifdef ONNC_WASM
     if (EnvMgr.IsQITCTimer) {
       TimeRecorder.stopRecord(TIMER_TAG_QITC_INFER_HOST);
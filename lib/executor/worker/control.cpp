@@ -85,9 +85,9 @@ ErrCode Worker::runBrTableOp(AST::BrTableControlInstruction &Instr) {
   int32_t Value = retrieveValue<uint32_t>(Val);
 
   /// Do branch.
-  const std::vector<unsigned int> &LabelTable = Instr.getLabelTable();
+  const auto LabelTable = Instr.getLabelTable();
   if (Value < LabelTable.size()) {
-    Status = branchToLabel(LabelTable.at(Value));
+    Status = branchToLabel(LabelTable[Value]);
   } else {
     Status = branchToLabel(Instr.getLabelIndex());
   }
@@ -18,7 +18,7 @@ AST::Instruction *InstrProvider::getNextInstr() {
   }
 
   /// Get instruction.
-  AST::Instruction *Instr = (*Iters.back().Curr).get();
+  AST::Instruction *Instr = *Iters.back().Curr;
   (Iters.back().Curr)++;
   return Instr;
 }
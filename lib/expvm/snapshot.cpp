@@ -0,0 +1,569 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "expvm/snapshot.h"
+#include "loader/filemgr.h"
+#include "support/allocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+/// Maximum chunk count of a run, so that run bytes fit in 32 bits.
+static const constexpr uint32_t kMaxRunChunks = 65536;
+
+/// Check the chunk is all zeros.
+bool isZeroChunk(const uint8_t *Ptr) {
+  uint64_t Acc = 0;
+  for (uint64_t I = 0; I < SSVM::ExpVM::Snapshot::kChunkSize; I += 8) {
+    uint64_t Word;
+    std::memcpy(&Word, Ptr + I, 8);
+    Acc |= Word;
+  }
+  return Acc == 0;
+}
+
+/// Get the encoded size of unsigned LEB128.
+uint64_t getLEBSize(uint64_t Val) {
+  uint64_t Size = 1;
+  while (Val >= 0x80) {
+    Val >>= 7;
+    ++Size;
+  }
+  return Size;
+}
+
+/// Write unsigned LEB128.
+void writeLEB(std::ostream &OS, uint64_t Val) {
+  do {
+    uint8_t Byte = Val & 0x7F;
+    Val >>= 7;
+    if (Val != 0) {
+      Byte |= 0x80;
+    }
+    OS.put(static_cast<char>(Byte));
+  } while (Val != 0);
+}
+
+/// Restore states read from file manager. Mapped runs are mapped from the
+/// file descriptor if valid, or copied otherwise.
+SSVM::Expect<void> restoreFrom(SSVM::Runtime::StoreManager &StoreMgr,
+                               SSVM::FileMgrMap &Mgr, const int Fd) {
+  using namespace SSVM;
+  /// Chunks are mapped only if they are aligned to system pages.
+  const bool CanMap =
+      Fd >= 0 &&
+      ExpVM::Snapshot::kChunkSize %
+              Runtime::Instance::MemoryInstance::getDirtyPageSize() ==
+          0;
+
+  /// Check header.
+  if (auto Res = Mgr.readView(sizeof(ExpVM::Snapshot::kMagic))) {
+    if (!std::equal(Res->begin(), Res->end(),
+                    std::begin(ExpVM::Snapshot::kMagic))) {
+      return Unexpect(ErrCode::InvalidGrammar);
+    }
+  } else {
+    return Unexpect(Res);
+  }
+  if (auto Res = Mgr.readU32()) {
+    if (*Res != ExpVM::Snapshot::kVersion) {
+      return Unexpect(ErrCode::InvalidGrammar);
+    }
+  } else {
+    return Unexpect(Res);
+  }
+
+  /// Get instantiated active module instance.
+  Runtime::Instance::ModuleInstance *ModInst;
+  if (auto Res = StoreMgr.getActiveModule()) {
+    ModInst = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+
+  /// Check the snapshot is taken from the same module. Modules loaded without
+  /// the digest cannot be checked.
+  const auto &Hash = ModInst->getHash();
+  if (!Hash) {
+    return Unexpect(ErrCode::WrongVMWorkflow);
+  }
+  if (auto Res = Mgr.readView(Hash->size())) {
+    if (!std::equal(Res->begin(), Res->end(), Hash->begin())) {
+      return Unexpect(ErrCode::ImportNotMatch);
+    }
+  } else {
+    return Unexpect(Res);
+  }
+
+  /// Restore globals. Only mutable globals of the same types are written.
+  uint32_t GlobCnt;
+  if (auto Res = Mgr.readU32()) {
+    GlobCnt = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+  for (uint32_t I = 0; I < GlobCnt; ++I) {
+    Runtime::Instance::GlobalInstance *GlobInst;
+    if (auto Res = Mgr.readU32()) {
+      if (auto Addr = ModInst->getGlobalAddr(*Res)) {
+        GlobInst = *StoreMgr.getGlobal(*Addr);
+      } else {
+        return Unexpect(Addr);
+      }
+    } else {
+      return Unexpect(Res);
+    }
+    if (auto Res = Mgr.readByte()) {
+      if (GlobInst->getValMut() != ValMut::Var ||
+          static_cast<Byte>(GlobInst->getValType()) != *Res) {
+        return Unexpect(ErrCode::TypeNotMatch);
+      }
+    } else {
+      return Unexpect(Res);
+    }
+    if (auto Res = Mgr.readU64()) {
+      retrieveValue<uint64_t>(GlobInst->getValue()) = *Res;
+    } else {
+      return Unexpect(Res);
+    }
+  }
+
+  /// Restore tables of the same sizes.
+  uint32_t TabCnt;
+  if (auto Res = Mgr.readU32()) {
+    TabCnt = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+  for (uint32_t I = 0; I < TabCnt; ++I) {
+    Runtime::Instance::TableInstance *TabInst;
+    if (auto Res = Mgr.readU32()) {
+      if (auto Addr = ModInst->getTableAddr(*Res)) {
+        TabInst = *StoreMgr.getTable(*Addr);
+      } else {
+        return Unexpect(Addr);
+      }
+    } else {
+      return Unexpect(Res);
+    }
+    if (auto Res = Mgr.readU32()) {
+      if (*Res != TabInst->getSize()) {
+        return Unexpect(ErrCode::TypeNotMatch);
+      }
+    } else {
+      return Unexpect(Res);
+    }
+    std::vector<Runtime::Instance::TableInstance::FuncElem> Elems(
+        TabInst->getSize());
+    for (auto &Elem : Elems) {
+      uint32_t FuncIdx;
+      if (auto Res = Mgr.readU32()) {
+        FuncIdx = *Res;
+      } else {
+        return Unexpect(Res);
+      }
+      if (FuncIdx == 0) {
+        continue;
+      }
+      if (auto Addr = ModInst->getFuncAddr(FuncIdx - 1)) {
+        Elem.Addr = *Addr;
+        Elem.TypeId = (*StoreMgr.getFunction(*Addr))->getFuncTypeId();
+      } else {
+        return Unexpect(Addr);
+      }
+    }
+    if (auto Res = TabInst->setInitList(0, Elems); !Res) {
+      return Unexpect(Res);
+    }
+  }
+
+  /// Restore memories.
+  uint32_t MemCnt;
+  if (auto Res = Mgr.readU32()) {
+    MemCnt = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+  for (uint32_t I = 0; I < MemCnt; ++I) {
+    Runtime::Instance::MemoryInstance *MemInst;
+    if (auto Res = Mgr.readU32()) {
+      if (auto Addr = ModInst->getMemAddr(*Res)) {
+        MemInst = *StoreMgr.getMemory(*Addr);
+      } else {
+        return Unexpect(Addr);
+      }
+    } else {
+      return Unexpect(Res);
+    }
+    if (auto Res = Mgr.readU32()) {
+      if (*Res > MemInst->getDataPageSize()) {
+        if (auto GrowRes = MemInst->growPage(*Res - MemInst->getDataPageSize());
+            !GrowRes) {
+          return Unexpect(GrowRes);
+        }
+      }
+    } else {
+      return Unexpect(Res);
+    }
+    uint32_t RunCnt;
+    if (auto Res = Mgr.readU32()) {
+      RunCnt = *Res;
+    } else {
+      return Unexpect(Res);
+    }
+    for (uint32_t J = 0; J < RunCnt; ++J) {
+      uint64_t Offset, Length;
+      if (auto Res = Mgr.readU32()) {
+        Offset = *Res * ExpVM::Snapshot::kChunkSize;
+      } else {
+        return Unexpect(Res);
+      }
+      if (auto Res = Mgr.readU32(); Res && *Res <= kMaxRunChunks) {
+        Length = *Res * ExpVM::Snapshot::kChunkSize;
+      } else {
+        return Unexpect(Res ? ErrCode::InvalidGrammar : Res.error());
+      }
+      Byte Kind;
+      if (auto Res = Mgr.readByte()) {
+        Kind = *Res;
+      } else {
+        return Unexpect(Res);
+      }
+      if (Kind == 0x00) {
+        if (auto Res = MemInst->clearBytes(Offset, Length); !Res) {
+          return Unexpect(Res);
+        }
+      } else if (Kind == 0x01) {
+        if (Offset + Length > MemInst->getDataSize()) {
+          return Unexpect(ErrCode::MemorySizeExceeded);
+        }
+        if (auto Res = Mgr.readView(Length)) {
+          if (auto SetRes = MemInst->setBytes(*Res, Offset, 0, Length);
+              !SetRes) {
+            return Unexpect(SetRes);
+          }
+        } else {
+          return Unexpect(Res);
+        }
+      } else if (Kind == 0x02) {
+        if (Offset + Length > MemInst->getDataSize()) {
+          return Unexpect(ErrCode::MemorySizeExceeded);
+        }
+        /// Bytes start after the padding to the chunk aligned offset.
+        const uint64_t Padding =
+            (ExpVM::Snapshot::kChunkSize -
+             Mgr.getOffset() % ExpVM::Snapshot::kChunkSize) %
+            ExpVM::Snapshot::kChunkSize;
+        auto Res = Mgr.readView(Padding + Length);
+        if (!Res) {
+          return Unexpect(Res);
+        }
+        if (CanMap) {
+          if (auto MapRes = MemInst->mapBytes(Fd, Mgr.getOffset() - Length,
+                                              Offset, Length);
+              !MapRes) {
+            return Unexpect(MapRes);
+          }
+        } else if (auto SetRes = MemInst->setBytes(*Res, Offset, Padding,
+                                                   Length);
+                   !SetRes) {
+          return Unexpect(SetRes);
+        }
+      } else {
+        return Unexpect(ErrCode::InvalidGrammar);
+      }
+    }
+  }
+  return {};
+}
+
+} // namespace
+
+namespace SSVM {
+namespace ExpVM {
+
+/// Scan states of the active module. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::scan(Runtime::StoreManager &StoreMgr) {
+  return scanChunks(StoreMgr, false);
+}
+
+/// Scan delta states of the active module. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::scanDirty(Runtime::StoreManager &StoreMgr) {
+  return scanChunks(StoreMgr, true);
+}
+
+/// Start tracking dirty pages. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::track(Runtime::StoreManager &StoreMgr) {
+  /// Get instantiated active module instance.
+  Runtime::Instance::ModuleInstance *ModInst;
+  if (auto Res = StoreMgr.getActiveModule()) {
+    ModInst = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+
+  for (uint32_t I = 0; I < ModInst->getMemNum(); ++I) {
+    auto *MemInst = *StoreMgr.getMemory(*ModInst->getMemAddr(I));
+    if (auto Res = MemInst->clearDirtyPages(); !Res) {
+      return Unexpect(Res);
+    }
+  }
+  return {};
+}
+
+/// Scan states in full or dirty chunks. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::scanChunks(Runtime::StoreManager &StoreMgr,
+                                  const bool DirtyOnly) {
+  Globals.clear();
+  Tables.clear();
+  Memories.clear();
+
+  /// Get instantiated active module instance.
+  Runtime::Instance::ModuleInstance *ModInst;
+  if (auto Res = StoreMgr.getActiveModule()) {
+    ModInst = *Res;
+  } else {
+    return Unexpect(Res);
+  }
+  /// The states are bound to the module by its digest.
+  if (!ModInst->getHash()) {
+    return Unexpect(ErrCode::WrongVMWorkflow);
+  }
+  ModuleHash = *ModInst->getHash();
+
+  /// Record mutable global values in bits. Immutable globals never change
+  /// after instantiation.
+  for (uint32_t I = 0; I < ModInst->getGlobalNum(); ++I) {
+    auto *GlobInst = *StoreMgr.getGlobal(*ModInst->getGlobalAddr(I));
+    if (GlobInst->getValMut() == ValMut::Var) {
+      Globals.push_back(Global{I, GlobInst->getValType(),
+                               retrieveValue<uint64_t>(GlobInst->getValue())});
+    }
+  }
+
+  /// Record table elements as function indices of the module, since function
+  /// addresses differ between stores.
+  if (ModInst->getTableNum() > 0) {
+    std::unordered_map<uint32_t, uint32_t> FuncIdxs;
+    for (uint32_t I = ModInst->getFuncNum(); I > 0; --I) {
+      FuncIdxs[*ModInst->getFuncAddr(I - 1)] = I - 1;
+    }
+    Tables.reserve(ModInst->getTableNum());
+    for (uint32_t I = 0; I < ModInst->getTableNum(); ++I) {
+      auto *TabInst = *StoreMgr.getTable(*ModInst->getTableAddr(I));
+      Table &Tab = Tables.emplace_back();
+      Tab.Index = I;
+      Tab.Elems.reserve(TabInst->getSize());
+      for (uint32_t J = 0; J < TabInst->getSize(); ++J) {
+        const auto *Elem = *TabInst->getElem(J);
+        if (Elem->TypeId == Runtime::Instance::NullFuncTypeId) {
+          Tab.Elems.push_back(0);
+        } else if (auto It = FuncIdxs.find(Elem->Addr); It != FuncIdxs.end()) {
+          Tab.Elems.push_back(It->second + 1);
+        } else {
+          /// Functions not in the module cannot be restored.
+          return Unexpect(ErrCode::WrongInstanceAddress);
+        }
+      }
+    }
+  }
+
+  /// Split memories into runs of zero chunks and data chunks.
+  Memories.reserve(ModInst->getMemNum());
+  for (uint32_t I = 0; I < ModInst->getMemNum(); ++I) {
+    auto *MemInst = *StoreMgr.getMemory(*ModInst->getMemAddr(I));
+    Memory &Mem = Memories.emplace_back();
+    Mem.Index = I;
+    Mem.PageCount = MemInst->getDataPageSize();
+    Mem.Data = MemInst->getDataPtr();
+    const uint32_t ChunkCnt =
+        static_cast<uint32_t>(MemInst->getDataSize() / kChunkSize);
+    if (DirtyOnly && MemInst->isDirtyTracking()) {
+      /// Chunks overlapped by dirty pages in ascending order.
+      const uint64_t PageSize = MemInst->getDirtyPageSize();
+      uint64_t Next = 0;
+      for (const uint64_t Page : MemInst->getDirtyPages()) {
+        const uint64_t Last = std::min<uint64_t>(
+            ((Page + 1) * PageSize + kChunkSize - 1) / kChunkSize, ChunkCnt);
+        for (uint64_t C = std::max(Next, Page * PageSize / kChunkSize);
+             C < Last; ++C) {
+          appendChunk(Mem, static_cast<uint32_t>(C));
+        }
+        Next = std::max(Next, Last);
+      }
+    } else {
+      for (uint32_t C = 0; C < ChunkCnt; ++C) {
+        appendChunk(Mem, C);
+      }
+    }
+  }
+  return {};
+}
+
+/// Append chunk to runs. See "include/expvm/snapshot.h".
+void Snapshot::appendChunk(Memory &Mem, const uint32_t Chunk) {
+  const RunKind Kind = isZeroChunk(Mem.Data + uint64_t(Chunk) * kChunkSize)
+                           ? RunKind::Zero
+                           : RunKind::Data;
+  if (!Mem.Runs.empty() && Mem.Runs.back().Kind == Kind &&
+      Mem.Runs.back().First + Mem.Runs.back().Count == Chunk &&
+      Mem.Runs.back().Count < kMaxRunChunks) {
+    ++Mem.Runs.back().Count;
+  } else {
+    Mem.Runs.push_back(Run{Chunk, 1, Kind});
+  }
+}
+
+/// Get encoded size. See "include/expvm/snapshot.h".
+uint64_t Snapshot::getSize() const {
+  uint64_t Size = sizeof(kMagic) + getLEBSize(kVersion) + ModuleHash.size();
+  Size += getLEBSize(Globals.size());
+  for (const auto &Glob : Globals) {
+    Size += getLEBSize(Glob.Index) + 1 + getLEBSize(Glob.Bits);
+  }
+  Size += getLEBSize(Tables.size());
+  for (const auto &Tab : Tables) {
+    Size += getLEBSize(Tab.Index) + getLEBSize(Tab.Elems.size());
+    for (const uint32_t Elem : Tab.Elems) {
+      Size += getLEBSize(Elem);
+    }
+  }
+  Size += getLEBSize(Memories.size());
+  for (const auto &Mem : Memories) {
+    Size += getLEBSize(Mem.Index) + getLEBSize(Mem.PageCount) +
+            getLEBSize(Mem.Runs.size());
+    for (const auto &R : Mem.Runs) {
+      Size += getLEBSize(R.First) + getLEBSize(R.Count) + 1;
+      if (R.Kind == RunKind::Data) {
+        Size += R.Count * kChunkSize;
+      }
+    }
+  }
+  return Size;
+}
+
+/// Write encoded snapshot. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::write(std::ostream &OS) const {
+  return writeRuns(OS, false);
+}
+
+/// Write encoded snapshot to file. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::write(const std::string &Path,
+                             const bool Mappable) const {
+  /// Write a temporary file and rename it over the path, so that readers and
+  /// mappings of the old file never see a partial or truncated one.
+  std::string TempPath = Path + ".XXXXXX";
+  const int Fd = ::mkstemp(TempPath.data());
+  if (Fd < 0) {
+    return Unexpect(ErrCode::InvalidPath);
+  }
+  ::fchmod(Fd, 0644);
+  ::close(Fd);
+  std::ofstream OS(TempPath, std::ios::out | std::ios::binary);
+  if (!OS.is_open()) {
+    ::unlink(TempPath.c_str());
+    return Unexpect(ErrCode::InvalidPath);
+  }
+  if (auto Res = writeRuns(OS, Mappable); !Res) {
+    ::unlink(TempPath.c_str());
+    return Unexpect(Res);
+  }
+  OS.close();
+  if (!OS || std::rename(TempPath.c_str(), Path.c_str()) != 0) {
+    ::unlink(TempPath.c_str());
+    return Unexpect(ErrCode::InvalidPath);
+  }
+  return {};
+}
+
+/// Write encoded snapshot with runs. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::writeRuns(std::ostream &OS, const bool Mappable) const {
+  /// Offset of the encoding for aligning mapped runs.
+  uint64_t Pos = sizeof(kMagic) + getLEBSize(kVersion) + ModuleHash.size();
+  auto Write = [&OS, &Pos](const uint64_t Val) {
+    writeLEB(OS, Val);
+    Pos += getLEBSize(Val);
+  };
+  OS.write(kMagic, sizeof(kMagic));
+  writeLEB(OS, kVersion);
+  OS.write(reinterpret_cast<const char *>(ModuleHash.data()),
+           ModuleHash.size());
+  Write(Globals.size());
+  for (const auto &Glob : Globals) {
+    Write(Glob.Index);
+    OS.put(static_cast<char>(Glob.Type));
+    ++Pos;
+    Write(Glob.Bits);
+  }
+  Write(Tables.size());
+  for (const auto &Tab : Tables) {
+    Write(Tab.Index);
+    Write(Tab.Elems.size());
+    for (const uint32_t Elem : Tab.Elems) {
+      Write(Elem);
+    }
+  }
+  Write(Memories.size());
+  for (const auto &Mem : Memories) {
+    Write(Mem.Index);
+    Write(Mem.PageCount);
+    Write(Mem.Runs.size());
+    for (const auto &R : Mem.Runs) {
+      const RunKind Kind =
+          (Mappable && R.Kind == RunKind::Data) ? RunKind::Mapped : R.Kind;
+      Write(R.First);
+      Write(R.Count);
+      OS.put(static_cast<char>(Kind));
+      ++Pos;
+      if (Kind == RunKind::Mapped) {
+        const uint64_t Padding = (kChunkSize - Pos % kChunkSize) % kChunkSize;
+        for (uint64_t I = 0; I < Padding; ++I) {
+          OS.put('\0');
+        }
+        Pos += Padding;
+      }
+      if (Kind != RunKind::Zero) {
+        OS.write(reinterpret_cast<const char *>(Mem.Data) +
+                     R.First * kChunkSize,
+                 R.Count * kChunkSize);
+        Pos += R.Count * kChunkSize;
+      }
+    }
+  }
+  if (!OS) {
+    return Unexpect(ErrCode::InvalidPath);
+  }
+  return {};
+}
+
+/// Restore from snapshot file. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::restore(Runtime::StoreManager &StoreMgr,
+                               const std::string &Path) {
+  FileMgrMap Mgr;
+  if (auto Res = Mgr.setPath(Path); !Res) {
+    return Unexpect(Res);
+  }
+  /// Mapped runs are mapped from the file that is read, not by opening the
+  /// path again, which may be replaced meanwhile. The mappings keep the file
+  /// alive after the file manager closes it.
+  return restoreFrom(StoreMgr, Mgr, Mgr.getSourceFd());
+}
+
+/// Restore from encoded snapshot. See "include/expvm/snapshot.h".
+Expect<void> Snapshot::restore(Runtime::StoreManager &StoreMgr,
+                               Span<const Byte> Data) {
+  FileMgrMap Mgr;
+  if (auto Res = Mgr.setCode(Data); !Res) {
+    return Unexpect(Res);
+  }
+  return restoreFrom(StoreMgr, Mgr, -1);
+}
+
+} // namespace ExpVM
+} // namespace SSVM
@@ -1,4 +1,5 @@
 #include "expvm/vm.h"
+#include "expvm/snapshot.h"
 #include "host/ethereum/eeimodule.h"
 #include "host/wasi/wasimodule.h"
 
@@ -22,6 +23,19 @@ VM::VM(Configure &InputConfig, Runtime::StoreManager &S)
 }
 
 void VM::initVM() {
+  /// Select interpreter engine.
+  if (Config.getEngineType() == Configure::EngineType::Flat) {
+    InterpreterEngine.setEngineKind(Interpreter::Interpreter::EngineKind::Flat);
+  } else if (Config.getEngineType() == Configure::EngineType::Tiered) {
+    InterpreterEngine.setEngineKind(
+        Interpreter::Interpreter::EngineKind::Tiered);
+    InterpreterEngine.setTierUpThreshold(Config.getTierUpThreshold());
+  }
+  LoaderEngine.setThreadCount(Config.getThreadCount());
+  LoaderEngine.setLazyFunctionBody(Config.isLazyFunctionBody());
+  LoaderEngine.setModuleHash(Config.isModuleHash());
+  ValidatorEngine.setThreadCount(Config.getThreadCount());
+
   /// Set cost table and create import modules from configure.
   CostTab.setCostTable(Configure::VMType::Wasm);
   Measure.setCostTable(CostTab.getCostTable(Configure::VMType::Wasm));
@@ -63,7 +77,7 @@ Expect<void> VM::registerModule(const std::string &Name,
   }
   /// Load module.
   if (auto Res = LoaderEngine.parseModule(Path)) {
-    return registerModule(Name, *(*Res).get());
+    return registerModule(Name, std::move(*Res));
   } else {
     return Unexpect(Res);
   }
@@ -76,9 +90,8 @@ Expect<void> VM::registerModule(const std::string &Name, const Bytes &Code) {
     Stage = VMStage::Validated;
   }
   /// Load module.
-  std::unique_ptr<AST::Module> LoadedMod;
   if (auto Res = LoaderEngine.parseModule(Code)) {
-    return registerModule(Name, *(*Res).get());
+    return registerModule(Name, std::move(*Res));
   } else {
     return Unexpect(Res);
   }
@@ -94,12 +107,12 @@ Expect<void> VM::registerModule(const Runtime::ImportObject &Obj) {
 }
 
 Expect<void> VM::registerModule(const std::string &Name,
-                                const AST::Module &Module) {
+                                std::shared_ptr<const AST::Module> Module) {
   /// Validate module.
-  if (auto Res = ValidatorEngine.validate(Module); !Res) {
+  if (auto Res = ValidatorEngine.validate(*Module); !Res) {
     return Unexpect(Res);
   }
-  return InterpreterEngine.registerModule(StoreRef, Module, Name);
+  return InterpreterEngine.registerModule(StoreRef, std::move(Module), Name);
 }
 
 Expect<std::vector<ValVariant>>
@@ -112,7 +125,7 @@ VM::runWasmFile(const std::string &Path, const std::string &Func,
   }
   /// Load module.
   if (auto Res = LoaderEngine.parseModule(Path)) {
-    return runWasmFile(*(*Res).get(), Func, Params);
+    return runWasmFile(std::move(*Res), Func, Params);
   } else {
     return Unexpect(Res);
   }
@@ -128,19 +141,21 @@ VM::runWasmFile(const Bytes &Code, const std::string &Func,
   }
   /// Load module.
   if (auto Res = LoaderEngine.parseModule(Code)) {
-    return runWasmFile(*(*Res).get(), Func, Params);
+    return runWasmFile(std::move(*Res), Func, Params);
   } else {
     return Unexpect(Res);
   }
 }
 
 Expect<std::vector<ValVariant>>
-VM::runWasmFile(const AST::Module &Module, const std::string &Func,
+VM::runWasmFile(std::shared_ptr<const AST::Module> Module,
+                const std::string &Func,
                 const std::vector<ValVariant> &Params) {
-  if (auto Res = ValidatorEngine.validate(Module); !Res) {
+  if (auto Res = ValidatorEngine.validate(*Module); !Res) {
     return Unexpect(Res);
   }
-  if (auto Res = InterpreterEngine.instantiateModule(StoreRef, Module); !Res) {
+  if (auto Res = InterpreterEngine.instantiateModule(StoreRef, Module);
+      !Res) {
     return Unexpect(Res);
   }
   if (auto Res = InterpreterEngine.invoke(StoreRef, Func, Params)) {
@@ -173,7 +188,7 @@ Expect<void> VM::loadWasm(const Bytes &Code) {
 }
 
 Expect<void> VM::validate() {
-  if (Stage < VMStage::Loaded) {
+  if (Stage < VMStage::Loaded || !Mod) {
     /// When module is not loaded, not validate.
     return Unexpect(ErrCode::WrongVMWorkflow);
   }
@@ -186,12 +201,30 @@ Expect<void> VM::validate() {
 }
 
 Expect<void> VM::instantiate() {
-  if (Stage < VMStage::Validated) {
+  if (Stage < VMStage::Validated || !Mod) {
     /// When module is not validated, not instantiate.
     return Unexpect(ErrCode::ValidationFailed);
   }
-  if (auto Res =
-          InterpreterEngine.instantiateModule(StoreRef, *Mod.get(), "")) {
+  if (auto Res = InterpreterEngine.instantiateModule(StoreRef, Mod, "")) {
+    Stage = VMStage::Instantiated;
+    return {};
+  } else {
+    return Unexpect(Res);
+  }
+}
+
+Expect<void> VM::instantiate(std::shared_ptr<const AST::Module> Module) {
+  if (auto Res = InterpreterEngine.instantiateModule(StoreRef,
+                                                     std::move(Module), "")) {
+    Stage = VMStage::Instantiated;
+    return {};
+  } else {
+    return Unexpect(Res);
+  }
+}
+
+Expect<void> VM::fork(const Runtime::StoreTemplate &Tmpl) {
+  if (auto Res = InterpreterEngine.forkModule(StoreRef, Tmpl)) {
     Stage = VMStage::Instantiated;
     return {};
   } else {
@@ -199,13 +232,32 @@ Expect<void> VM::instantiate() {
   }
 }
 
+Expect<void> VM::loadImage(const std::string &Path) {
+  if (Stage < VMStage::Instantiated) {
+    /// When module is not instantiated, no states to restore.
+    return Unexpect(ErrCode::WrongVMWorkflow);
+  }
+  return Snapshot::restore(StoreRef, Path);
+}
+
 Expect<std::vector<ValVariant>>
 VM::execute(const std::string &Func, const std::vector<ValVariant> &Params) {
   /// Error handling is included in interpreter.
   return InterpreterEngine.invoke(StoreRef, Func, Params);
 }
 
+Expect<std::shared_ptr<const Runtime::StoreTemplate>> VM::makeTemplate() {
+  if (Stage < VMStage::Instantiated) {
+    /// When module is not instantiated, no template.
+    return Unexpect(ErrCode::WrongVMWorkflow);
+  }
+  /// Stop lowering in background, so the code is not written while copied.
+  InterpreterEngine.stopTierUp();
+  return StoreRef.makeTemplate();
+}
+
 void VM::cleanup() {
+  InterpreterEngine.stopTierUp();
   Mod.reset();
   StoreRef.reset();
   Measure.clear();
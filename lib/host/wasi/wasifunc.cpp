@@ -326,7 +326,8 @@ ErrCode WasiFdRead::body(Runtime::Instance::MemoryInstance &MemInst,
       return Res.error();
     }
     /// Read data from Fd.
-    unsigned char *ReadArr = MemInst.getPointer<unsigned char *>(CIOVecBufPtr);
+    unsigned char *ReadArr =
+        MemInst.getPointer<unsigned char *>(CIOVecBufPtr, CIOVecBufLen);
     int32_t SizeRead = read(Fd, ReadArr, CIOVecBufLen);
     /// Store data.
     if (SizeRead == -1) {
@@ -9,28 +9,21 @@ namespace Interpreter {
 
 Expect<void>
 Interpreter::runBlockOp(const AST::BlockControlInstruction &Instr) {
-  /// Get result type for arity.
-  const ValType ResultType = Instr.getResultType();
-  uint32_t Arity = (ResultType == ValType::None) ? 0 : 1;
-
-  /// Create Label{ nothing } and push.
-  return enterBlock(Arity, nullptr, Instr.getBody());
+  return enterBlock(Instr.getBody());
 }
 
 Expect<void> Interpreter::runLoopOp(const AST::BlockControlInstruction &Instr) {
-  /// Create Label{ loop-instruction } and push.
-  return enterBlock(0, &Instr, Instr.getBody());
+  /// Branches to loop restart the body.
+  return enterBlock(Instr.getBody());
 }
 
 Expect<void>
 Interpreter::runIfElseOp(const AST::IfElseControlInstruction &Instr) {
-  /// Get condition and result type for arity.
-  ValVariant Cond = StackMgr.pop();
-  ValType ResultType = Instr.getResultType();
-  uint32_t Arity = (ResultType == ValType::None) ? 0 : 1;
+  /// Get condition.
+  const uint32_t Cond = StackMgr.popAs<uint32_t>();
 
   /// If non-zero, run if-statement; else, run else-statement.
-  if (retrieveValue<uint32_t>(Cond) != 0) {
+  if (Cond != 0) {
     const auto &IfStatement = Instr.getIfStatement();
     if (!IfStatement.empty()) {
 #ifndef ONNC_WASM
@@ -39,7 +32,7 @@ Interpreter::runIfElseOp(const AST::IfElseControlInstruction &Instr) {
         return Unexpect(ErrCode::CostLimitExceeded);
       }
 #endif
-      return enterBlock(Arity, nullptr, IfStatement);
+      return enterBlock(IfStatement);
     }
   } else {
     const auto &ElseStatement = Instr.getElseStatement();
@@ -50,19 +43,18 @@ Interpreter::runIfElseOp(const AST::IfElseControlInstruction &Instr) {
         return Unexpect(ErrCode::CostLimitExceeded);
       }
 #endif
-      return enterBlock(Arity, nullptr, ElseStatement);
+      return enterBlock(ElseStatement);
     }
   }
   return {};
 }
 
 Expect<void> Interpreter::runBrOp(const AST::BrControlInstruction &Instr) {
-  return branchToLabel(Instr.getLabelIndex());
+  return branchToLabel(Instr.getLabelIndex(), Instr.getTarget());
 }
 
 Expect<void> Interpreter::runBrIfOp(const AST::BrControlInstruction &Instr) {
-  ValVariant Cond = StackMgr.pop();
-  if (retrieveValue<uint32_t>(Cond) != 0) {
+  if (StackMgr.popAs<uint32_t>() != 0) {
     return runBrOp(Instr);
   }
   return {};
@@ -71,14 +63,15 @@ Expect<void> Interpreter::runBrIfOp(const AST::BrControlInstruction &Instr) {
 Expect<void>
 Interpreter::runBrTableOp(const AST::BrTableControlInstruction &Instr) {
   /// Get value on top of stack.
-  uint32_t Value = retrieveValue<uint32_t>(StackMgr.pop());
+  uint32_t Value = StackMgr.popAs<uint32_t>();
 
   /// Do branch.
-  const auto &LabelTable = Instr.getLabelTable();
+  const auto LabelTable = Instr.getLabelTable();
+  const auto Targets = Instr.getTargets();
   if (Value < LabelTable.size()) {
-    return branchToLabel(LabelTable[Value]);
+    return branchToLabel(LabelTable[Value], Targets[Value]);
   }
-  return branchToLabel(Instr.getLabelIndex());
+  return branchToLabel(Instr.getLabelIndex(), Targets[LabelTable.size()]);
 }
 
 Expect<void> Interpreter::runReturnOp() { return leaveFunction(); }
@@ -86,9 +79,26 @@ Expect<void> Interpreter::runReturnOp() { return leaveFunction(); }
 Expect<void> Interpreter::runCallOp(Runtime::StoreManager &StoreMgr,
                                     const AST::CallControlInstruction &Instr) {
   /// Get Function address.
-  const auto *ModInst = *StoreMgr.getModule(StackMgr.getModuleAddr());
-  const uint32_t FuncAddr = *ModInst->getFuncAddr(Instr.getFuncIndex());
+  const uint32_t FuncAddr =
+      *CurrCtx->ModInst->getFuncAddr(Instr.getFuncIndex());
   const auto *FuncInst = *StoreMgr.getFunction(FuncAddr);
+  if (Engine == EngineKind::Tiered) {
+    if (const auto *Native = getNativeCode(*FuncInst)) {
+      /// Run native code, which returns to here or bails out to the flat code
+      /// tier.
+      auto PC = callNativeFunction(StoreMgr, *FuncInst, *Native, nullptr);
+      if (!PC) {
+        return Unexpect(PC);
+      }
+      TierFlatPC = *PC;
+      return {};
+    }
+    if (FuncInst->getTieredCode() != nullptr) {
+      /// Switch to the flat code tier, which returns to here.
+      TierFlatPC = enterFlatFunction(StoreMgr, *FuncInst, nullptr);
+      return {};
+    }
+  }
   return enterFunction(StoreMgr, *FuncInst);
 }
 
@@ -96,30 +106,43 @@ Expect<void>
 Interpreter::runCallIndirectOp(Runtime::StoreManager &StoreMgr,
                                const AST::CallControlInstruction &Instr) {
   /// Get Table Instance
-  const auto *TabInst = getTabInstByIdx(StoreMgr, 0);
+  const auto *TabInst = CurrCtx->TabInst;
 
-  /// Get function type at index x.
-  const auto *ModInst = *StoreMgr.getModule(StackMgr.getModuleAddr());
-  const auto *TargetFuncType = *ModInst->getFuncType(Instr.getFuncIndex());
+  /// Get canonical ID of function type at index x.
+  const uint32_t TargetTypeId =
+      *CurrCtx->ModInst->getFuncTypeId(Instr.getFuncIndex());
 
   /// Pop the value i32.const i from the Stack.
-  ValVariant Idx = StackMgr.pop();
+  const uint32_t Idx = StackMgr.popAs<uint32_t>();
 
-  /// Get function address.
-  uint32_t FuncAddr;
-  if (auto Res = TabInst->getElemAddr(retrieveValue<uint32_t>(Idx))) {
-    FuncAddr = *Res;
+  /// Get function element and check function type.
+  const Runtime::Instance::TableInstance::FuncElem *Elem;
+  if (auto Res = TabInst->getElem(Idx)) {
+    Elem = *Res;
   } else {
     return Unexpect(Res);
   }
-
-  /// Check function type.
-  const auto *FuncInst = *StoreMgr.getFunction(FuncAddr);
-  const auto &FuncType = FuncInst->getFuncType();
-  if (TargetFuncType->Params != FuncType.Params ||
-      TargetFuncType->Returns != FuncType.Returns) {
+  if (Elem->TypeId != TargetTypeId) {
     return Unexpect(ErrCode::TypeNotMatch);
   }
+  const auto *FuncInst = *StoreMgr.getFunction(Elem->Addr);
+  if (Engine == EngineKind::Tiered) {
+    if (const auto *Native = getNativeCode(*FuncInst)) {
+      /// Run native code, which returns to here or bails out to the flat code
+      /// tier.
+      auto PC = callNativeFunction(StoreMgr, *FuncInst, *Native, nullptr);
+      if (!PC) {
+        return Unexpect(PC);
+      }
+      TierFlatPC = *PC;
+      return {};
+    }
+    if (FuncInst->getTieredCode() != nullptr) {
+      /// Switch to the flat code tier, which returns to here.
+      TierFlatPC = enterFlatFunction(StoreMgr, *FuncInst, nullptr);
+      return {};
+    }
+  }
   return enterFunction(StoreMgr, *FuncInst);
 }
 
@@ -3,12 +3,57 @@
 #include "common/value.h"
 #include "interpreter/interpreter.h"
 #include "support/casting.h"
+#include "support/fault.h"
 #include "support/log.h"
 #include "support/measure.h"
 
+#include <algorithm>
+#include <fstream>
+#include <string>
+
 namespace SSVM {
 namespace Interpreter {
 
+namespace {
+
+/// Name the function instances in profile by module names and export names,
+/// or by function indices if not exported. Modules are iterated backward, so
+/// that the imported functions are named by the modules defining them.
+void nameProfileFunctions(Runtime::StoreManager &StoreMgr,
+                          Support::Profile &Prof) {
+  std::vector<Runtime::Instance::ModuleInstance *> Mods;
+  for (uint32_t Addr = 0;; ++Addr) {
+    if (auto Res = StoreMgr.getModule(Addr)) {
+      Mods.push_back(*Res);
+    } else {
+      break;
+    }
+  }
+  auto getPrefix = [](const Runtime::Instance::ModuleInstance &Mod) {
+    const std::string &ModName = Mod.getModuleName();
+    return ModName.empty() ? ModName : ModName + ".";
+  };
+  for (auto It = Mods.rbegin(); It != Mods.rend(); ++It) {
+    const std::string Prefix = getPrefix(**It);
+    for (uint32_t Idx = 0; Idx < (*It)->getFuncNum(); ++Idx) {
+      if (auto Res = StoreMgr.getFunction(*(*It)->getFuncAddr(Idx))) {
+        Prof.setFunctionName(*Res,
+                             Prefix + "func[" + std::to_string(Idx) + "]");
+      }
+    }
+  }
+  for (auto It = Mods.rbegin(); It != Mods.rend(); ++It) {
+    const std::string Prefix = getPrefix(**It);
+    for (const auto &[Name, Addr] : (*It)->getFuncExports()) {
+      if (auto Res = StoreMgr.getFunction(Addr)) {
+        Prof.setFunctionName(*Res, Prefix + Name);
+      }
+    }
+  }
+}
+
+} // namespace
+
 Expect<void> Interpreter::runExpression(Runtime::StoreManager &StoreMgr,
                                         const AST::InstrVec &Instrs) {
   /// Set instruction vector to instruction provider.
@@ -20,7 +65,22 @@ Expect<void>
 Interpreter::runFunction(Runtime::StoreManager &StoreMgr,
                          const Runtime::Instance::FunctionInstance &Func) {
   /// Enter start function. Args should be pushed into stack.
-  if (auto Res = enterFunction(StoreMgr, Func); !Res) {
+  const Runtime::FlatInstr *PC = nullptr;
+  NativeDepth = 0;
+  const Runtime::NativeCode *Native =
+      (Engine == EngineKind::Tiered) ? getNativeCode(Func) : nullptr;
+  if (Engine == EngineKind::Flat && !Func.isHostFunction()) {
+    if (Func.getFlatCode().empty()) {
+      if (auto Res = lowerLazyFunction(StoreMgr, Func); !Res) {
+        return Unexpect(Res);
+      }
+    }
+    PC = enterFlatFunction(StoreMgr, Func, nullptr);
+  } else if (Native != nullptr) {
+    /// Native code is called in the fault scope below.
+  } else if (Engine == EngineKind::Tiered && Func.getTieredCode() != nullptr) {
+    PC = enterFlatFunction(StoreMgr, Func, nullptr);
+  } else if (auto Res = enterFunction(StoreMgr, Func); !Res) {
     return Unexpect(Res);
   }
 
@@ -29,9 +89,39 @@ Interpreter::runFunction(Runtime::StoreManager &StoreMgr,
     Measure->getTimeRecorder().startRecord(TIMER_TAG_EXECUTION);
   }
 
-  /// Execute run loop.
+  /// Execute run loop. Memory accesses out of bound fault in the guard region
+  /// and jump back here. Host functions run out of the fault scope.
   LOG(DEBUG) << "Start running...";
-  auto Res = execute(StoreMgr);
+  Expect<void> Res;
+  Support::Fault FaultHandler;
+  FlatFaultPC = nullptr;
+  FlatStepping = false;
+  TierFlatPC = nullptr;
+  TierASTCalls.clear();
+  if (const int Err = sigsetjmp(FaultHandler.getBuffer(), 0); Err != 0) {
+    Res = Unexpect(static_cast<ErrCode>(Err));
+    if (Measure && FlatFaultPC != nullptr) {
+      refundFlatBlock(FlatFaultPC);
+    }
+  } else {
+    if (Native != nullptr) {
+      /// Native code returns, or bails out to resume the function in flat
+      /// code.
+      if (auto Ret = callNativeFunction(StoreMgr, Func, *Native, nullptr)) {
+        if (*Ret != nullptr) {
+          Res = executeTiered(StoreMgr, *Ret);
+        }
+      } else {
+        Res = Unexpect(Ret);
+      }
+    } else if (Engine == EngineKind::Tiered) {
+      Res = executeTiered(StoreMgr, PC);
+    } else if (PC != nullptr) {
+      Res = executeFlat(StoreMgr, PC);
+    } else {
+      Res = execute(StoreMgr);
+    }
+  }
   if (Res) {
     LOG(DEBUG) << "Execution succeeded.";
   } else if (Res.error() == ErrCode::Revert) {
@@ -45,26 +135,43 @@ Interpreter::runFunction(Runtime::StoreManager &StoreMgr,
 
   /// Print time cost.
   if (Measure) {
-    uint64_t ExecTime =
-        Measure->getTimeRecorder().stopRecord(TIMER_TAG_EXECUTION);
-    uint64_t HostFuncTime =
-        Measure->getTimeRecorder().getRecord(TIMER_TAG_HOSTFUNC);
+    auto &TimeRecorder = Measure->getTimeRecorder();
+    TimeRecorder.stopRecord(TIMER_TAG_EXECUTION);
+    const uint64_t ExecTime = TimeRecorder.getRecordNano(TIMER_TAG_EXECUTION);
+    const uint64_t HostFuncTime =
+        TimeRecorder.getRecordNano(TIMER_TAG_HOSTFUNC);
     LOG(DEBUG) << std::endl
                << " =================  Statistics  ================="
                << std::endl
-               << " Total execution time: " << ExecTime + HostFuncTime << " us"
+               << " Total execution time: " << ExecTime + HostFuncTime << " ns"
                << std::endl
-               << " Wasm instructions execution time: " << ExecTime << " us"
+               << " Wasm instructions execution time: " << ExecTime << " ns"
                << std::endl
-               << " Host functions execution time: " << HostFuncTime << " us"
+               << " Host functions execution time: " << HostFuncTime << " ns"
                << std::endl
                << " Executed wasm instructions count: "
                << Measure->getInstrCnt() << std::endl
                << " Gas costs: " << Measure->getCostSum() << std::endl
                << " Instructions per second: "
                << static_cast<uint64_t>((double)Measure->getInstrCnt() *
-                                        1000000 / ExecTime)
+                                        1000000000 /
+                                        std::max<uint64_t>(ExecTime, 1))
                << std::endl;
+
+    /// Write profile. Functions not returned by traps are left here.
+    if (auto *Prof = Measure->getProfile()) {
+      Prof->leaveAllFunctions(Measure->getInstrCnt());
+      if (const std::string &Path = Prof->getOutputPath(); !Path.empty()) {
+        nameProfileFunctions(StoreMgr, *Prof);
+        std::ofstream JSONFile(Path + ".json");
+        Prof->dumpJSON(JSONFile);
+        std::ofstream FoldedFile(Path + ".folded");
+        Prof->dumpCollapsed(FoldedFile);
+        if (!JSONFile || !FoldedFile) {
+          LOG(ERROR) << "Failed to write profile to " << Path;
+        }
+      }
+    }
   }
 
   if (Res || Res.error() == ErrCode::Terminated) {
@@ -151,15 +258,12 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
     return {};
   case OpCode::Select: {
     /// Pop the i32 value and select values from stack.
-    ValVariant CondVal = StackMgr.pop();
-    ValVariant Val2 = StackMgr.pop();
-    ValVariant Val1 = StackMgr.pop();
+    const uint32_t Cond = StackMgr.popAs<uint32_t>();
+    const ValVariant Val2 = StackMgr.pop();
 
-    /// Select the value.
-    if (retrieveValue<uint32_t>(CondVal) == 0) {
-      StackMgr.push(Val2);
-    } else {
-      StackMgr.push(Val1);
+    /// Select the value. Val1 is kept on the top of stack.
+    if (Cond == 0) {
+      StackMgr.getTop() = Val2;
     }
     return {};
   }
@@ -182,9 +286,9 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
   case OpCode::Local__tee:
     return runLocalTeeOp(Index);
   case OpCode::Global__get:
-    return runGlobalGetOp(StoreMgr, Index);
+    return runGlobalGetOp(Index);
   case OpCode::Global__set:
-    return runGlobalSetOp(StoreMgr, Index);
+    return runGlobalSetOp(Index);
   default:
     return Unexpect(ErrCode::ExecutionFailed);
   }
@@ -192,54 +296,54 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
 
 Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
                                   const AST::MemoryInstruction &Instr) {
-  auto *MemInst = getMemInstByIdx(StoreMgr, 0);
+  auto *MemInst = CurrCtx->MemInst;
   switch (Instr.getOpCode()) {
   case OpCode::I32__load:
-    return runLoadOp<uint32_t>(*MemInst, Instr);
+    return runLoadOp<uint32_t>(*MemInst, Instr.getMemoryOffset());
   case OpCode::I64__load:
-    return runLoadOp<uint64_t>(*MemInst, Instr);
+    return runLoadOp<uint64_t>(*MemInst, Instr.getMemoryOffset());
   case OpCode::F32__load:
-    return runLoadOp<float>(*MemInst, Instr);
+    return runLoadOp<float>(*MemInst, Instr.getMemoryOffset());
   case OpCode::F64__load:
-    return runLoadOp<double>(*MemInst, Instr);
+    return runLoadOp<double>(*MemInst, Instr.getMemoryOffset());
   case OpCode::I32__load8_s:
-    return runLoadOp<int32_t>(*MemInst, Instr, 8);
+    return runLoadOp<int32_t>(*MemInst, Instr.getMemoryOffset(), 8);
   case OpCode::I32__load8_u:
-    return runLoadOp<uint32_t>(*MemInst, Instr, 8);
+    return runLoadOp<uint32_t>(*MemInst, Instr.getMemoryOffset(), 8);
   case OpCode::I32__load16_s:
-    return runLoadOp<int32_t>(*MemInst, Instr, 16);
+    return runLoadOp<int32_t>(*MemInst, Instr.getMemoryOffset(), 16);
   case OpCode::I32__load16_u:
-    return runLoadOp<uint32_t>(*MemInst, Instr, 16);
+    return runLoadOp<uint32_t>(*MemInst, Instr.getMemoryOffset(), 16);
   case OpCode::I64__load8_s:
-    return runLoadOp<int64_t>(*MemInst, Instr, 8);
+    return runLoadOp<int64_t>(*MemInst, Instr.getMemoryOffset(), 8);
   case OpCode::I64__load8_u:
-    return runLoadOp<uint64_t>(*MemInst, Instr, 8);
+    return runLoadOp<uint64_t>(*MemInst, Instr.getMemoryOffset(), 8);
   case OpCode::I64__load16_s:
-    return runLoadOp<int64_t>(*MemInst, Instr, 16);
+    return runLoadOp<int64_t>(*MemInst, Instr.getMemoryOffset(), 16);
   case OpCode::I64__load16_u:
-    return runLoadOp<uint64_t>(*MemInst, Instr, 16);
+    return runLoadOp<uint64_t>(*MemInst, Instr.getMemoryOffset(), 16);
   case OpCode::I64__load32_s:
-    return runLoadOp<int64_t>(*MemInst, Instr, 32);
+    return runLoadOp<int64_t>(*MemInst, Instr.getMemoryOffset(), 32);
   case OpCode::I64__load32_u:
-    return runLoadOp<uint64_t>(*MemInst, Instr, 32);
+    return runLoadOp<uint64_t>(*MemInst, Instr.getMemoryOffset(), 32);
   case OpCode::I32__store:
-    return runStoreOp<uint32_t>(*MemInst, Instr);
+    return runStoreOp<uint32_t>(*MemInst, Instr.getMemoryOffset());
   case OpCode::I64__store:
-    return runStoreOp<uint64_t>(*MemInst, Instr);
+    return runStoreOp<uint64_t>(*MemInst, Instr.getMemoryOffset());
   case OpCode::F32__store:
-    return runStoreOp<float>(*MemInst, Instr);
+    return runStoreOp<float>(*MemInst, Instr.getMemoryOffset());
   case OpCode::F64__store:
-    return runStoreOp<double>(*MemInst, Instr);
+    return runStoreOp<double>(*MemInst, Instr.getMemoryOffset());
   case OpCode::I32__store8:
-    return runStoreOp<uint32_t>(*MemInst, Instr, 8);
+    return runStoreOp<uint32_t>(*MemInst, Instr.getMemoryOffset(), 8);
   case OpCode::I32__store16:
-    return runStoreOp<uint32_t>(*MemInst, Instr, 16);
+    return runStoreOp<uint32_t>(*MemInst, Instr.getMemoryOffset(), 16);
   case OpCode::I64__store8:
-    return runStoreOp<uint64_t>(*MemInst, Instr, 8);
+    return runStoreOp<uint64_t>(*MemInst, Instr.getMemoryOffset(), 8);
   case OpCode::I64__store16:
-    return runStoreOp<uint64_t>(*MemInst, Instr, 16);
+    return runStoreOp<uint64_t>(*MemInst, Instr.getMemoryOffset(), 16);
   case OpCode::I64__store32:
-    return runStoreOp<uint64_t>(*MemInst, Instr, 32);
+    return runStoreOp<uint64_t>(*MemInst, Instr.getMemoryOffset(), 32);
   case OpCode::Memory__grow:
     return runMemoryGrowOp(*MemInst);
   case OpCode::Memory__size:
@@ -283,6 +387,8 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
     return runCeilOp<float>(Val);
   case OpCode::F32__floor:
     return runFloorOp<float>(Val);
+  case OpCode::F32__trunc:
+    return runTruncOp<float>(Val);
   case OpCode::F32__nearest:
     return runNearestOp<float>(Val);
   case OpCode::F32__sqrt:
@@ -295,6 +401,8 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
     return runCeilOp<double>(Val);
   case OpCode::F64__floor:
     return runFloorOp<double>(Val);
+  case OpCode::F64__trunc:
+    return runTruncOp<double>(Val);
   case OpCode::F64__nearest:
     return runNearestOp<double>(Val);
   case OpCode::F64__sqrt:
@@ -517,9 +625,10 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
   }
 }
 
-Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr) {
+Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr,
+                                  const uint32_t Depth) {
   /// Run instructions until end.
-  while (InstrPdr.getScopeSize() > 0) {
+  while (InstrPdr.getScopeSize() > Depth) {
     const AST::Instruction *Instr = InstrPdr.getNextInstr();
     if (Instr == nullptr) {
       /// Pop instruction sequence.
@@ -540,6 +649,9 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr) {
       OpCode Code = Instr->getOpCode();
       if (Measure) {
         Measure->incInstrCnt();
+        if (auto *Prof = Measure->getProfile()) {
+          Prof->countInstr(static_cast<uint8_t>(Code));
+        }
         /// Add cost. Note: if-else case should be processed additionally.
         if (!Measure->addInstrCost(Code)) {
           return Unexpect(ErrCode::CostLimitExceeded);
@@ -563,26 +675,24 @@ Expect<void> Interpreter::execute(Runtime::StoreManager &StoreMgr) {
       if (!Res) {
         return Unexpect(Res);
       }
+      /// Called function in the flat code tier is entered.
+      if (TierFlatPC != nullptr) {
+        return {};
+      }
     }
   }
   /// Run out the expressions.
   return {};
 }
 
-Expect<void> Interpreter::enterBlock(const uint32_t Arity,
-                                     const AST::BlockControlInstruction *Instr,
-                                     const AST::InstrVec &Seq) {
-  /// Create label for block and push.
-  StackMgr.pushLabel(Arity, Instr);
-
-  /// Jump to block body.
+Expect<void> Interpreter::enterBlock(const AST::InstrVec &Seq) {
+  /// Jump to block body. Labels are resolved in validation.
   InstrPdr.pushInstrs(InstrProvider::SeqType::Block, Seq);
   return {};
 }
 
 Expect<void> Interpreter::leaveBlock() {
-  /// Pop label entry and the corresponding instruction sequence.
-  StackMgr.popLabel();
+  /// Results of validated block are already on the label height.
   return InstrPdr.popInstrs();
 }
 
@@ -595,7 +705,7 @@ Interpreter::enterFunction(Runtime::StoreManager &StoreMgr,
   if (Func.isHostFunction()) {
     /// Host function case: Push args and call function.
     auto &HostFunc = Func.getHostFunc();
-    auto *MemoryInst = getMemInstByIdx(StoreMgr, 0);
+    auto *MemoryInst = CurrCtx ? CurrCtx->MemInst : nullptr;
 
     if (Measure) {
       /// Check host function cost.
@@ -603,17 +713,29 @@ Interpreter::enterFunction(Runtime::StoreManager &StoreMgr,
         return Unexpect(ErrCode::CostLimitExceeded);
       }
       /// Start recording time of running host function.
-      Measure->getTimeRecorder().stopRecord(TIMER_TAG_EXECUTION);
-      Measure->getTimeRecorder().startRecord(TIMER_TAG_HOSTFUNC);
+      Measure->getTimeRecorder().switchRecord(TIMER_TAG_EXECUTION,
+                                              TIMER_TAG_HOSTFUNC);
     }
 
     /// Run host function.
-    ErrCode Status = HostFunc.run(StackMgr, *MemoryInst);
+    Support::Profile *Prof = Measure ? Measure->getProfile() : nullptr;
+    const auto Start = Prof ? Support::Profile::Clock::now()
+                            : Support::Profile::Clock::time_point();
+    ErrCode Status = ErrCode::Success;
+    {
+      /// Faults in host functions are not from wasm memory accesses, and
+      /// must not jump over the frames of host functions.
+      Support::FaultBlocker Blocker;
+      Status = HostFunc.run(StackMgr, *MemoryInst);
+    }
 
     if (Measure) {
       /// Stop recording time of running host function.
-      Measure->getTimeRecorder().stopRecord(TIMER_TAG_HOSTFUNC);
-      Measure->getTimeRecorder().startRecord(TIMER_TAG_EXECUTION);
+      Measure->getTimeRecorder().switchRecord(TIMER_TAG_HOSTFUNC,
+                                              TIMER_TAG_EXECUTION);
+      if (Prof) {
+        Prof->recordHostCall(&Func, Support::Profile::Clock::now() - Start);
+      }
     }
 
     /// TODO: Fix this after refactoring HostFunctionBase.
@@ -622,11 +744,28 @@ Interpreter::enterFunction(Runtime::StoreManager &StoreMgr,
     }
     return {};
   } else {
-    /// Native function case: Push frame with locals and args.
+    /// Native function case: Decode the lazily loaded function body.
+    if (auto Res = Func.loadBody(); !Res) {
+      return Unexpect(Res);
+    }
+
+    /// Count for tiered engine.
+    if (Engine == EngineKind::Tiered) {
+      TierFuncStack.push_back(&Func);
+      countTierUp(Func);
+    }
+    if (Measure) {
+      if (auto *Prof = Measure->getProfile()) {
+        Prof->enterFunction(&Func, Measure->getInstrCnt());
+      }
+    }
+
+    /// Push frame with locals and args.
     StackMgr.pushFrame(Func.getModuleAddr(),   /// Module address
                        FuncType.Params.size(), /// Arity
                        FuncType.Returns.size() /// Coarity
     );
+    switchFrameContext(StoreMgr);
 
     /// Push local variables to stack.
     for (auto &Def : Func.getLocals()) {
@@ -639,63 +778,103 @@ Interpreter::enterFunction(Runtime::StoreManager &StoreMgr,
     InstrPdr.pushInstrs(InstrProvider::SeqType::FunctionCall);
 
     /// Enter function block.
-    return enterBlock(FuncType.Returns.size(), nullptr, Func.getInstrs());
+    return enterBlock(Func.getInstrs());
   }
 }
 
 Expect<void> Interpreter::leaveFunction() {
-  /// Pop the frame entry from the Stack.
-  const uint32_t LabelPoped = StackMgr.popFrame();
-  for (uint32_t I = 0; I < LabelPoped; ++I) {
-    InstrPdr.popInstrs();
+  /// Pop the frame entry from the Stack and the instruction sequences.
+  StackMgr.popFrame();
+  restoreFrameContext();
+  InstrPdr.popFunction();
+  if (Engine == EngineKind::Tiered) {
+    TierFuncStack.pop_back();
+  }
+  if (Measure) {
+    if (auto *Prof = Measure->getProfile()) {
+      Prof->leaveFunction(Measure->getInstrCnt());
+    }
   }
-  InstrPdr.popInstrs();
   return {};
 }
 
-Expect<void> Interpreter::branchToLabel(const uint32_t Cnt) {
-  /// Get the L-th label from top of stack and the continuation instruction.
-  auto &L = StackMgr.getLabelWithCount(Cnt);
-  const AST::BlockControlInstruction *ContInstr = L.Target;
+Expect<void> Interpreter::branchToLabel(const uint32_t Cnt,
+                                        const AST::BranchTarget &Target) {
+  /// Code not validated has no targets to branch to.
+  if (!Target.Resolved) {
+    return Unexpect(ErrCode::ValidationFailed);
+  }
 
-  /// Pop L + 1 labels.
-  StackMgr.popLabel(Cnt + 1);
+  /// Keep the arity values on the label height resolved in validation.
+  StackMgr.eraseValue(Target.Height, Target.Arity);
 
-  /// Repeat LabelIndex + 1 times
-  for (uint32_t I = 0; I < Cnt + 1; I++) {
-    /// Pop the corresponding instruction sequence.
-    InstrPdr.popInstrs();
+  if (Target.IsLoop) {
+    /// Loop iterations count for tiered engine.
+    if (Engine == EngineKind::Tiered && !TierFuncStack.empty()) {
+      countTierUp(*TierFuncStack.back());
+    }
+    /// Pop the inner instruction sequences and restart the loop body.
+    InstrPdr.popInstrs(Cnt);
+    InstrPdr.restartInstrs();
+    return {};
   }
 
-  /// Jump to the continuation of Label
-  if (ContInstr != nullptr) {
-    return runLoopOp(*ContInstr);
-  }
+  /// Pop the instruction sequences to the continuation of block.
+  InstrPdr.popInstrs(Cnt + 1);
   return {};
 }
 
-Runtime::Instance::TableInstance *
-Interpreter::getTabInstByIdx(Runtime::StoreManager &StoreMgr,
-                             const uint32_t Idx) {
-  const auto *ModInst = *StoreMgr.getModule(StackMgr.getModuleAddr());
-  const uint32_t TabAddr = *ModInst->getTableAddr(Idx);
-  return *StoreMgr.getTable(TabAddr);
-}
+Interpreter::FrameContext &
+Interpreter::getFrameContext(Runtime::StoreManager &StoreMgr,
+                             const uint32_t ModAddr) {
+  if (ModAddr >= FrameCtxs.size()) {
+    FrameCtxs.resize(ModAddr + 1);
+  }
+  FrameContext &Ctx = FrameCtxs[ModAddr];
+  if (Ctx.ModInst != nullptr) {
+    return Ctx;
+  }
 
-Runtime::Instance::MemoryInstance *
-Interpreter::getMemInstByIdx(Runtime::StoreManager &StoreMgr,
-                             const uint32_t Idx) {
-  const auto *ModInst = *StoreMgr.getModule(StackMgr.getModuleAddr());
-  const uint32_t MemAddr = *ModInst->getMemAddr(Idx);
-  return *StoreMgr.getMemory(MemAddr);
+  /// Resolve the instances of module once.
+  const auto *ModInst = *StoreMgr.getModule(ModAddr);
+  Ctx.ModInst = ModInst;
+  if (ModInst->getMemNum() > 0) {
+    Ctx.MemInst = *StoreMgr.getMemory(*ModInst->getMemAddr(0));
+  }
+  if (ModInst->getTableNum() > 0) {
+    Ctx.TabInst = *StoreMgr.getTable(*ModInst->getTableAddr(0));
+  }
+  for (uint32_t I = 0; I < ModInst->getGlobalNum(); ++I) {
+    Ctx.GlobInsts.push_back(*StoreMgr.getGlobal(*ModInst->getGlobalAddr(I)));
+    Ctx.GlobVals.push_back(&Ctx.GlobInsts.back()->getValue());
+  }
+
+  /// Native code reaches the same instances through the native context.
+  Ctx.Native.Interp = this;
+  Ctx.Native.Frame = &Ctx;
+  Ctx.Native.StoreMgr = &StoreMgr;
+  Ctx.Native.MemBase = Ctx.MemInst ? Ctx.MemInst->getDataPtr() : nullptr;
+  Ctx.Native.MemSize = Ctx.MemInst ? Ctx.MemInst->getDataSize() : 0;
+  Ctx.Native.Globals = Ctx.GlobVals.data();
+  if (Measure) {
+    Ctx.Native.CostSum = &Measure->getCostSum();
+    Ctx.Native.CostLimit = &Measure->getCostLimit();
+    Ctx.Native.InstrCnt = &Measure->getInstrCounter();
+  }
+  return Ctx;
 }
 
-Runtime::Instance::GlobalInstance *
-Interpreter::getGlobInstByIdx(Runtime::StoreManager &StoreMgr,
-                              const uint32_t Idx) {
-  const auto *ModInst = *StoreMgr.getModule(StackMgr.getModuleAddr());
-  const uint32_t GlobAddr = *ModInst->getGlobalAddr(Idx);
-  return *StoreMgr.getGlobal(GlobAddr);
+void Interpreter::resetFrameContexts() {
+  /// Keep the buffers of globals for the next invocation.
+  for (auto &Ctx : FrameCtxs) {
+    Ctx.ModInst = nullptr;
+    Ctx.MemInst = nullptr;
+    Ctx.TabInst = nullptr;
+    Ctx.GlobInsts.clear();
+    Ctx.GlobVals.clear();
+    Ctx.Native = NativeContext();
+  }
+  CurrCtx = nullptr;
 }
 
 } // namespace Interpreter
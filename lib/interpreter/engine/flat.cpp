@@ -0,0 +1,653 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "common/ast/instruction.h"
+#include "common/value.h"
+#include "interpreter/interpreter.h"
+#include "runtime/flatcode.h"
+#include "support/measure.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+/// Use computed-goto dispatch if the compiler supports labels as values.
+#if defined(__GNUC__) || defined(__clang__)
+#define SSVM_FLAT_THREADED 1
+#else
+#define SSVM_FLAT_THREADED 0
+#endif
+
+/// Control, parametric, variable, and const instructions. X(OpCode)
+#define FLAT_CONTROL_OPS(X)                                                    \
+  X(Unreachable)                                                               \
+  X(Nop)                                                                       \
+  X(Block)                                                                     \
+  X(Loop)                                                                      \
+  X(If)                                                                        \
+  X(Else)                                                                      \
+  X(End)                                                                       \
+  X(Br)                                                                        \
+  X(Br_if)                                                                     \
+  X(Br_table)                                                                  \
+  X(Return)                                                                    \
+  X(Call)                                                                      \
+  X(Call_indirect)                                                             \
+  X(Drop)                                                                      \
+  X(Select)                                                                    \
+  X(Local__get)                                                                \
+  X(Local__set)                                                                \
+  X(Local__tee)                                                                \
+  X(Global__get)                                                               \
+  X(Global__set)                                                               \
+  X(Memory__size)                                                              \
+  X(Memory__grow)                                                              \
+  X(I32__const)                                                                \
+  X(I64__const)                                                                \
+  X(F32__const)                                                                \
+  X(F64__const)
+
+/// Load instructions. X(OpCode, Type, BitWidth)
+#define FLAT_LOAD_OPS(X)                                                       \
+  X(I32__load, uint32_t, 32)                                                   \
+  X(I64__load, uint64_t, 64)                                                   \
+  X(F32__load, float, 32)                                                      \
+  X(F64__load, double, 64)                                                     \
+  X(I32__load8_s, int32_t, 8)                                                  \
+  X(I32__load8_u, uint32_t, 8)                                                 \
+  X(I32__load16_s, int32_t, 16)                                                \
+  X(I32__load16_u, uint32_t, 16)                                               \
+  X(I64__load8_s, int64_t, 8)                                                  \
+  X(I64__load8_u, uint64_t, 8)                                                 \
+  X(I64__load16_s, int64_t, 16)                                                \
+  X(I64__load16_u, uint64_t, 16)                                               \
+  X(I64__load32_s, int64_t, 32)                                                \
+  X(I64__load32_u, uint64_t, 32)
+
+/// Store instructions. X(OpCode, Type, BitWidth)
+#define FLAT_STORE_OPS(X)                                                      \
+  X(I32__store, uint32_t, 32)                                                  \
+  X(I64__store, uint64_t, 64)                                                  \
+  X(F32__store, float, 32)                                                     \
+  X(F64__store, double, 64)                                                    \
+  X(I32__store8, uint32_t, 8)                                                  \
+  X(I32__store16, uint32_t, 16)                                                \
+  X(I64__store8, uint64_t, 8)                                                  \
+  X(I64__store16, uint64_t, 16)                                                \
+  X(I64__store32, uint64_t, 32)
+
+/// Unary numeric instructions. X(OpCode, Function, Types...)
+#define FLAT_UNARY_OPS(X)                                                      \
+  X(I32__eqz, runEqzOp, uint32_t)                                              \
+  X(I64__eqz, runEqzOp, uint64_t)                                              \
+  X(I32__clz, runClzOp, uint32_t)                                              \
+  X(I32__ctz, runCtzOp, uint32_t)                                              \
+  X(I32__popcnt, runPopcntOp, uint32_t)                                        \
+  X(I64__clz, runClzOp, uint64_t)                                              \
+  X(I64__ctz, runCtzOp, uint64_t)                                              \
+  X(I64__popcnt, runPopcntOp, uint64_t)                                        \
+  X(F32__abs, runAbsOp, float)                                                 \
+  X(F32__neg, runNegOp, float)                                                 \
+  X(F32__ceil, runCeilOp, float)                                               \
+  X(F32__floor, runFloorOp, float)                                             \
+  X(F32__trunc, runTruncOp, float)                                             \
+  X(F32__nearest, runNearestOp, float)                                         \
+  X(F32__sqrt, runSqrtOp, float)                                               \
+  X(F64__abs, runAbsOp, double)                                                \
+  X(F64__neg, runNegOp, double)                                                \
+  X(F64__ceil, runCeilOp, double)                                              \
+  X(F64__floor, runFloorOp, double)                                            \
+  X(F64__trunc, runTruncOp, double)                                            \
+  X(F64__nearest, runNearestOp, double)                                        \
+  X(F64__sqrt, runSqrtOp, double)                                              \
+  X(I32__wrap_i64, runWrapOp, uint64_t, uint32_t)                              \
+  X(I32__trunc_f32_s, runTruncateOp, float, int32_t)                           \
+  X(I32__trunc_f32_u, runTruncateOp, float, uint32_t)                          \
+  X(I32__trunc_f64_s, runTruncateOp, double, int32_t)                          \
+  X(I32__trunc_f64_u, runTruncateOp, double, uint32_t)                         \
+  X(I64__extend_i32_s, runExtendOp, int32_t, uint64_t)                         \
+  X(I64__extend_i32_u, runExtendOp, uint32_t, uint64_t)                        \
+  X(I64__trunc_f32_s, runTruncateOp, float, int64_t)                           \
+  X(I64__trunc_f32_u, runTruncateOp, float, uint64_t)                          \
+  X(I64__trunc_f64_s, runTruncateOp, double, int64_t)                          \
+  X(I64__trunc_f64_u, runTruncateOp, double, uint64_t)                         \
+  X(F32__convert_i32_s, runConvertOp, int32_t, float)                          \
+  X(F32__convert_i32_u, runConvertOp, uint32_t, float)                         \
+  X(F32__convert_i64_s, runConvertOp, int64_t, float)                          \
+  X(F32__convert_i64_u, runConvertOp, uint64_t, float)                         \
+  X(F32__demote_f64, runDemoteOp, double, float)                               \
+  X(F64__convert_i32_s, runConvertOp, int32_t, double)                         \
+  X(F64__convert_i32_u, runConvertOp, uint32_t, double)                        \
+  X(F64__convert_i64_s, runConvertOp, int64_t, double)                         \
+  X(F64__convert_i64_u, runConvertOp, uint64_t, double)                        \
+  X(F64__promote_f32, runPromoteOp, float, double)                             \
+  X(I32__reinterpret_f32, runReinterpretOp, float, uint32_t)                   \
+  X(I64__reinterpret_f64, runReinterpretOp, double, uint64_t)                  \
+  X(F32__reinterpret_i32, runReinterpretOp, uint32_t, float)                   \
+  X(F64__reinterpret_i64, runReinterpretOp, uint64_t, double)
+
+/// Binary numeric instructions. X(OpCode, Function, Type)
+#define FLAT_BINARY_OPS(X)                                                     \
+  X(I32__eq, runEqOp, uint32_t)                                                \
+  X(I32__ne, runNeOp, uint32_t)                                                \
+  X(I32__lt_s, runLtOp, int32_t)                                               \
+  X(I32__lt_u, runLtOp, uint32_t)                                              \
+  X(I32__gt_s, runGtOp, int32_t)                                               \
+  X(I32__gt_u, runGtOp, uint32_t)                                              \
+  X(I32__le_s, runLeOp, int32_t)                                               \
+  X(I32__le_u, runLeOp, uint32_t)                                              \
+  X(I32__ge_s, runGeOp, int32_t)                                               \
+  X(I32__ge_u, runGeOp, uint32_t)                                              \
+  X(I64__eq, runEqOp, uint64_t)                                                \
+  X(I64__ne, runNeOp, uint64_t)                                                \
+  X(I64__lt_s, runLtOp, int64_t)                                               \
+  X(I64__lt_u, runLtOp, uint64_t)                                              \
+  X(I64__gt_s, runGtOp, int64_t)                                               \
+  X(I64__gt_u, runGtOp, uint64_t)                                              \
+  X(I64__le_s, runLeOp, int64_t)                                               \
+  X(I64__le_u, runLeOp, uint64_t)                                              \
+  X(I64__ge_s, runGeOp, int64_t)                                               \
+  X(I64__ge_u, runGeOp, uint64_t)                                              \
+  X(F32__eq, runEqOp, float)                                                   \
+  X(F32__ne, runNeOp, float)                                                   \
+  X(F32__lt, runLtOp, float)                                                   \
+  X(F32__gt, runGtOp, float)                                                   \
+  X(F32__le, runLeOp, float)                                                   \
+  X(F32__ge, runGeOp, float)                                                   \
+  X(F64__eq, runEqOp, double)                                                  \
+  X(F64__ne, runNeOp, double)                                                  \
+  X(F64__lt, runLtOp, double)                                                  \
+  X(F64__gt, runGtOp, double)                                                  \
+  X(F64__le, runLeOp, double)                                                  \
+  X(F64__ge, runGeOp, double)                                                  \
+  X(I32__add, runAddOp, uint32_t)                                              \
+  X(I32__sub, runSubOp, uint32_t)                                              \
+  X(I32__mul, runMulOp, uint32_t)                                              \
+  X(I32__div_s, runDivOp, int32_t)                                             \
+  X(I32__div_u, runDivOp, uint32_t)                                            \
+  X(I32__rem_s, runRemOp, int32_t)                                             \
+  X(I32__rem_u, runRemOp, uint32_t)                                            \
+  X(I32__and, runAndOp, uint32_t)                                              \
+  X(I32__or, runOrOp, uint32_t)                                                \
+  X(I32__xor, runXorOp, uint32_t)                                              \
+  X(I32__shl, runShlOp, uint32_t)                                              \
+  X(I32__shr_s, runShrOp, int32_t)                                             \
+  X(I32__shr_u, runShrOp, uint32_t)                                            \
+  X(I32__rotl, runRotlOp, uint32_t)                                            \
+  X(I32__rotr, runRotrOp, uint32_t)                                            \
+  X(I64__add, runAddOp, uint64_t)                                              \
+  X(I64__sub, runSubOp, uint64_t)                                              \
+  X(I64__mul, runMulOp, uint64_t)                                              \
+  X(I64__div_s, runDivOp, int64_t)                                             \
+  X(I64__div_u, runDivOp, uint64_t)                                            \
+  X(I64__rem_s, runRemOp, int64_t)                                             \
+  X(I64__rem_u, runRemOp, uint64_t)                                            \
+  X(I64__and, runAndOp, uint64_t)                                              \
+  X(I64__or, runOrOp, uint64_t)                                                \
+  X(I64__xor, runXorOp, uint64_t)                                              \
+  X(I64__shl, runShlOp, uint64_t)                                              \
+  X(I64__shr_s, runShrOp, int64_t)                                             \
+  X(I64__shr_u, runShrOp, uint64_t)                                            \
+  X(I64__rotl, runRotlOp, uint64_t)                                            \
+  X(I64__rotr, runRotrOp, uint64_t)                                            \
+  X(F32__add, runAddOp, float)                                                 \
+  X(F32__sub, runSubOp, float)                                                 \
+  X(F32__mul, runMulOp, float)                                                 \
+  X(F32__div, runDivOp, float)                                                 \
+  X(F32__min, runMinOp, float)                                                 \
+  X(F32__max, runMaxOp, float)                                                 \
+  X(F32__copysign, runCopysignOp, float)                                       \
+  X(F64__add, runAddOp, double)                                                \
+  X(F64__sub, runSubOp, double)                                                \
+  X(F64__mul, runMulOp, double)                                                \
+  X(F64__div, runDivOp, double)                                                \
+  X(F64__min, runMinOp, double)                                                \
+  X(F64__max, runMaxOp, double)                                                \
+  X(F64__copysign, runCopysignOp, double)
+
+namespace SSVM {
+namespace Interpreter {
+
+using Runtime::FlatInstr;
+
+Expect<void> Interpreter::executeFlat(Runtime::StoreManager &StoreMgr,
+                                      const FlatInstr *PC) {
+#if SSVM_FLAT_THREADED
+  /// Dispatch table from opcode to handler. The tables are built once, since
+  /// the tiered engine enters this function on every switch of tiers.
+  static const std::array<const void *, 256> Table = ({
+    std::array<const void *, 256> T;
+    T.fill(&&L_Default);
+#define FLAT_SET_TARGET(Op, ...)                                               \
+  T[static_cast<uint8_t>(OpCode::Op)] = &&L_##Op;
+#define FLAT_SET_CONTROL_TARGET(Op) FLAT_SET_TARGET(Op, void)
+    FLAT_CONTROL_OPS(FLAT_SET_CONTROL_TARGET)
+    FLAT_LOAD_OPS(FLAT_SET_TARGET)
+    FLAT_STORE_OPS(FLAT_SET_TARGET)
+    FLAT_UNARY_OPS(FLAT_SET_TARGET)
+    FLAT_BINARY_OPS(FLAT_SET_TARGET)
+#undef FLAT_SET_CONTROL_TARGET
+#undef FLAT_SET_TARGET
+    T;
+  });
+  /// Dispatch table while stepping.
+  static const std::array<const void *, 256> StepTable = ({
+    std::array<const void *, 256> T;
+    T.fill(&&L_Step);
+    T;
+  });
+  const void *const *Targets = Table.data();
+#define TARGET(Op) L_##Op:
+#define DISPATCH_TARGET() goto *Targets[static_cast<uint8_t>(PC->Code)]
+#define STEP_BEGIN()                                                           \
+  do {                                                                         \
+    Targets = StepTable.data();                                                \
+    FlatStepping = true;                                                       \
+  } while (0)
+#define STEP_END()                                                             \
+  do {                                                                         \
+    Targets = Table.data();                                                    \
+    FlatStepping = false;                                                      \
+  } while (0)
+#else
+#define TARGET(Op) case OpCode::Op:
+#define DISPATCH_TARGET() goto Dispatch
+#define STEP_BEGIN() FlatStepping = true
+#define STEP_END() FlatStepping = false
+#endif
+
+/// Jump to the handler of instruction at PC. Instructions are charged by the
+/// metering entries of basic blocks.
+#define DISPATCH() DISPATCH_TARGET()
+#define NEXT()                                                                 \
+  do {                                                                         \
+    ++PC;                                                                      \
+    DISPATCH();                                                                \
+  } while (0)
+#define JUMP()                                                                 \
+  do {                                                                         \
+    PC += static_cast<int32_t>(PC->Index);                                     \
+    DISPATCH();                                                                \
+  } while (0)
+/// Refund the rest of basic block after the trapping instruction.
+#define TRAP(Err)                                                              \
+  do {                                                                         \
+    if (Measure) {                                                             \
+      refundFlatBlock(PC);                                                     \
+    }                                                                          \
+    return Unexpect(Err);                                                      \
+  } while (0)
+/// Record the memory accessing instruction, which traps by fault.
+#define FAULT_POINT()                                                          \
+  do {                                                                         \
+    FlatFaultPC = PC;                                                          \
+    std::atomic_signal_fence(std::memory_order_seq_cst);                       \
+  } while (0)
+#define TRY(...)                                                               \
+  do {                                                                         \
+    if (auto Res = (__VA_ARGS__); !Res) {                                      \
+      TRAP(Res);                                                               \
+    }                                                                          \
+  } while (0)
+/// Enter the function instance. Host functions return immediately. Functions
+/// compiled in tiered engine run the native code, which returns immediately
+/// or bails out in the middle of a basic block. Functions not lowered yet are
+/// entered in the AST tier, and the return address is recorded for
+/// `executeTiered` to resume. Lazily loaded functions are lowered on first
+/// call.
+#define CALL(FuncInst)                                                         \
+  do {                                                                         \
+    if ((FuncInst)->isHostFunction()) {                                        \
+      TRY(enterFunction(StoreMgr, *(FuncInst)));                               \
+      NEXT();                                                                  \
+    }                                                                          \
+    if (Engine == EngineKind::Tiered) {                                        \
+      if (const auto *Native = getNativeCode(*(FuncInst))) {                   \
+        auto Ret = callNativeFunction(StoreMgr, *(FuncInst), *Native, PC + 1); \
+        if (!Ret) {                                                            \
+          TRAP(Ret);                                                           \
+        }                                                                      \
+        if (*Ret != PC + 1) {                                                  \
+          STEP_END();                                                          \
+        }                                                                      \
+        PC = *Ret;                                                             \
+        DISPATCH();                                                            \
+      }                                                                        \
+      if ((FuncInst)->getTieredCode() == nullptr) {                            \
+        const uint32_t Depth = InstrPdr.getScopeSize();                        \
+        TRY(enterFunction(StoreMgr, *(FuncInst)));                             \
+        TierASTCalls.emplace_back(Depth, PC + 1);                              \
+        return {};                                                             \
+      }                                                                        \
+    }                                                                          \
+    if ((FuncInst)->getFlatCode().empty()) {                                   \
+      TRY(lowerLazyFunction(StoreMgr, *(FuncInst)));                           \
+    }                                                                          \
+    PC = enterFlatFunction(StoreMgr, *(FuncInst), PC + 1);                     \
+    DISPATCH();                                                                \
+  } while (0)
+
+  /// Resume stepping the basic block left by switching tiers.
+  if (FlatStepping) {
+    STEP_BEGIN();
+  }
+  DISPATCH();
+
+  /// Stepping charges instructions one by one until the next basic block.
+#if SSVM_FLAT_THREADED
+L_Step:
+#else
+Dispatch:
+  if (FlatStepping)
+#endif
+  {
+    if (PC->Flags & FlatInstr::Meter) {
+      STEP_END();
+    } else if (!(PC->Flags & FlatInstr::Internal)) {
+      Measure->incInstrCnt();
+      if (auto *Prof = Measure->getProfile()) {
+        Prof->countInstr(static_cast<uint8_t>(PC->Code));
+      }
+      if (!Measure->addInstrCost(PC->Code)) {
+        return Unexpect(ErrCode::CostLimitExceeded);
+      }
+    }
+#if SSVM_FLAT_THREADED
+    goto *Table[static_cast<uint8_t>(PC->Code)];
+#endif
+  }
+
+#if !SSVM_FLAT_THREADED
+  switch (PC->Code) {
+#endif
+
+  /// ======= Control instructions =======
+  TARGET(Unreachable) { TRAP(ErrCode::Unreachable); }
+  TARGET(Nop) {
+    if ((PC->Flags & FlatInstr::Meter) &&
+        (PC->Arity != Measure->getCostTableId() || !chargeFlatBlock(PC))) {
+      /// Cost table is changed after lowering, or cost limit exceeds in the
+      /// basic block. Charge the extra cost, and step the instructions by the
+      /// current table to stop at the exceeding one.
+      if (const uint64_t Extra = getFlatBlockExtra(PC);
+          Extra > 0 && !Measure->addCost(Extra)) {
+        return Unexpect(ErrCode::CostLimitExceeded);
+      }
+      STEP_BEGIN();
+    }
+    NEXT();
+  }
+  TARGET(Block)
+  TARGET(Loop) { NEXT(); }
+  TARGET(If) {
+    if (StackMgr.popAs<uint32_t>() != 0) {
+      NEXT();
+    }
+    JUMP();
+  }
+  TARGET(Else) { JUMP(); }
+  TARGET(End)
+  TARGET(Return) {
+    PC = leaveFlatFunction();
+    if (PC == nullptr) {
+      /// Returned from the entered function, or to the AST tier.
+      return {};
+    }
+    DISPATCH();
+  }
+  TARGET(Br) {
+    StackMgr.eraseValue(PC->Height, PC->Arity);
+    JUMP();
+  }
+  TARGET(Br_if) {
+    if (StackMgr.popAs<uint32_t>() != 0) {
+      StackMgr.eraseValue(PC->Height, PC->Arity);
+      JUMP();
+    }
+    NEXT();
+  }
+  TARGET(Br_table) {
+    /// Label entries follow this instruction.
+    const uint32_t Value = StackMgr.popAs<uint32_t>();
+    PC += 1 + std::min(Value, PC->Index);
+    DISPATCH();
+  }
+  TARGET(Call) {
+    const uint32_t FuncAddr = *CurrCtx->ModInst->getFuncAddr(PC->Index);
+    const auto *FuncInst = *StoreMgr.getFunction(FuncAddr);
+    CALL(FuncInst);
+  }
+  TARGET(Call_indirect) {
+    const auto *TabInst = CurrCtx->TabInst;
+
+    /// Get function element from table and check function type.
+    const uint32_t Idx = StackMgr.popAs<uint32_t>();
+    const Runtime::Instance::TableInstance::FuncElem *Elem;
+    if (auto Res = TabInst->getElem(Idx)) {
+      Elem = *Res;
+    } else {
+      TRAP(Res);
+    }
+    if (Elem->TypeId != PC->Index) {
+      TRAP(ErrCode::TypeNotMatch);
+    }
+    const auto *FuncInst = *StoreMgr.getFunction(Elem->Addr);
+    CALL(FuncInst);
+  }
+
+  /// ======= Parametric instructions =======
+  TARGET(Drop) {
+    StackMgr.pop();
+    NEXT();
+  }
+  TARGET(Select) {
+    const uint32_t Cond = StackMgr.popAs<uint32_t>();
+    const ValVariant Val2 = StackMgr.pop();
+    if (Cond == 0) {
+      StackMgr.getTop() = Val2;
+    }
+    NEXT();
+  }
+
+  /// ======= Variable instructions =======
+  TARGET(Local__get) {
+    runLocalGetOp(PC->Index);
+    NEXT();
+  }
+  TARGET(Local__set) {
+    runLocalSetOp(PC->Index);
+    NEXT();
+  }
+  TARGET(Local__tee) {
+    runLocalTeeOp(PC->Index);
+    NEXT();
+  }
+  TARGET(Global__get) {
+    runGlobalGetOp(PC->Index);
+    NEXT();
+  }
+  TARGET(Global__set) {
+    runGlobalSetOp(PC->Index);
+    NEXT();
+  }
+
+  /// ======= Memory instructions =======
+#define FLAT_LOAD_HANDLER(Op, T, BitWidth)                                     \
+  TARGET(Op) {                                                                 \
+    FAULT_POINT();                                                             \
+    TRY(runLoadOp<T>(*CurrCtx->MemInst, PC->Index, BitWidth));                 \
+    NEXT();                                                                    \
+  }
+#define FLAT_STORE_HANDLER(Op, T, BitWidth)                                    \
+  TARGET(Op) {                                                                 \
+    FAULT_POINT();                                                             \
+    TRY(runStoreOp<T>(*CurrCtx->MemInst, PC->Index, BitWidth));                \
+    NEXT();                                                                    \
+  }
+  FLAT_LOAD_OPS(FLAT_LOAD_HANDLER)
+  FLAT_STORE_OPS(FLAT_STORE_HANDLER)
+#undef FLAT_STORE_HANDLER
+#undef FLAT_LOAD_HANDLER
+  TARGET(Memory__size) {
+    runMemorySizeOp(*CurrCtx->MemInst);
+    NEXT();
+  }
+  TARGET(Memory__grow) {
+    runMemoryGrowOp(*CurrCtx->MemInst);
+    NEXT();
+  }
+
+  /// ======= Const numeric instructions =======
+  TARGET(I32__const)
+  TARGET(I64__const)
+  TARGET(F32__const)
+  TARGET(F64__const) {
+    StackMgr.push(ValVariant(PC->Num));
+    NEXT();
+  }
+
+  /// ======= Unary and binary numeric instructions =======
+#define FLAT_UNARY_HANDLER(Op, Func, ...)                                      \
+  TARGET(Op) {                                                                 \
+    TRY(Func<__VA_ARGS__>(StackMgr.getTop()));                                 \
+    NEXT();                                                                    \
+  }
+#define FLAT_BINARY_HANDLER(Op, Func, T)                                       \
+  TARGET(Op) {                                                                 \
+    const ValVariant Val2 = StackMgr.pop();                                    \
+    TRY(Func<T>(StackMgr.getTop(), Val2));                                     \
+    NEXT();                                                                    \
+  }
+  FLAT_UNARY_OPS(FLAT_UNARY_HANDLER)
+  FLAT_BINARY_OPS(FLAT_BINARY_HANDLER)
+#undef FLAT_BINARY_HANDLER
+#undef FLAT_UNARY_HANDLER
+
+#if SSVM_FLAT_THREADED
+L_Default:
+#else
+  default:
+    break;
+  }
+#endif
+  return Unexpect(ErrCode::ExecutionFailed);
+
+#undef CALL
+#undef TRY
+#undef TRAP
+#undef FAULT_POINT
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+#undef DISPATCH_TARGET
+#undef STEP_END
+#undef STEP_BEGIN
+#undef TARGET
+}
+
+bool Interpreter::chargeFlatBlock(const FlatInstr *Meter) {
+  uint64_t &CostSum = Measure->getCostSum();
+  if (CostSum + Meter->Num > Measure->getCostLimit()) {
+    return false;
+  }
+  CostSum += Meter->Num;
+  Measure->addInstrCnt(Meter->Index);
+  if (auto *Prof = Measure->getProfile()) {
+    const FlatInstr *Instr = Meter + 1;
+    for (uint32_t I = 0; I < Meter->Index; ++Instr) {
+      if (!(Instr->Flags & FlatInstr::Internal)) {
+        Prof->countInstr(static_cast<uint8_t>(Instr->Code));
+        ++I;
+      }
+    }
+  }
+  return true;
+}
+
+uint64_t Interpreter::getFlatBlockExtra(const FlatInstr *Meter) {
+  if (Meter->Flags & FlatInstr::Enter) {
+    return Measure->getInstrCost(OpCode::Else);
+  }
+  return 0;
+}
+
+void Interpreter::refundFlatBlock(const FlatInstr *PC) {
+  if (FlatStepping) {
+    /// Instructions are charged one by one while stepping.
+    return;
+  }
+  /// The trapping instruction is charged. The basic block ends before the next
+  /// metering entry or at the function end.
+  uint64_t Cost = 0, Cnt = 0;
+  auto *Prof = Measure->getProfile();
+  for (++PC; !(PC->Flags & FlatInstr::Meter) && PC->Code != OpCode::End;
+       ++PC) {
+    if (!(PC->Flags & FlatInstr::Internal)) {
+      Cost += Measure->getInstrCost(PC->Code);
+      ++Cnt;
+      if (Prof) {
+        Prof->uncountInstr(static_cast<uint8_t>(PC->Code));
+      }
+    }
+  }
+  Measure->subCost(Cost);
+  Measure->subInstrCnt(Cnt);
+}
+
+Expect<void> Interpreter::lowerLazyFunction(
+    Runtime::StoreManager &StoreMgr,
+    const Runtime::Instance::FunctionInstance &Func) {
+  if (auto Res = Func.loadBody(); !Res) {
+    return Unexpect(Res);
+  }
+  const auto *ModInst = *StoreMgr.getModule(Func.getModuleAddr());
+  if (auto Res = lowerFunction(StoreMgr, *ModInst, Func)) {
+    Func.setTieredCode(std::move(*Res));
+    return {};
+  } else {
+    return Unexpect(Res);
+  }
+}
+
+const FlatInstr *
+Interpreter::enterFlatFunction(Runtime::StoreManager &StoreMgr,
+                               const Runtime::Instance::FunctionInstance &Func,
+                               const FlatInstr *RetPC) {
+  if (Measure) {
+    if (auto *Prof = Measure->getProfile()) {
+      Prof->enterFunction(&Func, Measure->getInstrCnt());
+    }
+  }
+
+  /// Push frame with locals and args.
+  const auto &FuncType = Func.getFuncType();
+  StackMgr.pushFrame(Func.getModuleAddr(),   /// Module address
+                     FuncType.Params.size(), /// Arity
+                     FuncType.Returns.size() /// Coarity
+  );
+  switchFrameContext(StoreMgr);
+  for (auto &Def : Func.getLocals()) {
+    for (uint32_t I = 0; I < Def.first; I++) {
+      StackMgr.push(ValueFromType(Def.second));
+    }
+  }
+
+  /// Record return address and jump to function body.
+  FlatRetStack.push_back(RetPC);
+  return Func.getFlatCode().data();
+}
+
+const FlatInstr *Interpreter::leaveFlatFunction() {
+  /// Pop the frame entry and keep the return values.
+  StackMgr.popFrame();
+  restoreFrameContext();
+  if (Measure) {
+    if (auto *Prof = Measure->getProfile()) {
+      Prof->leaveFunction(Measure->getInstrCnt());
+    }
+  }
+  const FlatInstr *RetPC = FlatRetStack.back();
+  FlatRetStack.pop_back();
+  return RetPC;
+}
+
+} // namespace Interpreter
+} // namespace SSVM
@@ -0,0 +1,1375 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "common/ast/instruction.h"
+#include "interpreter/interpreter.h"
+#include "runtime/flatcode.h"
+#include "runtime/instance/function.h"
+#include "runtime/instance/module.h"
+#include "runtime/nativecode.h"
+
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace SSVM {
+namespace Interpreter {
+
+namespace {
+
+using Runtime::FlatInstr;
+
+/// Offsets of the fields of native context and addresses of the helper
+/// functions, which native code is compiled against.
+struct NativeABI {
+  uint32_t MemBase, MemSize, Globals, CostSum, CostLimit, InstrCnt, Ret;
+  uint64_t Call, CallIndirect, MemoryGrow, BailOut;
+};
+
+/// Process-wide JIT shared by interpreters. Compiled code is removed by the
+/// owners of native code, which may be released at process exit, so the JIT
+/// is never destroyed.
+llvm::orc::LLJIT *getJIT() {
+  static llvm::orc::LLJIT *const JIT = []() -> llvm::orc::LLJIT * {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    /// Functions are compiled on the tier-up threads of interpreters at the
+    /// same time.
+    auto Builder = llvm::orc::LLJITBuilder();
+    Builder.setCompileFunctionCreator(
+        [](llvm::orc::JITTargetMachineBuilder JTMB)
+            -> llvm::Expected<
+                std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+          return std::make_unique<llvm::orc::ConcurrentIRCompiler>(
+              std::move(JTMB));
+        });
+    auto Res = Builder.create();
+    if (!Res) {
+      llvm::consumeError(Res.takeError());
+      return nullptr;
+    }
+    /// Math functions not lowered to instructions are resolved in process.
+    auto Gen = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*Res)->getDataLayout().getGlobalPrefix());
+    if (!Gen) {
+      llvm::consumeError(Gen.takeError());
+      return nullptr;
+    }
+    (*Res)->getMainJITDylib().addGenerator(std::move(*Gen));
+    return Res->release();
+  }();
+  return JIT;
+}
+
+/// Compiled code of a function, removed from the JIT when released.
+struct NativeOwner {
+  llvm::orc::ResourceTrackerSP Tracker;
+  ~NativeOwner() {
+    if (Tracker) {
+      llvm::consumeError(Tracker->remove());
+    }
+  }
+};
+
+/// Bounds of the truncated values converted by native code. The bounds of
+/// trapping in `runTruncateOp` are narrowed to the range converted exactly,
+/// and the values out of it are left to flat code.
+template <typename TIn, typename TOut>
+std::pair<double, double> getTruncateRange() {
+  constexpr int Bits = std::numeric_limits<TOut>::digits;
+  const double TrapLo =
+      static_cast<TIn>(std::numeric_limits<TOut>::min()) - 1.0;
+  const double TrapHi =
+      static_cast<TIn>(std::numeric_limits<TOut>::max()) + 1.0;
+  const double ExactLo =
+      std::is_signed_v<TOut> ? -std::ldexp(1.0, Bits) - 1.0 : -1.0;
+  const double ExactHi = std::ldexp(1.0, Bits);
+  return {std::max(TrapLo, ExactLo), std::min(TrapHi, ExactHi)};
+}
+
+/// Compiler from flat code into LLVM IR.
+///
+/// The locals and operands are kept in 8-byte slots at the heights of flat
+/// code, which are promoted into registers. Instructions which trap, and
+/// basic blocks which exceed the cost limit, store the slots and bail out to
+/// flat code at the instruction, so that flat code runs the rest of function
+/// with the same costs.
+class FlatCompiler {
+public:
+  FlatCompiler(Runtime::StoreManager &StoreMgr,
+               const Runtime::Instance::ModuleInstance &ModInst,
+               const NativeABI &ABI, llvm::LLVMContext &C)
+      : StoreMgr(StoreMgr), ModInst(ModInst), ABI(ABI), C(C), Builder(C),
+        I8(Builder.getInt8Ty()), I32(Builder.getInt32Ty()),
+        I64(Builder.getInt64Ty()), F32(Builder.getFloatTy()),
+        F64(Builder.getDoubleTy()) {}
+
+  /// Compile the flat code of function into the function of name in module.
+  Expect<void> compile(const Runtime::Instance::FunctionInstance &Func,
+                       llvm::Module &M, const std::string &Name) {
+    const auto &FuncType = Func.getFuncType();
+    if (FuncType.Returns.size() > 1) {
+      return Unexpect(ErrCode::Unimplemented);
+    }
+    Code = Func.getFlatCode().data();
+    Size = Func.getFlatCode().size();
+    Params = FuncType.Params.size();
+    Locals = Params;
+    for (const auto &Def : Func.getLocals()) {
+      Locals += Def.first;
+    }
+    Returns = FuncType.Returns.size();
+    Metered = Size > 0 && (Code[0].Flags & FlatInstr::Meter);
+    if (auto Res = analyze(); !Res) {
+      return Unexpect(Res);
+    }
+
+    /// uint32_t Entry(void *Ctx, const uint64_t *Args)
+    auto *FTy = llvm::FunctionType::get(
+        I32, {Builder.getInt8PtrTy(), I64->getPointerTo()}, false);
+    F = llvm::Function::Create(FTy, llvm::Function::ExternalLinkage, Name, M);
+    F->addFnAttr(llvm::Attribute::NoUnwind);
+    CtxArg = F->getArg(0);
+    auto *ArgsArg = F->getArg(1);
+
+    /// Entry block: allocate the slots, load the context, and copy the
+    /// arguments, which are not valid after calls.
+    auto *Entry = llvm::BasicBlock::Create(C, "entry", F);
+    Builder.SetInsertPoint(Entry);
+    for (int64_t K = 0; K < MaxHeight; ++K) {
+      Slots.push_back(Builder.CreateAlloca(I64));
+    }
+    if (MaxArgs > 0) {
+      ArgsArr = Builder.CreateAlloca(llvm::ArrayType::get(I64, MaxArgs));
+    }
+    if (MaxHeight > 0) {
+      BailArr = Builder.CreateAlloca(llvm::ArrayType::get(I64, MaxHeight));
+    }
+    RetVar = Builder.CreateAlloca(I64);
+    MemSizeVar = Builder.CreateAlloca(I64);
+    MemBase = loadContext(ABI.MemBase, Builder.getInt8PtrTy(), true);
+    Globals = loadContext(ABI.Globals, I64->getPointerTo()->getPointerTo(),
+                          true);
+    Builder.CreateStore(loadContext(ABI.MemSize, I64, false), MemSizeVar);
+    if (Metered) {
+      CostSum = loadContext(ABI.CostSum, I64->getPointerTo(), true);
+      InstrCnt = loadContext(ABI.InstrCnt, I64->getPointerTo(), true);
+      CostLimit = Builder.CreateLoad(
+          I64, loadContext(ABI.CostLimit, I64->getPointerTo(), true));
+      CostVar = Builder.CreateAlloca(I64);
+      InstrVar = Builder.CreateAlloca(I64);
+      reloadMeter();
+    }
+    for (uint32_t K = 0; K < Params; ++K) {
+      Builder.CreateStore(
+          Builder.CreateLoad(I64, Builder.CreateConstInBoundsGEP1_32(
+                                      I64, ArgsArg, K)),
+          Slots[K]);
+    }
+    for (uint32_t K = Params; K < Locals; ++K) {
+      Builder.CreateStore(Builder.getInt64(0), Slots[K]);
+    }
+
+    /// Blocks of the branch targets.
+    Blocks.assign(Size, nullptr);
+    for (size_t P = 0; P < Size; ++P) {
+      if (IsTarget[P] && Heights[P] >= 0) {
+        Blocks[P] = llvm::BasicBlock::Create(C, "", F);
+      }
+    }
+    auto *Body = llvm::BasicBlock::Create(C, "body", F);
+    Builder.CreateBr(Body);
+    Builder.SetInsertPoint(Body);
+
+    for (size_t P = 0; P < Size; ++P) {
+      if (Heights[P] < 0) {
+        /// Unreachable instruction.
+        continue;
+      }
+      if (Blocks[P] != nullptr && Builder.GetInsertBlock() != Blocks[P]) {
+        if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
+          Builder.CreateBr(Blocks[P]);
+        }
+        Builder.SetInsertPoint(Blocks[P]);
+      }
+      if (auto Res = compileInstr(P); !Res) {
+        return Unexpect(Res);
+      }
+      if (Code[P].Code == OpCode::Br_table) {
+        /// Label entries are compiled with the table.
+        P += Code[P].Index + 1;
+      }
+    }
+    if (Builder.GetInsertBlock()->getTerminator() == nullptr) {
+      Builder.CreateUnreachable();
+    }
+    if (llvm::verifyFunction(*F)) {
+      return Unexpect(ErrCode::ExecutionFailed);
+    }
+    return {};
+  }
+
+private:
+  /// Compute the heights of the reachable instructions.
+  Expect<void> analyze() {
+    Heights.assign(Size, -1);
+    IsTarget.assign(Size, false);
+    CallTypes.assign(Size, nullptr);
+    auto IsJump = [](const OpCode Op) {
+      return Op == OpCode::If || Op == OpCode::Else || Op == OpCode::Br ||
+             Op == OpCode::Br_if;
+    };
+    for (size_t P = 0; P < Size; ++P) {
+      if (IsJump(Code[P].Code)) {
+        const int64_t T = getTarget(P);
+        if (T < 0 || T >= static_cast<int64_t>(Size)) {
+          return Unexpect(ErrCode::ExecutionFailed);
+        }
+        IsTarget[T] = true;
+      }
+    }
+
+    std::vector<int64_t> TargetHeights(Size, -1);
+    auto Jump = [&](const size_t From, const int64_t H) {
+      TargetHeights[getTarget(From)] = H;
+    };
+    int64_t H = Locals;
+    bool Live = true;
+    MaxHeight = Locals;
+    for (size_t P = 0; P < Size; ++P) {
+      if (!Live) {
+        if (TargetHeights[P] < 0) {
+          continue;
+        }
+        H = TargetHeights[P];
+        Live = true;
+      }
+      Heights[P] = H;
+      const FlatInstr &Instr = Code[P];
+      switch (Instr.Code) {
+      case OpCode::Unreachable:
+      case OpCode::End:
+      case OpCode::Return:
+        Live = false;
+        break;
+      case OpCode::Nop:
+      case OpCode::Block:
+      case OpCode::Loop:
+        break;
+      case OpCode::If:
+        H -= 1;
+        Jump(P, H);
+        break;
+      case OpCode::Else:
+        Jump(P, H);
+        Live = false;
+        break;
+      case OpCode::Br:
+        Jump(P, Instr.Height + Instr.Arity);
+        Live = false;
+        break;
+      case OpCode::Br_if:
+        H -= 1;
+        Jump(P, Instr.Height + Instr.Arity);
+        break;
+      case OpCode::Br_table:
+        H -= 1;
+        if (P + Instr.Index + 1 >= Size) {
+          return Unexpect(ErrCode::ExecutionFailed);
+        }
+        for (size_t E = P + 1; E <= P + Instr.Index + 1; ++E) {
+          Heights[E] = H;
+          Jump(E, Code[E].Height + Code[E].Arity);
+        }
+        P += Instr.Index + 1;
+        Live = false;
+        break;
+      case OpCode::Call:
+      case OpCode::Call_indirect: {
+        auto Type = getCallType(Instr);
+        if (!Type) {
+          return Unexpect(Type);
+        }
+        if ((*Type)->Returns.size() > 1) {
+          return Unexpect(ErrCode::Unimplemented);
+        }
+        CallTypes[P] = *Type;
+        H -= (*Type)->Params.size() + (Instr.Code == OpCode::Call_indirect);
+        H += (*Type)->Returns.size();
+        MaxArgs = std::max(MaxArgs, (*Type)->Params.size());
+        break;
+      }
+      case OpCode::Drop:
+      case OpCode::Local__set:
+      case OpCode::Global__set:
+        H -= 1;
+        break;
+      case OpCode::Select:
+        H -= 2;
+        break;
+      case OpCode::Local__get:
+      case OpCode::Global__get:
+      case OpCode::Memory__size:
+        H += 1;
+        break;
+      case OpCode::Local__tee:
+      case OpCode::Memory__grow:
+        break;
+      default:
+        /// Numeric and memory instructions.
+        H += AST::dispatchInstruction(
+            Instr.Code, [&Instr](auto &&Arg) -> int64_t {
+              using InstrT = typename std::decay_t<decltype(Arg)>::type;
+              if constexpr (std::is_same_v<InstrT, AST::ConstInstruction>) {
+                return 1;
+              } else if constexpr (std::is_same_v<
+                                       InstrT, AST::BinaryNumericInstruction>) {
+                return -1;
+              } else if constexpr (std::is_same_v<InstrT,
+                                                  AST::MemoryInstruction>) {
+                /// Loads keep the height, and stores pop two.
+                return (Instr.Code >= OpCode::I32__store) ? -2 : 0;
+              } else {
+                return 0;
+              }
+            });
+        break;
+      }
+      if (H < 0) {
+        return Unexpect(ErrCode::ExecutionFailed);
+      }
+      MaxHeight = std::max(MaxHeight, H);
+    }
+    return {};
+  }
+
+  /// Compile the instruction at P with the operands at heights below H.
+  Expect<void> compileInstr(const size_t P) {
+    const FlatInstr &Instr = Code[P];
+    const int64_t H = Heights[P];
+    switch (Instr.Code) {
+    /// ======= Control instructions =======
+    case OpCode::Unreachable:
+      bailOut(P, H);
+      return {};
+    case OpCode::Nop:
+      if ((Instr.Flags & FlatInstr::Meter) && Metered) {
+        chargeBlock(Instr, P, H);
+      }
+      return {};
+    case OpCode::Block:
+    case OpCode::Loop:
+      return {};
+    case OpCode::If: {
+      auto *Next = getNextBlock(P);
+      Builder.CreateCondBr(isNonZero(H - 1), Next, Blocks[getTarget(P)]);
+      Builder.SetInsertPoint(Next);
+      return {};
+    }
+    case OpCode::Else:
+      Builder.CreateBr(Blocks[getTarget(P)]);
+      return {};
+    case OpCode::End:
+    case OpCode::Return:
+      flushMeter();
+      if (Returns > 0) {
+        Builder.CreateStore(get(H - 1, I64), getContextPtr(ABI.Ret, I64));
+      }
+      Builder.CreateRet(Builder.getInt32(0));
+      return {};
+    case OpCode::Br:
+      branch(P, H);
+      return {};
+    case OpCode::Br_if: {
+      auto *Next = getNextBlock(P);
+      auto *Cond = isNonZero(H - 1);
+      if (needsCopy(Instr, H - 1)) {
+        auto *Taken = llvm::BasicBlock::Create(C, "", F);
+        Builder.CreateCondBr(Cond, Taken, Next);
+        Builder.SetInsertPoint(Taken);
+        branch(P, H - 1);
+      } else {
+        Builder.CreateCondBr(Cond, Blocks[getTarget(P)], Next);
+      }
+      Builder.SetInsertPoint(Next);
+      return {};
+    }
+    case OpCode::Br_table: {
+      /// Values out of the table take the last label entry.
+      auto *Value = get(H - 1, I32);
+      auto *Current = Builder.GetInsertBlock();
+      std::vector<llvm::BasicBlock *> Entries;
+      for (size_t E = P + 1; E <= P + Instr.Index + 1; ++E) {
+        if (needsCopy(Code[E], H - 1)) {
+          Entries.push_back(llvm::BasicBlock::Create(C, "", F));
+          Builder.SetInsertPoint(Entries.back());
+          branch(E, H - 1);
+        } else {
+          Entries.push_back(Blocks[getTarget(E)]);
+        }
+      }
+      Builder.SetInsertPoint(Current);
+      auto *Switch = Builder.CreateSwitch(Value, Entries.back(), Instr.Index);
+      for (uint32_t K = 0; K < Instr.Index; ++K) {
+        Switch->addCase(Builder.getInt32(K), Entries[K]);
+      }
+      return {};
+    }
+    case OpCode::Call:
+    case OpCode::Call_indirect:
+      compileCall(P, H);
+      return {};
+
+    /// ======= Parametric instructions =======
+    case OpCode::Drop:
+      return {};
+    case OpCode::Select: {
+      auto *Val = Builder.CreateSelect(isNonZero(H - 1), get(H - 3, I64),
+                                       get(H - 2, I64));
+      set(H - 3, Val);
+      return {};
+    }
+
+    /// ======= Variable instructions =======
+    case OpCode::Local__get:
+      set(H, get(Instr.Index, I64));
+      return {};
+    case OpCode::Local__set:
+      set(Instr.Index, get(H - 1, I64));
+      return {};
+    case OpCode::Local__tee:
+      set(Instr.Index, get(H - 1, I64));
+      return {};
+    case OpCode::Global__get:
+      set(H, Builder.CreateLoad(I64, getGlobalPtr(Instr.Index)));
+      return {};
+    case OpCode::Global__set:
+      Builder.CreateStore(get(H - 1, I64), getGlobalPtr(Instr.Index));
+      return {};
+
+    /// ======= Memory instructions =======
+    case OpCode::I32__load:
+      return load(P, H, I32, 32, false);
+    case OpCode::I64__load:
+      return load(P, H, I64, 64, false);
+    case OpCode::F32__load:
+      return load(P, H, F32, 32, false);
+    case OpCode::F64__load:
+      return load(P, H, F64, 64, false);
+    case OpCode::I32__load8_s:
+      return load(P, H, I32, 8, true);
+    case OpCode::I32__load8_u:
+      return load(P, H, I32, 8, false);
+    case OpCode::I32__load16_s:
+      return load(P, H, I32, 16, true);
+    case OpCode::I32__load16_u:
+      return load(P, H, I32, 16, false);
+    case OpCode::I64__load8_s:
+      return load(P, H, I64, 8, true);
+    case OpCode::I64__load8_u:
+      return load(P, H, I64, 8, false);
+    case OpCode::I64__load16_s:
+      return load(P, H, I64, 16, true);
+    case OpCode::I64__load16_u:
+      return load(P, H, I64, 16, false);
+    case OpCode::I64__load32_s:
+      return load(P, H, I64, 32, true);
+    case OpCode::I64__load32_u:
+      return load(P, H, I64, 32, false);
+    case OpCode::I32__store:
+      return store(P, H, I32, 32);
+    case OpCode::I64__store:
+      return store(P, H, I64, 64);
+    case OpCode::F32__store:
+      return store(P, H, F32, 32);
+    case OpCode::F64__store:
+      return store(P, H, F64, 64);
+    case OpCode::I32__store8:
+      return store(P, H, I32, 8);
+    case OpCode::I32__store16:
+      return store(P, H, I32, 16);
+    case OpCode::I64__store8:
+      return store(P, H, I64, 8);
+    case OpCode::I64__store16:
+      return store(P, H, I64, 16);
+    case OpCode::I64__store32:
+      return store(P, H, I64, 32);
+    case OpCode::Memory__size:
+      set(H, Builder.CreateTrunc(
+                 Builder.CreateLShr(Builder.CreateLoad(I64, MemSizeVar), 16),
+                 I32));
+      return {};
+    case OpCode::Memory__grow: {
+      auto *FTy = llvm::FunctionType::get(I32, {Builder.getInt8PtrTy(), I32},
+                                          false);
+      set(H - 1, Builder.CreateCall(FTy, getHelper(ABI.MemoryGrow, FTy),
+                                    {CtxArg, get(H - 1, I32)}));
+      reloadMemSize();
+      return {};
+    }
+
+    /// ======= Const numeric instructions =======
+    case OpCode::I32__const:
+    case OpCode::I64__const:
+    case OpCode::F32__const:
+    case OpCode::F64__const:
+      set(H, Builder.getInt64(Instr.Num));
+      return {};
+
+    /// ======= Unary numeric instructions =======
+    case OpCode::I32__eqz:
+      set(H - 1, Builder.CreateICmpEQ(get(H - 1, I32), Builder.getInt32(0)));
+      return {};
+    case OpCode::I64__eqz:
+      set(H - 1, Builder.CreateICmpEQ(get(H - 1, I64), Builder.getInt64(0)));
+      return {};
+    case OpCode::I32__clz:
+      return countLeadingZeros(H, I32);
+    case OpCode::I64__clz:
+      return countLeadingZeros(H, I64);
+    case OpCode::I32__ctz:
+      return bitCount(H, I32, llvm::Intrinsic::cttz);
+    case OpCode::I64__ctz:
+      return bitCount(H, I64, llvm::Intrinsic::cttz);
+    case OpCode::I32__popcnt:
+      set(H - 1, Builder.CreateUnaryIntrinsic(llvm::Intrinsic::ctpop,
+                                              get(H - 1, I32)));
+      return {};
+    case OpCode::I64__popcnt:
+      set(H - 1, Builder.CreateUnaryIntrinsic(llvm::Intrinsic::ctpop,
+                                              get(H - 1, I64)));
+      return {};
+    case OpCode::F32__abs:
+      return unaryIntrinsic(H, F32, llvm::Intrinsic::fabs);
+    case OpCode::F32__neg:
+      set(H - 1, Builder.CreateFNeg(get(H - 1, F32)));
+      return {};
+    case OpCode::F32__ceil:
+      return unaryIntrinsic(H, F32, llvm::Intrinsic::ceil);
+    case OpCode::F32__floor:
+      return unaryIntrinsic(H, F32, llvm::Intrinsic::floor);
+    case OpCode::F32__trunc:
+      return unaryIntrinsic(H, F32, llvm::Intrinsic::trunc);
+    case OpCode::F32__nearest:
+      return unaryIntrinsic(H, F32, llvm::Intrinsic::nearbyint);
+    case OpCode::F32__sqrt:
+      return unaryIntrinsic(H, F32, llvm::Intrinsic::sqrt);
+    case OpCode::F64__abs:
+      return unaryIntrinsic(H, F64, llvm::Intrinsic::fabs);
+    case OpCode::F64__neg:
+      set(H - 1, Builder.CreateFNeg(get(H - 1, F64)));
+      return {};
+    case OpCode::F64__ceil:
+      return unaryIntrinsic(H, F64, llvm::Intrinsic::ceil);
+    case OpCode::F64__floor:
+      return unaryIntrinsic(H, F64, llvm::Intrinsic::floor);
+    case OpCode::F64__trunc:
+      return unaryIntrinsic(H, F64, llvm::Intrinsic::trunc);
+    case OpCode::F64__nearest:
+      return unaryIntrinsic(H, F64, llvm::Intrinsic::nearbyint);
+    case OpCode::F64__sqrt:
+      return unaryIntrinsic(H, F64, llvm::Intrinsic::sqrt);
+    case OpCode::I32__wrap_i64:
+      set(H - 1, get(H - 1, I32));
+      return {};
+    case OpCode::I32__trunc_f32_s:
+      return truncate<float, int32_t>(P, H);
+    case OpCode::I32__trunc_f32_u:
+      return truncate<float, uint32_t>(P, H);
+    case OpCode::I32__trunc_f64_s:
+      return truncate<double, int32_t>(P, H);
+    case OpCode::I32__trunc_f64_u:
+      return truncate<double, uint32_t>(P, H);
+    case OpCode::I64__extend_i32_s:
+      set(H - 1, Builder.CreateSExt(get(H - 1, I32), I64));
+      return {};
+    case OpCode::I64__extend_i32_u:
+      set(H - 1, Builder.CreateZExt(get(H - 1, I32), I64));
+      return {};
+    case OpCode::I64__trunc_f32_s:
+      return truncate<float, int64_t>(P, H);
+    case OpCode::I64__trunc_f32_u:
+      return truncate<float, uint64_t>(P, H);
+    case OpCode::I64__trunc_f64_s:
+      return truncate<double, int64_t>(P, H);
+    case OpCode::I64__trunc_f64_u:
+      return truncate<double, uint64_t>(P, H);
+    case OpCode::F32__convert_i32_s:
+      set(H - 1, Builder.CreateSIToFP(get(H - 1, I32), F32));
+      return {};
+    case OpCode::F32__convert_i32_u:
+      set(H - 1, Builder.CreateUIToFP(get(H - 1, I32), F32));
+      return {};
+    case OpCode::F32__convert_i64_s:
+      set(H - 1, Builder.CreateSIToFP(get(H - 1, I64), F32));
+      return {};
+    case OpCode::F32__convert_i64_u:
+      set(H - 1, Builder.CreateUIToFP(get(H - 1, I64), F32));
+      return {};
+    case OpCode::F32__demote_f64:
+      set(H - 1, Builder.CreateFPTrunc(get(H - 1, F64), F32));
+      return {};
+    case OpCode::F64__convert_i32_s:
+      set(H - 1, Builder.CreateSIToFP(get(H - 1, I32), F64));
+      return {};
+    case OpCode::F64__convert_i32_u:
+      set(H - 1, Builder.CreateUIToFP(get(H - 1, I32), F64));
+      return {};
+    case OpCode::F64__convert_i64_s:
+      set(H - 1, Builder.CreateSIToFP(get(H - 1, I64), F64));
+      return {};
+    case OpCode::F64__convert_i64_u:
+      set(H - 1, Builder.CreateUIToFP(get(H - 1, I64), F64));
+      return {};
+    case OpCode::F64__promote_f32:
+      set(H - 1, Builder.CreateFPExt(get(H - 1, F32), F64));
+      return {};
+    case OpCode::I32__reinterpret_f32:
+    case OpCode::I64__reinterpret_f64:
+    case OpCode::F32__reinterpret_i32:
+    case OpCode::F64__reinterpret_i64:
+      /// Slots keep the raw bits.
+      return {};
+
+    /// ======= Binary numeric instructions =======
+    case OpCode::I32__eq:
+      return compare(H, I32, llvm::CmpInst::ICMP_EQ);
+    case OpCode::I32__ne:
+      return compare(H, I32, llvm::CmpInst::ICMP_NE);
+    case OpCode::I32__lt_s:
+      return compare(H, I32, llvm::CmpInst::ICMP_SLT);
+    case OpCode::I32__lt_u:
+      return compare(H, I32, llvm::CmpInst::ICMP_ULT);
+    case OpCode::I32__gt_s:
+      return compare(H, I32, llvm::CmpInst::ICMP_SGT);
+    case OpCode::I32__gt_u:
+      return compare(H, I32, llvm::CmpInst::ICMP_UGT);
+    case OpCode::I32__le_s:
+      return compare(H, I32, llvm::CmpInst::ICMP_SLE);
+    case OpCode::I32__le_u:
+      return compare(H, I32, llvm::CmpInst::ICMP_ULE);
+    case OpCode::I32__ge_s:
+      return compare(H, I32, llvm::CmpInst::ICMP_SGE);
+    case OpCode::I32__ge_u:
+      return compare(H, I32, llvm::CmpInst::ICMP_UGE);
+    case OpCode::I64__eq:
+      return compare(H, I64, llvm::CmpInst::ICMP_EQ);
+    case OpCode::I64__ne:
+      return compare(H, I64, llvm::CmpInst::ICMP_NE);
+    case OpCode::I64__lt_s:
+      return compare(H, I64, llvm::CmpInst::ICMP_SLT);
+    case OpCode::I64__lt_u:
+      return compare(H, I64, llvm::CmpInst::ICMP_ULT);
+    case OpCode::I64__gt_s:
+      return compare(H, I64, llvm::CmpInst::ICMP_SGT);
+    case OpCode::I64__gt_u:
+      return compare(H, I64, llvm::CmpInst::ICMP_UGT);
+    case OpCode::I64__le_s:
+      return compare(H, I64, llvm::CmpInst::ICMP_SLE);
+    case OpCode::I64__le_u:
+      return compare(H, I64, llvm::CmpInst::ICMP_ULE);
+    case OpCode::I64__ge_s:
+      return compare(H, I64, llvm::CmpInst::ICMP_SGE);
+    case OpCode::I64__ge_u:
+      return compare(H, I64, llvm::CmpInst::ICMP_UGE);
+    case OpCode::F32__eq:
+      return compare(H, F32, llvm::CmpInst::FCMP_OEQ);
+    case OpCode::F32__ne:
+      return compare(H, F32, llvm::CmpInst::FCMP_UNE);
+    case OpCode::F32__lt:
+      return compare(H, F32, llvm::CmpInst::FCMP_OLT);
+    case OpCode::F32__gt:
+      return compare(H, F32, llvm::CmpInst::FCMP_OGT);
+    case OpCode::F32__le:
+      return compare(H, F32, llvm::CmpInst::FCMP_OLE);
+    case OpCode::F32__ge:
+      return compare(H, F32, llvm::CmpInst::FCMP_OGE);
+    case OpCode::F64__eq:
+      return compare(H, F64, llvm::CmpInst::FCMP_OEQ);
+    case OpCode::F64__ne:
+      return compare(H, F64, llvm::CmpInst::FCMP_UNE);
+    case OpCode::F64__lt:
+      return compare(H, F64, llvm::CmpInst::FCMP_OLT);
+    case OpCode::F64__gt:
+      return compare(H, F64, llvm::CmpInst::FCMP_OGT);
+    case OpCode::F64__le:
+      return compare(H, F64, llvm::CmpInst::FCMP_OLE);
+    case OpCode::F64__ge:
+      return compare(H, F64, llvm::CmpInst::FCMP_OGE);
+    case OpCode::I32__add:
+      return binary(H, I32, llvm::Instruction::Add);
+    case OpCode::I32__sub:
+      return binary(H, I32, llvm::Instruction::Sub);
+    case OpCode::I32__mul:
+      return binary(H, I32, llvm::Instruction::Mul);
+    case OpCode::I32__div_s:
+      return divide(P, H, I32, llvm::Instruction::SDiv);
+    case OpCode::I32__div_u:
+      return divide(P, H, I32, llvm::Instruction::UDiv);
+    case OpCode::I32__rem_s:
+      return divide(P, H, I32, llvm::Instruction::SRem);
+    case OpCode::I32__rem_u:
+      return divide(P, H, I32, llvm::Instruction::URem);
+    case OpCode::I32__and:
+      return binary(H, I32, llvm::Instruction::And);
+    case OpCode::I32__or:
+      return binary(H, I32, llvm::Instruction::Or);
+    case OpCode::I32__xor:
+      return binary(H, I32, llvm::Instruction::Xor);
+    case OpCode::I32__shl:
+      return shift(H, I32, llvm::Instruction::Shl);
+    case OpCode::I32__shr_s:
+      return shift(H, I32, llvm::Instruction::AShr);
+    case OpCode::I32__shr_u:
+      return shift(H, I32, llvm::Instruction::LShr);
+    case OpCode::I32__rotl:
+      return rotate(H, I32, llvm::Intrinsic::fshl);
+    case OpCode::I32__rotr:
+      return rotate(H, I32, llvm::Intrinsic::fshr);
+    case OpCode::I64__add:
+      return binary(H, I64, llvm::Instruction::Add);
+    case OpCode::I64__sub:
+      return binary(H, I64, llvm::Instruction::Sub);
+    case OpCode::I64__mul:
+      return binary(H, I64, llvm::Instruction::Mul);
+    case OpCode::I64__div_s:
+      return divide(P, H, I64, llvm::Instruction::SDiv);
+    case OpCode::I64__div_u:
+      return divide(P, H, I64, llvm::Instruction::UDiv);
+    case OpCode::I64__rem_s:
+      return divide(P, H, I64, llvm::Instruction::SRem);
+    case OpCode::I64__rem_u:
+      return divide(P, H, I64, llvm::Instruction::URem);
+    case OpCode::I64__and:
+      return binary(H, I64, llvm::Instruction::And);
+    case OpCode::I64__or:
+      return binary(H, I64, llvm::Instruction::Or);
+    case OpCode::I64__xor:
+      return binary(H, I64, llvm::Instruction::Xor);
+    case OpCode::I64__shl:
+      return shift(H, I64, llvm::Instruction::Shl);
+    case OpCode::I64__shr_s:
+      return shift(H, I64, llvm::Instruction::AShr);
+    case OpCode::I64__shr_u:
+      return shift(H, I64, llvm::Instruction::LShr);
+    case OpCode::I64__rotl:
+      return rotate(H, I64, llvm::Intrinsic::fshl);
+    case OpCode::I64__rotr:
+      return rotate(H, I64, llvm::Intrinsic::fshr);
+    case OpCode::F32__add:
+      return binary(H, F32, llvm::Instruction::FAdd);
+    case OpCode::F32__sub:
+      return binary(H, F32, llvm::Instruction::FSub);
+    case OpCode::F32__mul:
+      return binary(H, F32, llvm::Instruction::FMul);
+    case OpCode::F32__div:
+      return binary(H, F32, llvm::Instruction::FDiv);
+    case OpCode::F32__min:
+      return minimum(H, F32);
+    case OpCode::F32__max:
+      return maximum(H, F32);
+    case OpCode::F32__copysign:
+      set(H - 2, Builder.CreateBinaryIntrinsic(llvm::Intrinsic::copysign,
+                                               get(H - 2, F32),
+                                               get(H - 1, F32)));
+      return {};
+    case OpCode::F64__add:
+      return binary(H, F64, llvm::Instruction::FAdd);
+    case OpCode::F64__sub:
+      return binary(H, F64, llvm::Instruction::FSub);
+    case OpCode::F64__mul:
+      return binary(H, F64, llvm::Instruction::FMul);
+    case OpCode::F64__div:
+      return binary(H, F64, llvm::Instruction::FDiv);
+    case OpCode::F64__min:
+      return minimum(H, F64);
+    case OpCode::F64__max:
+      return maximum(H, F64);
+    case OpCode::F64__copysign:
+      set(H - 2, Builder.CreateBinaryIntrinsic(llvm::Intrinsic::copysign,
+                                               get(H - 2, F64),
+                                               get(H - 1, F64)));
+      return {};
+    default:
+      return Unexpect(ErrCode::Unimplemented);
+    }
+  }
+
+  /// \name Helpers of control instructions.
+  /// @{
+  int64_t getTarget(const size_t P) const {
+    return static_cast<int64_t>(P) + static_cast<int32_t>(Code[P].Index);
+  }
+
+  /// Block of the instruction after P, which may be a branch target.
+  llvm::BasicBlock *getNextBlock(const size_t P) {
+    if (P + 1 < Size && Blocks[P + 1] != nullptr) {
+      return Blocks[P + 1];
+    }
+    return llvm::BasicBlock::Create(C, "", F);
+  }
+
+  bool needsCopy(const FlatInstr &Br, const int64_t H) const {
+    return Br.Arity > 0 && Br.Height + Br.Arity != H;
+  }
+
+  /// Keep the arity values on the label height and jump to the target.
+  void branch(const size_t P, const int64_t H) {
+    const FlatInstr &Br = Code[P];
+    if (needsCopy(Br, H)) {
+      std::vector<llvm::Value *> Vals;
+      for (uint32_t K = 0; K < Br.Arity; ++K) {
+        Vals.push_back(get(H - Br.Arity + K, I64));
+      }
+      for (uint32_t K = 0; K < Br.Arity; ++K) {
+        set(Br.Height + K, Vals[K]);
+      }
+    }
+    Builder.CreateBr(Blocks[getTarget(P)]);
+  }
+
+  /// Charge the basic block, or bail out to flat code to charge it by steps.
+  void chargeBlock(const FlatInstr &Meter, const size_t P, const int64_t H) {
+    if (Meter.Num > 0) {
+      auto *Sum = Builder.CreateAdd(Builder.CreateLoad(I64, CostVar),
+                                    Builder.getInt64(Meter.Num));
+      bailOutIf(Builder.CreateICmpUGT(Sum, CostLimit), P, H);
+      Builder.CreateStore(Sum, CostVar);
+    }
+    if (Meter.Index > 0) {
+      Builder.CreateStore(Builder.CreateAdd(Builder.CreateLoad(I64, InstrVar),
+                                            Builder.getInt64(Meter.Index)),
+                          InstrVar);
+    }
+  }
+
+  void compileCall(const size_t P, const int64_t H) {
+    const FlatInstr &Instr = Code[P];
+    const auto &Type = *CallTypes[P];
+    const bool Indirect = Instr.Code == OpCode::Call_indirect;
+    const int64_t Base = H - Type.Params.size() - Indirect;
+    llvm::Value *Args = llvm::ConstantPointerNull::get(I64->getPointerTo());
+    if (ArgsArr != nullptr) {
+      Args = Builder.CreateConstInBoundsGEP2_32(ArgsArr->getAllocatedType(),
+                                                ArgsArr, 0, 0);
+    }
+    for (uint32_t K = 0; K < Type.Params.size(); ++K) {
+      Builder.CreateStore(get(Base + K, I64),
+                          Builder.CreateConstInBoundsGEP1_32(I64, Args, K));
+    }
+
+    /// Callees charge the meters in place.
+    flushMeter();
+    llvm::Value *Status;
+    if (Indirect) {
+      auto *FTy = llvm::FunctionType::get(
+          I32,
+          {Builder.getInt8PtrTy(), I32, I32, I64->getPointerTo(),
+           I64->getPointerTo()},
+          false);
+      Status = Builder.CreateCall(FTy, getHelper(ABI.CallIndirect, FTy),
+                                  {CtxArg, Builder.getInt32(Instr.Index),
+                                   get(H - 1, I32), Args, RetVar});
+      bailOutIf(Builder.CreateICmpEQ(
+                    Status, Builder.getInt32(Runtime::NativeCode::kBailOut)),
+                P, H);
+    } else {
+      auto *FTy = llvm::FunctionType::get(
+          I32,
+          {Builder.getInt8PtrTy(), I32, I64->getPointerTo(),
+           I64->getPointerTo()},
+          false);
+      Status = Builder.CreateCall(
+          FTy, getHelper(ABI.Call, FTy),
+          {CtxArg, Builder.getInt32(Instr.Index), Args, RetVar});
+    }
+
+    /// Errors of callees are returned as they are.
+    auto *Error = llvm::BasicBlock::Create(C, "", F);
+    auto *Next = llvm::BasicBlock::Create(C, "", F);
+    Builder.CreateCondBr(Builder.CreateICmpNE(Status, Builder.getInt32(0)),
+                         Error, Next, getUnlikely());
+    Builder.SetInsertPoint(Error);
+    Builder.CreateRet(Status);
+    Builder.SetInsertPoint(Next);
+    if (Metered) {
+      reloadMeter();
+    }
+    reloadMemSize();
+    if (!Type.Returns.empty()) {
+      set(Base, Builder.CreateLoad(I64, RetVar));
+    }
+  }
+  /// @}
+
+  /// \name Helpers of bailing out.
+  /// @{
+  /// Leave the frame of height to flat code at the instruction P.
+  void bailOut(const size_t P, const int64_t H) {
+    auto &[Block, PC] = getBailBlock(H);
+    PC->addIncoming(Builder.getInt32(P), Builder.GetInsertBlock());
+    Builder.CreateBr(Block);
+  }
+
+  void bailOutIf(llvm::Value *Cond, const size_t P, const int64_t H) {
+    auto &[Block, PC] = getBailBlock(H);
+    auto *Next = llvm::BasicBlock::Create(C, "", F);
+    PC->addIncoming(Builder.getInt32(P), Builder.GetInsertBlock());
+    Builder.CreateCondBr(Cond, Block, Next, getUnlikely());
+    Builder.SetInsertPoint(Next);
+  }
+
+  /// Block storing the slots below height, shared by the bailing out
+  /// instructions.
+  std::pair<llvm::BasicBlock *, llvm::PHINode *> &
+  getBailBlock(const int64_t H) {
+    auto It = BailBlocks.find(H);
+    if (It != BailBlocks.end()) {
+      return It->second;
+    }
+    llvm::IRBuilderBase::InsertPointGuard Guard(Builder);
+    auto *Block = llvm::BasicBlock::Create(C, "bail", F);
+    Builder.SetInsertPoint(Block);
+    auto *PC = Builder.CreatePHI(I32, 2);
+    flushMeter();
+    llvm::Value *Arr = llvm::ConstantPointerNull::get(I64->getPointerTo());
+    if (BailArr != nullptr) {
+      Arr = Builder.CreateConstInBoundsGEP2_32(BailArr->getAllocatedType(),
+                                               BailArr, 0, 0);
+    }
+    for (int64_t K = 0; K < H; ++K) {
+      Builder.CreateStore(get(K, I64),
+                          Builder.CreateConstInBoundsGEP1_32(I64, Arr, K));
+    }
+    auto *FTy = llvm::FunctionType::get(
+        Builder.getVoidTy(),
+        {Builder.getInt8PtrTy(), I64->getPointerTo(), I32, I32}, false);
+    Builder.CreateCall(FTy, getHelper(ABI.BailOut, FTy),
+                       {CtxArg, Arr, PC, Builder.getInt32(H)});
+    Builder.CreateRet(Builder.getInt32(Runtime::NativeCode::kBailOut));
+    return BailBlocks.try_emplace(H, Block, PC).first->second;
+  }
+
+  llvm::MDNode *getUnlikely() {
+    return llvm::MDBuilder(C).createBranchWeights(1, 1U << 20);
+  }
+  /// @}
+
+  /// \name Helpers of context and slots.
+  /// @{
+  llvm::Value *getContextPtr(const uint32_t Offset, llvm::Type *Ty) {
+    auto *Ptr = Builder.CreateConstInBoundsGEP1_32(I8, CtxArg, Offset);
+    return Builder.CreateBitCast(Ptr, Ty->getPointerTo());
+  }
+
+  llvm::Value *loadContext(const uint32_t Offset, llvm::Type *Ty,
+                           const bool Invariant) {
+    auto *Load = Builder.CreateLoad(Ty, getContextPtr(Offset, Ty));
+    if (Invariant) {
+      Load->setMetadata(llvm::LLVMContext::MD_invariant_load,
+                        llvm::MDNode::get(C, {}));
+    }
+    return Load;
+  }
+
+  llvm::Value *getHelper(const uint64_t Addr, llvm::FunctionType *FTy) {
+    return Builder.CreateIntToPtr(Builder.getInt64(Addr),
+                                  FTy->getPointerTo());
+  }
+
+  llvm::Value *getGlobalPtr(const uint32_t Idx) {
+    auto *Ptr = Builder.CreateLoad(
+        I64->getPointerTo(),
+        Builder.CreateConstInBoundsGEP1_32(I64->getPointerTo(), Globals, Idx));
+    Ptr->setMetadata(llvm::LLVMContext::MD_invariant_load,
+                     llvm::MDNode::get(C, {}));
+    return Ptr;
+  }
+
+  /// Meters are counted in registers, and written back before leaving.
+  void flushMeter() {
+    if (Metered) {
+      Builder.CreateStore(Builder.CreateLoad(I64, CostVar), CostSum);
+      Builder.CreateStore(Builder.CreateLoad(I64, InstrVar), InstrCnt);
+    }
+  }
+
+  void reloadMeter() {
+    Builder.CreateStore(Builder.CreateLoad(I64, CostSum), CostVar);
+    Builder.CreateStore(Builder.CreateLoad(I64, InstrCnt), InstrVar);
+  }
+
+  void reloadMemSize() {
+    Builder.CreateStore(loadContext(ABI.MemSize, I64, false), MemSizeVar);
+  }
+
+  llvm::Value *get(const int64_t K, llvm::Type *Ty) {
+    llvm::Value *Val = Builder.CreateLoad(I64, Slots[K]);
+    if (Ty == I64) {
+      return Val;
+    }
+    if (Ty == F64) {
+      return Builder.CreateBitCast(Val, F64);
+    }
+    Val = Builder.CreateTrunc(Val, I32);
+    return (Ty == F32) ? Builder.CreateBitCast(Val, F32) : Val;
+  }
+
+  void set(const int64_t K, llvm::Value *Val) {
+    llvm::Type *Ty = Val->getType();
+    if (Ty == F32) {
+      Val = Builder.CreateBitCast(Val, I32);
+    } else if (Ty == F64) {
+      Val = Builder.CreateBitCast(Val, I64);
+    }
+    if (Val->getType() != I64) {
+      Val = Builder.CreateZExt(Val, I64);
+    }
+    Builder.CreateStore(Val, Slots[K]);
+  }
+
+  llvm::Value *isNonZero(const int64_t K) {
+    return Builder.CreateICmpNE(get(K, I32), Builder.getInt32(0));
+  }
+  /// @}
+
+  /// \name Helpers of memory instructions.
+  /// @{
+  /// Address of the access at the operand K. Out of bound accesses bail out
+  /// to trap in flat code.
+  llvm::Value *getAddress(const int64_t K, const uint32_t Offset,
+                          const uint32_t Bytes, const size_t P,
+                          const int64_t H) {
+    auto *EA = Builder.CreateAdd(Builder.CreateZExt(get(K, I32), I64),
+                                 Builder.getInt64(Offset));
+    auto *End = Builder.CreateAdd(EA, Builder.getInt64(Bytes));
+    bailOutIf(Builder.CreateICmpUGT(End, Builder.CreateLoad(I64, MemSizeVar)),
+              P, H);
+    return Builder.CreateInBoundsGEP(I8, MemBase, EA);
+  }
+
+  Expect<void> load(const size_t P, const int64_t H, llvm::Type *Ty,
+                    const uint32_t BitWidth, const bool Signed) {
+    auto *Addr = getAddress(H - 1, Code[P].Index, BitWidth / 8, P, H);
+    llvm::Type *MemTy = Ty->isFloatingPointTy()
+                            ? Ty
+                            : static_cast<llvm::Type *>(
+                                  Builder.getIntNTy(BitWidth));
+    llvm::Value *Val = Builder.CreateAlignedLoad(
+        MemTy, Builder.CreateBitCast(Addr, MemTy->getPointerTo()),
+        llvm::MaybeAlign(1));
+    if (MemTy != Ty) {
+      Val = Signed ? Builder.CreateSExt(Val, Ty) : Builder.CreateZExt(Val, Ty);
+    }
+    set(H - 1, Val);
+    return {};
+  }
+
+  Expect<void> store(const size_t P, const int64_t H, llvm::Type *Ty,
+                     const uint32_t BitWidth) {
+    llvm::Value *Val = get(H - 1, Ty);
+    if (!Ty->isFloatingPointTy() && Ty->getIntegerBitWidth() != BitWidth) {
+      Val = Builder.CreateTrunc(Val, Builder.getIntNTy(BitWidth));
+    }
+    auto *Addr = getAddress(H - 2, Code[P].Index, BitWidth / 8, P, H);
+    Builder.CreateAlignedStore(
+        Val, Builder.CreateBitCast(Addr, Val->getType()->getPointerTo()),
+        llvm::MaybeAlign(1));
+    return {};
+  }
+  /// @}
+
+  /// \name Helpers of numeric instructions, which have the same results as
+  /// the interpreter.
+  /// @{
+  Expect<void> unaryIntrinsic(const int64_t H, llvm::Type *Ty,
+                              const llvm::Intrinsic::ID ID) {
+    set(H - 1, Builder.CreateUnaryIntrinsic(ID, get(H - 1, Ty)));
+    return {};
+  }
+
+  Expect<void> bitCount(const int64_t H, llvm::Type *Ty,
+                        const llvm::Intrinsic::ID ID) {
+    set(H - 1, Builder.CreateIntrinsic(ID, {Ty},
+                                       {get(H - 1, Ty), Builder.getFalse()}));
+    return {};
+  }
+
+  /// Zero is kept as it is by `runClzOp`.
+  Expect<void> countLeadingZeros(const int64_t H, llvm::Type *Ty) {
+    auto *Val = get(H - 1, Ty);
+    auto *Cnt = Builder.CreateIntrinsic(llvm::Intrinsic::ctlz, {Ty},
+                                        {Val, Builder.getFalse()});
+    auto *Zero = llvm::ConstantInt::get(Ty, 0);
+    set(H - 1, Builder.CreateSelect(Builder.CreateICmpEQ(Val, Zero), Zero,
+                                    Cnt));
+    return {};
+  }
+
+  Expect<void> compare(const int64_t H, llvm::Type *Ty,
+                       const llvm::CmpInst::Predicate Pred) {
+    auto *LHS = get(H - 2, Ty);
+    auto *RHS = get(H - 1, Ty);
+    set(H - 2, Ty->isFloatingPointTy() ? Builder.CreateFCmp(Pred, LHS, RHS)
+                                       : Builder.CreateICmp(Pred, LHS, RHS));
+    return {};
+  }
+
+  Expect<void> binary(const int64_t H, llvm::Type *Ty,
+                      const llvm::Instruction::BinaryOps Op) {
+    set(H - 2, Builder.CreateBinOp(Op, get(H - 2, Ty), get(H - 1, Ty)));
+    return {};
+  }
+
+  /// Shift counts are taken modulo the bit width.
+  Expect<void> shift(const int64_t H, llvm::Type *Ty,
+                     const llvm::Instruction::BinaryOps Op) {
+    auto *Cnt = Builder.CreateAnd(
+        get(H - 1, Ty),
+        llvm::ConstantInt::get(Ty, Ty->getIntegerBitWidth() - 1));
+    set(H - 2, Builder.CreateBinOp(Op, get(H - 2, Ty), Cnt));
+    return {};
+  }
+
+  Expect<void> rotate(const int64_t H, llvm::Type *Ty,
+                      const llvm::Intrinsic::ID ID) {
+    auto *Val = get(H - 2, Ty);
+    set(H - 2, Builder.CreateIntrinsic(ID, {Ty}, {Val, Val, get(H - 1, Ty)}));
+    return {};
+  }
+
+  /// Division by zero and overflow bail out to trap. The remainder of
+  /// division by -1 is zero.
+  Expect<void> divide(const size_t P, const int64_t H, llvm::Type *Ty,
+                      const llvm::Instruction::BinaryOps Op) {
+    auto *LHS = get(H - 2, Ty);
+    auto *RHS = get(H - 1, Ty);
+    auto *Zero = llvm::ConstantInt::get(Ty, 0);
+    auto *MinusOne = llvm::ConstantInt::getSigned(Ty, -1);
+    llvm::Value *Trap = Builder.CreateICmpEQ(RHS, Zero);
+    if (Op == llvm::Instruction::SDiv) {
+      auto *Min = llvm::ConstantInt::get(
+          Ty, llvm::APInt::getSignedMinValue(Ty->getIntegerBitWidth()));
+      Trap = Builder.CreateOr(Trap, Builder.CreateAnd(
+                                        Builder.CreateICmpEQ(LHS, Min),
+                                        Builder.CreateICmpEQ(RHS, MinusOne)));
+    }
+    bailOutIf(Trap, P, H);
+    if (Op == llvm::Instruction::SRem) {
+      RHS = Builder.CreateSelect(Builder.CreateICmpEQ(RHS, MinusOne),
+                                 llvm::ConstantInt::get(Ty, 1), RHS);
+    }
+    set(H - 2, Builder.CreateBinOp(Op, LHS, RHS));
+    return {};
+  }
+
+  /// Zeros of opposite signs give negative zero, and others give
+  /// `std::min(Z1, Z2)`.
+  Expect<void> minimum(const int64_t H, llvm::Type *Ty) {
+    auto *Z1 = get(H - 2, Ty);
+    auto *Z2 = get(H - 1, Ty);
+    auto *Zero = llvm::ConstantFP::get(Ty, 0.0);
+    auto *IntTy = Builder.getIntNTy(Ty->getPrimitiveSizeInBits());
+    auto *Signs = Builder.CreateICmpSLT(
+        Builder.CreateXor(Builder.CreateBitCast(Z1, IntTy),
+                          Builder.CreateBitCast(Z2, IntTy)),
+        llvm::ConstantInt::get(IntTy, 0));
+    auto *Zeros = Builder.CreateAnd(Builder.CreateFCmpOEQ(Z1, Zero),
+                                    Builder.CreateFCmpOEQ(Z2, Zero));
+    auto *Min = Builder.CreateSelect(Builder.CreateFCmpOLT(Z2, Z1), Z2, Z1);
+    set(H - 2, Builder.CreateSelect(Builder.CreateAnd(Zeros, Signs),
+                                    llvm::ConstantFP::get(Ty, -0.0), Min));
+    return {};
+  }
+
+  /// `std::max(Z1, Z2)`.
+  Expect<void> maximum(const int64_t H, llvm::Type *Ty) {
+    auto *Z1 = get(H - 2, Ty);
+    auto *Z2 = get(H - 1, Ty);
+    set(H - 2, Builder.CreateSelect(Builder.CreateFCmpOLT(Z1, Z2), Z2, Z1));
+    return {};
+  }
+
+  template <typename TIn, typename TOut>
+  Expect<void> truncate(const size_t P, const int64_t H) {
+    llvm::Type *InTy = std::is_same_v<TIn, float> ? F32 : F64;
+    llvm::Type *OutTy = (sizeof(TOut) == 4) ? I32 : I64;
+    const auto [Lo, Hi] = getTruncateRange<TIn, TOut>();
+    auto *Z = Builder.CreateUnaryIntrinsic(llvm::Intrinsic::trunc,
+                                           get(H - 1, InTy));
+    auto *D = (InTy == F64) ? Z : Builder.CreateFPExt(Z, F64);
+    auto *InRange = Builder.CreateAnd(
+        Builder.CreateFCmpOGT(D, llvm::ConstantFP::get(F64, Lo)),
+        Builder.CreateFCmpOLT(D, llvm::ConstantFP::get(F64, Hi)));
+    bailOutIf(Builder.CreateNot(InRange), P, H);
+    set(H - 1, std::is_signed_v<TOut> ? Builder.CreateFPToSI(Z, OutTy)
+                                      : Builder.CreateFPToUI(Z, OutTy));
+    return {};
+  }
+  /// @}
+
+  Expect<const Runtime::Instance::FType *>
+  getCallType(const FlatInstr &Instr) {
+    if (Instr.Code == OpCode::Call) {
+      auto FuncAddr = ModInst.getFuncAddr(Instr.Index);
+      if (!FuncAddr) {
+        return Unexpect(FuncAddr);
+      }
+      auto FuncInst = StoreMgr.getFunction(*FuncAddr);
+      if (!FuncInst) {
+        return Unexpect(FuncInst);
+      }
+      return &(*FuncInst)->getFuncType();
+    }
+    /// Indirect calls are lowered with the canonical type ID.
+    for (uint32_t I = 0;; ++I) {
+      auto TypeId = ModInst.getFuncTypeId(I);
+      if (!TypeId) {
+        return Unexpect(TypeId);
+      }
+      if (*TypeId == Instr.Index) {
+        return ModInst.getFuncType(I);
+      }
+    }
+  }
+
+  Runtime::StoreManager &StoreMgr;
+  const Runtime::Instance::ModuleInstance &ModInst;
+  const NativeABI &ABI;
+  llvm::LLVMContext &C;
+  llvm::IRBuilder<> Builder;
+  llvm::Type *const I8, *const I32, *const I64, *const F32, *const F64;
+
+  /// Flat code and the analysis.
+  const FlatInstr *Code = nullptr;
+  size_t Size = 0;
+  uint32_t Params = 0, Locals = 0, Returns = 0;
+  bool Metered = false;
+  std::vector<int64_t> Heights;
+  std::vector<bool> IsTarget;
+  std::vector<const Runtime::Instance::FType *> CallTypes;
+  int64_t MaxHeight = 0;
+  size_t MaxArgs = 0;
+
+  /// Compiled function.
+  llvm::Function *F = nullptr;
+  llvm::Value *CtxArg = nullptr;
+  std::vector<llvm::AllocaInst *> Slots;
+  std::vector<llvm::BasicBlock *> Blocks;
+  std::map<int64_t, std::pair<llvm::BasicBlock *, llvm::PHINode *>> BailBlocks;
+  llvm::AllocaInst *ArgsArr = nullptr, *BailArr = nullptr, *RetVar = nullptr;
+  llvm::AllocaInst *MemSizeVar = nullptr, *CostVar = nullptr,
+                   *InstrVar = nullptr;
+  llvm::Value *MemBase = nullptr, *Globals = nullptr;
+  llvm::Value *CostSum = nullptr, *InstrCnt = nullptr, *CostLimit = nullptr;
+};
+
+/// Optimize the module for the host.
+void optimize(llvm::Module &M) {
+  std::unique_ptr<llvm::TargetMachine> TM;
+  if (auto JTMB = llvm::orc::JITTargetMachineBuilder::detectHost()) {
+    if (auto Res = JTMB->createTargetMachine()) {
+      TM = std::move(*Res);
+    } else {
+      llvm::consumeError(Res.takeError());
+    }
+  } else {
+    llvm::consumeError(JTMB.takeError());
+  }
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB(TM.get());
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2).run(M, MAM);
+}
+
+} // namespace
+
+Expect<Runtime::NativeCode> Interpreter::compileFunction(
+    Runtime::StoreManager &StoreMgr,
+    const Runtime::Instance::ModuleInstance &ModInst,
+    const Runtime::Instance::FunctionInstance &FuncInst) const {
+  auto *JIT = getJIT();
+  if (JIT == nullptr) {
+    return Unexpect(ErrCode::ExecutionFailed);
+  }
+  const NativeABI ABI = {
+      offsetof(NativeContext, MemBase),
+      offsetof(NativeContext, MemSize),
+      offsetof(NativeContext, Globals),
+      offsetof(NativeContext, CostSum),
+      offsetof(NativeContext, CostLimit),
+      offsetof(NativeContext, InstrCnt),
+      offsetof(NativeContext, Ret),
+      reinterpret_cast<uint64_t>(&Interpreter::nativeCall),
+      reinterpret_cast<uint64_t>(&Interpreter::nativeCallIndirect),
+      reinterpret_cast<uint64_t>(&Interpreter::nativeMemoryGrow),
+      reinterpret_cast<uint64_t>(&Interpreter::nativeBailOut)};
+
+  /// Every function is compiled into a module of unique name.
+  static std::atomic<uint64_t> Count{0};
+  const std::string Name = "ssvm.native." + std::to_string(Count++);
+  auto Ctx = std::make_unique<llvm::LLVMContext>();
+  auto M = std::make_unique<llvm::Module>(Name, *Ctx);
+  M->setDataLayout(JIT->getDataLayout());
+  M->setTargetTriple(JIT->getTargetTriple().str());
+  FlatCompiler Compiler(StoreMgr, ModInst, ABI, *Ctx);
+  if (auto Res = Compiler.compile(FuncInst, *M, Name); !Res) {
+    return Unexpect(Res);
+  }
+  optimize(*M);
+
+  auto Owner = std::make_shared<NativeOwner>();
+  Owner->Tracker = JIT->getMainJITDylib().createResourceTracker();
+  if (auto Err = JIT->addIRModule(
+          Owner->Tracker,
+          llvm::orc::ThreadSafeModule(std::move(M), std::move(Ctx)))) {
+    llvm::consumeError(std::move(Err));
+    return Unexpect(ErrCode::ExecutionFailed);
+  }
+  auto Sym = JIT->lookup(Name);
+  if (!Sym) {
+    llvm::consumeError(Sym.takeError());
+    return Unexpect(ErrCode::ExecutionFailed);
+  }
+
+  const auto &Code = FuncInst.getFlatCode();
+  Runtime::NativeCode Native;
+  Native.Entry =
+      reinterpret_cast<Runtime::NativeCode::EntryFunc>(Sym->getAddress());
+  Native.Metered = !Code.empty() && (Code.front().Flags & FlatInstr::Meter);
+  Native.CostTableId = Native.Metered ? Code.front().Arity : 0;
+  Native.Owner = std::move(Owner);
+  return Native;
+}
+
+} // namespace Interpreter
+} // namespace SSVM
@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "common/ast/instruction.h"
+#include "interpreter/interpreter.h"
+#include "runtime/flatcode.h"
+#include "runtime/instance/function.h"
+#include "runtime/instance/module.h"
+#include "support/measure.h"
+
+#include <cstring>
+#include <vector>
+
+namespace SSVM {
+namespace Interpreter {
+
+namespace {
+
+using Runtime::FlatCode;
+using Runtime::FlatInstr;
+
+/// Lowering of validated function body into flat code.
+///
+/// If measured, every basic block starts with a metering entry, which charges
+/// the summed costs of the instructions in the block at once. Basic blocks
+/// end at branches, branch targets, and calls, so that host functions see the
+/// exact costs.
+class FlatLowering {
+public:
+  FlatLowering(Runtime::StoreManager &Store,
+               const Runtime::Instance::ModuleInstance &Mod,
+               const Support::Measurement *Measure)
+      : StoreMgr(Store), ModInst(Mod), Measure(Measure) {}
+
+  Expect<FlatCode> lower(const Runtime::Instance::FunctionInstance &Func) {
+    const auto &FuncType = Func.getFuncType();
+    const uint32_t Returns = FuncType.Returns.size();
+
+    /// Locals occupy the bottom of frame.
+    Height = FuncType.Params.size();
+    for (auto &Def : Func.getLocals()) {
+      Height += Def.first;
+    }
+
+    /// The function body is the outermost block.
+    Labels.emplace_back(Height, Returns, Returns);
+    beginBlock();
+    if (auto Res = lowerSeq(Func.getInstrs()); !Res) {
+      return Unexpect(Res);
+    }
+    patchLabel(Labels.back());
+    Labels.pop_back();
+    Code.emplace_back(OpCode::End, FlatInstr::Internal);
+    return std::move(Code);
+  }
+
+private:
+  struct Label {
+    Label(const uint32_t H, const uint32_t A, const uint32_t R)
+        : Height(H), Arity(A), Results(R), IsLoop(false), Start(0) {}
+    /// Value stack height at block entry.
+    uint32_t Height;
+    /// Count of values kept when branching to this label.
+    uint32_t Arity;
+    /// Count of values left after block end.
+    uint32_t Results;
+    /// Loop label branches backward to start.
+    bool IsLoop;
+    uint32_t Start;
+    /// Forward branches waiting for block end.
+    std::vector<uint32_t> Fixups;
+  };
+
+  Expect<void> lowerSeq(const AST::InstrVec &Instrs) {
+    for (auto &Instr : Instrs) {
+      charge(Instr->getOpCode());
+      auto Res = AST::dispatchInstruction(
+          Instr->getOpCode(), [this, &Instr](auto &&Arg) -> Expect<void> {
+            if constexpr (std::is_void_v<
+                              typename std::decay_t<decltype(Arg)>::type>) {
+              return Unexpect(ErrCode::Unimplemented);
+            } else {
+              return lowerInstr(
+                  *static_cast<const typename std::decay_t<decltype(Arg)>::type
+                                   *>(Instr));
+            }
+          });
+      if (!Res) {
+        return Unexpect(Res);
+      }
+    }
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::ControlInstruction &Instr) {
+    Code.emplace_back(Instr.getOpCode());
+    if (Instr.getOpCode() != OpCode::Nop) {
+      /// Unreachable and return.
+      setUnreachable();
+      beginBlock();
+    }
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::BlockControlInstruction &Instr) {
+    const uint32_t Results = (Instr.getResultType() == ValType::None) ? 0 : 1;
+    Code.emplace_back(Instr.getOpCode());
+    if (Instr.getOpCode() == OpCode::Loop) {
+      Labels.emplace_back(Height, 0, Results);
+      Labels.back().IsLoop = true;
+      Labels.back().Start = Code.size();
+      beginBlock();
+    } else {
+      Labels.emplace_back(Height, Results, Results);
+    }
+    if (auto Res = lowerSeq(Instr.getBody()); !Res) {
+      return Unexpect(Res);
+    }
+    endBlock();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::IfElseControlInstruction &Instr) {
+    const uint32_t Results = (Instr.getResultType() == ValType::None) ? 0 : 1;
+    const auto &IfStatement = Instr.getIfStatement();
+    const auto &ElseStatement = Instr.getElseStatement();
+
+    /// Pop condition.
+    pop(1);
+    const uint32_t IfPos = Code.size();
+    Code.emplace_back(OpCode::If);
+    Labels.emplace_back(Height, Results, Results);
+    beginBlock(isEntering(IfStatement));
+    if (auto Res = lowerSeq(IfStatement); !Res) {
+      return Unexpect(Res);
+    }
+    if (ElseStatement.empty()) {
+      /// False condition jumps to block end.
+      Labels.back().Fixups.push_back(IfPos);
+    } else {
+      /// Skip else statement at the end of if statement.
+      Labels.back().Fixups.push_back(Code.size());
+      Code.emplace_back(OpCode::Else, FlatInstr::Internal);
+      Code[IfPos].Index = Code.size() - IfPos;
+      Height = Labels.back().Height;
+      beginBlock(isEntering(ElseStatement));
+      if (auto Res = lowerSeq(ElseStatement); !Res) {
+        return Unexpect(Res);
+      }
+    }
+    endBlock();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::BrControlInstruction &Instr) {
+    if (Instr.getOpCode() == OpCode::Br_if) {
+      pop(1);
+    }
+    emitBranch(Instr.getOpCode(), Instr.getLabelIndex(), 0);
+    if (Instr.getOpCode() == OpCode::Br) {
+      setUnreachable();
+    }
+    beginBlock();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::BrTableControlInstruction &Instr) {
+    const auto LabelTable = Instr.getLabelTable();
+    pop(1);
+    Code.emplace_back(OpCode::Br_table);
+    Code.back().Index = LabelTable.size();
+    for (const uint32_t Idx : LabelTable) {
+      emitBranch(OpCode::Br, Idx, FlatInstr::Internal);
+    }
+    emitBranch(OpCode::Br, Instr.getLabelIndex(), FlatInstr::Internal);
+    setUnreachable();
+    beginBlock();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::CallControlInstruction &Instr) {
+    const Runtime::Instance::FType *Type = nullptr;
+    if (Instr.getOpCode() == OpCode::Call) {
+      auto FuncAddr = ModInst.getFuncAddr(Instr.getFuncIndex());
+      if (!FuncAddr) {
+        return Unexpect(FuncAddr);
+      }
+      auto FuncInst = StoreMgr.getFunction(*FuncAddr);
+      if (!FuncInst) {
+        return Unexpect(FuncInst);
+      }
+      Type = &(*FuncInst)->getFuncType();
+    } else {
+      auto FuncType = ModInst.getFuncType(Instr.getFuncIndex());
+      if (!FuncType) {
+        return Unexpect(FuncType);
+      }
+      Type = *FuncType;
+      /// Pop table index.
+      pop(1);
+    }
+    pop(Type->Params.size());
+    Height += Type->Returns.size();
+    Code.emplace_back(Instr.getOpCode());
+    if (Instr.getOpCode() == OpCode::Call) {
+      Code.back().Index = Instr.getFuncIndex();
+    } else {
+      Code.back().Index = *ModInst.getFuncTypeId(Instr.getFuncIndex());
+    }
+    beginBlock();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::ParametricInstruction &Instr) {
+    pop((Instr.getOpCode() == OpCode::Drop) ? 1 : 2);
+    Code.emplace_back(Instr.getOpCode());
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::VariableInstruction &Instr) {
+    switch (Instr.getOpCode()) {
+    case OpCode::Local__get:
+    case OpCode::Global__get:
+      Height++;
+      break;
+    case OpCode::Local__set:
+    case OpCode::Global__set:
+      pop(1);
+      break;
+    default:
+      break;
+    }
+    Code.emplace_back(Instr.getOpCode());
+    Code.back().Index = Instr.getVariableIndex();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::MemoryInstruction &Instr) {
+    const OpCode Op = Instr.getOpCode();
+    if (Op == OpCode::Memory__size) {
+      Height++;
+    } else if (Op >= OpCode::I32__store && Op <= OpCode::I64__store32) {
+      pop(2);
+    }
+    Code.emplace_back(Op);
+    Code.back().Index = Instr.getMemoryOffset();
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::ConstInstruction &Instr) {
+    const ValVariant Val = Instr.getConstValue();
+    Height++;
+    Code.emplace_back(Instr.getOpCode());
+    std::memcpy(&Code.back().Num, &Val, sizeof(Code.back().Num));
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::UnaryNumericInstruction &Instr) {
+    Code.emplace_back(Instr.getOpCode());
+    return {};
+  }
+
+  Expect<void> lowerInstr(const AST::BinaryNumericInstruction &Instr) {
+    pop(1);
+    Code.emplace_back(Instr.getOpCode());
+    return {};
+  }
+
+  /// Emit branch to the label with depth.
+  void emitBranch(const OpCode Op, const uint32_t Depth, const uint8_t Flags) {
+    Label &L = Labels[Labels.size() - Depth - 1];
+    const uint32_t Pos = Code.size();
+    Code.emplace_back(Op, Flags);
+    Code.back().Arity = L.Arity;
+    Code.back().Height = L.Height;
+    if (L.IsLoop) {
+      /// Backward offset is stored in two's complement.
+      Code.back().Index = L.Start - Pos;
+    } else {
+      L.Fixups.push_back(Pos);
+    }
+  }
+
+  /// Resolve forward branches of label to current position.
+  void patchLabel(const Label &L) {
+    for (const uint32_t Pos : L.Fixups) {
+      Code[Pos].Index = Code.size() - Pos;
+    }
+  }
+
+  /// Leave the top block and restore the height after block.
+  void endBlock() {
+    patchLabel(Labels.back());
+    Height = Labels.back().Height + Labels.back().Results;
+    /// Block end is a branch target only if any forward branch exists.
+    if (!Labels.back().Fixups.empty()) {
+      beginBlock();
+    }
+    Labels.pop_back();
+  }
+
+  /// Start a basic block by emitting the metering entry. Entering a
+  /// statement costs extra.
+  void beginBlock(const bool Entering = false) {
+    if (Measure) {
+      Meter = Code.size();
+      Code.emplace_back(OpCode::Nop, FlatInstr::Internal | FlatInstr::Meter);
+      Code.back().Arity = Measure->getCostTableId();
+      if (Entering) {
+        Code.back().Flags |= FlatInstr::Enter;
+        Code.back().Num = Measure->getInstrCost(OpCode::Else);
+      }
+    }
+  }
+
+  /// Count the instruction and add its cost into the current basic block.
+  void charge(const OpCode Op) {
+    if (Measure) {
+      Code[Meter].Index++;
+      Code[Meter].Num += Measure->getInstrCost(Op);
+    }
+  }
+
+  /// Entering the non-empty statement of if instruction costs extra.
+  bool isEntering(const AST::InstrVec &Statement) const {
+#ifndef ONNC_WASM
+    return !Statement.empty();
+#else
+    return false;
+#endif
+  }
+
+  /// Rest instructions of the block are unreachable. Heights of them are not
+  /// used by reachable branches, so only reset the height to block entry.
+  void setUnreachable() { Height = Labels.back().Height; }
+
+  /// Pop values. Saturate for the polymorphic stack in unreachable code.
+  void pop(const uint32_t Cnt) { Height = (Height > Cnt) ? Height - Cnt : 0; }
+
+  Runtime::StoreManager &StoreMgr;
+  const Runtime::Instance::ModuleInstance &ModInst;
+  const Support::Measurement *Measure;
+  FlatCode Code;
+  std::vector<Label> Labels;
+  uint32_t Height = 0;
+  /// Position of the metering entry of the current basic block.
+  uint32_t Meter = 0;
+};
+
+} // namespace
+
+/// Lower function body. See "include/interpreter/interpreter.h".
+Expect<FlatCode> Interpreter::lowerFunction(
+    Runtime::StoreManager &StoreMgr,
+    const Runtime::Instance::ModuleInstance &ModInst,
+    const Runtime::Instance::FunctionInstance &FuncInst) const {
+  return FlatLowering(StoreMgr, ModInst, Measure).lower(FuncInst);
+}
+
+} // namespace Interpreter
+} // namespace SSVM
@@ -17,7 +17,7 @@ const AST::Instruction *InstrProvider::getNextInstr() {
   }
 
   /// Get instruction.
-  const AST::Instruction *Instr = (*Iters.back().Curr).get();
+  const AST::Instruction *Instr = *Iters.back().Curr;
   (Iters.back().Curr)++;
   return Instr;
 }
@@ -32,5 +32,14 @@ Expect<void> InstrProvider::popInstrs() {
   return {};
 }
 
+/// Pop instruction sequences of function. See
+/// "include/interpreter/engine/provider.h".
+void InstrProvider::popFunction() {
+  while (Iters.back().Type != SeqType::FunctionCall) {
+    Iters.pop_back();
+  }
+  Iters.pop_back();
+}
+
 } // namespace Interpreter
 } // namespace SSVM
@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "interpreter/interpreter.h"
+#include "runtime/instance/function.h"
+#include "runtime/instance/memory.h"
+#include "runtime/instance/module.h"
+#include "runtime/instance/table.h"
+
+namespace SSVM {
+namespace Interpreter {
+
+/// Stop lowering in background. See "include/interpreter/interpreter.h".
+void Interpreter::stopTierUp() {
+  {
+    std::lock_guard<std::mutex> Lock(TierUpMutex);
+    TierUpStopping = true;
+  }
+  TierUpCond.notify_all();
+  if (TierUpWorker.joinable()) {
+    TierUpWorker.join();
+  }
+  std::lock_guard<std::mutex> Lock(TierUpMutex);
+  /// Dropped functions are counted again from zero to be requested again.
+  for (const auto *Func : TierUpQueue) {
+    Func->resetHotness();
+  }
+  TierUpQueue.clear();
+  TierUpStore = nullptr;
+  TierUpStopping = false;
+}
+
+void Interpreter::countTierUp(
+    const Runtime::Instance::FunctionInstance &Func) {
+  if (!Func.countHotness(TierUpThreshold) || Func.getTieredCode() != nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> Lock(TierUpMutex);
+  if (TierUpStore == nullptr) {
+    Func.resetHotness();
+    return;
+  }
+  TierUpQueue.push_back(&Func);
+  if (!TierUpWorker.joinable()) {
+    TierUpWorker = std::thread(&Interpreter::runTierUpWorker, this);
+  }
+  TierUpCond.notify_one();
+}
+
+Expect<void> Interpreter::executeTiered(Runtime::StoreManager &StoreMgr,
+                                        const Runtime::FlatInstr *PC,
+                                        const uint32_t Depth) {
+  /// Calls from flat code to the AST tier recorded by outer loops are left.
+  const size_t BaseCalls = TierASTCalls.size();
+  while (true) {
+    if (PC != nullptr) {
+      /// Run flat code until it returns or calls a function in the AST tier.
+      if (auto Res = executeFlat(StoreMgr, PC); !Res) {
+        return Unexpect(Res);
+      }
+      if (InstrPdr.getScopeSize() == Depth) {
+        /// Returned from the entered function.
+        return {};
+      }
+    }
+
+    /// Walk AST until the function called from flat code returns, or a
+    /// function in the flat code tier is called. Faults in the AST tier are
+    /// charged by instructions, not refunded.
+    FlatFaultPC = nullptr;
+    const uint32_t ASTDepth =
+        TierASTCalls.size() > BaseCalls ? TierASTCalls.back().first : Depth;
+    if (auto Res = execute(StoreMgr, ASTDepth); !Res) {
+      return Unexpect(Res);
+    }
+    if (TierFlatPC != nullptr) {
+      PC = TierFlatPC;
+      TierFlatPC = nullptr;
+    } else if (TierASTCalls.size() > BaseCalls) {
+      PC = TierASTCalls.back().second;
+      TierASTCalls.pop_back();
+    } else {
+      /// Returned from the entered function.
+      return {};
+    }
+  }
+}
+
+void Interpreter::runTierUpWorker() {
+  std::unique_lock<std::mutex> Lock(TierUpMutex);
+  while (true) {
+    TierUpCond.wait(Lock,
+                    [this]() { return TierUpStopping || !TierUpQueue.empty(); });
+    if (TierUpStopping) {
+      return;
+    }
+    const auto *Func = TierUpQueue.front();
+    TierUpQueue.pop_front();
+    Runtime::StoreManager &StoreMgr = *TierUpStore;
+    Lock.unlock();
+
+    /// Lowering only reads the instances, which are not changed during
+    /// execution. Failed functions stay in the AST tier. The native code is
+    /// compiled from the published flat code, and functions failed to compile
+    /// stay in the flat code tier.
+    const auto *ModInst = *StoreMgr.getModule(Func->getModuleAddr());
+    if (auto Res = lowerFunction(StoreMgr, *ModInst, *Func)) {
+      Func->setTieredCode(std::move(*Res));
+#ifdef SSVM_TIERED_JIT
+      if (auto Native = compileFunction(StoreMgr, *ModInst, *Func)) {
+        Func->setNativeCode(std::move(*Native));
+      }
+#endif
+    }
+    Lock.lock();
+  }
+}
+
+const Runtime::NativeCode *Interpreter::getNativeCode(
+    const Runtime::Instance::FunctionInstance &Func) const {
+  const auto *Code = Func.getNativeCode();
+  if (Code == nullptr || NativeDepth >= kNativeDepthLimit) {
+    return nullptr;
+  }
+  /// Native code charges the costs by the table at lowering, and does not
+  /// count instructions for profiling.
+  if (Measure == nullptr) {
+    return Code->Metered ? nullptr : Code;
+  }
+  if (!Code->Metered || Measure->getProfile() != nullptr ||
+      Code->CostTableId != Measure->getCostTableId() ||
+      Code->CostTableId == Support::Measurement::kUnknownCostTable) {
+    return nullptr;
+  }
+  return Code;
+}
+
+Expect<const Runtime::FlatInstr *> Interpreter::callNativeFunction(
+    Runtime::StoreManager &StoreMgr,
+    const Runtime::Instance::FunctionInstance &Func,
+    const Runtime::NativeCode &Code, const Runtime::FlatInstr *RetPC) {
+  const auto &FuncType = Func.getFuncType();
+  const uint32_t Params = FuncType.Params.size();
+  NativeContext &Ctx = getFrameContext(StoreMgr, Func.getModuleAddr()).Native;
+  refreshNativeContext(Ctx);
+
+  /// Arguments are read from the stack before anything is pushed.
+  const bool Stepping = FlatStepping;
+  ++NativeDepth;
+  const uint32_t Status = Code.Entry(
+      &Ctx, reinterpret_cast<const uint64_t *>(StackMgr.getTopN(Params)));
+  --NativeDepth;
+  StackMgr.popN(Params);
+  restoreFrameContext();
+  FlatFaultPC = nullptr;
+  if (Status == 0) {
+    /// Nested runs of callees may change the stepping state of caller.
+    FlatStepping = Stepping;
+    if (!FuncType.Returns.empty()) {
+      StackMgr.push(ValVariant(Ctx.Ret));
+    }
+    return RetPC;
+  }
+  if (Status != Runtime::NativeCode::kBailOut) {
+    return Unexpect(static_cast<ErrCode>(Status));
+  }
+  return resumeNativeFunction(StoreMgr, Func, RetPC);
+}
+
+const Runtime::FlatInstr *Interpreter::resumeNativeFunction(
+    Runtime::StoreManager &StoreMgr,
+    const Runtime::Instance::FunctionInstance &Func,
+    const Runtime::FlatInstr *RetPC) {
+  /// The locals and operands are the frame of flat code at the instruction,
+  /// whose basic block is already charged.
+  for (const auto &Val : NativeBailSlots) {
+    StackMgr.push(Val);
+  }
+  StackMgr.pushFrame(Func.getModuleAddr(), NativeBailSlots.size(),
+                     Func.getFuncType().Returns.size());
+  switchFrameContext(StoreMgr);
+  FlatRetStack.push_back(RetPC);
+  FlatStepping = false;
+  return Func.getFlatCode().data() + NativeBailPC;
+}
+
+uint32_t
+Interpreter::callFromNative(NativeContext &Ctx,
+                            const Runtime::Instance::FunctionInstance &Func,
+                            const uint64_t *Args, uint64_t *Ret) {
+  Runtime::StoreManager &StoreMgr = *Ctx.StoreMgr;
+  const auto &FuncType = Func.getFuncType();
+  const uint32_t Depth = InstrPdr.getScopeSize();
+  const Runtime::FlatInstr *PC = nullptr;
+  if (const auto *Code = getNativeCode(Func)) {
+    /// Calls between native code stay on the native stack.
+    NativeContext &Callee =
+        getFrameContext(StoreMgr, Func.getModuleAddr()).Native;
+    refreshNativeContext(Callee);
+    ++NativeDepth;
+    const uint32_t Status = Code->Entry(&Callee, Args);
+    --NativeDepth;
+    if (Status == 0) {
+      *Ret = Callee.Ret;
+      refreshNativeContext(Ctx);
+      return 0;
+    }
+    if (Status != Runtime::NativeCode::kBailOut) {
+      return Status;
+    }
+    PC = resumeNativeFunction(StoreMgr, Func, nullptr);
+  } else {
+    for (uint32_t I = 0; I < FuncType.Params.size(); ++I) {
+      StackMgr.push(ValVariant(Args[I]));
+    }
+    if (Func.isHostFunction()) {
+      /// Host functions access the memory of the calling module.
+      CurrCtx = Ctx.Frame;
+      auto Res = enterFunction(StoreMgr, Func);
+      restoreFrameContext();
+      if (!Res) {
+        return static_cast<uint32_t>(Res.error());
+      }
+    } else if (Func.getTieredCode() != nullptr) {
+      PC = enterFlatFunction(StoreMgr, Func, nullptr);
+    } else if (auto Res = enterFunction(StoreMgr, Func); !Res) {
+      return static_cast<uint32_t>(Res.error());
+    }
+  }
+
+  /// Run the callee in a nested loop of tiers until it returns.
+  if (!Func.isHostFunction()) {
+    if (auto Res = executeTiered(StoreMgr, PC, Depth); !Res) {
+      return static_cast<uint32_t>(Res.error());
+    }
+  }
+  if (!FuncType.Returns.empty()) {
+    *Ret = retrieveValue<uint64_t>(StackMgr.pop());
+  }
+  refreshNativeContext(Ctx);
+  return 0;
+}
+
+void Interpreter::refreshNativeContext(NativeContext &Ctx) {
+  if (const auto *MemInst = Ctx.Frame->MemInst) {
+    Ctx.MemSize = MemInst->getDataSize();
+  }
+}
+
+uint32_t Interpreter::nativeCall(NativeContext *Ctx, const uint32_t FuncIdx,
+                                 const uint64_t *Args, uint64_t *Ret) {
+  const uint32_t FuncAddr = *Ctx->Frame->ModInst->getFuncAddr(FuncIdx);
+  const auto *FuncInst = *Ctx->StoreMgr->getFunction(FuncAddr);
+  return Ctx->Interp->callFromNative(*Ctx, *FuncInst, Args, Ret);
+}
+
+uint32_t Interpreter::nativeCallIndirect(NativeContext *Ctx,
+                                         const uint32_t TypeId,
+                                         const uint32_t Idx,
+                                         const uint64_t *Args, uint64_t *Ret) {
+  /// Trapping calls are bailed out to trap in flat code.
+  auto Elem = Ctx->Frame->TabInst->getElem(Idx);
+  if (!Elem || (*Elem)->TypeId != TypeId) {
+    return Runtime::NativeCode::kBailOut;
+  }
+  const auto *FuncInst = *Ctx->StoreMgr->getFunction((*Elem)->Addr);
+  return Ctx->Interp->callFromNative(*Ctx, *FuncInst, Args, Ret);
+}
+
+uint32_t Interpreter::nativeMemoryGrow(NativeContext *Ctx,
+                                       const uint32_t Count) {
+  auto &MemInst = *Ctx->Frame->MemInst;
+  const uint32_t CurrPageSize = MemInst.getDataPageSize();
+  const bool Grown = static_cast<bool>(MemInst.growPage(Count));
+  refreshNativeContext(*Ctx);
+  return Grown ? CurrPageSize : UINT32_C(-1);
+}
+
+void Interpreter::nativeBailOut(NativeContext *Ctx, const uint64_t *Slots,
+                                const uint32_t PC, const uint32_t Height) {
+  Interpreter &Interp = *Ctx->Interp;
+  Interp.NativeBailSlots.assign(Slots, Slots + Height);
+  Interp.NativeBailPC = PC;
+}
+
+} // namespace Interpreter
+} // namespace SSVM
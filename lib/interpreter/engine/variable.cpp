@@ -27,17 +27,13 @@ Expect<void> Interpreter::runLocalTeeOp(const uint32_t Idx) {
   return {};
 }
 
-Expect<void> Interpreter::runGlobalGetOp(Runtime::StoreManager &StoreMgr,
-                                         const uint32_t Idx) {
-  auto *GlobInst = getGlobInstByIdx(StoreMgr, Idx);
-  StackMgr.push(GlobInst->getValue());
+Expect<void> Interpreter::runGlobalGetOp(const uint32_t Idx) {
+  StackMgr.push(CurrCtx->GlobInsts[Idx]->getValue());
   return {};
 }
 
-Expect<void> Interpreter::runGlobalSetOp(Runtime::StoreManager &StoreMgr,
-                                         const uint32_t Idx) {
-  auto *GlobInst = getGlobInstByIdx(StoreMgr, Idx);
-  GlobInst->getValue() = StackMgr.pop();
+Expect<void> Interpreter::runGlobalSetOp(const uint32_t Idx) {
+  CurrCtx->GlobInsts[Idx]->getValue() = StackMgr.pop();
   return {};
 }
 
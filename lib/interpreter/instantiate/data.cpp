@@ -28,7 +28,7 @@ Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
     auto *MemInst = *StoreMgr.getMemory(MemAddr);
 
     /// Copy data to memory instance
-    const auto &Data = DataSeg->getData();
+    const auto Data = DataSeg->getData();
     if (auto Res = MemInst->setBytes(Data, Offset, 0, Data.size()); !Res) {
       return Unexpect(Res);
     }
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "common/ast/section.h"
 #include "interpreter/interpreter.h"
+#include "runtime/instance/function.h"
 #include "runtime/instance/module.h"
 #include "runtime/instance/table.h"
 
@@ -27,13 +28,16 @@ Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
     uint32_t TabAddr = *ModInst.getTableAddr(ElemSeg->getIdx());
     auto *TabInst = *StoreMgr.getTable(TabAddr);
 
-    /// Transfer function index to address and copy data to table instance
-    auto FuncIdxList = ElemSeg->getFuncIdxes();
-    for (auto &Idx : FuncIdxList) {
-      uint32_t FuncAddr = *ModInst.getFuncAddr(Idx);
-      Idx = FuncAddr;
+    /// Transfer function index to address with function type ID and copy
+    /// data to table instance
+    std::vector<Runtime::Instance::TableInstance::FuncElem> Elems;
+    Elems.reserve(ElemSeg->getFuncIdxes().size());
+    for (const auto Idx : ElemSeg->getFuncIdxes()) {
+      const uint32_t FuncAddr = *ModInst.getFuncAddr(Idx);
+      const auto *FuncInst = *StoreMgr.getFunction(FuncAddr);
+      Elems.push_back({FuncAddr, FuncInst->getFuncTypeId()});
     }
-    if (auto Res = TabInst->setInitList(Offset, FuncIdxList); !Res) {
+    if (auto Res = TabInst->setInitList(Offset, Elems); !Res) {
       return Unexpect(Res);
     }
   }
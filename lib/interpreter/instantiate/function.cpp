@@ -10,19 +10,21 @@ namespace Interpreter {
 /// Instantiate function instance. See "include/interpreter/interpreter.h".
 Expect<void> Interpreter::instantiate(
     Runtime::StoreManager &StoreMgr, Runtime::Instance::ModuleInstance &ModInst,
-    const AST::FunctionSection &FuncSec, const AST::CodeSection &CodeSec) {
+    const AST::FunctionSection &FuncSec, const AST::CodeSection &CodeSec,
+    const std::shared_ptr<const AST::Module> &Owner) {
 
   /// Get the function type indices.
   auto &TypeIdxs = FuncSec.getContent();
   auto &CodeSegs = CodeSec.getContent();
 
-  /// Iterate through code segments to make function instances.
+  /// Iterate through code segments to make function instances. The code is
+  /// shared with the module instead of copied.
   for (uint32_t I = 0; I < CodeSegs.size(); ++I) {
-    /// Make a new function instance.
+    /// Make a new function instance with the type ID interned by module.
     auto *FuncType = *ModInst.getFuncType(TypeIdxs[I]);
     auto NewFuncInst = std::make_unique<Runtime::Instance::FunctionInstance>(
-        ModInst.Addr, *FuncType, CodeSegs[I]->getLocals(),
-        CodeSegs[I]->getInstrs());
+        ModInst.Addr, *FuncType, *ModInst.getFuncTypeId(TypeIdxs[I]),
+        *CodeSegs[I], Owner);
 
     /// Insert function instance to store manager.
     uint32_t NewFuncInstAddr;
@@ -33,6 +35,21 @@ Expect<void> Interpreter::instantiate(
     }
     ModInst.addFuncAddr(NewFuncInstAddr);
   }
+
+  /// Lower function bodies after all function addresses are resolved. Lazily
+  /// loaded function bodies are lowered on first call.
+  if (Engine == EngineKind::Flat && !CodeSec.isLazy()) {
+    const uint32_t ImportNum = ModInst.getFuncNum() - CodeSegs.size();
+    for (uint32_t I = 0; I < CodeSegs.size(); ++I) {
+      const uint32_t FuncAddr = *ModInst.getFuncAddr(ImportNum + I);
+      auto *FuncInst = *StoreMgr.getFunction(FuncAddr);
+      if (auto Res = lowerFunction(StoreMgr, ModInst, *FuncInst)) {
+        FuncInst->setFlatCode(std::move(*Res));
+      } else {
+        return Unexpect(Res);
+      }
+    }
+  }
   return {};
 }
 
@@ -23,6 +23,7 @@ Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
 
   /// Push a new frame {TmpModInst:{globaddrs}, locals:none}
   StackMgr.pushFrame(TmpModInstAddr, 0, 0);
+  switchFrameContext(StoreMgr);
 
   /// Instantiate and initialize globals.
   for (const auto &GlobSeg : GlobSec.getContent()) {
@@ -51,9 +52,11 @@ Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
 
   /// Stack is ensured in validation phase.
   StackMgr.popFrame();
+  restoreFrameContext();
 
-  /// Pop the added temp. module.
+  /// Pop the added temp. module and its context.
   StoreMgr.popModule();
+  resetFrameContexts();
   return {};
 }
 
@@ -8,19 +8,23 @@ namespace SSVM {
 namespace Interpreter {
 
 /// Instantiate module instance. See "include/executor/Interpreter.h".
-Expect<void> Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
-                                      const AST::Module &Mod,
-                                      const std::string &Name) {
+Expect<void>
+Interpreter::instantiate(Runtime::StoreManager &StoreMgr, const AST::Module &Mod,
+                         const std::string &Name,
+                         const std::shared_ptr<const AST::Module> &Owner) {
   /// Check is module name duplicated.
   if (auto Res = StoreMgr.findModule(Name)) {
     return Unexpect(ErrCode::ModuleNameConflict);
   }
   auto NewModInst = std::make_unique<Runtime::Instance::ModuleInstance>(Name);
+  NewModInst->setHash(Mod.getHash());
 
   /// Reset store manager, stack manager, and instruction provider.
   StoreMgr.reset();
   StackMgr.reset();
   InstrPdr.reset();
+  FlatRetStack.clear();
+  resetFrameContexts();
 
   /// Insert the module instance to store manager and retieve instance.
   uint32_t ModInstAddr;
@@ -54,7 +58,8 @@ Expect<void> Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
   const AST::FunctionSection *FuncSec = Mod.getFunctionSection();
   const AST::CodeSection *CodeSec = Mod.getCodeSection();
   if (FuncSec != nullptr && CodeSec != nullptr) {
-    if (auto Res = instantiate(StoreMgr, *ModInst, *FuncSec, *CodeSec); !Res) {
+    if (auto Res = instantiate(StoreMgr, *ModInst, *FuncSec, *CodeSec, Owner);
+        !Res) {
       return Unexpect(Res);
     }
   }
@@ -89,6 +94,7 @@ Expect<void> Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
                      0,             /// Arity
                      0              /// Coarity
   );
+  switchFrameContext(StoreMgr);
 
   /// Instantiate initialization of table instances (ElemSec)
   const AST::ElementSection *ElemSec = Mod.getElementSection();
@@ -108,6 +114,7 @@ Expect<void> Interpreter::instantiate(Runtime::StoreManager &StoreMgr,
 
   /// Pop Frame.
   StackMgr.popFrame();
+  restoreFrameContext();
 
   /// Instantiate ExportSection (ExportSec)
   const AST::ExportSection *ExportSec = Mod.getExportSection();
@@ -12,18 +12,33 @@
 namespace SSVM {
 namespace Interpreter {
 
-/// Instantiate Wasm Module. See "include/interpreter/interpreter.h".
-Expect<void> Interpreter::instantiateModule(Runtime::StoreManager &StoreMgr,
-                                            const AST::Module &Mod,
-                                            const std::string &Name) {
+/// Instantiate shared Wasm Module. See "include/interpreter/interpreter.h".
+Expect<void>
+Interpreter::instantiateModule(Runtime::StoreManager &StoreMgr,
+                               std::shared_ptr<const AST::Module> Mod,
+                               const std::string &Name) {
+  stopTierUp();
   InsMode = InstantiateMode::Instantiate;
-  return instantiate(StoreMgr, Mod, Name);
+  return instantiate(StoreMgr, *Mod, Name, Mod);
+}
+
+/// Fork Wasm Module from template. See "include/interpreter/interpreter.h".
+Expect<void> Interpreter::forkModule(Runtime::StoreManager &StoreMgr,
+                                     const Runtime::StoreTemplate &Tmpl) {
+  stopTierUp();
+  StackMgr.reset();
+  InstrPdr.reset();
+  FlatRetStack.clear();
+  resetFrameContexts();
+  return StoreMgr.fork(Tmpl);
 }
 
 /// Register host module. See "include/interpreter/interpreter.h".
 Expect<void> Interpreter::registerModule(Runtime::StoreManager &StoreMgr,
                                          const Runtime::ImportObject &Obj) {
+  stopTierUp();
   StoreMgr.reset();
+  resetFrameContexts();
   /// Check is module name duplicated.
   if (auto Res = StoreMgr.findModule(Obj.getModuleName())) {
     return Unexpect(ErrCode::ModuleNameConflict);
@@ -56,12 +71,13 @@ Expect<void> Interpreter::registerModule(Runtime::StoreManager &StoreMgr,
   return {};
 }
 
-/// Register Wasm module. See "include/interpreter/interpreter.h".
+/// Register shared Wasm module. See "include/interpreter/interpreter.h".
 Expect<void> Interpreter::registerModule(Runtime::StoreManager &StoreMgr,
-                                         const AST::Module &Mod,
-                                         const std::string &Name = "") {
+                                         std::shared_ptr<const AST::Module> Mod,
+                                         const std::string &Name) {
+  stopTierUp();
   InsMode = InstantiateMode::ImportWasm;
-  return instantiate(StoreMgr, Mod, Name);
+  return instantiate(StoreMgr, *Mod, Name, Mod);
 }
 
 /// Invoke function. See "include/interpreter/interpreter.h".
@@ -84,6 +100,13 @@ Interpreter::invoke(Runtime::StoreManager &StoreMgr, const std::string &Name,
   /// Push arguments.
   InstrPdr.reset();
   StackMgr.reset();
+  FlatRetStack.clear();
+  TierFuncStack.clear();
+  resetFrameContexts();
+  if (Engine == EngineKind::Tiered) {
+    std::lock_guard<std::mutex> Lock(TierUpMutex);
+    TierUpStore = &StoreMgr;
+  }
   for (auto &Val : Params) {
     StackMgr.push(Val);
   }
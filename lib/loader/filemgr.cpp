@@ -2,7 +2,13 @@
 #include "loader/filemgr.h"
 
 #include <algorithm>
+#include <cstring>
+#include <fcntl.h>
 #include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
 
 namespace SSVM {
 
@@ -211,6 +217,12 @@ Expect<std::string> FileMgrFStream::readName() {
   return Str;
 }
 
+/// Get offset of file stream. See "include/loader/filemgr.h".
+uint64_t FileMgrFStream::getOffset() {
+  const auto Pos = Fin.tellg();
+  return Pos < 0 ? 0 : static_cast<uint64_t>(Pos);
+}
+
 /// Set code data. See "include/loader/filemgr.h".
 Expect<void> FileMgrVector::setCode(const std::vector<uint8_t> &CodeData) {
   Code = CodeData;
@@ -376,4 +388,250 @@ Expect<std::string> FileMgrVector::readName() {
   return Str;
 }
 
+/// Map file into memory. See "include/loader/filemgr.h".
+Expect<void> FileMgrMap::setPath(const std::string &FilePath) {
+  setBuffer(nullptr, 0, nullptr);
+  Status = ErrCode::InvalidPath;
+  const int FD = open(FilePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (FD < 0) {
+    return Unexpect(Status);
+  }
+  struct stat Stat;
+  if (fstat(FD, &Stat) != 0 || !S_ISREG(Stat.st_mode)) {
+    close(FD);
+    return Unexpect(Status);
+  }
+
+  /// Empty file can not be mapped. Reading from it reaches end of file.
+  const size_t Length = static_cast<size_t>(Stat.st_size);
+  if (Length == 0) {
+    close(FD);
+    setBuffer(nullptr, 0, nullptr);
+    return {};
+  }
+  void *Ptr = mmap(nullptr, Length, PROT_READ, MAP_PRIVATE, FD, 0);
+  if (Ptr == MAP_FAILED) {
+    close(FD);
+    Status = ErrCode::ReadError;
+    return Unexpect(Status);
+  }
+  std::shared_ptr<const void> Mapping(
+      Ptr, [Length](const void *P) { munmap(const_cast<void *>(P), Length); });
+
+  /// Pages out of the file size fault when read, so the file must not be
+  /// changed during mapping.
+  struct stat MappedStat;
+  if (fstat(FD, &MappedStat) != 0 || MappedStat.st_size != Stat.st_size ||
+      MappedStat.st_mtim.tv_sec != Stat.st_mtim.tv_sec ||
+      MappedStat.st_mtim.tv_nsec != Stat.st_mtim.tv_nsec) {
+    close(FD);
+    Status = ErrCode::ReadError;
+    return Unexpect(Status);
+  }
+  madvise(Ptr, Length, MADV_SEQUENTIAL);
+  setBuffer(static_cast<const Byte *>(Ptr), Length, std::move(Mapping));
+  SourceFd = FD;
+  SourceMTime = Stat.st_mtim;
+  Copies = std::make_shared<Support::Arena>();
+  return {};
+}
+
+/// Check the mapped file. See "include/loader/filemgr.h".
+Expect<void> FileMgrMap::checkSource() const {
+  if (SourceFd < 0) {
+    return {};
+  }
+  struct stat Stat;
+  if (fstat(SourceFd, &Stat) != 0 ||
+      static_cast<size_t>(Stat.st_size) != Size ||
+      Stat.st_mtim.tv_sec != SourceMTime.tv_sec ||
+      Stat.st_mtim.tv_nsec != SourceMTime.tv_nsec) {
+    return Unexpect(ErrCode::ReadError);
+  }
+  return {};
+}
+
+/// Close the mapped file. See "include/loader/filemgr.h".
+void FileMgrMap::closeSource() noexcept {
+  if (SourceFd >= 0) {
+    close(SourceFd);
+    SourceFd = -1;
+  }
+  Copies.reset();
+}
+
+/// Set code data by copying. See "include/loader/filemgr.h".
+Expect<void> FileMgrMap::setCode(const Bytes &CodeData) {
+  auto Buf = std::make_shared<const Bytes>(CodeData);
+  const Byte *Ptr = Buf->data();
+  const size_t Length = Buf->size();
+  setBuffer(Ptr, Length, std::move(Buf));
+  if (Size == 0) {
+    Status = ErrCode::EndOfFile;
+    return Unexpect(Status);
+  }
+  return {};
+}
+
+/// Set code data without copying. See "include/loader/filemgr.h".
+Expect<void> FileMgrMap::setCode(Span<const Byte> CodeData) {
+  setBuffer(CodeData.data(), CodeData.size(), nullptr);
+  if (Size == 0) {
+    Status = ErrCode::EndOfFile;
+    return Unexpect(Status);
+  }
+  return {};
+}
+
+/// Reset the input buffer. See "include/loader/filemgr.h".
+void FileMgrMap::setBuffer(const Byte *Ptr, size_t Length,
+                           std::shared_ptr<const void> BufOwner) {
+  closeSource();
+  Data = Ptr;
+  Size = Length;
+  Pos = 0;
+  Owner = std::move(BufOwner);
+  Status = ErrCode::Success;
+}
+
+/// Read one byte. See "include/loader/filemgr.h".
+Expect<Byte> FileMgrMap::readByte() {
+  if (!checkRemain(1)) {
+    return Unexpect(Status);
+  }
+  return Data[Pos++];
+}
+
+/// Read number of bytes. See "include/loader/filemgr.h".
+Expect<Bytes> FileMgrMap::readBytes(size_t SizeToRead) {
+  if (!checkRemain(SizeToRead)) {
+    return Unexpect(Status);
+  }
+  Bytes Buf(Data + Pos, Data + Pos + SizeToRead);
+  Pos += SizeToRead;
+  return Buf;
+}
+
+/// Read number of bytes as a view. See "include/loader/filemgr.h".
+Expect<Span<const Byte>>
+FileMgrMap::readSpan(size_t SizeToRead,
+                     std::shared_ptr<const void> &SpanOwner) {
+  if (!checkRemain(SizeToRead)) {
+    return Unexpect(Status);
+  }
+  Span<const Byte> View(Data + Pos, SizeToRead);
+  if (Copies) {
+    /// Spans kept out of loading never reference the file mapping.
+    View = Copies->copy(Data + Pos, SizeToRead);
+    SpanOwner = Copies;
+  } else {
+    SpanOwner = Owner;
+  }
+  Pos += SizeToRead;
+  return View;
+}
+
+/// Read number of bytes as a view. See "include/loader/filemgr.h".
+Expect<Span<const Byte>> FileMgrMap::readView(size_t SizeToRead) {
+  if (!checkRemain(SizeToRead)) {
+    return Unexpect(Status);
+  }
+  Span<const Byte> View(Data + Pos, SizeToRead);
+  Pos += SizeToRead;
+  return View;
+}
+
+/// Decode LEB128 encoded integer. See "include/loader/filemgr.h".
+template <typename T, bool IsSigned> Expect<T> FileMgrMap::readLEB128() {
+  using UT = std::make_unsigned_t<T>;
+  constexpr const uint32_t Bits = sizeof(T) * 8;
+  constexpr const size_t MaxBytes = (Bits + 6) / 7;
+
+  /// Fast path: most of indices and sizes are encoded in one byte.
+  if (Pos < Size && Data[Pos] < 0x80U) {
+    const Byte B = Data[Pos++];
+    if constexpr (IsSigned) {
+      return static_cast<T>(static_cast<int8_t>(B << 1) >> 1);
+    } else {
+      return static_cast<T>(B);
+    }
+  }
+
+  /// Only one bound check for the whole encoding.
+  const Byte *Ptr = Data + Pos;
+  const size_t Avail = std::min(Size - Pos, MaxBytes);
+  UT Result = 0;
+  uint32_t Offset = 0;
+  for (size_t I = 0; I < Avail; ++I) {
+    const Byte B = Ptr[I];
+    Result |= static_cast<UT>(B & 0x7FU) << Offset;
+    Offset += 7;
+    if ((B & 0x80U) == 0) {
+      if constexpr (IsSigned) {
+        if ((B & 0x40U) && Offset < Bits) {
+          Result |= ~static_cast<UT>(0) << Offset;
+        }
+      }
+      Pos += I + 1;
+      return static_cast<T>(Result);
+    }
+  }
+  if (Avail == MaxBytes) {
+    /// Encoding is longer than the integer type.
+    Status = ErrCode::InvalidGrammar;
+  } else {
+    Pos = Size;
+    Status = ErrCode::EndOfFile;
+  }
+  return Unexpect(Status);
+}
+
+/// Decode and read an unsigned int. See "include/loader/filemgr.h".
+Expect<uint32_t> FileMgrMap::readU32() { return readLEB128<uint32_t, false>(); }
+
+/// Decode and read an unsigned long long int. See "include/loader/filemgr.h".
+Expect<uint64_t> FileMgrMap::readU64() { return readLEB128<uint64_t, false>(); }
+
+/// Decode and read a signed int. See "include/loader/filemgr.h".
+Expect<int32_t> FileMgrMap::readS32() { return readLEB128<int32_t, true>(); }
+
+/// Decode and read a signed long long int. See "include/loader/filemgr.h".
+Expect<int64_t> FileMgrMap::readS64() { return readLEB128<int64_t, true>(); }
+
+/// Copy bytes to a float. See "include/loader/filemgr.h".
+Expect<float> FileMgrMap::readF32() {
+  if (!checkRemain(4)) {
+    return Unexpect(Status);
+  }
+  float Val;
+  std::memcpy(&Val, Data + Pos, 4);
+  Pos += 4;
+  return Val;
+}
+
+/// Copy bytes to a double. See "include/loader/filemgr.h".
+Expect<double> FileMgrMap::readF64() {
+  if (!checkRemain(8)) {
+    return Unexpect(Status);
+  }
+  double Val;
+  std::memcpy(&Val, Data + Pos, 8);
+  Pos += 8;
+  return Val;
+}
+
+/// Read a vector of bytes. See "include/loader/filemgr.h".
+Expect<std::string> FileMgrMap::readName() {
+  Expect<uint32_t> Length = readU32();
+  if (!Length) {
+    return Unexpect(Length);
+  }
+  if (!checkRemain(*Length)) {
+    return Unexpect(Status);
+  }
+  std::string Str(reinterpret_cast<const char *>(Data + Pos), *Length);
+  Pos += *Length;
+  return Str;
+}
+
 } // namespace SSVM
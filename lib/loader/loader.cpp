@@ -7,29 +7,50 @@ namespace Loader {
 /// Parse module from file path. See "include/loader/loader.h".
 Expect<std::unique_ptr<AST::Module>>
 Loader::parseModule(const std::string &FilePath) {
-  auto Mod = std::make_unique<AST::Module>();
-  if (auto Res = FSMgr.setPath(FilePath); !Res) {
-    return Unexpect(Res);
-  }
-  if (auto Res = Mod->loadBinary(FSMgr)) {
-    return std::move(Mod);
-  } else {
+  if (auto Res = FMgr.setPath(FilePath); !Res) {
     return Unexpect(Res);
   }
+  return parseModule(FMgr);
 }
 
 /// Parse module from byte code. See "include/loader/loader.h".
 Expect<std::unique_ptr<AST::Module>>
 Loader::parseModule(const std::vector<uint8_t> &Code) {
-  auto Mod = std::make_unique<AST::Module>();
-  if (auto Res = FVMgr.setCode(Code); !Res) {
+  if (auto Res = FMgr.setCode(Code); !Res) {
+    return Unexpect(Res);
+  }
+  return parseModule(FMgr);
+}
+
+/// Parse module from byte code view. See "include/loader/loader.h".
+Expect<std::unique_ptr<AST::Module>>
+Loader::parseModule(Span<const Byte> Code) {
+  if (auto Res = FMgr.setCode(Code); !Res) {
     return Unexpect(Res);
   }
-  if (auto Res = Mod->loadBinary(FVMgr)) {
-    return std::move(Mod);
-  } else {
+  return parseModule(FMgr);
+}
+
+/// Parse module from the file manager. See "include/loader/loader.h".
+Expect<std::unique_ptr<AST::Module>> Loader::parseModule(FileMgr &Mgr) {
+  auto Mod = std::make_unique<AST::Module>();
+  Mod->setThreadCount(ThreadCount);
+  Mod->setLazyFunctionBody(LazyFunctionBody);
+  auto Res = Mod->loadBinary(Mgr);
+  if (Res) {
+    /// Bytes read from a file changed during loading are not trusted.
+    Res = FMgr.checkSource();
+  }
+  if (Res && ModuleHash) {
+    Mod->setHash(FMgr.getDigest());
+  }
+  /// Release the input held by file manager. Parsed nodes keep their own
+  /// references to byte buffers, or copies out of file mappings.
+  FMgr.clearBuffer();
+  if (!Res) {
     return Unexpect(Res);
   }
+  return std::move(Mod);
 }
 
 } // namespace Loader
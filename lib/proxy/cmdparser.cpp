@@ -10,7 +10,11 @@ void CmdParser::printHelperMsg() {
   std::cout << "Usage:\n"
             << "  --input_file=<path-of-input-JSON-file>\n"
             << "  --output_file=<path-of-output-JSON-file>\n"
-            << "  --wasm_file=<path-of-wasm-file>\n";
+            << "  --wasm_file=<path-of-wasm-file>\n"
+            << "  --socket=<path-of-unix-socket-to-serve-as-daemon>\n"
+            << "  --workers=<count-of-daemon-workers>\n"
+            << "  --wasm_root=<directory-of-wasm-and-snapshot-files-of-daemon-"
+               "requests>\n";
 }
 
 void CmdParser::parseCommandLine(int Argc, const char *const *Argv) {
@@ -31,6 +35,21 @@ void CmdParser::parseCommandLine(int Argc, const char *const *Argv) {
     if (S.rfind("--wasm_file=") == 0) {
       WasmPath = S.substr(12);
     }
+
+    // Get the Unix domain socket path of daemon mode.
+    if (S.rfind("--socket=") == 0) {
+      SocketPath = S.substr(9);
+    }
+
+    // Get the worker count of daemon mode.
+    if (S.rfind("--workers=") == 0) {
+      WorkerCount = static_cast<uint32_t>(std::stoul(S.substr(10)));
+    }
+
+    // Get the directory of wasm files requested in daemon mode.
+    if (S.rfind("--wasm_root=") == 0) {
+      WasmRoot = S.substr(12);
+    }
   }
 }
 
@@ -0,0 +1,442 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "proxy/daemon.h"
+#include "proxy/proxy.h"
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "support/log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace SSVM {
+namespace Proxy {
+
+namespace {
+
+/// Timeout of connections idle in the middle of a request frame.
+static const constexpr uint32_t kReadTimeoutSec = 5;
+/// Timeout of writing a response to a connection not reading it.
+static const constexpr uint32_t kWriteTimeoutSec = 5;
+/// Bytes received from a connection at once.
+static const constexpr size_t kReadChunkSize = 65536;
+
+/// Write all data to the non-blocking socket. Closed peers fail the write
+/// instead of raising SIGPIPE.
+bool writeAll(const int Fd, const char *Buf, size_t Len) {
+  while (Len > 0) {
+    const ssize_t Ret = ::send(Fd, Buf, Len, MSG_NOSIGNAL);
+    if (Ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (Ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd PollFd{Fd, POLLOUT, 0};
+      if (::poll(&PollFd, 1, kWriteTimeoutSec * 1000) > 0) {
+        continue;
+      }
+      return false;
+    }
+    if (Ret <= 0) {
+      return false;
+    }
+    Buf += Ret;
+    Len -= static_cast<size_t>(Ret);
+  }
+  return true;
+}
+
+bool writeFrame(const int Fd, const std::string &Payload) {
+  const uint32_t Len = static_cast<uint32_t>(Payload.size());
+  const uint8_t Header[4] = {uint8_t(Len >> 24), uint8_t(Len >> 16),
+                             uint8_t(Len >> 8), uint8_t(Len)};
+  return writeAll(Fd, reinterpret_cast<const char *>(Header), 4) &&
+         writeAll(Fd, Payload.data(), Payload.size());
+}
+
+} // namespace
+
+void Daemon::LatencyStat::add(const Clock::duration D) {
+  const uint64_t Us = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(D).count());
+  ++Count;
+  TotalUs += Us;
+  MaxUs = std::max(MaxUs, Us);
+  const uint32_t Bucket =
+      Us == 0 ? 0 : std::min(31U, 64U - uint32_t(__builtin_clzll(Us)));
+  ++Buckets[Bucket];
+}
+
+uint64_t Daemon::LatencyStat::getPercentile(const double P) const {
+  /// Upper bound of the bucket containing the percentile.
+  const uint64_t Rank = static_cast<uint64_t>(P * Count);
+  uint64_t Sum = 0;
+  for (uint32_t I = 0; I < Buckets.size(); ++I) {
+    Sum += Buckets[I];
+    if (Sum > Rank) {
+      return std::min(MaxUs, UINT64_C(1) << I);
+    }
+  }
+  return MaxUs;
+}
+
+Daemon::Daemon(const std::string &Socket, const uint32_t Workers,
+               const std::string &DefaultWasm, const std::string &WasmRoot)
+    : SocketPath(Socket), DefaultWasmPath(DefaultWasm), WasmRootPath(WasmRoot),
+      WorkerCount(std::max(Workers, 1U)) {}
+
+Daemon::~Daemon() {
+  for (const int Fd : {ListenFd, WakeFds[0], WakeFds[1]}) {
+    if (Fd >= 0) {
+      ::close(Fd);
+    }
+  }
+}
+
+bool Daemon::claimSocketPath() {
+  struct stat Stat;
+  if (::lstat(SocketPath.c_str(), &Stat) != 0) {
+    return errno == ENOENT;
+  }
+  if (!S_ISSOCK(Stat.st_mode)) {
+    LOG(ERROR) << "Not a socket: " << SocketPath;
+    return false;
+  }
+
+  /// Only sockets refusing connections are stale.
+  sockaddr_un Addr{};
+  Addr.sun_family = AF_UNIX;
+  std::strcpy(Addr.sun_path, SocketPath.c_str());
+  const int Fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (Fd < 0) {
+    return false;
+  }
+  const int Ret =
+      ::connect(Fd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr));
+  const int Err = errno;
+  ::close(Fd);
+  if (Ret == 0 || Err != ECONNREFUSED) {
+    LOG(ERROR) << "Socket in use: " << SocketPath;
+    return false;
+  }
+  return ::unlink(SocketPath.c_str()) == 0;
+}
+
+bool Daemon::receive(const int Fd, Connection &Conn) {
+  while (true) {
+    const size_t Size = Conn.Buffer.size();
+    Conn.Buffer.resize(Size + kReadChunkSize);
+    const ssize_t Ret = ::recv(Fd, &Conn.Buffer[Size], kReadChunkSize, 0);
+    Conn.Buffer.resize(Size + static_cast<size_t>(std::max<ssize_t>(Ret, 0)));
+    if (Ret > 0) {
+      Conn.LastRead = Clock::now();
+      /// Stop at a whole or too long frame. The rest is read after the frame
+      /// is answered.
+      if (Conn.Buffer.size() >= 4) {
+        const auto *Header = reinterpret_cast<const uint8_t *>(&Conn.Buffer[0]);
+        const uint64_t Len =
+            uint32_t(Header[0]) << 24 | uint32_t(Header[1]) << 16 |
+            uint32_t(Header[2]) << 8 | uint32_t(Header[3]);
+        if (Len > kMaxFrameSize || Conn.Buffer.size() >= Len + 4) {
+          return true;
+        }
+      }
+      continue;
+    }
+    if (Ret < 0 && errno == EINTR) {
+      continue;
+    }
+    return Ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+}
+
+bool Daemon::dispatchFrame(const int Fd, Connection &Conn) {
+  if (Conn.Buffer.size() < 4) {
+    return true;
+  }
+  const auto *Header = reinterpret_cast<const uint8_t *>(&Conn.Buffer[0]);
+  const uint32_t Len = uint32_t(Header[0]) << 24 | uint32_t(Header[1]) << 16 |
+                       uint32_t(Header[2]) << 8 | uint32_t(Header[3]);
+  if (Len > kMaxFrameSize) {
+    return false;
+  }
+  if (Conn.Buffer.size() < Len + 4) {
+    return true;
+  }
+  Request Req{Fd, Conn.Buffer.substr(4, Len), Clock::now()};
+  Conn.Buffer.erase(0, Len + 4);
+  Conn.Busy = true;
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Queue.push_back(std::move(Req));
+  MaxQueueDepth = std::max<uint64_t>(MaxQueueDepth, Queue.size());
+  QueueCond.notify_one();
+  return true;
+}
+
+bool Daemon::run() {
+  /// Listen on the socket path.
+  sockaddr_un Addr{};
+  Addr.sun_family = AF_UNIX;
+  if (SocketPath.size() >= sizeof(Addr.sun_path)) {
+    LOG(ERROR) << "Socket path too long: " << SocketPath;
+    return false;
+  }
+  std::strcpy(Addr.sun_path, SocketPath.c_str());
+  ListenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (ListenFd < 0 || ::pipe2(WakeFds, O_CLOEXEC | O_NONBLOCK) != 0) {
+    LOG(ERROR) << "Failed to create socket: " << std::strerror(errno);
+    return false;
+  }
+  if (!claimSocketPath()) {
+    return false;
+  }
+  struct stat Stat;
+  if (::bind(ListenFd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) !=
+          0 ||
+      ::listen(ListenFd, SOMAXCONN) != 0 ||
+      ::lstat(SocketPath.c_str(), &Stat) != 0) {
+    LOG(ERROR) << "Failed to listen on " << SocketPath << ": "
+               << std::strerror(errno);
+    return false;
+  }
+  SocketDev = Stat.st_dev;
+  SocketIno = Stat.st_ino;
+
+  for (uint32_t I = 0; I < WorkerCount; ++I) {
+    Workers.emplace_back(&Daemon::runWorker, this);
+  }
+
+  /// Poll the connections waiting for requests. Connections with requests in
+  /// flight are handed to workers and come back by `DoneFds`.
+  std::unordered_map<int, Connection> Conns;
+  auto Close = [&Conns](const int Fd) {
+    ::close(Fd);
+    Conns.erase(Fd);
+  };
+  std::vector<pollfd> PollFds;
+  while (!StopRequested.load(std::memory_order_relaxed)) {
+    std::vector<std::pair<int, bool>> Done;
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Done.swap(DoneFds);
+    }
+    for (const auto &[Fd, KeepAlive] : Done) {
+      /// Answered connections may have buffered the next frame already.
+      Connection &Conn = Conns[Fd];
+      Conn.Busy = false;
+      Conn.LastRead = Clock::now();
+      if (!KeepAlive || !dispatchFrame(Fd, Conn)) {
+        Close(Fd);
+      }
+    }
+
+    /// Wake up to close the connections idle in the middle of frames.
+    const auto Now = Clock::now();
+    int Timeout = -1;
+    PollFds.clear();
+    PollFds.push_back({ListenFd, POLLIN, 0});
+    PollFds.push_back({WakeFds[0], POLLIN, 0});
+    std::vector<int> Expired;
+    for (const auto &[Fd, Conn] : Conns) {
+      if (Conn.Busy) {
+        continue;
+      }
+      if (!Conn.Buffer.empty()) {
+        const auto Left = std::chrono::seconds(kReadTimeoutSec) -
+                          (Now - Conn.LastRead);
+        if (Left <= Clock::duration::zero()) {
+          Expired.push_back(Fd);
+          continue;
+        }
+        const int LeftMs = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(Left)
+                .count() +
+            1);
+        Timeout = Timeout < 0 ? LeftMs : std::min(Timeout, LeftMs);
+      }
+      PollFds.push_back({Fd, POLLIN, 0});
+    }
+    for (const int Fd : Expired) {
+      Close(Fd);
+    }
+    if (::poll(PollFds.data(), PollFds.size(), Timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "Failed to poll: " << std::strerror(errno);
+      break;
+    }
+
+    if (PollFds[1].revents) {
+      char Buf[64];
+      while (::read(WakeFds[0], Buf, sizeof(Buf)) > 0) {
+      }
+    }
+    if (PollFds[0].revents & POLLIN) {
+      if (const int Fd = ::accept4(ListenFd, nullptr, nullptr,
+                                   SOCK_CLOEXEC | SOCK_NONBLOCK);
+          Fd >= 0) {
+        Conns[Fd].LastRead = Clock::now();
+        std::lock_guard<std::mutex> Lock(Mutex);
+        ++Connections;
+      }
+    }
+
+    /// Read from readable connections, and queue the whole frames. The
+    /// connections are removed from polling until answered.
+    for (size_t I = 2; I < PollFds.size(); ++I) {
+      if (PollFds[I].revents == 0) {
+        continue;
+      }
+      const int Fd = PollFds[I].fd;
+      Connection &Conn = Conns[Fd];
+      if (!receive(Fd, Conn) || !dispatchFrame(Fd, Conn)) {
+        Close(Fd);
+      }
+    }
+  }
+
+  /// Stop workers and close connections.
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Stopping = true;
+  }
+  QueueCond.notify_all();
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+  Workers.clear();
+  Queue.clear();
+  DoneFds.clear();
+  for (const auto &Conn : Conns) {
+    ::close(Conn.first);
+  }
+  ::close(ListenFd);
+  ListenFd = -1;
+  if (::lstat(SocketPath.c_str(), &Stat) == 0 && Stat.st_dev == SocketDev &&
+      Stat.st_ino == SocketIno) {
+    ::unlink(SocketPath.c_str());
+  }
+  return true;
+}
+
+void Daemon::stop() noexcept {
+  StopRequested.store(true, std::memory_order_relaxed);
+  if (WakeFds[1] >= 0) {
+    const char C = 0;
+    [[maybe_unused]] const ssize_t Ret = ::write(WakeFds[1], &C, 1);
+  }
+}
+
+void Daemon::runWorker() {
+  /// Every worker reuses its own VM between requests.
+  Proxy VMProxy;
+  VMProxy.setWasmPath(DefaultWasmPath);
+  VMProxy.setWasmRoot(WasmRootPath);
+  VMProxy.setModuleCache(&Cache);
+
+  while (true) {
+    Request Req;
+    {
+      std::unique_lock<std::mutex> Lock(Mutex);
+      QueueCond.wait(Lock, [this]() { return Stopping || !Queue.empty(); });
+      if (Stopping) {
+        return;
+      }
+      Req = std::move(Queue.front());
+      Queue.pop_front();
+      QueueLatency.add(Clock::now() - Req.Arrival);
+    }
+
+    const auto Start = Clock::now();
+    rapidjson::Document Doc;
+    Doc.Parse(Req.Payload.c_str());
+    std::string Response;
+    rapidjson::Value::ConstMemberIterator ItCommand;
+    if (Doc.IsObject() &&
+        (ItCommand = Doc.FindMember("command")) != Doc.MemberEnd() &&
+        ItCommand->value.IsString() &&
+        std::strcmp(ItCommand->value.GetString(), "metrics") == 0) {
+      Response = getMetricsJSON();
+    } else {
+      Response = VMProxy.runRequest(Doc);
+    }
+    const bool Written = writeFrame(Req.Fd, Response);
+
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      ++Requests;
+      if (Doc.HasParseError()) {
+        ++InvalidRequests;
+      }
+      ServiceLatency.add(Clock::now() - Start);
+    }
+    finishRequest(Req.Fd, Written);
+  }
+}
+
+void Daemon::finishRequest(const int Fd, const bool KeepAlive) {
+  {
+    /// The dispatcher owns and closes the connections.
+    std::lock_guard<std::mutex> Lock(Mutex);
+    DoneFds.emplace_back(Fd, KeepAlive);
+  }
+  const char C = 0;
+  [[maybe_unused]] const ssize_t Ret = ::write(WakeFds[1], &C, 1);
+}
+
+std::string Daemon::getMetricsJSON() {
+  rapidjson::StringBuffer StrBuf;
+  rapidjson::Writer<rapidjson::StringBuffer> Writer(StrBuf);
+  auto writeLatency = [&Writer](const char *Name, const LatencyStat &Stat) {
+    Writer.Key(Name);
+    Writer.StartObject();
+    Writer.Key("count");
+    Writer.Uint64(Stat.Count);
+    Writer.Key("mean");
+    Writer.Uint64(Stat.Count ? Stat.TotalUs / Stat.Count : 0);
+    Writer.Key("p50");
+    Writer.Uint64(Stat.getPercentile(0.5));
+    Writer.Key("p99");
+    Writer.Uint64(Stat.getPercentile(0.99));
+    Writer.Key("max");
+    Writer.Uint64(Stat.MaxUs);
+    Writer.EndObject();
+  };
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Writer.StartObject();
+  Writer.Key("workers");
+  Writer.Uint(WorkerCount);
+  Writer.Key("connections");
+  Writer.Uint64(Connections);
+  Writer.Key("requests");
+  Writer.Uint64(Requests);
+  Writer.Key("invalid_requests");
+  Writer.Uint64(InvalidRequests);
+  Writer.Key("queue_depth");
+  Writer.Uint64(Queue.size());
+  Writer.Key("max_queue_depth");
+  Writer.Uint64(MaxQueueDepth);
+  Writer.Key("module_cache");
+  Writer.StartObject();
+  Writer.Key("hits");
+  Writer.Uint64(Cache.getHits());
+  Writer.Key("misses");
+  Writer.Uint64(Cache.getMisses());
+  Writer.EndObject();
+  writeLatency("queue_latency_us", QueueLatency);
+  writeLatency("service_latency_us", ServiceLatency);
+  Writer.EndObject();
+  return std::string(StrBuf.GetString(), StrBuf.GetSize());
+}
+
+} // namespace Proxy
+} // namespace SSVM
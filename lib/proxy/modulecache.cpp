@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "proxy/modulecache.h"
+#include "loader/loader.h"
+#include "validator/validator.h"
+
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+
+namespace SSVM {
+namespace Proxy {
+
+Expect<std::shared_ptr<const ModuleCache::Entry>>
+ModuleCache::get(const std::string &Path) {
+  struct stat Stat;
+  if (::stat(Path.c_str(), &Stat) != 0) {
+    return Unexpect(ErrCode::InvalidPath);
+  }
+  const int64_t MTime =
+      int64_t(Stat.st_mtim.tv_sec) * INT64_C(1000000000) + Stat.st_mtim.tv_nsec;
+  const uint64_t Size = static_cast<uint64_t>(Stat.st_size);
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (auto It = Index.find(Path); It != Index.end()) {
+      const auto &Cached = *It->second;
+      if (Cached->MTime == MTime && Cached->Size == Size) {
+        LRU.splice(LRU.begin(), LRU, It->second);
+        ++Hits;
+        return Cached;
+      }
+    }
+    ++Misses;
+  }
+
+  /// Load and validate the module without holding the lock.
+  auto Loaded = std::make_shared<Entry>();
+  Loaded->Path = Path;
+  Loaded->MTime = MTime;
+  Loaded->Size = Size;
+  std::ifstream File(Path, std::ios::binary);
+  if (!File) {
+    return Unexpect(ErrCode::InvalidPath);
+  }
+  Loaded->Code.assign(std::istreambuf_iterator<char>(File),
+                      std::istreambuf_iterator<char>());
+  Loader::Loader WasmLoader;
+  Validator::Validator WasmValidator;
+  /// The digest for snapshots is computed once per entry.
+  WasmLoader.setModuleHash(true);
+  if (auto Res = WasmLoader.parseModule(Span<const Byte>(Loaded->Code))) {
+    Loaded->Module = std::move(*Res);
+  } else {
+    return Unexpect(Res);
+  }
+  if (auto Res = WasmValidator.validate(*Loaded->Module); !Res) {
+    return Unexpect(Res);
+  }
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  if (auto It = Index.find(Path); It != Index.end()) {
+    LRU.erase(It->second);
+    Index.erase(It);
+  }
+  if (Capacity > 0) {
+    LRU.push_front(Loaded);
+    Index.emplace(Path, LRU.begin());
+    while (LRU.size() > Capacity) {
+      Index.erase(LRU.back()->Path);
+      LRU.pop_back();
+    }
+  }
+  return Loaded;
+}
+
+uint64_t ModuleCache::getHits() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return Hits;
+}
+
+uint64_t ModuleCache::getMisses() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return Misses;
+}
+
+} // namespace Proxy
+} // namespace SSVM
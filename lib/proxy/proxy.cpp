@@ -1,26 +1,231 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "proxy/proxy.h"
+#include "expvm/snapshot.h"
+#include "support/sha256.h"
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
 #include <boost/filesystem.hpp>
-#include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/hex.hpp>
 #include <boost/range/counting_range.hpp>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
 namespace SSVM {
 namespace Proxy {
 
+namespace {
+
+/// Snapshots up to this size are inlined in the output JSON.
+static const constexpr uint64_t kInlineSnapshotSize = 65536;
+/// Delta snapshots are chained up to this depth before a full snapshot.
+static const constexpr uint32_t kMaxSnapshotDepth = 16;
+
+static const constexpr char kBase64Table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/// Encode bytes to base64 string.
+std::string encodeBase64(const std::string &Data) {
+  std::string Str;
+  Str.reserve((Data.size() + 2) / 3 * 4);
+  size_t I = 0;
+  for (; I + 2 < Data.size(); I += 3) {
+    const uint32_t Bits = uint32_t(uint8_t(Data[I])) << 16 |
+                          uint32_t(uint8_t(Data[I + 1])) << 8 |
+                          uint32_t(uint8_t(Data[I + 2]));
+    Str.push_back(kBase64Table[(Bits >> 18) & 0x3F]);
+    Str.push_back(kBase64Table[(Bits >> 12) & 0x3F]);
+    Str.push_back(kBase64Table[(Bits >> 6) & 0x3F]);
+    Str.push_back(kBase64Table[Bits & 0x3F]);
+  }
+  if (I < Data.size()) {
+    uint32_t Bits = uint32_t(uint8_t(Data[I])) << 16;
+    if (I + 1 < Data.size()) {
+      Bits |= uint32_t(uint8_t(Data[I + 1])) << 8;
+    }
+    Str.push_back(kBase64Table[(Bits >> 18) & 0x3F]);
+    Str.push_back(kBase64Table[(Bits >> 12) & 0x3F]);
+    Str.push_back(I + 1 < Data.size() ? kBase64Table[(Bits >> 6) & 0x3F]
+                                      : '=');
+    Str.push_back('=');
+  }
+  return Str;
+}
+
+/// Decode base64 string to bytes.
+Expect<Bytes> decodeBase64(const char *Str, const size_t Length) {
+  Bytes Data;
+  Data.reserve(Length / 4 * 3);
+  uint32_t Bits = 0, BitCnt = 0;
+  for (size_t I = 0; I < Length && Str[I] != '='; ++I) {
+    const char *Pos = std::strchr(kBase64Table, Str[I]);
+    if (Pos == nullptr || *Pos == '\0') {
+      return Unexpect(ErrCode::InvalidGrammar);
+    }
+    Bits = (Bits << 6) | static_cast<uint32_t>(Pos - kBase64Table);
+    BitCnt += 6;
+    if (BitCnt >= 8) {
+      BitCnt -= 8;
+      Data.push_back(static_cast<Byte>(Bits >> BitCnt));
+    }
+  }
+  return Data;
+}
+
+/// Generate a random hexadecimal name, so that the snapshot files of
+/// concurrent requests never replace each other.
+std::string getRandomName() {
+  std::random_device Rand;
+  std::ostringstream OS;
+  OS << std::hex << std::setfill('0');
+  for (uint32_t I = 0; I < 4; ++I) {
+    OS << std::setw(4) << (Rand() & 0xFFFFU);
+  }
+  return OS.str();
+}
+
+/// Write the bytes to a temporary file and rename it over the path.
+bool writeFile(const std::string &Path, const Bytes &Data) {
+  const std::string TempPath = Path + "." + getRandomName();
+  std::ofstream OS(TempPath, std::ios::out | std::ios::binary);
+  OS.write(reinterpret_cast<const char *>(Data.data()), Data.size());
+  OS.close();
+  if (!OS || std::rename(TempPath.c_str(), Path.c_str()) != 0) {
+    std::remove(TempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Check the absolute path is under the root directory. Paths escaping the
+/// root by ".." or symbolic links are resolved by `getAbsPath` before.
+bool isUnderRoot(const std::string &Path, const std::string &Root) {
+  const boost::filesystem::path Rel =
+      boost::filesystem::path(Path).lexically_relative(Root);
+  return !Root.empty() && !Rel.empty() && *Rel.begin() != "..";
+}
+
+/// Append the links of the snapshot chain of `Snap` and the link of `Snap`
+/// itself to `Chain`. Links refer to snapshot files by `path`. Inlined
+/// `data` is written to a file named by its digest next to `Path`, or kept
+/// inlined when `Path` is empty.
+///
+/// \returns false when the chain cannot be linked.
+bool appendChain(const rapidjson::Value &Snap, rapidjson::Value &Chain,
+                 rapidjson::Document::AllocatorType &Alloc,
+                 const std::string &Path) {
+  rapidjson::Value::ConstMemberIterator ItChain = Snap.FindMember("chain");
+  if (ItChain != Snap.MemberEnd()) {
+    for (auto It = ItChain->value.Begin(); It != ItChain->value.End(); ++It) {
+      if (!appendChain(*It, Chain, Alloc, Path)) {
+        return false;
+      }
+    }
+  }
+  rapidjson::Value::ConstMemberIterator ItBase = Snap.FindMember("base");
+  if (ItBase != Snap.MemberEnd() &&
+      !appendChain(ItBase->value, Chain, Alloc, Path)) {
+    return false;
+  }
+
+  rapidjson::Value Link(rapidjson::kObjectType);
+  rapidjson::Value::ConstMemberIterator ItPath = Snap.FindMember("path");
+  rapidjson::Value::ConstMemberIterator ItData = Snap.FindMember("data");
+  if (ItPath != Snap.MemberEnd()) {
+    Link.AddMember("path", rapidjson::Value(ItPath->value, Alloc), Alloc);
+  } else if (ItData != Snap.MemberEnd() && Path.empty()) {
+    Link.AddMember("data", rapidjson::Value(ItData->value, Alloc), Alloc);
+  } else if (ItData != Snap.MemberEnd()) {
+    auto Res = decodeBase64(ItData->value.GetString(),
+                            ItData->value.GetStringLength());
+    if (!Res) {
+      return false;
+    }
+    const std::string DataPath =
+        Path + "." +
+        Support::SHA256::toHex(Support::SHA256::hash(Res->data(), Res->size()));
+    if (!boost::filesystem::exists(DataPath) && !writeFile(DataPath, *Res)) {
+      return false;
+    }
+    Link.AddMember("path", rapidjson::Value(DataPath.c_str(), Alloc), Alloc);
+  } else {
+    /// Legacy hex encoded states are linked as is.
+    for (const char *Name : {"global", "memory"}) {
+      rapidjson::Value::ConstMemberIterator It = Snap.FindMember(Name);
+      if (It != Snap.MemberEnd()) {
+        Link.AddMember(rapidjson::StringRef(Name),
+                       rapidjson::Value(It->value, Alloc), Alloc);
+      }
+    }
+    if (Link.ObjectEmpty()) {
+      return false;
+    }
+  }
+  Chain.PushBack(Link, Alloc);
+  return true;
+}
+
+} // namespace
+
 /// Resume from JSON.
+///
+/// The snapshot is either a binary snapshot in file `path`, a binary snapshot
+/// inlined as base64 string `data`, or the legacy hex encoded `global` and
+/// `memory` states. A delta snapshot is restored on top of the snapshots
+/// linked in its `chain` in order, or of its legacy nested `base`.
+///
+/// Snapshot files are restricted to the files under `Root` if not null.
 Expect<void> restore(Runtime::StoreManager &StoreMgr,
-                     const rapidjson::Value &Doc) {
+                     const rapidjson::Value &Doc, const std::string *Root) {
+  /// Restore the base states of delta snapshot.
+  rapidjson::Value::ConstMemberIterator ItChain = Doc.FindMember("chain");
+  if (ItChain != Doc.MemberEnd()) {
+    for (auto It = ItChain->value.Begin(); It != ItChain->value.End(); ++It) {
+      if (auto Res = restore(StoreMgr, *It, Root); !Res) {
+        return Unexpect(Res);
+      }
+    }
+  }
+  rapidjson::Value::ConstMemberIterator ItBase = Doc.FindMember("base");
+  if (ItBase != Doc.MemberEnd()) {
+    if (auto Res = restore(StoreMgr, ItBase->value, Root); !Res) {
+      return Unexpect(Res);
+    }
+  }
+
+  /// Restore from binary snapshot.
+  rapidjson::Value::ConstMemberIterator ItPath = Doc.FindMember("path");
+  if (ItPath != Doc.MemberEnd()) {
+    if (!ItPath->value.IsString()) {
+      return Unexpect(ErrCode::InvalidPath);
+    }
+    const std::string Path = getAbsPath(ItPath->value.GetString());
+    if (Root != nullptr && !isUnderRoot(Path, *Root)) {
+      return Unexpect(ErrCode::InvalidPath);
+    }
+    return ExpVM::Snapshot::restore(StoreMgr, Path);
+  }
+  rapidjson::Value::ConstMemberIterator ItData = Doc.FindMember("data");
+  if (ItData != Doc.MemberEnd()) {
+    if (auto Res = decodeBase64(ItData->value.GetString(),
+                                ItData->value.GetStringLength())) {
+      return ExpVM::Snapshot::restore(StoreMgr, *Res);
+    } else {
+      return Unexpect(Res);
+    }
+  }
+
   /// Get instantiated active module instance.
   Runtime::Instance::ModuleInstance *ModInst;
   if (auto Res = StoreMgr.getActiveModule()) {
@@ -70,65 +275,59 @@ Expect<void> restore(Runtime::StoreManager &StoreMgr,
 }
 
 /// Snapshot to JSON.
-Expect<void> snapshot(Runtime::StoreManager &StoreMgr, rapidjson::Value &Doc,
-                      rapidjson::Document::AllocatorType &Alloc) {
-  /// Get instantiated active module instance.
-  Runtime::Instance::ModuleInstance *ModInst;
-  if (auto Res = StoreMgr.getActiveModule()) {
-    ModInst = *Res;
-  } else {
-    return Unexpect(Res);
+///
+/// The pages written since restoring `Base` are emitted as a delta snapshot,
+/// which links the snapshots of `Base` as `chain` and records the chain
+/// length as `depth`. A full snapshot is emitted instead when the chain is
+/// too long or cannot be linked. `Base` is null when the states were freshly
+/// instantiated.
+///
+/// Small snapshots are inlined as base64 string `data`. Others are streamed
+/// to a file named by `Path` and a random suffix, so that the files of other
+/// requests and of the base chain are kept, which is recorded as `path`.
+Expect<void> snapshot(Runtime::StoreManager &StoreMgr,
+                      const rapidjson::Value *Base, rapidjson::Value &Doc,
+                      rapidjson::Document::AllocatorType &Alloc,
+                      std::string Path) {
+  uint32_t Depth = 1;
+  if (Base != nullptr) {
+    rapidjson::Value::ConstMemberIterator ItDepth = Base->FindMember("depth");
+    Depth = ItDepth != Base->MemberEnd() ? ItDepth->value.GetUint() + 1 : 1;
+  }
+  rapidjson::Value Chain(rapidjson::kArrayType);
+  if (Depth > kMaxSnapshotDepth ||
+      (Base != nullptr && !appendChain(*Base, Chain, Alloc, Path))) {
+    Depth = 0;
   }
 
-  /// Iterate Global instances.
-  if (ModInst->getGlobalNum() > 0) {
-    rapidjson::Value GlobArr(rapidjson::kArrayType);
-    for (uint32_t I = 0; I < ModInst->getGlobalNum(); ++I) {
-      /// Get address and data to string.
-      uint32_t GlobAddr = *ModInst->getGlobalAddr(I);
-      auto *GlobInst = *StoreMgr.getGlobal(GlobAddr);
-      ValVariant Val = GlobInst->getValue();
-      std::string ValHex =
-          (boost::format("0x%016llx") % retrieveValue<uint64_t>(Val)).str();
-
-      /// Insert into global array.
-      rapidjson::Value GlobData(rapidjson::kArrayType);
-      rapidjson::Value Idx(I);
-      rapidjson::Value ValStr;
-      ValStr.SetString(ValHex.c_str(), Alloc);
-      GlobData.PushBack(Idx, Alloc);
-      GlobData.PushBack(ValStr, Alloc);
-      GlobArr.PushBack(GlobData, Alloc);
+  ExpVM::Snapshot Snap;
+  if (auto Res = Depth > 0 ? Snap.scanDirty(StoreMgr) : Snap.scan(StoreMgr);
+      !Res) {
+    return Unexpect(Res);
+  }
+  if (Depth > 0) {
+    if (Base != nullptr) {
+      Doc.AddMember("chain", Chain, Alloc);
     }
-    Doc.AddMember("global", GlobArr, Alloc);
-  }
-
-  /// Iterate Memory instances.
-  if (ModInst->getMemNum() > 0) {
-    rapidjson::Value MemArr(rapidjson::kArrayType);
-    for (uint32_t I = 0; I < ModInst->getMemNum(); ++I) {
-      /// Get address and data to string.
-      uint32_t MemAddr = *ModInst->getMemAddr(I);
-      auto *MemInst = *StoreMgr.getMemory(MemAddr);
-      const std::vector<uint8_t> &Data = MemInst->getDataVector();
-      std::string DataHex;
-      boost::algorithm::hex_lower(Data.begin(), Data.end(),
-                                  std::back_inserter(DataHex));
-
-      /// Insert into memory array.
-      if (DataHex.length() > 0) {
-        rapidjson::Value MemData(rapidjson::kArrayType);
-        rapidjson::Value Idx(I);
-        rapidjson::Value MemStr;
-        MemStr.SetString(DataHex.c_str(), Alloc);
-        MemData.PushBack(Idx, Alloc);
-        MemData.PushBack(MemStr, Alloc);
-        MemArr.PushBack(MemData, Alloc);
-      }
+    Doc.AddMember("depth", Depth, Alloc);
+  }
+
+  rapidjson::Value Str;
+  if (Snap.getSize() <= kInlineSnapshotSize || Path.empty()) {
+    std::ostringstream OS;
+    if (auto Res = Snap.write(OS); !Res) {
+      return Unexpect(Res);
     }
-    if (MemArr.Size() > 0) {
-      Doc.AddMember("memory", MemArr, Alloc);
+    const std::string Data = encodeBase64(OS.str());
+    Str.SetString(Data.c_str(), Data.size(), Alloc);
+    Doc.AddMember("data", Str, Alloc);
+  } else {
+    Path += "." + getRandomName();
+    if (auto Res = Snap.write(Path); !Res) {
+      return Unexpect(Res);
     }
+    Str.SetString(Path.c_str(), Path.size(), Alloc);
+    Doc.AddMember("path", Str, Alloc);
   }
   return {};
 }
@@ -170,6 +369,14 @@ void Proxy::runRequest() {
   exportOutputJSON();
 }
 
+std::string Proxy::runRequest(rapidjson::Document &Input) {
+  prepareOutputJSON();
+  InputDoc.Swap(Input);
+  parseInputDoc();
+  executeVM();
+  return writeOutputJSON();
+}
+
 void Proxy::prepareOutputJSON() {
   OutputDoc.SetObject();
   rapidjson::Document::AllocatorType &Allocator = OutputDoc.GetAllocator();
@@ -193,10 +400,12 @@ void Proxy::prepareOutputJSON() {
 
 void Proxy::parseInputJSON() {
   /// Open JSON file
+  RequestWasmPath = WasmPath;
   std::ifstream InputFS(InputJSONPath, std::ios::binary);
   if (!InputFS.is_open()) {
     OutputDoc["result"]["error_message"].SetString(
         "Input JSON file not found.");
+    VMUnit.reset();
     return;
   }
   InputFS.unsetf(std::ios::skipws);
@@ -214,6 +423,16 @@ void Proxy::parseInputJSON() {
               std::istream_iterator<char>());
   Data.push_back(0);
   InputDoc.Parse(&Data[0]);
+  parseInputDoc();
+}
+
+void Proxy::parseInputDoc() {
+  RequestWasmPath = WasmPath;
+  if (!InputDoc.IsObject()) {
+    OutputDoc["result"]["error_message"].SetString("Invalid input JSON.");
+    VMUnit.reset();
+    return;
+  }
 
   /// Parse header
   rapidjson::Value::ConstMemberIterator ItServiceName =
@@ -223,11 +442,29 @@ void Proxy::parseInputJSON() {
       InputDoc.FindMember("modules");
   rapidjson::Value::ConstMemberIterator ItExecution =
       InputDoc.FindMember("execution");
+  rapidjson::Value::ConstMemberIterator ItWasmPath =
+      InputDoc.FindMember("wasm_path");
   if (ItModules == InputDoc.MemberEnd() ||
       ItExecution == InputDoc.MemberEnd()) {
     OutputDoc["result"]["error_message"].SetString("Module not determined.");
+    VMUnit.reset();
     return;
   }
+  if (ItWasmPath != InputDoc.MemberEnd()) {
+    if (!ItWasmPath->value.IsString()) {
+      OutputDoc["result"]["error_message"].SetString("Invalid wasm path.");
+      VMUnit.reset();
+      return;
+    }
+    const std::string Path = getAbsPath(ItWasmPath->value.GetString());
+    if (RestrictWasmPath && !isUnderRoot(Path, WasmRoot)) {
+      OutputDoc["result"]["error_message"].SetString(
+          "Wasm path not allowed.");
+      VMUnit.reset();
+      return;
+    }
+    RequestWasmPath = Path;
+  }
   rapidjson::Document::AllocatorType &Allocator = OutputDoc.GetAllocator();
   if (ItServiceName != InputDoc.MemberEnd()) {
     OutputDoc["service_name"].SetString(ItServiceName->value.GetString(),
@@ -243,31 +480,49 @@ void Proxy::parseInputJSON() {
   }
 
   /// Create VM with configure.
-  VMUnit.reset();
-  VMConf = ExpVM::Configure();
+  bool NeedWasi = false;
   for (auto &Val : ItModules->value.GetArray()) {
     std::string ModuleType(Val.GetString());
     if (ModuleType == "Rust") {
-      VMConf.addVMType(SSVM::ExpVM::Configure::VMType::Wasi);
+      NeedWasi = true;
     } else if (ModuleType == "ethereum") {
       OutputDoc["result"]["error_message"].SetString(
           "Ethereum mode is not supported in SSVM-RPC.");
+      VMUnit.reset();
       return;
       /// VMConf.addVMType(SSVM::VM::Configure::VMType::Ewasm);
     }
   }
+
+  /// Reuse the VM of the same configuration with host modules kept.
+  if (VMUnit != nullptr &&
+      VMConf.hasVMType(ExpVM::Configure::VMType::Wasi) == NeedWasi) {
+    VMUnit->cleanup();
+    VMUnit->getMeasurement().getCostLimit() = UINT64_MAX;
+    VMUnit->getMeasurement().getCostSum() = 0;
+    return;
+  }
+  VMUnit.reset();
+  TmplEntry.reset();
+  Tmpl.reset();
+  VMConf = ExpVM::Configure();
+  /// Snapshots of the states are bound to the module by its digest.
+  VMConf.setModuleHash(true);
+  if (NeedWasi) {
+    VMConf.addVMType(SSVM::ExpVM::Configure::VMType::Wasi);
+  }
   VMUnit = std::make_unique<ExpVM::VM>(VMConf);
 }
 
 void Proxy::executeVM() {
-  /// Wasm path is empty or not found.
-  if (WasmPath == "" || !boost::filesystem::exists(WasmPath)) {
-    OutputDoc["result"]["error_message"].SetString("Wasm file not found.");
+  /// Failed in previous functions.
+  if (VMUnit == nullptr) {
     return;
   }
 
-  /// Failed in previous functions.
-  if (VMUnit == nullptr) {
+  /// Wasm path is empty or not found.
+  if (RequestWasmPath == "" || !boost::filesystem::exists(RequestWasmPath)) {
+    OutputDoc["result"]["error_message"].SetString("Wasm file not found.");
     return;
   }
 
@@ -312,17 +567,46 @@ void Proxy::executeVM() {
 
   /// Instantiate wasm module.
   ErrCode Status = ErrCode::Success;
-  if (auto Res = VMUnit->loadWasm(WasmPath); !Res) {
+  if (ModCache != nullptr) {
+    if (auto Res = ModCache->get(RequestWasmPath)) {
+      /// Fork from the template of the module, or instantiate the module and
+      /// make the template. The instance keeps the cache entry alive through
+      /// the shared module.
+      const auto &Entry = *Res;
+      if (Tmpl != nullptr && TmplEntry == Entry) {
+        if (auto ResFork = VMUnit->fork(*Tmpl); !ResFork) {
+          Status = ResFork.error();
+          OutputDoc["result"]["error_message"].SetString(
+              "Wasm instantiation failed.");
+        }
+      } else if (auto ResInst = VMUnit->instantiate(
+                     std::shared_ptr<const AST::Module>(Entry,
+                                                        Entry->Module.get()));
+                 !ResInst) {
+        Status = ResInst.error();
+        OutputDoc["result"]["error_message"].SetString(
+            "Wasm instantiation failed.");
+      } else if (auto ResTmpl = VMUnit->makeTemplate()) {
+        TmplEntry = Entry;
+        Tmpl = std::move(*ResTmpl);
+      }
+    } else {
+      Status = Res.error();
+      OutputDoc["result"]["error_message"].SetString(rapidjson::StringRef(
+          Status == ErrCode::ValidationFailed ? "Wasm validation failed."
+                                              : "Wasm decoding failed."));
+    }
+  } else if (auto Res = VMUnit->loadWasm(RequestWasmPath); !Res) {
     Status = Res.error();
     OutputDoc["result"]["error_message"].SetString("Wasm decoding failed.");
   }
-  if (Status == ErrCode::Success) {
+  if (Status == ErrCode::Success && ModCache == nullptr) {
     if (auto Res = VMUnit->validate(); !Res) {
       Status = Res.error();
       OutputDoc["result"]["error_message"].SetString("Wasm validation failed.");
     }
   }
-  if (Status == ErrCode::Success) {
+  if (Status == ErrCode::Success && ModCache == nullptr) {
     if (auto Res = VMUnit->instantiate(); !Res) {
       Status = Res.error();
       OutputDoc["result"]["error_message"].SetString(
@@ -331,16 +615,26 @@ void Proxy::executeVM() {
   }
 
   /// Restore VM state.
+  const rapidjson::Value *BaseSnapshot = nullptr;
   if (Status == ErrCode::Success &&
       InputDoc["execution"].FindMember("vm_snapshot") !=
           InputDoc["execution"].MemberEnd()) {
-    if (auto Res = restore(VMUnit->getStoreManager(),
-                           InputDoc["execution"]["vm_snapshot"]);
+    BaseSnapshot = &InputDoc["execution"]["vm_snapshot"];
+    if (auto Res = restore(VMUnit->getStoreManager(), *BaseSnapshot,
+                           RestrictWasmPath ? &WasmRoot : nullptr);
         !Res) {
       Status = Res.error();
+      OutputDoc["result"]["error_message"].SetString(
+          "Snapshot restoring failed.");
     }
   }
 
+  /// Track dirty pages for the delta snapshot. Memories failed to be tracked
+  /// are snapshotted fully.
+  if (Status == ErrCode::Success) {
+    ExpVM::Snapshot::track(VMUnit->getStoreManager());
+  }
+
   /// Execute function.
   if (Status == ErrCode::Success) {
     std::string FuncName;
@@ -386,24 +680,30 @@ void Proxy::executeVM() {
 
   /// Snapshot VM
   if (Status == ErrCode::Success) {
-    snapshot(VMUnit->getStoreManager(), OutputDoc["result"]["vm_snapshot"],
-             Allocator);
+    const std::string SnapshotPath =
+        OutputJSONPath.empty() ? "" : OutputJSONPath + ".snapshot";
+    snapshot(VMUnit->getStoreManager(), BaseSnapshot,
+             OutputDoc["result"]["vm_snapshot"], Allocator, SnapshotPath);
   }
 }
 
 void Proxy::exportOutputJSON() {
-  rapidjson::StringBuffer StrBuf;
-  rapidjson::Writer<rapidjson::StringBuffer> Writer(StrBuf);
-  OutputDoc.Accept(Writer);
-
+  const std::string Output = writeOutputJSON();
   std::ofstream OutputFS(OutputJSONPath, std::ios::out | std::ios::trunc);
   if (!OutputFS.is_open()) {
     std::cout << "\n Cannot open output path: \"" << OutputJSONPath << "\""
               << "\n ===================  Results  ==================\n "
-              << StrBuf.GetString() << std::endl;
+              << Output << std::endl;
     return;
   }
-  OutputFS << StrBuf.GetString();
+  OutputFS << Output;
+}
+
+std::string Proxy::writeOutputJSON() {
+  rapidjson::StringBuffer StrBuf;
+  rapidjson::Writer<rapidjson::StringBuffer> Writer(StrBuf);
+  OutputDoc.Accept(Writer);
+  return std::string(StrBuf.GetString(), StrBuf.GetSize());
 }
 
 } // namespace Proxy
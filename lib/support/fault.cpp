@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "support/fault.h"
+#include "support/pagetracker.h"
+
+#include <atomic>
+#include <csignal>
+
+namespace SSVM {
+namespace Support {
+
+namespace {
+
+/// Maximum count of guard regions. The 47-bit user address space holds at
+/// most 16384 reserved ranges of `Support::Allocator`.
+static const constexpr uint32_t kMaxGuards = 16384;
+
+/// Registered guard region. Base 0 means the slot is free.
+///
+/// Size is stored before base when registering, so that the signal handler
+/// never reads a region with a stale size.
+struct GuardSlot {
+  std::atomic<bool> Used;
+  std::atomic<uintptr_t> Base;
+  std::atomic<uint64_t> Size;
+};
+
+GuardSlot Guards[kMaxGuards];
+/// Upper bound of slot indices ever used.
+std::atomic<uint32_t> GuardEnd;
+
+/// Actions installed before, chained for the faults not handled here.
+struct sigaction PrevSegvAction;
+struct sigaction PrevBusAction;
+
+thread_local Fault *CurrentFault = nullptr;
+
+bool isGuarded(const void *Addr) noexcept {
+  const uintptr_t Ptr = reinterpret_cast<uintptr_t>(Addr);
+  const uint32_t End = GuardEnd.load();
+  for (uint32_t I = 0; I < End; ++I) {
+    const uintptr_t Base = Guards[I].Base.load();
+    if (Base != 0 && Ptr >= Base && Ptr - Base < Guards[I].Size.load()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Pass the signal to the action installed before.
+void chainSignal(int Signal, siginfo_t *Info, void *Context) {
+  struct sigaction &Prev =
+      (Signal == SIGSEGV) ? PrevSegvAction : PrevBusAction;
+  if ((Prev.sa_flags & SA_SIGINFO) != 0) {
+    if (Prev.sa_sigaction != nullptr) {
+      Prev.sa_sigaction(Signal, Info, Context);
+      return;
+    }
+  } else if (Prev.sa_handler != SIG_DFL && Prev.sa_handler != SIG_IGN) {
+    Prev.sa_handler(Signal);
+    return;
+  }
+
+  /// Default action. Restore it and return to fault again, or raise the
+  /// signal again if it is not from a fault.
+  struct sigaction Action = {};
+  Action.sa_handler = SIG_DFL;
+  sigemptyset(&Action.sa_mask);
+  sigaction(Signal, &Action, nullptr);
+  if (Info->si_code <= 0) {
+    raise(Signal);
+  }
+}
+
+void signalHandler(int Signal, siginfo_t *Info, void *Context) {
+  /// First writes to tracked pages are resolved in any scope.
+  if (PageTracker::resolveFault(Info->si_addr)) {
+    return;
+  }
+  if (CurrentFault != nullptr && isGuarded(Info->si_addr)) {
+    Fault::emitFault(ErrCode::MemorySizeExceeded);
+  }
+  chainSignal(Signal, Info, Context);
+}
+
+} // namespace
+
+void Fault::install() {
+  static const bool Installed = []() {
+    struct sigaction Action = {};
+    Action.sa_sigaction = &signalHandler;
+    /// Not to block the signal in handler, so that jumping out of the handler
+    /// needs not to restore the signal mask.
+    Action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&Action.sa_mask);
+    sigaction(SIGSEGV, &Action, &PrevSegvAction);
+    sigaction(SIGBUS, &Action, &PrevBusAction);
+    return true;
+  }();
+  static_cast<void>(Installed);
+}
+
+Fault::Fault() : Prev(CurrentFault) {
+  install();
+  CurrentFault = this;
+}
+
+Fault::~Fault() noexcept { CurrentFault = Prev; }
+
+void Fault::emitFault(const ErrCode Error) {
+  Fault *Current = CurrentFault;
+  siglongjmp(Current->Buffer, static_cast<int>(Error));
+}
+
+bool Fault::addGuard(const void *Base, const uint64_t Size) noexcept {
+  for (uint32_t I = 0; I < kMaxGuards; ++I) {
+    GuardSlot &S = Guards[I];
+    bool Expected = false;
+    if (!S.Used.compare_exchange_strong(Expected, true)) {
+      continue;
+    }
+    S.Size.store(Size);
+    S.Base.store(reinterpret_cast<uintptr_t>(Base));
+    uint32_t End = GuardEnd.load();
+    while (End <= I && !GuardEnd.compare_exchange_weak(End, I + 1)) {
+    }
+    return true;
+  }
+  return false;
+}
+
+void Fault::removeGuard(const void *Base) noexcept {
+  const uintptr_t Ptr = reinterpret_cast<uintptr_t>(Base);
+  const uint32_t End = GuardEnd.load();
+  for (uint32_t I = 0; I < End; ++I) {
+    GuardSlot &S = Guards[I];
+    if (S.Base.load() == Ptr) {
+      S.Base.store(0);
+      S.Used.store(false);
+      return;
+    }
+  }
+}
+
+FaultBlocker::FaultBlocker() noexcept : Saved(CurrentFault) {
+  CurrentFault = nullptr;
+}
+
+FaultBlocker::~FaultBlocker() noexcept { CurrentFault = Saved; }
+
+} // namespace Support
+} // namespace SSVM
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "support/pagetracker.h"
+#include "support/fault.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace SSVM {
+namespace Support {
+
+namespace {
+
+/// Maximum count of ranges tracked at the same time.
+static const constexpr uint32_t kMaxSlots = 1024;
+/// Maximum tracked bytes of a range, which is the maximum wasm memory size.
+static const constexpr uint64_t kMaxSize = 65536ULL * 65536ULL;
+
+const uint64_t kSysPageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+/// Registered range.
+///
+/// Only the owner of a slot modifies it. The modifications are wrapped by
+/// increasing the generation to odd and back to even, so that the signal
+/// handler reads a consistent range or skips the slot. The bitmap is
+/// allocated by the first owner and kept for the following owners.
+struct TrackSlot {
+  std::atomic<bool> Used;
+  std::atomic<uint64_t> Gen;
+  std::atomic<uintptr_t> Base;
+  std::atomic<uint64_t> Size;
+  std::atomic<std::atomic<uint64_t> *> Bitmap;
+};
+
+TrackSlot Slots[kMaxSlots];
+/// Upper bound of slot indices ever used.
+std::atomic<uint32_t> SlotEnd;
+
+/// Set or clear the bits of pages [First, Last).
+void fillBits(std::atomic<uint64_t> *Bitmap, uint64_t First,
+              const uint64_t Last, const bool Value) noexcept {
+  while (First < Last) {
+    const uint64_t Shift = First % 64;
+    const uint64_t Cnt = std::min(64 - Shift, Last - First);
+    const uint64_t Mask = (Cnt == 64 ? ~0ULL : ((1ULL << Cnt) - 1)) << Shift;
+    if (Value) {
+      Bitmap[First / 64].fetch_or(Mask);
+    } else {
+      Bitmap[First / 64].fetch_and(~Mask);
+    }
+    First += Cnt;
+  }
+}
+
+/// Publish the range of slot.
+void publish(TrackSlot &S, const uintptr_t Base, const uint64_t Size) noexcept {
+  S.Gen.fetch_add(1);
+  S.Base.store(Base);
+  S.Size.store(Size);
+  S.Gen.fetch_add(1);
+}
+
+} // namespace
+
+/// Getter of page size. See "include/support/pagetracker.h".
+uint64_t PageTracker::getPageSize() noexcept { return kSysPageSize; }
+
+/// Start or clear tracking. See "include/support/pagetracker.h".
+bool PageTracker::reset(uint8_t *Base, const uint64_t Size) noexcept {
+  if (Size > kMaxSize || Size % kSysPageSize != 0) {
+    return false;
+  }
+  if (Slot < 0) {
+    /// Claim a free slot.
+    for (uint32_t I = 0; I < kMaxSlots; ++I) {
+      bool Expected = false;
+      if (Slots[I].Used.compare_exchange_strong(Expected, true)) {
+        Slot = static_cast<int32_t>(I);
+        break;
+      }
+    }
+    if (Slot < 0) {
+      return false;
+    }
+    TrackSlot &S = Slots[Slot];
+    if (S.Bitmap.load() == nullptr) {
+      void *Ptr = mmap(nullptr, kMaxSize / kSysPageSize / 8,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (Ptr == MAP_FAILED) {
+        S.Used.store(false);
+        Slot = -1;
+        return false;
+      }
+      S.Bitmap.store(static_cast<std::atomic<uint64_t> *>(Ptr));
+    }
+    uint32_t End = SlotEnd.load();
+    while (End <= static_cast<uint32_t>(Slot) &&
+           !SlotEnd.compare_exchange_weak(End, Slot + 1)) {
+    }
+    Fault::install();
+  }
+
+  /// Write-protect all pages before publishing them as clean.
+  TrackSlot &S = Slots[Slot];
+  publish(S, 0, 0);
+  fillBits(S.Bitmap.load(), 0, Size / kSysPageSize, false);
+  if (Size > 0 && mprotect(Base, Size, PROT_READ) != 0) {
+    stop();
+    return false;
+  }
+  publish(S, reinterpret_cast<uintptr_t>(Base), Size);
+  return true;
+}
+
+/// Extend tracked range. See "include/support/pagetracker.h".
+void PageTracker::grow(const uint64_t NewSize) noexcept {
+  if (Slot < 0) {
+    return;
+  }
+  TrackSlot &S = Slots[Slot];
+  const uintptr_t Base = S.Base.load();
+  const uint64_t OldSize = S.Size.load();
+  if (NewSize <= OldSize) {
+    return;
+  }
+  /// New pages which fail to be protected stay writable, so they are dirty.
+  const bool Protected =
+      mprotect(reinterpret_cast<void *>(Base + OldSize), NewSize - OldSize,
+               PROT_READ) == 0;
+  fillBits(S.Bitmap.load(), OldSize / kSysPageSize, NewSize / kSysPageSize,
+           !Protected);
+  publish(S, Base, NewSize);
+}
+
+/// Mark range dirty. See "include/support/pagetracker.h".
+void PageTracker::markDirty(const uint64_t Offset,
+                            const uint64_t Length) noexcept {
+  if (Slot < 0) {
+    return;
+  }
+  TrackSlot &S = Slots[Slot];
+  const uintptr_t Base = S.Base.load();
+  const uint64_t Size = S.Size.load();
+  if (Length == 0 || Offset >= Size) {
+    return;
+  }
+  const uint64_t First = Offset / kSysPageSize;
+  const uint64_t Last =
+      (std::min(Offset + Length, Size) + kSysPageSize - 1) / kSysPageSize;
+  /// Skip the system call when the pages are dirty already.
+  std::atomic<uint64_t> *Bitmap = S.Bitmap.load();
+  uint64_t Page = First;
+  while (Page < Last &&
+         (Bitmap[Page / 64].load() & (1ULL << (Page % 64))) != 0) {
+    ++Page;
+  }
+  if (Page == Last) {
+    return;
+  }
+  /// Pages failed to be unprotected are left clean to fault on writes.
+  if (mprotect(reinterpret_cast<void *>(Base + Page * kSysPageSize),
+               (Last - Page) * kSysPageSize, PROT_READ | PROT_WRITE) == 0) {
+    fillBits(Bitmap, Page, Last, true);
+  }
+}
+
+/// Get dirty pages. See "include/support/pagetracker.h".
+std::vector<uint64_t> PageTracker::getDirtyPages() const {
+  std::vector<uint64_t> Pages;
+  if (Slot < 0) {
+    return Pages;
+  }
+  const TrackSlot &S = Slots[Slot];
+  const std::atomic<uint64_t> *Bitmap = S.Bitmap.load();
+  const uint64_t PageCnt = S.Size.load() / kSysPageSize;
+  for (uint64_t W = 0; W * 64 < PageCnt; ++W) {
+    uint64_t Bits = Bitmap[W].load();
+    while (Bits != 0) {
+      const uint64_t Page = W * 64 + __builtin_ctzll(Bits);
+      if (Page >= PageCnt) {
+        break;
+      }
+      Pages.push_back(Page);
+      Bits &= Bits - 1;
+    }
+  }
+  return Pages;
+}
+
+/// Stop tracking. See "include/support/pagetracker.h".
+void PageTracker::stop() noexcept {
+  if (Slot < 0) {
+    return;
+  }
+  TrackSlot &S = Slots[Slot];
+  const uintptr_t Base = S.Base.load();
+  const uint64_t Size = S.Size.load();
+  publish(S, 0, 0);
+  if (Size > 0) {
+    mprotect(reinterpret_cast<void *>(Base), Size, PROT_READ | PROT_WRITE);
+  }
+  S.Used.store(false);
+  Slot = -1;
+}
+
+/// Resolve fault in signal handler. See "include/support/pagetracker.h".
+bool PageTracker::resolveFault(const void *Addr) noexcept {
+  const uintptr_t Ptr = reinterpret_cast<uintptr_t>(Addr);
+  const uint32_t End = SlotEnd.load();
+  for (uint32_t I = 0; I < End; ++I) {
+    TrackSlot &S = Slots[I];
+    /// Read a consistent range, or skip the slot under modification, which
+    /// is never the range of current fault.
+    const uint64_t Gen = S.Gen.load();
+    if (Gen % 2 != 0) {
+      continue;
+    }
+    const uintptr_t Base = S.Base.load();
+    const uint64_t Size = S.Size.load();
+    std::atomic<uint64_t> *Bitmap = S.Bitmap.load();
+    if (S.Gen.load() != Gen || Ptr < Base || Ptr >= Base + Size) {
+      continue;
+    }
+
+    /// Faults on dirty pages are not caused by tracking.
+    const uint64_t Page = (Ptr - Base) / kSysPageSize;
+    const uint64_t Mask = 1ULL << (Page % 64);
+    if ((Bitmap[Page / 64].load() & Mask) != 0 ||
+        mprotect(reinterpret_cast<void *>(Base + Page * kSysPageSize),
+                 kSysPageSize, PROT_READ | PROT_WRITE) != 0) {
+      return false;
+    }
+    Bitmap[Page / 64].fetch_or(Mask);
+    return true;
+  }
+  return false;
+}
+
+} // namespace Support
+} // namespace SSVM
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "support/profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace SSVM {
+namespace Support {
+
+namespace {
+
+uint64_t toNanoseconds(const Profile::Clock::duration D) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(D).count());
+}
+
+/// Write string as JSON string literal.
+void writeJSONString(std::ostream &OS, const std::string &Str) {
+  OS << '"';
+  for (const char C : Str) {
+    switch (C) {
+    case '"':
+      OS << "\\\"";
+      break;
+    case '\\':
+      OS << "\\\\";
+      break;
+    default:
+      if (static_cast<unsigned char>(C) < 0x20) {
+        char Buf[8];
+        std::snprintf(Buf, sizeof(Buf), "\\u%04x", C);
+        OS << Buf;
+      } else {
+        OS << C;
+      }
+    }
+  }
+  OS << '"';
+}
+
+/// Write function name as a frame of collapsed stack, which is separated by
+/// semicolons and ended by space.
+void writeFrameName(std::ostream &OS, const std::string &Str) {
+  for (const char C : Str) {
+    OS << ((C == ';' || C == ' ' || C == '\n') ? '_' : C);
+  }
+}
+
+} // namespace
+
+void Profile::enterFunction(const void *Func, const uint64_t InstrCnt) {
+  /// Find or create the call tree node under the caller.
+  const uint32_t Parent = Frames.empty() ? 0 : Frames.back().Node;
+  auto [It, Added] = Children.try_emplace(
+      std::make_pair(Parent, Func), static_cast<uint32_t>(Nodes.size()));
+  if (Added) {
+    Nodes.push_back({Parent, Func, 0});
+  }
+
+  auto &Stat = Funcs[Func];
+  ++Stat.Calls;
+  ++Stat.Active;
+  Frames.push_back({Func, It->second, InstrCnt, Clock::now(), 0, {}});
+}
+
+void Profile::leaveFunction(const uint64_t InstrCnt) {
+  if (Frames.empty()) {
+    return;
+  }
+  const auto Now = Clock::now();
+  const Frame Top = Frames.back();
+  Frames.pop_back();
+
+  const uint64_t InclInstr = InstrCnt - Top.StartInstr;
+  const Clock::duration InclTime = Now - Top.StartTime;
+  const uint64_t ExclInstr = InclInstr - Top.ChildInstr;
+  auto &Stat = Funcs[Top.Func];
+  Stat.ExclInstr += ExclInstr;
+  Stat.ExclTime += InclTime - Top.ChildTime;
+  if (--Stat.Active == 0) {
+    Stat.InclInstr += InclInstr;
+    Stat.InclTime += InclTime;
+  }
+  Nodes[Top.Node].ExclInstr += ExclInstr;
+
+  if (!Frames.empty()) {
+    Frames.back().ChildInstr += InclInstr;
+    Frames.back().ChildTime += InclTime;
+  }
+}
+
+void Profile::leaveAllFunctions(const uint64_t InstrCnt) {
+  while (!Frames.empty()) {
+    leaveFunction(InstrCnt);
+  }
+}
+
+void Profile::recordHostCall(const void *Func, const Clock::duration Latency) {
+  auto &Stat = Hosts[Func];
+  ++Stat.Calls;
+  Stat.Time += Latency;
+  /// Host function time is not counted as the exclusive time of caller.
+  if (!Frames.empty()) {
+    Frames.back().ChildTime += Latency;
+  }
+}
+
+void Profile::dumpJSON(std::ostream &OS) const {
+  OS << "{\n  \"opcodes\": {";
+  bool First = true;
+  for (uint32_t I = 0; I < 256; ++I) {
+    if (OpCodeCnt[I] == 0) {
+      continue;
+    }
+    char Buf[8];
+    std::snprintf(Buf, sizeof(Buf), "0x%02x", I);
+    OS << (First ? "\n    \"" : ",\n    \"") << Buf << "\": " << OpCodeCnt[I];
+    First = false;
+  }
+  OS << (First ? "},\n" : "\n  },\n");
+
+  /// Functions are sorted by exclusive instructions in descending order.
+  std::vector<std::pair<std::string, const FuncStat *>> FuncList;
+  for (const auto &[Func, Stat] : Funcs) {
+    FuncList.emplace_back(getName(Func), &Stat);
+  }
+  std::sort(FuncList.begin(), FuncList.end(), [](const auto &A, const auto &B) {
+    if (A.second->ExclInstr != B.second->ExclInstr) {
+      return A.second->ExclInstr > B.second->ExclInstr;
+    }
+    return A.first < B.first;
+  });
+  OS << "  \"functions\": [";
+  First = true;
+  for (const auto &[Name, Stat] : FuncList) {
+    OS << (First ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    writeJSONString(OS, Name);
+    OS << ", \"calls\": " << Stat->Calls
+       << ", \"inclusive_instructions\": " << Stat->InclInstr
+       << ", \"exclusive_instructions\": " << Stat->ExclInstr
+       << ", \"inclusive_time_ns\": " << toNanoseconds(Stat->InclTime)
+       << ", \"exclusive_time_ns\": " << toNanoseconds(Stat->ExclTime) << "}";
+    First = false;
+  }
+  OS << (First ? "],\n" : "\n  ],\n");
+
+  /// Host functions are sorted by time in descending order.
+  std::vector<std::pair<std::string, const HostStat *>> HostList;
+  for (const auto &[Func, Stat] : Hosts) {
+    HostList.emplace_back(getName(Func), &Stat);
+  }
+  std::sort(HostList.begin(), HostList.end(), [](const auto &A, const auto &B) {
+    if (A.second->Time != B.second->Time) {
+      return A.second->Time > B.second->Time;
+    }
+    return A.first < B.first;
+  });
+  OS << "  \"host_functions\": [";
+  First = true;
+  for (const auto &[Name, Stat] : HostList) {
+    OS << (First ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    writeJSONString(OS, Name);
+    OS << ", \"calls\": " << Stat->Calls
+       << ", \"time_ns\": " << toNanoseconds(Stat->Time)
+       << ", \"average_latency_ns\": "
+       << toNanoseconds(Stat->Time) / Stat->Calls << "}";
+    First = false;
+  }
+  OS << (First ? "]\n}\n" : "\n  ]\n}\n");
+}
+
+void Profile::dumpCollapsed(std::ostream &OS) const {
+  std::vector<std::string> Lines;
+  std::vector<uint32_t> Path;
+  for (uint32_t I = 1; I < Nodes.size(); ++I) {
+    if (Nodes[I].ExclInstr == 0) {
+      continue;
+    }
+    /// Collect the call stack from the root.
+    Path.clear();
+    for (uint32_t N = I; N != 0; N = Nodes[N].Parent) {
+      Path.push_back(N);
+    }
+    std::ostringstream Line;
+    for (auto It = Path.rbegin(); It != Path.rend(); ++It) {
+      if (It != Path.rbegin()) {
+        Line << ';';
+      }
+      writeFrameName(Line, getName(Nodes[*It].Func));
+    }
+    Line << ' ' << Nodes[I].ExclInstr;
+    Lines.push_back(Line.str());
+  }
+  std::sort(Lines.begin(), Lines.end());
+  for (const auto &Line : Lines) {
+    OS << Line << '\n';
+  }
+}
+
+void Profile::clear() {
+  OpCodeCnt.fill(0);
+  Funcs.clear();
+  Hosts.clear();
+  Nodes.resize(1);
+  Children.clear();
+  Frames.clear();
+}
+
+std::string Profile::getName(const void *Func) const {
+  if (auto It = Names.find(Func); It != Names.end()) {
+    return It->second;
+  }
+  char Buf[32];
+  std::snprintf(Buf, sizeof(Buf), "func@%p", Func);
+  return Buf;
+}
+
+} // namespace Support
+} // namespace SSVM
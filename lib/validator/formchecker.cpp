@@ -26,7 +26,7 @@ Expect<void> FormChecker::validate(const AST::InstrVec &Instrs,
   for (ValType Val : RetVals) {
     Returns.push_back(ASTToVType(Val));
   }
-  pushCtrl({}, Returns);
+  pushCtrl(Returns, Returns);
   return checkInstrs(Instrs);
 }
 
@@ -35,7 +35,7 @@ Expect<void> FormChecker::validate(const AST::InstrVec &Instrs,
   for (VType Val : RetVals) {
     Returns.push_back(Val);
   }
-  pushCtrl({}, Returns);
+  pushCtrl(Returns, Returns);
   return checkInstrs(Instrs);
 }
 
@@ -94,6 +94,16 @@ VType FormChecker::ASTToVType(const ValType &V) {
   }
 }
 
+AST::BranchTarget FormChecker::getBranchTarget(const uint32_t N) const {
+  /// Locals, including arguments, occupy the bottom of frame.
+  AST::BranchTarget Target;
+  Target.Height = Locals.size() + CtrlStack[N].Height;
+  Target.Arity = CtrlStack[N].LabelTypes.size();
+  Target.IsLoop = CtrlStack[N].IsLoop;
+  Target.Resolved = true;
+  return Target;
+}
+
 Expect<void> FormChecker::checkInstrs(const AST::InstrVec &Instrs) {
   for (auto &Instr : Instrs) {
     OpCode Code = Instr->getOpCode();
@@ -107,7 +117,7 @@ Expect<void> FormChecker::checkInstrs(const AST::InstrVec &Instrs) {
             /// Check the corresponding instruction.
             return checkInstr(
                 *static_cast<typename std::decay_t<decltype(Arg)>::type *>(
-                    Instr.get()));
+                    Instr));
           }
         });
     if (!Res) {
@@ -149,7 +159,7 @@ FormChecker::checkInstr(const AST::BlockControlInstruction &Instr) {
   }
   case OpCode::Loop: {
     /// Push ctrl frame ([], [t*])
-    pushCtrl({}, ResVec);
+    pushCtrl({}, ResVec, true);
     break;
   }
   default:
@@ -213,6 +223,7 @@ Expect<void> FormChecker::checkInstr(const AST::BrControlInstruction &Instr) {
     /// Branch out of stack
     return Unexpect(ErrCode::ValidationFailed);
   }
+  Instr.setTarget(getBranchTarget(N));
   switch (Instr.getOpCode()) {
   case OpCode::Br: {
     if (auto Res = popTypes(CtrlStack[N].LabelTypes); !Res) {
@@ -245,7 +256,9 @@ FormChecker::checkInstr(const AST::BrTableControlInstruction &Instr) {
       /// Branch out of table index
       return Unexpect(ErrCode::ValidationFailed);
     }
-    for (auto &N : Instr.getLabelTable()) {
+    const auto LabelTable = Instr.getLabelTable();
+    for (uint32_t I = 0; I < LabelTable.size(); ++I) {
+      const uint32_t N = LabelTable[I];
       // Error_if(ctrls.size() < n || ctrls[n].label_types =/=
       // ctrls[m].label_types)
       if (CtrlStack.size() <= N) {
@@ -256,7 +269,9 @@ FormChecker::checkInstr(const AST::BrTableControlInstruction &Instr) {
         /// CtrlStack[N].label_types != CtrlStack[M].label_types
         return Unexpect(ErrCode::ValidationFailed);
       }
+      Instr.setTarget(I, getBranchTarget(N));
     }
+    Instr.setTarget(LabelTable.size(), getBranchTarget(M));
     if (auto Res = popType(VType::I32); !Res) {
       return Unexpect(Res);
     }
@@ -717,11 +732,12 @@ Expect<void> FormChecker::popTypes(const std::vector<VType> &Input) {
 }
 
 void FormChecker::pushCtrl(const std::vector<VType> &Label,
-                           const std::vector<VType> &Out) {
+                           const std::vector<VType> &Out, const bool IsLoop) {
   CtrlFrame Frame = {.LabelTypes = Label,
                      .EndTypes = Out,
                      .Height = ValStack.size(),
-                     .IsUnreachable = false};
+                     .IsUnreachable = false,
+                     .IsLoop = IsLoop};
   CtrlStack.emplace_front(Frame);
 }
 
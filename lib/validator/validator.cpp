@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "validator/validator.h"
 #include "common/ast/module.h"
+#include "support/parallel.h"
 
+#include <memory>
 #include <string>
 #include <unordered_set>
 
@@ -155,23 +157,24 @@ Expect<void> Validator::validate(const AST::ElementSegment &ElemSeg) {
 }
 
 /// Validate Code segment. See "include/validator/validator.h".
-Expect<void> Validator::validate(const AST::CodeSegment &CodeSeg,
+Expect<void> Validator::validate(FormChecker &FuncChecker,
+                                 const AST::CodeSegment &CodeSeg,
                                  const uint32_t TypeIdx) {
   /// Reset stack in FormChecker.
-  Checker.reset();
+  FuncChecker.reset();
   /// Add parameters into this frame.
-  for (auto Val : Checker.getTypes()[TypeIdx].first) {
-    Checker.addLocal(Val);
+  for (auto Val : FuncChecker.getTypes()[TypeIdx].first) {
+    FuncChecker.addLocal(Val);
   }
   /// Add locals into this frame.
   for (auto Val : CodeSeg.getLocals()) {
     for (uint32_t Cnt = 0; Cnt < Val.first; ++Cnt) {
-      Checker.addLocal(Val.second);
+      FuncChecker.addLocal(Val.second);
     }
   }
   /// Validate function body expression.
-  return Checker.validate(CodeSeg.getInstrs(),
-                          Checker.getTypes()[TypeIdx].second);
+  return FuncChecker.validate(CodeSeg.getInstrs(),
+                              FuncChecker.getTypes()[TypeIdx].second);
 }
 
 /// Validate Data segment. See "include/validator/validator.h".
@@ -298,12 +301,37 @@ Expect<void> Validator::validate(const AST::FunctionSection &FuncSec,
     Checker.addFunc(TId);
   }
 
-  /// Validate function body.
-  for (size_t Id = 0; Id < FuncVec.size(); ++Id) {
-    uint32_t TId = FuncVec[Id];
-    if (auto Res = validate(*CodeVec[Id].get(), TId); !Res) {
-      return Unexpect(Res);
-    }
+  /// Lazily loaded function bodies are validated on first use, by a copy of
+  /// FormChecker with the same contexts.
+  if (CodeSec.isLazy()) {
+    CodeSec.setLazyChecker(
+        [FuncChecker = std::make_shared<FormChecker>(Checker),
+         TypeIdxs = &FuncVec](const AST::CodeSegment &CodeSeg,
+                              const uint32_t Id) {
+          return validate(*FuncChecker, CodeSeg, (*TypeIdxs)[Id]);
+        });
+    return {};
+  }
+
+  /// Validate function bodies. Each worker has its own copy of FormChecker
+  /// with the same contexts.
+  const uint32_t Workers =
+      Support::getWorkerCount(ThreadCount, FuncVec.size());
+  std::vector<FormChecker> Checkers(Workers - 1, Checker);
+  std::vector<ErrCode> Errors(FuncVec.size(), ErrCode::Success);
+  const size_t Failed = Support::parallelFor(
+      FuncVec.size(), Workers, [&](uint32_t Worker, size_t Id) {
+        FormChecker &FuncChecker =
+            (Worker == 0) ? Checker : Checkers[Worker - 1];
+        if (auto Res = validate(FuncChecker, *CodeVec[Id].get(), FuncVec[Id]);
+            !Res) {
+          Errors[Id] = Res.error();
+          return false;
+        }
+        return true;
+      });
+  if (Failed < FuncVec.size()) {
+    return Unexpect(Errors[Failed]);
   }
   return {};
 }
@@ -406,7 +434,7 @@ Expect<void> Validator::validateConstExpr(const AST::InstrVec &Instrs,
       /// For global initialization case, global indices must be imported
       /// globals.
       if (RestrictGlobal) {
-        auto GlobInstr = static_cast<AST::VariableInstruction *>(Instr.get());
+        auto GlobInstr = static_cast<AST::VariableInstruction *>(Instr);
         if (GlobInstr->getVariableIndex() >= Checker.getNumImportGlobals()) {
           return Unexpect(ErrCode::ValidationFailed);
         }
@@ -185,6 +185,7 @@ TEST(SectionTest, LoadTableSection) {
   ///   2.  Load table section without contents.
   ///   3.  Load table section with zero vector length.
   ///   4.  Load table section with contents.
+  ///   5.  Load table section with wrong content size.
   Mgr.clearBuffer();
   SSVM::AST::TableSection Sec1;
   EXPECT_FALSE(Sec1.loadBinary(Mgr));
@@ -217,6 +218,19 @@ TEST(SectionTest, LoadTableSection) {
   Mgr.setCode(Vec4);
   SSVM::AST::TableSection Sec4;
   EXPECT_TRUE(Sec4.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec5 = {
+      0x91U, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 17
+      0x03U,                             /// Vector length = 3
+      0x70U, 0x01U, 0x00U, 0x0FU,        /// vec[0]
+      0x70U, 0x01U, 0x00U, 0x0EU,        /// vec[1]
+      0x70U, 0x01U, 0x00U, 0x0DU,        /// vec[2]
+      0x70U, 0x00U, 0x00U, 0x00U         /// Following bytes
+  };
+  Mgr.setCode(Vec5);
+  SSVM::AST::TableSection Sec5;
+  EXPECT_FALSE(Sec5.loadBinary(Mgr));
 }
 
 TEST(SectionTest, LoadMemorySection) {
@@ -433,6 +447,7 @@ TEST(SectionTest, LoadCodeSection) {
   ///   2.  Load code section without contents.
   ///   3.  Load code section with zero vector length.
   ///   4.  Load code section with contents.
+  ///   5.  Load code section with wrong code segment size.
   Mgr.clearBuffer();
   SSVM::AST::CodeSection Sec1;
   EXPECT_FALSE(Sec1.loadBinary(Mgr));
@@ -474,6 +489,169 @@ TEST(SectionTest, LoadCodeSection) {
   Mgr.setCode(Vec4);
   SSVM::AST::CodeSection Sec4;
   EXPECT_TRUE(Sec4.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec5 = {
+      0x90U, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 16
+      0x01U,                             /// Vector length = 1
+      /// vec[0]
+      0x8AU, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 10
+      0x02U, 0x01U, 0x7CU, 0x02U, 0x7DU, /// Local vec(2)
+      0x45U, 0x46U, 0x47U, 0x0BU,        /// Expression
+      0x01U                              /// Byte after expression
+  };
+  Mgr.setCode(Vec5);
+  SSVM::AST::CodeSection Sec5;
+  EXPECT_FALSE(Sec5.loadBinary(Mgr));
+}
+
+TEST(SectionTest, LoadCodeSectionParallel) {
+  /// 11-1. Test load code section with multiple threads.
+  ///
+  ///   1.  Load code section with contents.
+  ///   2.  Load code section with a segment size mismatched to its body.
+  ///   3.  Load code section with an invalid body.
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec1 = {
+      0xABU, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 43
+      0x03U,                             /// Vector length = 3
+      /// vec[0]
+      0x89U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 9
+      0x02U, 0x01U, 0x7CU, 0x02U, 0x7DU, /// Local vec(2)
+      0x45U, 0x46U, 0x47U, 0x0BU,        /// Expression
+      /// vec[1]
+      0x89U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 9
+      0x02U, 0x03U, 0x7CU, 0x04U, 0x7DU, /// Local vec(2)
+      0x45U, 0x46U, 0x47U, 0x0BU,        /// Expression
+      /// vec[2]
+      0x89U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 9
+      0x02U, 0x05U, 0x7CU, 0x06U, 0x7DU, /// Local vec(2)
+      0x45U, 0x46U, 0x47U, 0x0BU         /// Expression
+  };
+  Mgr.setCode(Vec1);
+  SSVM::AST::CodeSection Sec1;
+  Sec1.setThreadCount(4);
+  ASSERT_TRUE(Sec1.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+  ASSERT_EQ(3U, Sec1.getContent().size());
+  EXPECT_EQ(5U, Sec1.getContent()[2]->getLocals()[0].first);
+
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec2 = {
+      0x90U, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 16
+      0x01U,                             /// Vector length = 1
+      0x8AU, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 10
+      0x00U,                             /// Local vec(0)
+      0x45U, 0x46U, 0x47U, 0x0BU,        /// Expression
+      0x01U, 0x01U, 0x01U, 0x01U, 0x01U  /// Remaining bytes
+  };
+  Mgr.setCode(Vec2);
+  SSVM::AST::CodeSection Sec2;
+  Sec2.setThreadCount(4);
+  EXPECT_FALSE(Sec2.loadBinary(Mgr));
+
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec3 = {
+      0x8DU, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 13
+      0x02U,                             /// Vector length = 2
+      0x85U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 5
+      0x00U,                             /// Local vec(0)
+      0x45U, 0x46U, 0x47U, 0x0BU,        /// Expression
+      0x81U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 1
+      0x01U                              /// Truncated local vec
+  };
+  Mgr.setCode(Vec3);
+  SSVM::AST::CodeSection Sec3;
+  Sec3.setThreadCount(4);
+  EXPECT_FALSE(Sec3.loadBinary(Mgr));
+}
+
+TEST(SectionTest, LoadCodeSectionLazy) {
+  /// 11-2. Test load code section lazily.
+  ///
+  ///   1.  Load code section with contents and decode on first use.
+  ///   2.  Load code section with an invalid body, which fails decoding.
+  ///   3.  Load code section with a validator of decoded bodies.
+  ///   4.  Decode a body before setting the validator, which validates it on
+  ///       the next decoding.
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec1 = {
+      0x99U, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 25
+      0x02U,                             /// Vector length = 2
+      /// vec[0]
+      0x89U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 9
+      0x02U, 0x01U, 0x7CU, 0x02U, 0x7DU, /// Local vec(2)
+      0x45U, 0x46U, 0x47U, 0x0BU,        /// Expression
+      /// vec[1]
+      0x85U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 5
+      0x00U,                             /// Local vec(0)
+      0x45U, 0x46U, 0x47U, 0x0BU         /// Expression
+  };
+  Mgr.setCode(Vec1);
+  SSVM::AST::CodeSection Sec1;
+  Sec1.setLazy(true);
+  ASSERT_TRUE(Sec1.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+  ASSERT_TRUE(Sec1.isLazy());
+  ASSERT_EQ(2U, Sec1.getContent().size());
+  const auto &Seg1 = *Sec1.getContent()[0];
+  EXPECT_TRUE(Seg1.getLocals().empty());
+  EXPECT_TRUE(Seg1.decodeBody());
+  EXPECT_EQ(2U, Seg1.getLocals().size());
+  EXPECT_EQ(3U, Seg1.getInstrs().size());
+  EXPECT_TRUE(Seg1.decodeBody());
+  EXPECT_EQ(2U, Seg1.getLocals().size());
+
+  Mgr.clearBuffer();
+  std::vector<unsigned char> Vec2 = {
+      0x8BU, 0x80U, 0x80U, 0x80U, 0x00U, /// Content size = 11
+      0x01U,                             /// Vector length = 1
+      0x85U, 0x80U, 0x80U, 0x80U, 0x00U, /// Code segment size = 5
+      0x00U,                             /// Local vec(0)
+      0x45U, 0x46U, 0x47U, 0x47U         /// Expression without end
+  };
+  Mgr.setCode(Vec2);
+  SSVM::AST::CodeSection Sec2;
+  Sec2.setLazy(true);
+  ASSERT_TRUE(Sec2.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+  EXPECT_FALSE(Sec2.getContent()[0]->decodeBody());
+  EXPECT_FALSE(Sec2.getContent()[0]->decodeBody());
+
+  Mgr.clearBuffer();
+  Mgr.setCode(Vec1);
+  SSVM::AST::CodeSection Sec3;
+  Sec3.setLazy(true);
+  ASSERT_TRUE(Sec3.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+  uint32_t Checked = 0;
+  Sec3.setLazyChecker([&Checked](const SSVM::AST::CodeSegment &,
+                                 const uint32_t Idx) -> SSVM::Expect<void> {
+    ++Checked;
+    if (Idx == 1) {
+      return SSVM::Unexpect(SSVM::ErrCode::ValidationFailed);
+    }
+    return {};
+  });
+  EXPECT_TRUE(Sec3.getContent()[0]->decodeBody());
+  EXPECT_FALSE(Sec3.getContent()[1]->decodeBody());
+  EXPECT_FALSE(Sec3.getContent()[1]->decodeBody());
+  EXPECT_EQ(2U, Checked);
+
+  Mgr.clearBuffer();
+  Mgr.setCode(Vec1);
+  SSVM::AST::CodeSection Sec4;
+  Sec4.setLazy(true);
+  ASSERT_TRUE(Sec4.loadBinary(Mgr) && Mgr.getRemainSize() == 0);
+  const auto &Seg4 = *Sec4.getContent()[1];
+  EXPECT_TRUE(Seg4.decodeBody());
+  EXPECT_EQ(3U, Seg4.getInstrs().size());
+  Checked = 0;
+  Sec4.setLazyChecker([&Checked](const SSVM::AST::CodeSegment &,
+                                 const uint32_t) -> SSVM::Expect<void> {
+    ++Checked;
+    return SSVM::Unexpect(SSVM::ErrCode::ValidationFailed);
+  });
+  EXPECT_FALSE(Seg4.decodeBody());
+  EXPECT_FALSE(Seg4.decodeBody());
+  EXPECT_EQ(1U, Checked);
+  EXPECT_EQ(3U, Seg4.getInstrs().size());
 }
 
 TEST(SectionTest, LoadDataSection) {
@@ -19,6 +19,7 @@
 #include "example_host.h"
 
 #include <cstring>
+#include <dlfcn.h>
 #include <iostream>
 
 namespace {
@@ -286,6 +287,51 @@ TEST(EVMCTest, Run__9_check_balance_of_0x7FFFFFFF) {
     result.release(&result);
 }
 
+TEST(EVMCTest, Run_10_module_cache) {
+  enum evmc_loader_error_code err;
+  struct evmc_instance *vm = evmc_load_and_create(evmc_library.c_str(), &err);
+  EXPECT_EQ(err, EVMC_LOADER_SUCCESS);
+  void *handle = dlopen(evmc_library.c_str(), RTLD_NOW | RTLD_NOLOAD);
+  ASSERT_NE(handle, nullptr);
+  auto get_cache_stats =
+      reinterpret_cast<void (*)(evmc_instance *, uint64_t *, uint64_t *)>(
+          dlsym(handle, "ssvm_evmc_get_cache_stats"));
+  ASSERT_NE(get_cache_stats, nullptr);
+
+  /// Same code is validated once and reused by later calls.
+  std::string SenderStr = "000000000000000000000000000000007fffffff";
+  std::string CallDataStr = "18160ddd";
+  for (int i = 0; i < 3; i++) {
+    evmc_result result = evmc_vm_execute(vm, SenderStr, CallDataStr);
+    EXPECT_EQ(result.status_code, EVMC_SUCCESS);
+    EXPECT_EQ(result.output_size, 32U);
+    EXPECT_EQ(0x03, result.output_data[30]);
+    EXPECT_EQ(0xe8, result.output_data[31]);
+    if (result.release)
+      result.release(&result);
+  }
+  uint64_t hits = 0, misses = 0;
+  get_cache_stats(vm, &hits, &misses);
+  EXPECT_EQ(hits, 2U);
+  EXPECT_EQ(misses, 1U);
+
+  /// Disabled cache validates the code on every call.
+  EXPECT_EQ(vm->set_option(vm, "cache-size", "0"), EVMC_SET_OPTION_SUCCESS);
+  EXPECT_EQ(vm->set_option(vm, "cache-size", "x"),
+            EVMC_SET_OPTION_INVALID_VALUE);
+  EXPECT_EQ(vm->set_option(vm, "unknown", "0"), EVMC_SET_OPTION_INVALID_NAME);
+  evmc_result result = evmc_vm_execute(vm, SenderStr, CallDataStr);
+  EXPECT_EQ(result.status_code, EVMC_SUCCESS);
+  if (result.release)
+    result.release(&result);
+  get_cache_stats(vm, &hits, &misses);
+  EXPECT_EQ(hits, 2U);
+  EXPECT_EQ(misses, 2U);
+
+  vm->destroy(vm);
+  dlclose(handle);
+}
+
 } // namespace
 
 GTEST_API_ int main(int argc, char **argv) {
@@ -0,0 +1,449 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/test/interpreter/engineTest.cpp - Interpreter engine tests ---===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contents tests comparing the results of the AST, flat, and tiered
+/// interpreter engines on the same inputs.
+///
+//===----------------------------------------------------------------------===//
+
+#include "expvm/configure.h"
+#include "expvm/snapshot.h"
+#include "expvm/vm.h"
+#include "interpreter/interpreter.h"
+#include "loader/loader.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using SSVM::ErrCode;
+using SSVM::ValVariant;
+using SSVM::ExpVM::Configure;
+
+/// Module with one page of memory and a table of {sum, switch, div}.
+/// Exported functions:
+///   fac(i64) -> i64:          recursive factorial.
+///   sum(i32) -> i32:          sum of 1..n in a loop with br_if.
+///   switch(i32) -> i32:       br_table to 10, 20, 30, and default 40.
+///   nested(i32) -> i32:       br_if out of a block with value 100, else 7,
+///                             plus 1.
+///   div(i32, i32) -> i32:     i32.div_s.
+///   unreachable() -> i32:     unreachable.
+///   load(i32) -> i32:         i32.load at the address.
+///   indirect(i32, i32) -> i32: call_indirect (i32) -> i32 of table[b] with a.
+///   trunc32(i32) -> i32:      i32.trunc_f32_s(f32.trunc(f32(x) / 4)).
+///   trunc64(i32) -> i32:      i32.trunc_f64_s(f64.trunc(f64(x) / 4)).
+///   tconv(i32) -> i32:        i32.trunc_f32_s(f32(x) / 0).
+///   even(i32) -> i32:         mutual recursion with odd.
+///   odd(i32) -> i32:          mutual recursion with even.
+///   memrw(i32) -> i32:        store x at 8, and load it back plus x.
+const std::vector<uint8_t> EngineModule = {
+    0x00U, 0x61U, 0x73U, 0x6DU, 0x01U, 0x00U, 0x00U, 0x00U, 0x01U, 0x15U,
+    0x04U, 0x60U, 0x01U, 0x7FU, 0x01U, 0x7FU, 0x60U, 0x01U, 0x7EU, 0x01U,
+    0x7EU, 0x60U, 0x02U, 0x7FU, 0x7FU, 0x01U, 0x7FU, 0x60U, 0x00U, 0x01U,
+    0x7FU, 0x03U, 0x0FU, 0x0EU, 0x01U, 0x00U, 0x00U, 0x00U, 0x02U, 0x03U,
+    0x00U, 0x02U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x04U, 0x04U,
+    0x01U, 0x70U, 0x00U, 0x03U, 0x05U, 0x03U, 0x01U, 0x00U, 0x01U, 0x07U,
+    0x76U, 0x0EU, 0x03U, 0x66U, 0x61U, 0x63U, 0x00U, 0x00U, 0x03U, 0x73U,
+    0x75U, 0x6DU, 0x00U, 0x01U, 0x06U, 0x73U, 0x77U, 0x69U, 0x74U, 0x63U,
+    0x68U, 0x00U, 0x02U, 0x06U, 0x6EU, 0x65U, 0x73U, 0x74U, 0x65U, 0x64U,
+    0x00U, 0x03U, 0x03U, 0x64U, 0x69U, 0x76U, 0x00U, 0x04U, 0x0BU, 0x75U,
+    0x6EU, 0x72U, 0x65U, 0x61U, 0x63U, 0x68U, 0x61U, 0x62U, 0x6CU, 0x65U,
+    0x00U, 0x05U, 0x04U, 0x6CU, 0x6FU, 0x61U, 0x64U, 0x00U, 0x06U, 0x08U,
+    0x69U, 0x6EU, 0x64U, 0x69U, 0x72U, 0x65U, 0x63U, 0x74U, 0x00U, 0x07U,
+    0x07U, 0x74U, 0x72U, 0x75U, 0x6EU, 0x63U, 0x33U, 0x32U, 0x00U, 0x08U,
+    0x07U, 0x74U, 0x72U, 0x75U, 0x6EU, 0x63U, 0x36U, 0x34U, 0x00U, 0x09U,
+    0x05U, 0x74U, 0x63U, 0x6FU, 0x6EU, 0x76U, 0x00U, 0x0AU, 0x04U, 0x65U,
+    0x76U, 0x65U, 0x6EU, 0x00U, 0x0BU, 0x03U, 0x6FU, 0x64U, 0x64U, 0x00U,
+    0x0CU, 0x05U, 0x6DU, 0x65U, 0x6DU, 0x72U, 0x77U, 0x00U, 0x0DU, 0x09U,
+    0x09U, 0x01U, 0x00U, 0x41U, 0x00U, 0x0BU, 0x03U, 0x01U, 0x02U, 0x04U,
+    0x0AU, 0xF3U, 0x01U, 0x0EU, 0x17U, 0x00U, 0x20U, 0x00U, 0x42U, 0x01U,
+    0x57U, 0x04U, 0x7EU, 0x42U, 0x01U, 0x05U, 0x20U, 0x00U, 0x20U, 0x00U,
+    0x42U, 0x01U, 0x7DU, 0x10U, 0x00U, 0x7EU, 0x0BU, 0x0BU, 0x21U, 0x01U,
+    0x01U, 0x7FU, 0x02U, 0x40U, 0x03U, 0x40U, 0x20U, 0x00U, 0x45U, 0x0DU,
+    0x01U, 0x20U, 0x01U, 0x20U, 0x00U, 0x6AU, 0x21U, 0x01U, 0x20U, 0x00U,
+    0x41U, 0x01U, 0x6BU, 0x21U, 0x00U, 0x0CU, 0x00U, 0x0BU, 0x0BU, 0x20U,
+    0x01U, 0x0BU, 0x21U, 0x00U, 0x02U, 0x40U, 0x02U, 0x40U, 0x02U, 0x40U,
+    0x02U, 0x40U, 0x20U, 0x00U, 0x0EU, 0x03U, 0x00U, 0x01U, 0x02U, 0x03U,
+    0x0BU, 0x41U, 0x0AU, 0x0FU, 0x0BU, 0x41U, 0x14U, 0x0FU, 0x0BU, 0x41U,
+    0x1EU, 0x0FU, 0x0BU, 0x41U, 0x28U, 0x0BU, 0x12U, 0x00U, 0x02U, 0x7FU,
+    0x41U, 0xE4U, 0x00U, 0x20U, 0x00U, 0x0DU, 0x00U, 0x1AU, 0x41U, 0x07U,
+    0x0BU, 0x41U, 0x01U, 0x6AU, 0x0BU, 0x07U, 0x00U, 0x20U, 0x00U, 0x20U,
+    0x01U, 0x6DU, 0x0BU, 0x03U, 0x00U, 0x00U, 0x0BU, 0x07U, 0x00U, 0x20U,
+    0x00U, 0x28U, 0x02U, 0x00U, 0x0BU, 0x09U, 0x00U, 0x20U, 0x00U, 0x20U,
+    0x01U, 0x11U, 0x00U, 0x00U, 0x0BU, 0x0DU, 0x00U, 0x20U, 0x00U, 0xB2U,
+    0x43U, 0x00U, 0x00U, 0x80U, 0x40U, 0x95U, 0x8FU, 0xA8U, 0x0BU, 0x11U,
+    0x00U, 0x20U, 0x00U, 0xB7U, 0x44U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+    0x00U, 0x10U, 0x40U, 0xA3U, 0x9DU, 0xAAU, 0x0BU, 0x0CU, 0x00U, 0x20U,
+    0x00U, 0xB2U, 0x43U, 0x00U, 0x00U, 0x00U, 0x00U, 0x95U, 0xA8U, 0x0BU,
+    0x12U, 0x00U, 0x20U, 0x00U, 0x45U, 0x04U, 0x7FU, 0x41U, 0x01U, 0x05U,
+    0x20U, 0x00U, 0x41U, 0x01U, 0x6BU, 0x10U, 0x0CU, 0x0BU, 0x0BU, 0x12U,
+    0x00U, 0x20U, 0x00U, 0x45U, 0x04U, 0x7FU, 0x41U, 0x00U, 0x05U, 0x20U,
+    0x00U, 0x41U, 0x01U, 0x6BU, 0x10U, 0x0BU, 0x0BU, 0x0BU, 0x11U, 0x00U,
+    0x41U, 0x08U, 0x20U, 0x00U, 0x36U, 0x02U, 0x00U, 0x41U, 0x08U, 0x28U,
+    0x02U, 0x00U, 0x20U, 0x00U, 0x6AU, 0x0BU,
+};
+
+/// Function invocation and its expected result.
+struct Case {
+  std::string Func;
+  std::vector<ValVariant> Params;
+  /// Expected error code, or Success with the expected value.
+  ErrCode Err;
+  uint64_t Value;
+  /// The function returns i64 instead of i32.
+  bool IsI64;
+};
+
+const std::vector<Case> ControlCases = {
+    {"fac", {uint64_t(0)}, ErrCode::Success, 1, true},
+    {"fac", {uint64_t(5)}, ErrCode::Success, 120, true},
+    {"fac", {uint64_t(20)}, ErrCode::Success, 2432902008176640000ULL, true},
+    {"sum", {uint32_t(0)}, ErrCode::Success, 0, false},
+    {"sum", {uint32_t(100)}, ErrCode::Success, 5050, false},
+    {"switch", {uint32_t(0)}, ErrCode::Success, 10, false},
+    {"switch", {uint32_t(1)}, ErrCode::Success, 20, false},
+    {"switch", {uint32_t(2)}, ErrCode::Success, 30, false},
+    {"switch", {uint32_t(3)}, ErrCode::Success, 40, false},
+    {"switch", {uint32_t(UINT32_MAX)}, ErrCode::Success, 40, false},
+    {"nested", {uint32_t(0)}, ErrCode::Success, 8, false},
+    {"nested", {uint32_t(1)}, ErrCode::Success, 101, false},
+    {"div", {uint32_t(7), uint32_t(2)}, ErrCode::Success, 3, false},
+    {"div", {uint32_t(-7), uint32_t(2)}, ErrCode::Success, uint32_t(-3), false},
+    {"indirect", {uint32_t(5), uint32_t(0)}, ErrCode::Success, 15, false},
+    {"indirect", {uint32_t(2), uint32_t(1)}, ErrCode::Success, 30, false},
+    {"trunc32", {uint32_t(10)}, ErrCode::Success, 2, false},
+    {"trunc32", {uint32_t(-10)}, ErrCode::Success, uint32_t(-2), false},
+    {"trunc64", {uint32_t(10)}, ErrCode::Success, 2, false},
+    {"trunc64", {uint32_t(-10)}, ErrCode::Success, uint32_t(-2), false},
+    {"even", {uint32_t(10)}, ErrCode::Success, 1, false},
+    {"odd", {uint32_t(10)}, ErrCode::Success, 0, false},
+    {"load", {uint32_t(65532)}, ErrCode::Success, 0, false},
+    {"memrw", {uint32_t(5)}, ErrCode::Success, 10, false},
+};
+
+const std::vector<Case> TrapCases = {
+    {"div", {uint32_t(1), uint32_t(0)}, ErrCode::DivideByZero, 0, false},
+    {"unreachable", {}, ErrCode::Unreachable, 0, false},
+    {"load", {uint32_t(65533)}, ErrCode::MemorySizeExceeded, 0, false},
+    {"load", {uint32_t(UINT32_MAX)}, ErrCode::MemorySizeExceeded, 0, false},
+    {"indirect", {uint32_t(1), uint32_t(2)}, ErrCode::TypeNotMatch, 0, false},
+    {"indirect", {uint32_t(1), uint32_t(3)}, ErrCode::AccessForbidMemory, 0,
+     false},
+    {"tconv", {uint32_t(0)}, ErrCode::CastingError, 0, false},
+    {"tconv", {uint32_t(1)}, ErrCode::CastingError, 0, false},
+};
+
+/// Run the cases in a fresh VM of the engine each, and compare the results
+/// with the expected ones.
+void runCases(const std::vector<Case> &Cases,
+              const Configure::EngineType Engine,
+              const uint32_t Threshold = 1000) {
+  for (const auto &C : Cases) {
+    Configure Conf;
+    Conf.setEngineType(Engine);
+    Conf.setTierUpThreshold(Threshold);
+    SSVM::ExpVM::VM VM(Conf);
+    ASSERT_TRUE(VM.loadWasm(EngineModule));
+    ASSERT_TRUE(VM.validate());
+    ASSERT_TRUE(VM.instantiate());
+    auto Res = VM.execute(C.Func, C.Params);
+    SCOPED_TRACE(C.Func + " engine " + std::to_string(uint32_t(Engine)));
+    if (C.Err == ErrCode::Success) {
+      ASSERT_TRUE(Res);
+      ASSERT_EQ(1U, Res->size());
+      if (C.IsI64) {
+        EXPECT_EQ(C.Value, SSVM::retrieveValue<uint64_t>((*Res)[0]));
+      } else {
+        EXPECT_EQ(uint32_t(C.Value), SSVM::retrieveValue<uint32_t>((*Res)[0]));
+      }
+    } else {
+      ASSERT_FALSE(Res);
+      EXPECT_EQ(static_cast<uint32_t>(C.Err),
+                static_cast<uint32_t>(Res.error()));
+    }
+  }
+}
+
+TEST(EngineTest, ControlFlow) {
+  /// 1. Test control instructions and calls in each engine.
+  runCases(ControlCases, Configure::EngineType::AST);
+  runCases(ControlCases, Configure::EngineType::Flat);
+  runCases(ControlCases, Configure::EngineType::Tiered, 1);
+}
+
+TEST(EngineTest, Traps) {
+  /// 2. Test traps in each engine.
+  runCases(TrapCases, Configure::EngineType::AST);
+  runCases(TrapCases, Configure::EngineType::Flat);
+  runCases(TrapCases, Configure::EngineType::Tiered, 1);
+}
+
+/// Cost sums of the control cases, run with one table and again after
+/// changing to another.
+std::vector<uint64_t> runCosts(const Configure::EngineType Engine,
+                               const uint32_t Threshold = 1000) {
+  std::vector<uint64_t> TableA(256, 1), TableB(256);
+  for (uint32_t I = 0; I < 256; ++I) {
+    TableB[I] = I % 7 + 1;
+  }
+  Configure Conf;
+  Conf.setEngineType(Engine);
+  Conf.setTierUpThreshold(Threshold);
+  SSVM::ExpVM::VM VM(Conf);
+  auto &Measure = VM.getMeasurement();
+  Measure.setCostTable(TableA);
+  std::vector<uint64_t> Costs;
+  EXPECT_TRUE(VM.loadWasm(EngineModule));
+  EXPECT_TRUE(VM.validate());
+  EXPECT_TRUE(VM.instantiate());
+  for (const auto *Table : {&TableA, &TableB}) {
+    Measure.setCostTable(*Table);
+    for (const auto &C : ControlCases) {
+      Measure.getCostSum() = 0;
+      EXPECT_TRUE(VM.execute(C.Func, C.Params));
+      Costs.push_back(Measure.getCostSum());
+    }
+  }
+  return Costs;
+}
+
+TEST(EngineTest, CostTable) {
+  /// 3. Test costs follow the cost table changed after instantiation.
+  const auto Costs = runCosts(Configure::EngineType::AST);
+  ASSERT_EQ(ControlCases.size() * 2, Costs.size());
+  EXPECT_NE(std::vector<uint64_t>(Costs.begin(),
+                                  Costs.begin() + ControlCases.size()),
+            std::vector<uint64_t>(Costs.begin() + ControlCases.size(),
+                                  Costs.end()));
+  EXPECT_EQ(Costs, runCosts(Configure::EngineType::Flat));
+  EXPECT_EQ(Costs, runCosts(Configure::EngineType::Tiered, 1));
+}
+
+/// Results and cost sums of deep mutual recursions, run repeatedly in one VM
+/// so that the functions are promoted in the middle of the recursions.
+std::vector<uint64_t> runRecursions(const Configure::EngineType Engine,
+                                    const uint32_t Threshold = 1000) {
+  Configure Conf;
+  Conf.setEngineType(Engine);
+  Conf.setTierUpThreshold(Threshold);
+  SSVM::ExpVM::VM VM(Conf);
+  auto &Measure = VM.getMeasurement();
+  std::vector<uint64_t> Results;
+  EXPECT_TRUE(VM.loadWasm(EngineModule));
+  EXPECT_TRUE(VM.validate());
+  EXPECT_TRUE(VM.instantiate());
+  for (uint32_t I = 0; I < 8; ++I) {
+    for (const char *Func : {"even", "odd"}) {
+      Measure.getCostSum() = 0;
+      auto Res = VM.execute(Func, {uint32_t(20001 + I)});
+      EXPECT_TRUE(Res);
+      Results.push_back(Res ? SSVM::retrieveValue<uint32_t>((*Res)[0]) : 2);
+      Results.push_back(Measure.getCostSum());
+    }
+  }
+  return Results;
+}
+
+TEST(EngineTest, TierUpInRecursion) {
+  /// 4. Test calls and returns across tiers in deep recursions.
+  const auto Results = runRecursions(Configure::EngineType::AST);
+  ASSERT_EQ(32U, Results.size());
+  EXPECT_EQ(0U, Results[0]);
+  EXPECT_EQ(1U, Results[2]);
+  EXPECT_EQ(Results, runRecursions(Configure::EngineType::Flat));
+  for (const uint32_t Threshold : {1U, 2U, 100U, 5000U, 30000U}) {
+    SCOPED_TRACE("threshold " + std::to_string(Threshold));
+    EXPECT_EQ(Results, runRecursions(Configure::EngineType::Tiered, Threshold));
+  }
+}
+
+TEST(EngineTest, TierUpAfterStop) {
+  /// 5. Test functions dropped from the lowering queue are promoted later.
+  Configure Conf;
+  Conf.setEngineType(Configure::EngineType::Tiered);
+  Conf.setTierUpThreshold(1);
+  SSVM::ExpVM::VM VM(Conf);
+  ASSERT_TRUE(VM.loadWasm(EngineModule));
+  ASSERT_TRUE(VM.validate());
+  ASSERT_TRUE(VM.instantiate());
+  auto &StoreMgr = VM.getStoreManager();
+  const auto *Func =
+      *StoreMgr.getFunction(StoreMgr.getFuncExports().at("sum"));
+
+  /// Making the template stops lowering right after the request.
+  ASSERT_TRUE(VM.execute("sum", {uint32_t(1)}));
+  ASSERT_TRUE(VM.makeTemplate());
+  for (uint32_t I = 0; I < 500 && Func->getTieredCode() == nullptr; ++I) {
+    auto Res = VM.execute("sum", {uint32_t(1)});
+    ASSERT_TRUE(Res);
+    EXPECT_EQ(1U, SSVM::retrieveValue<uint32_t>((*Res)[0]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_NE(nullptr, Func->getTieredCode());
+}
+
+TEST(EngineTest, Image) {
+  /// 6. Test images are restored only into instances of the same module.
+  const std::string ImagePath = "engineTest.img";
+  Configure Conf;
+  Conf.setModuleHash(true);
+  {
+    SSVM::ExpVM::VM VM(Conf);
+    ASSERT_TRUE(VM.loadWasm(EngineModule));
+    ASSERT_TRUE(VM.validate());
+    ASSERT_TRUE(VM.instantiate());
+    ASSERT_TRUE(VM.execute("memrw", {uint32_t(42)}));
+    SSVM::ExpVM::Snapshot Image;
+    ASSERT_TRUE(Image.scan(VM.getStoreManager()));
+    ASSERT_TRUE(Image.write(ImagePath, true));
+  }
+  {
+    SSVM::ExpVM::VM VM(Conf);
+    ASSERT_TRUE(VM.loadWasm(EngineModule));
+    ASSERT_TRUE(VM.validate());
+    ASSERT_TRUE(VM.instantiate());
+    ASSERT_TRUE(VM.loadImage(ImagePath));
+    auto Res = VM.execute("load", {uint32_t(8)});
+    ASSERT_TRUE(Res);
+    EXPECT_EQ(42U, SSVM::retrieveValue<uint32_t>((*Res)[0]));
+    Res = VM.execute("indirect", {uint32_t(2), uint32_t(1)});
+    ASSERT_TRUE(Res);
+    EXPECT_EQ(30U, SSVM::retrieveValue<uint32_t>((*Res)[0]));
+  }
+  {
+    /// The module returning 11 instead of 10 in `switch`.
+    std::vector<uint8_t> Other = EngineModule;
+    const std::vector<uint8_t> Const10 = {0x41U, 0x0AU, 0x0FU};
+    auto It = std::search(Other.begin(), Other.end(), Const10.begin(),
+                          Const10.end());
+    ASSERT_NE(Other.end(), It);
+    *(It + 1) = 0x0BU;
+    SSVM::ExpVM::VM VM(Conf);
+    ASSERT_TRUE(VM.loadWasm(Other));
+    ASSERT_TRUE(VM.validate());
+    ASSERT_TRUE(VM.instantiate());
+    auto ImgRes = VM.loadImage(ImagePath);
+    ASSERT_FALSE(ImgRes);
+    EXPECT_EQ(ErrCode::ImportNotMatch, ImgRes.error());
+    auto Res = VM.execute("load", {uint32_t(8)});
+    ASSERT_TRUE(Res);
+    EXPECT_EQ(0U, SSVM::retrieveValue<uint32_t>((*Res)[0]));
+  }
+  {
+    /// Modules loaded without the digest are not bound to images.
+    Configure NoHashConf;
+    SSVM::ExpVM::VM VM(NoHashConf);
+    ASSERT_TRUE(VM.loadWasm(EngineModule));
+    ASSERT_TRUE(VM.validate());
+    ASSERT_TRUE(VM.instantiate());
+    auto ImgRes = VM.loadImage(ImagePath);
+    ASSERT_FALSE(ImgRes);
+    EXPECT_EQ(ErrCode::WrongVMWorkflow, ImgRes.error());
+    SSVM::ExpVM::Snapshot Image;
+    auto ScanRes = Image.scan(VM.getStoreManager());
+    ASSERT_FALSE(ScanRes);
+    EXPECT_EQ(ErrCode::WrongVMWorkflow, ScanRes.error());
+  }
+}
+
+TEST(EngineTest, Unvalidated) {
+  /// 7. Test branches in code not validated fail instead of taking targets
+  /// never resolved.
+  SSVM::Loader::Loader Load;
+  auto Mod = Load.parseModule(EngineModule);
+  ASSERT_TRUE(Mod);
+  SSVM::Support::Measurement Measure;
+  SSVM::Runtime::StoreManager Store;
+  SSVM::Interpreter::Interpreter Interp(&Measure);
+  ASSERT_TRUE(Interp.instantiateModule(
+      Store, std::shared_ptr<const SSVM::AST::Module>(std::move(*Mod))));
+  auto Res = Interp.invoke(Store, "switch", {uint32_t(1)});
+  ASSERT_FALSE(Res);
+  EXPECT_EQ(ErrCode::ValidationFailed, Res.error());
+}
+
+#ifdef SSVM_TIERED_JIT
+/// Results, errors, and cost sums of the cases, run in one VM after running
+/// the control cases until the functions of them are compiled into native
+/// code.
+std::vector<uint64_t> runNative(const Configure::EngineType Engine) {
+  std::vector<uint64_t> Table(256);
+  for (uint32_t I = 0; I < 256; ++I) {
+    Table[I] = I % 5 + 1;
+  }
+  Configure Conf;
+  Conf.setEngineType(Engine);
+  Conf.setTierUpThreshold(1);
+  SSVM::ExpVM::VM VM(Conf);
+  auto &Measure = VM.getMeasurement();
+  Measure.setCostTable(Table);
+  std::vector<uint64_t> Results;
+  EXPECT_TRUE(VM.loadWasm(EngineModule));
+  EXPECT_TRUE(VM.validate());
+  EXPECT_TRUE(VM.instantiate());
+  auto &StoreMgr = VM.getStoreManager();
+  auto IsNative = [&StoreMgr](const std::string &Name) {
+    return (*StoreMgr.getFunction(StoreMgr.getFuncExports().at(Name)))
+               ->getNativeCode() != nullptr;
+  };
+  for (uint32_t I = 0; I < 500; ++I) {
+    for (const auto &C : ControlCases) {
+      EXPECT_TRUE(VM.execute(C.Func, C.Params));
+    }
+    if (Engine != Configure::EngineType::Tiered ||
+        std::all_of(ControlCases.begin(), ControlCases.end(),
+                    [&IsNative](const Case &C) { return IsNative(C.Func); })) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (Engine == Configure::EngineType::Tiered) {
+    for (const auto &C : ControlCases) {
+      EXPECT_TRUE(IsNative(C.Func)) << C.Func;
+    }
+  }
+  for (const auto *Cases : {&ControlCases, &TrapCases}) {
+    for (const auto &C : *Cases) {
+      Measure.getCostSum() = 0;
+      auto Res = VM.execute(C.Func, C.Params);
+      if (Res) {
+        Results.push_back(C.IsI64
+                              ? SSVM::retrieveValue<uint64_t>((*Res)[0])
+                              : SSVM::retrieveValue<uint32_t>((*Res)[0]));
+      } else {
+        Results.push_back(static_cast<uint32_t>(Res.error()));
+      }
+      Results.push_back(Measure.getCostSum());
+    }
+  }
+  return Results;
+}
+
+TEST(EngineTest, TierUpToNative) {
+  /// 8. Test native code of hot functions gives the same results, traps, and
+  /// costs as the interpreter.
+  const auto Results = runNative(Configure::EngineType::AST);
+  ASSERT_EQ((ControlCases.size() + TrapCases.size()) * 2, Results.size());
+  EXPECT_EQ(Results, runNative(Configure::EngineType::Tiered));
+}
+#endif
+
+} // namespace
+
+GTEST_API_ int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
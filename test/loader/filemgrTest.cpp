@@ -14,12 +14,17 @@
 #include "common/errcode.h"
 #include "gtest/gtest.h"
 
-#include <limits>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <unistd.h>
 
 namespace {
 
 SSVM::FileMgrFStream Mgr;
+SSVM::FileMgrMap MapMgr;
 
 TEST(FileManagerTest, SetPath) {
   /// 1. Test opening data file.
@@ -265,6 +270,113 @@ TEST(FileManagerTest, ReadName) {
   EXPECT_EQ("Loader", ReadStr.value());
 }
 
+TEST(FileManagerTest, MapReadSpan) {
+  /// 11. Test byte view reading of memory mapped file manager.
+  SSVM::Expect<SSVM::Span<const uint8_t>> ReadSpan;
+  std::shared_ptr<const void> Owner;
+  ASSERT_TRUE(MapMgr.setPath("filemgrTestData/readByteTest.bin"));
+  ASSERT_TRUE(ReadSpan = MapMgr.readSpan(3, Owner));
+  ASSERT_EQ(3U, ReadSpan.value().size());
+  EXPECT_EQ(0x00, ReadSpan.value()[0]);
+  EXPECT_EQ(0xFF, ReadSpan.value()[1]);
+  EXPECT_EQ(0x1F, ReadSpan.value()[2]);
+  EXPECT_TRUE(Owner);
+  ASSERT_TRUE(ReadSpan = MapMgr.readSpan(7, Owner));
+  EXPECT_EQ(0x2E, ReadSpan.value()[0]);
+  EXPECT_EQ(0x88, ReadSpan.value()[6]);
+  EXPECT_FALSE(MapMgr.readSpan(1, Owner));
+
+  /// View keeps valid after the file manager switches to another input.
+  ASSERT_TRUE(MapMgr.setPath("filemgrTestData/readNameTest.bin"));
+  EXPECT_EQ(0x79, ReadSpan.value()[5]);
+
+  /// View of byte code references the input without copying.
+  const std::vector<uint8_t> Code = {0x01, 0x02, 0x03};
+  ASSERT_TRUE(MapMgr.setCode(SSVM::Span<const uint8_t>(Code)));
+  ASSERT_TRUE(ReadSpan = MapMgr.readSpan(3, Owner));
+  EXPECT_EQ(Code.data(), ReadSpan.value().data());
+}
+
+TEST(FileManagerTest, MapReadLEB128) {
+  /// 12. Test integer decoding of memory mapped file manager.
+  SSVM::Expect<uint32_t> ReadU32;
+  SSVM::Expect<int32_t> ReadS32;
+  SSVM::Expect<uint64_t> ReadU64;
+  SSVM::Expect<int64_t> ReadS64;
+  ASSERT_TRUE(MapMgr.setPath("filemgrTestData/readU32Test.bin"));
+  ASSERT_TRUE(ReadU32 = MapMgr.readU32());
+  EXPECT_EQ(0, ReadU32.value());
+  ASSERT_TRUE(ReadU32 = MapMgr.readU32());
+  EXPECT_EQ(INT32_MAX, ReadU32.value());
+  ASSERT_TRUE(ReadU32 = MapMgr.readU32());
+  EXPECT_EQ((unsigned int)INT32_MAX + 1, ReadU32.value());
+  ASSERT_TRUE(ReadU32 = MapMgr.readU32());
+  EXPECT_EQ(UINT32_MAX, ReadU32.value());
+  ASSERT_TRUE(MapMgr.setPath("filemgrTestData/readS32Test.bin"));
+  ASSERT_TRUE(ReadS32 = MapMgr.readS32());
+  EXPECT_EQ(0, ReadS32.value());
+  ASSERT_TRUE(ReadS32 = MapMgr.readS32());
+  EXPECT_EQ(INT32_MAX, ReadS32.value());
+  ASSERT_TRUE(ReadS32 = MapMgr.readS32());
+  EXPECT_EQ(INT32_MIN, ReadS32.value());
+  ASSERT_TRUE(ReadS32 = MapMgr.readS32());
+  EXPECT_EQ(-1, ReadS32.value());
+  ASSERT_TRUE(MapMgr.setPath("filemgrTestData/readU64Test.bin"));
+  ASSERT_TRUE(ReadU64 = MapMgr.readU64());
+  EXPECT_EQ(0, ReadU64.value());
+  ASSERT_TRUE(ReadU64 = MapMgr.readU64());
+  EXPECT_EQ(INT64_MAX, ReadU64.value());
+  ASSERT_TRUE(ReadU64 = MapMgr.readU64());
+  EXPECT_EQ((uint64_t)INT64_MAX + 1, ReadU64.value());
+  ASSERT_TRUE(ReadU64 = MapMgr.readU64());
+  EXPECT_EQ(UINT64_MAX, ReadU64.value());
+  ASSERT_TRUE(MapMgr.setPath("filemgrTestData/readS64Test.bin"));
+  ASSERT_TRUE(ReadS64 = MapMgr.readS64());
+  EXPECT_EQ(0, ReadS64.value());
+  ASSERT_TRUE(ReadS64 = MapMgr.readS64());
+  EXPECT_EQ(INT64_MAX, ReadS64.value());
+  ASSERT_TRUE(ReadS64 = MapMgr.readS64());
+  EXPECT_EQ(INT64_MIN, ReadS64.value());
+  ASSERT_TRUE(ReadS64 = MapMgr.readS64());
+  EXPECT_EQ(-1, ReadS64.value());
+
+  /// Overlong and truncated encodings.
+  const std::vector<uint8_t> Overlong = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+  ASSERT_TRUE(MapMgr.setCode(Overlong));
+  EXPECT_EQ(SSVM::ErrCode::InvalidGrammar, MapMgr.readU32().error());
+  const std::vector<uint8_t> Truncated = {0xFF, 0xFF};
+  ASSERT_TRUE(MapMgr.setCode(Truncated));
+  EXPECT_EQ(SSVM::ErrCode::EndOfFile, MapMgr.readU64().error());
+}
+
+TEST(FileManagerTest, MapChangedFile) {
+  /// 13. Test spans and changes of memory mapped file.
+  const std::string Path = "filemgrTestData/mapChangedTest.bin";
+  {
+    std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+    File << "SSVM loader";
+  }
+  std::shared_ptr<const void> Owner;
+  SSVM::Expect<SSVM::Span<const uint8_t>> ReadSpan;
+  SSVM::Expect<SSVM::Span<const uint8_t>> ReadView;
+  ASSERT_TRUE(MapMgr.setPath(Path));
+  ASSERT_TRUE(ReadSpan = MapMgr.readSpan(4, Owner));
+  ASSERT_TRUE(ReadView = MapMgr.readView(1));
+  EXPECT_NE(ReadSpan.value().data() + 4, ReadView.value().data());
+  EXPECT_TRUE(MapMgr.checkSource());
+  EXPECT_LE(0, MapMgr.getSourceFd());
+
+  /// Truncated file is detected, and kept spans are copied out of the
+  /// mapping.
+  ASSERT_EQ(0, truncate(Path.c_str(), 0));
+  EXPECT_FALSE(MapMgr.checkSource());
+  MapMgr.clearBuffer();
+  EXPECT_EQ(-1, MapMgr.getSourceFd());
+  EXPECT_EQ('S', ReadSpan.value()[0]);
+  EXPECT_EQ('M', ReadSpan.value()[3]);
+  std::remove(Path.c_str());
+}
+
 } // namespace
 
 GTEST_API_ int main(int argc, char **argv) {
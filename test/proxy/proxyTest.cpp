@@ -10,14 +10,23 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include "proxy/daemon.h"
 #include "proxy/proxy.h"
 #include "gtest/gtest.h"
 
 #include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
 
 namespace {
 
@@ -109,6 +118,286 @@ TEST(ProxyTest, Calc__mrc) {
   std::string RetStr = Doc["result"]["return_value"].GetArray()[0].GetString();
   EXPECT_EQ(int64_t(std::strtoull(RetStr.c_str(), nullptr, 10)), int64_t(238));
 }
+
+TEST(ProxyTest, Calc__Resume) {
+  /// Run input-mplus.json: mplus(255), original 9 in stored memory
+  SSVM::Proxy::Proxy VMProxy;
+  VMProxy.setInputJSONPath("inputJSONTestData/input-mplus.json");
+  VMProxy.setOutputJSONPath("outputJSONTestData/output-resume-mplus.json");
+  VMProxy.setWasmPath(WasmPath);
+  VMProxy.runRequest();
+
+  /// Take the binary snapshot in output JSON as the input of mrc().
+  std::ifstream OutputFS("outputJSONTestData/output-resume-mplus.json",
+                         std::ios::binary);
+  EXPECT_TRUE(OutputFS.is_open());
+  rapidjson::Document OutDoc;
+  readJSONFile(OutDoc, OutputFS);
+  ASSERT_NE(OutDoc["result"]["vm_snapshot"].FindMember("data"),
+            OutDoc["result"]["vm_snapshot"].MemberEnd());
+  EXPECT_EQ(OutDoc["result"]["vm_snapshot"]["depth"].GetUint(), 1U);
+
+  std::ifstream InputFS("inputJSONTestData/input-mrc.json", std::ios::binary);
+  EXPECT_TRUE(InputFS.is_open());
+  rapidjson::Document InDoc;
+  readJSONFile(InDoc, InputFS);
+  InDoc["execution"]["vm_snapshot"].CopyFrom(OutDoc["result"]["vm_snapshot"],
+                                             InDoc.GetAllocator());
+  rapidjson::StringBuffer StrBuf;
+  rapidjson::Writer<rapidjson::StringBuffer> Writer(StrBuf);
+  InDoc.Accept(Writer);
+  std::ofstream("outputJSONTestData/input-resume-mrc.json")
+      << StrBuf.GetString();
+
+  /// Run mrc(), 255 + 9 in restored memory
+  VMProxy.setInputJSONPath("outputJSONTestData/input-resume-mrc.json");
+  VMProxy.setOutputJSONPath("outputJSONTestData/output-resume-mrc.json");
+  VMProxy.runRequest();
+
+  std::ifstream ResultFS("outputJSONTestData/output-resume-mrc.json",
+                         std::ios::binary);
+  EXPECT_TRUE(ResultFS.is_open());
+  rapidjson::Document Doc;
+  readJSONFile(Doc, ResultFS);
+  std::string RetStr = Doc["result"]["return_value"].GetArray()[0].GetString();
+  EXPECT_EQ(int64_t(std::strtoull(RetStr.c_str(), nullptr, 10)),
+            int64_t(0xFF + 9));
+
+  /// The delta snapshot of mrc() is chained on the one of mplus().
+  const auto &Snapshot = Doc["result"]["vm_snapshot"];
+  EXPECT_EQ(Snapshot["depth"].GetUint(), 2U);
+  ASSERT_NE(Snapshot.FindMember("chain"), Snapshot.MemberEnd());
+  ASSERT_EQ(Snapshot["chain"].Size(), 2U);
+  EXPECT_EQ(Snapshot["chain"][0], OutDoc["result"]["vm_snapshot"]["chain"][0]);
+
+  /// The inlined base is linked by a file instead of being copied.
+  const auto &Link = Snapshot["chain"][1];
+  ASSERT_NE(Link.FindMember("path"), Link.MemberEnd());
+  EXPECT_EQ(Link.FindMember("data"), Link.MemberEnd());
+  EXPECT_TRUE(std::ifstream(Link["path"].GetString()).is_open());
+}
+
+TEST(ProxyTest, Cache__Fork) {
+  /// Requests after the first one fork the instance of the cached module.
+  SSVM::Proxy::ModuleCache Cache;
+  SSVM::Proxy::Proxy VMProxy;
+  VMProxy.setModuleCache(&Cache);
+  VMProxy.setWasmPath(WasmPath);
+  auto RunRequest = [&VMProxy](const std::string &Path, bool KeepSnapshot) {
+    std::ifstream InputFS(Path);
+    std::stringstream Input;
+    Input << InputFS.rdbuf();
+    rapidjson::Document InDoc;
+    InDoc.Parse(Input.str().c_str());
+    if (!KeepSnapshot) {
+      InDoc["execution"].RemoveMember("vm_snapshot");
+    }
+    rapidjson::Document OutDoc;
+    OutDoc.Parse(VMProxy.runRequest(InDoc).c_str());
+    EXPECT_TRUE(OutDoc.IsObject());
+    std::string RetStr =
+        OutDoc["result"]["return_value"].GetArray()[0].GetString();
+    return int64_t(std::strtoull(RetStr.c_str(), nullptr, 10));
+  };
+
+  /// mplus(255) on 9 in restored memory, and then mrc() on the memory of the
+  /// module, which is not changed by the previous requests.
+  const int64_t Initial = RunRequest("inputJSONTestData/input-mrc.json", false);
+  for (uint32_t I = 0; I < 3; ++I) {
+    EXPECT_EQ(RunRequest("inputJSONTestData/input-mplus.json", true),
+              int64_t(0xFF + 9));
+    EXPECT_EQ(RunRequest("inputJSONTestData/input-mrc.json", false), Initial);
+  }
+  EXPECT_EQ(Cache.getMisses(), 1U);
+}
+/// Send a framed request and receive the framed response.
+std::string roundTrip(const int Fd, const std::string &Req) {
+  const uint32_t Len = Req.size();
+  const uint8_t Header[4] = {uint8_t(Len >> 24), uint8_t(Len >> 16),
+                             uint8_t(Len >> 8), uint8_t(Len)};
+  EXPECT_EQ(send(Fd, Header, 4, 0), 4);
+  EXPECT_EQ(send(Fd, Req.data(), Req.size(), 0), ssize_t(Req.size()));
+  uint8_t RetHeader[4];
+  EXPECT_EQ(recv(Fd, RetHeader, 4, MSG_WAITALL), 4);
+  std::string Ret(uint32_t(RetHeader[0]) << 24 | uint32_t(RetHeader[1]) << 16 |
+                      uint32_t(RetHeader[2]) << 8 | uint32_t(RetHeader[3]),
+                  '\0');
+  EXPECT_EQ(recv(Fd, Ret.data(), Ret.size(), MSG_WAITALL), ssize_t(Ret.size()));
+  return Ret;
+}
+
+/// Connect to the daemon, retrying until it listens.
+int connectDaemon(const std::string &SocketPath) {
+  int Fd = -1;
+  sockaddr_un Addr{};
+  Addr.sun_family = AF_UNIX;
+  std::strcpy(Addr.sun_path, SocketPath.c_str());
+  for (uint32_t I = 0; I < 100 && Fd < 0; ++I) {
+    Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(Fd, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) != 0) {
+      close(Fd);
+      Fd = -1;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  return Fd;
+}
+
+TEST(ProxyTest, Daemon__Calc) {
+  /// Serve requests of calc.wasm by 2 workers.
+  const std::string SocketPath = "outputJSONTestData/proxy.sock";
+  SSVM::Proxy::Daemon Daemon(SocketPath, 2, WasmPath);
+  std::thread Server([&Daemon]() { EXPECT_TRUE(Daemon.run()); });
+
+  const int Fd = connectDaemon(SocketPath);
+  ASSERT_GE(Fd, 0);
+
+  /// Run mplus(255) twice on a connection. The module is loaded once.
+  std::ifstream InputFS("inputJSONTestData/input-mplus.json");
+  std::stringstream Input;
+  Input << InputFS.rdbuf();
+  for (uint32_t I = 0; I < 2; ++I) {
+    rapidjson::Document Doc;
+    Doc.Parse(roundTrip(Fd, Input.str()).c_str());
+    ASSERT_TRUE(Doc.IsObject());
+    std::string RetStr =
+        Doc["result"]["return_value"].GetArray()[0].GetString();
+    EXPECT_EQ(int64_t(std::strtoull(RetStr.c_str(), nullptr, 10)),
+              int64_t(0xFF + 9));
+  }
+
+  /// Check metrics.
+  rapidjson::Document Metrics;
+  Metrics.Parse(roundTrip(Fd, R"({"command": "metrics"})").c_str());
+  ASSERT_TRUE(Metrics.IsObject());
+  EXPECT_EQ(Metrics["requests"].GetUint64(), 2U);
+  EXPECT_EQ(Metrics["module_cache"]["misses"].GetUint64(), 1U);
+  EXPECT_EQ(Metrics["module_cache"]["hits"].GetUint64(), 1U);
+  EXPECT_EQ(Metrics["service_latency_us"]["count"].GetUint64(), 2U);
+
+  close(Fd);
+  Daemon.stop();
+  Server.join();
+}
+
+TEST(ProxyTest, Daemon__SlowClient) {
+  /// A client stopping in the middle of a frame does not stall the others.
+  const std::string SocketPath = "outputJSONTestData/proxy-slow.sock";
+  SSVM::Proxy::Daemon Daemon(SocketPath, 1, WasmPath);
+  std::thread Server([&Daemon]() { EXPECT_TRUE(Daemon.run()); });
+
+  const int SlowFd = connectDaemon(SocketPath);
+  ASSERT_GE(SlowFd, 0);
+  const std::string Req = R"({"command": "metrics"})";
+  const uint32_t Len = Req.size();
+  const uint8_t Header[4] = {uint8_t(Len >> 24), uint8_t(Len >> 16),
+                             uint8_t(Len >> 8), uint8_t(Len)};
+  EXPECT_EQ(send(SlowFd, Header, 2, 0), 2);
+
+  const auto Start = std::chrono::steady_clock::now();
+  const int Fd = connectDaemon(SocketPath);
+  ASSERT_GE(Fd, 0);
+  rapidjson::Document Metrics;
+  Metrics.Parse(roundTrip(Fd, Req).c_str());
+  ASSERT_TRUE(Metrics.IsObject());
+  EXPECT_LT(std::chrono::steady_clock::now() - Start, std::chrono::seconds(2));
+
+  /// The rest of the slow frame is still answered.
+  EXPECT_EQ(send(SlowFd, Header + 2, 2, 0), 2);
+  EXPECT_EQ(send(SlowFd, Req.data(), Req.size(), 0), ssize_t(Req.size()));
+  uint8_t RetHeader[4];
+  EXPECT_EQ(recv(SlowFd, RetHeader, 4, MSG_WAITALL), 4);
+
+  close(Fd);
+  close(SlowFd);
+  Daemon.stop();
+  Server.join();
+}
+
+TEST(ProxyTest, Daemon__SocketPath) {
+  /// A socket path served by another daemon is kept.
+  const std::string SocketPath = "outputJSONTestData/proxy-live.sock";
+  SSVM::Proxy::Daemon Daemon(SocketPath, 1, WasmPath);
+  std::thread Server([&Daemon]() { EXPECT_TRUE(Daemon.run()); });
+  const int Fd = connectDaemon(SocketPath);
+  ASSERT_GE(Fd, 0);
+  {
+    SSVM::Proxy::Daemon Other(SocketPath, 1, WasmPath);
+    EXPECT_FALSE(Other.run());
+  }
+  rapidjson::Document Metrics;
+  Metrics.Parse(roundTrip(Fd, R"({"command": "metrics"})").c_str());
+  EXPECT_TRUE(Metrics.IsObject());
+  close(Fd);
+  Daemon.stop();
+  Server.join();
+
+  /// Files of other types are kept.
+  const std::string FilePath = "outputJSONTestData/proxy-file.sock";
+  std::ofstream(FilePath) << "data";
+  {
+    SSVM::Proxy::Daemon Other(FilePath, 1, WasmPath);
+    EXPECT_FALSE(Other.run());
+  }
+  std::ifstream FileFS(FilePath);
+  std::string Content;
+  FileFS >> Content;
+  EXPECT_EQ(Content, "data");
+  unlink(FilePath.c_str());
+}
+
+TEST(ProxyTest, Daemon__WasmRoot) {
+  /// Requests load wasm files only under the root.
+  const std::string SocketPath = "outputJSONTestData/proxy-root.sock";
+  SSVM::Proxy::Daemon Daemon(SocketPath, 1, "", "WasmTestData");
+  std::thread Server([&Daemon]() { EXPECT_TRUE(Daemon.run()); });
+  const int Fd = connectDaemon(SocketPath);
+  ASSERT_GE(Fd, 0);
+
+  std::ifstream InputFS("inputJSONTestData/input-mplus.json");
+  rapidjson::Document Input;
+  readJSONFile(Input, InputFS);
+  auto RunWasm = [&](const char *Path) {
+    rapidjson::Document Req;
+    Req.CopyFrom(Input, Req.GetAllocator());
+    Req.AddMember("wasm_path", rapidjson::StringRef(Path), Req.GetAllocator());
+    rapidjson::StringBuffer Buf;
+    rapidjson::Writer<rapidjson::StringBuffer> Writer(Buf);
+    Req.Accept(Writer);
+    rapidjson::Document Doc;
+    Doc.Parse(roundTrip(Fd, Buf.GetString()).c_str());
+    return Doc;
+  };
+  rapidjson::Document Doc = RunWasm("WasmTestData/calc.wasm");
+  ASSERT_TRUE(Doc.IsObject());
+  EXPECT_TRUE(Doc["result"]["return_value"].IsArray());
+  Doc = RunWasm("WasmTestData/../WasmTestData/../inputJSONTestData/"
+                "input-mplus.json");
+  ASSERT_TRUE(Doc.IsObject());
+  EXPECT_STREQ(Doc["result"]["error_message"].GetString(),
+               "Wasm path not allowed.");
+
+  /// Snapshot files out of the root are not opened.
+  rapidjson::Document Req;
+  Req.CopyFrom(Input, Req.GetAllocator());
+  Req.AddMember("wasm_path", "WasmTestData/calc.wasm", Req.GetAllocator());
+  rapidjson::Value Snapshot(rapidjson::kObjectType);
+  Snapshot.AddMember("path", "inputJSONTestData/input-mplus.json",
+                     Req.GetAllocator());
+  Req["execution"]["vm_snapshot"] = Snapshot;
+  rapidjson::StringBuffer Buf;
+  rapidjson::Writer<rapidjson::StringBuffer> Writer(Buf);
+  Req.Accept(Writer);
+  Doc.Parse(roundTrip(Fd, Buf.GetString()).c_str());
+  ASSERT_TRUE(Doc.IsObject());
+  EXPECT_STREQ(Doc["result"]["error_message"].GetString(),
+               "Snapshot restoring failed.");
+  EXPECT_STREQ(Doc["result"]["status"].GetString(), "Failed");
+
+  close(Fd);
+  Daemon.stop();
+  Server.join();
+}
 } // namespace
 
 GTEST_API_ int main(int argc, char **argv) {
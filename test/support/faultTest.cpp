@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/test/support/faultTest.cpp - Fault handler tests -------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contents tests of turning faults in the guard regions into error
+/// codes, and passing the other faults to the handler installed before.
+///
+//===----------------------------------------------------------------------===//
+
+#include "support/allocator.h"
+#include "support/fault.h"
+#include "gtest/gtest.h"
+
+#include <csetjmp>
+#include <csignal>
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace {
+
+using SSVM::ErrCode;
+using SSVM::Support::Allocator;
+using SSVM::Support::Fault;
+using SSVM::Support::FaultBlocker;
+
+/// Handler installed before the fault handler, which jumps back to the test.
+sigjmp_buf PrevBuffer;
+volatile sig_atomic_t PrevCount = 0;
+
+void prevHandler(int, siginfo_t *, void *) {
+  ++PrevCount;
+  siglongjmp(PrevBuffer, 1);
+}
+
+/// Read a byte. Returns the error code of the fault scope, 1 when the fault
+/// goes to the handler installed before, or 0 when no fault.
+int touch(volatile const uint8_t *Ptr, const bool Blocked) {
+  Fault FaultHandler;
+  if (const int Err = sigsetjmp(FaultHandler.getBuffer(), 0); Err != 0) {
+    return Err;
+  }
+  if (sigsetjmp(PrevBuffer, 1) != 0) {
+    return 1;
+  }
+  if (Blocked) {
+    FaultBlocker Blocker;
+    static_cast<void>(*Ptr);
+  } else {
+    static_cast<void>(*Ptr);
+  }
+  return 0;
+}
+
+TEST(FaultTest, GuardRegion) {
+  uint8_t *Base = Allocator::allocate(1);
+  ASSERT_NE(Base, nullptr);
+  EXPECT_EQ(touch(Base, false), 0);
+  EXPECT_EQ(touch(Base + Allocator::kPageSize, false),
+            static_cast<int>(ErrCode::MemorySizeExceeded));
+  EXPECT_EQ(touch(Base + Allocator::kReserveSize - 1, false),
+            static_cast<int>(ErrCode::MemorySizeExceeded));
+  Allocator::release(Base);
+}
+
+TEST(FaultTest, OutOfGuardRegion) {
+  /// Inaccessible pages not reserved by the allocator.
+  void *Ptr = mmap(nullptr, Allocator::kPageSize, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(Ptr, MAP_FAILED);
+  const sig_atomic_t Count = PrevCount;
+  EXPECT_EQ(touch(static_cast<uint8_t *>(Ptr), false), 1);
+  EXPECT_EQ(PrevCount, Count + 1);
+  munmap(Ptr, Allocator::kPageSize);
+}
+
+TEST(FaultTest, ReleasedGuardRegion) {
+  uint8_t *Base = Allocator::allocate(0);
+  ASSERT_NE(Base, nullptr);
+  Allocator::release(Base);
+  /// Map the released range again without registering it.
+  void *Ptr = mmap(Base, Allocator::kPageSize, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+  if (Ptr == MAP_FAILED) {
+    GTEST_SKIP();
+  }
+  EXPECT_EQ(touch(static_cast<uint8_t *>(Ptr), false), 1);
+  munmap(Ptr, Allocator::kPageSize);
+}
+
+TEST(FaultTest, Blocked) {
+  uint8_t *Base = Allocator::allocate(1);
+  ASSERT_NE(Base, nullptr);
+  EXPECT_EQ(touch(Base + Allocator::kPageSize, true), 1);
+  EXPECT_EQ(touch(Base + Allocator::kPageSize, false),
+            static_cast<int>(ErrCode::MemorySizeExceeded));
+  Allocator::release(Base);
+}
+
+} // namespace
+
+GTEST_API_ int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  /// Install the handler before the fault handler is installed by the first
+  /// fault scope.
+  struct sigaction Action = {};
+  Action.sa_sigaction = &prevHandler;
+  Action.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset(&Action.sa_mask);
+  sigaction(SIGSEGV, &Action, nullptr);
+  return RUN_ALL_TESTS();
+}
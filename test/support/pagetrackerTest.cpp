@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/test/support/pagetrackerTest.cpp - Dirty page tests ----------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contents tests of tracking the pages written into memory
+/// instances, including the writes of system calls.
+///
+//===----------------------------------------------------------------------===//
+
+#include "loader/filemgr.h"
+#include "runtime/instance/memory.h"
+#include "gtest/gtest.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using SSVM::Runtime::Instance::MemoryInstance;
+
+const uint64_t kSysPageSize = MemoryInstance::getDirtyPageSize();
+
+/// Get the limit of one page.
+SSVM::AST::Limit getLimit() {
+  SSVM::FileMgrVector Mgr;
+  SSVM::AST::Limit Lim;
+  Mgr.setCode({0x00U, 0x01U});
+  Lim.loadBinary(Mgr);
+  return Lim;
+}
+
+TEST(PageTrackerTest, SystemCall) {
+  MemoryInstance Mem(getLimit());
+  ASSERT_TRUE(Mem.isAllocated());
+  ASSERT_TRUE(Mem.clearDirtyPages());
+  int Fds[2];
+  ASSERT_EQ(pipe(Fds), 0);
+  const uint8_t Data[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+  /// Clean pages are not writable by system calls.
+  ASSERT_EQ(write(Fds[1], Data, sizeof(Data)), 16);
+  uint8_t *Ptr = Mem.getPointer<uint8_t *>(kSysPageSize * 2);
+  ASSERT_NE(Ptr, nullptr);
+  EXPECT_EQ(read(Fds[0], Ptr, sizeof(Data)), -1);
+  EXPECT_EQ(errno, EFAULT);
+  EXPECT_TRUE(Mem.getDirtyPages().empty());
+
+  /// Pointers got with lengths are writable.
+  Ptr = Mem.getPointer<uint8_t *>(kSysPageSize * 2, sizeof(Data));
+  ASSERT_NE(Ptr, nullptr);
+  EXPECT_EQ(read(Fds[0], Ptr, sizeof(Data)), 16);
+  EXPECT_EQ(Ptr[15], 0);
+  EXPECT_EQ(Ptr[14], 15);
+  EXPECT_EQ(Mem.getDirtyPages(), std::vector<uint64_t>{2});
+
+  /// Lengths out of bound get null.
+  EXPECT_EQ(Mem.getPointer<uint8_t *>(Mem.getDataSize() - 8, 16), nullptr);
+  close(Fds[0]);
+  close(Fds[1]);
+}
+
+TEST(PageTrackerTest, CopyBytes) {
+  MemoryInstance Mem(getLimit());
+  ASSERT_TRUE(Mem.clearDirtyPages());
+  const std::vector<SSVM::Byte> Data(kSysPageSize + 2, 0xA5U);
+  ASSERT_TRUE(Mem.setBytes(Data, kSysPageSize * 3 - 1, 0, Data.size()));
+  EXPECT_EQ(Mem.getDirtyPages(), (std::vector<uint64_t>{2, 3, 4}));
+
+  /// Writes by the host code are tracked by faulting.
+  uint32_t Val = 1;
+  ASSERT_TRUE(Mem.storeValue(Val, kSysPageSize * 7, 4));
+  EXPECT_EQ(Mem.getDirtyPages(), (std::vector<uint64_t>{2, 3, 4, 7}));
+}
+
+} // namespace
+
+GTEST_API_ int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: Apache-2.0
+//===-- ssvm/test/support/sha256Test.cpp - SHA-256 tests ------------------===//
+//
+// Part of the SSVM Project.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file contents tests of the SHA-256 digest against the FIPS 180-4
+/// examples.
+///
+//===----------------------------------------------------------------------===//
+
+#include "support/sha256.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+using SSVM::Support::SHA256;
+
+std::string hexOf(const std::string &Msg) {
+  return SHA256::toHex(SHA256::hash(Msg.data(), Msg.size()));
+}
+
+TEST(SHA256Test, Messages) {
+  EXPECT_EQ(hexOf(""), "e3b0c44298fc1c149afbf4c8996fb924"
+                       "27ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(hexOf("abc"), "ba7816bf8f01cfea414140de5dae2223"
+                          "b00361a396177a9cb410ff61f20015ad");
+  EXPECT_EQ(hexOf("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+            "248d6a61d20638b8e5c026930c3e6039"
+            "a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST(SHA256Test, Incremental) {
+  /// One million 'a' in chunks of different sizes.
+  const std::string Chunk(997, 'a');
+  SHA256 Hasher;
+  size_t Done = 0;
+  for (size_t Size = 1; Done < 1000000; Size = Size * 3 % 997 + 1) {
+    const size_t Cnt = std::min(Size, 1000000 - Done);
+    Hasher.update(Chunk.data(), Cnt);
+    Done += Cnt;
+  }
+  EXPECT_EQ(SHA256::toHex(Hasher.finalize()),
+            "cdc76e5c9914fb9281a1c7e284d73e67"
+            "f1809a48a497200e046d39ccc7112cd0");
+}
+
+} // namespace
+
+GTEST_API_ int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
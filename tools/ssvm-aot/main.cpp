@@ -3,6 +3,7 @@
 #include "compiler/hostfunc.h"
 #include "compiler/library.h"
 #include "vm/result.h"
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -41,17 +42,48 @@ public:
 #endif
 
 int main(int Argc, char *Argv[]) {
-  if (Argc < 2) {
+  /// Options: -O0 to -O3 for optimization level, --generic-cpu for not
+  /// tuning code to the host CPU, --compile-threads=N for compiling on N
+  /// threads (0 for hardware threads), and --speculate for compiling the
+  /// reachable functions in background.
+  SSVM::VM::Configure Conf;
+  Conf.addVMType(SSVM::VM::Configure::VMType::Wasi);
+  int ArgBegin = 1;
+  for (; ArgBegin < Argc && Argv[ArgBegin][0] == '-'; ++ArgBegin) {
+    using OptLevel = SSVM::VM::Configure::OptimizationLevel;
+    const std::string Option(Argv[ArgBegin]);
+    if (Option == "-O0") {
+      Conf.setOptimizationLevel(OptLevel::O0);
+    } else if (Option == "-O1") {
+      Conf.setOptimizationLevel(OptLevel::O1);
+    } else if (Option == "-O2") {
+      Conf.setOptimizationLevel(OptLevel::O2);
+    } else if (Option == "-O3") {
+      Conf.setOptimizationLevel(OptLevel::O3);
+    } else if (Option == "--generic-cpu") {
+      Conf.setHostCPU(false);
+    } else if (Option.rfind("--compile-threads=", 0) == 0) {
+      Conf.setCompileThreadCount(static_cast<uint32_t>(
+          std::strtoul(Option.c_str() + 18, nullptr, 10)));
+    } else if (Option == "--speculate") {
+      Conf.setSpeculativeCompile(true);
+    } else {
+      std::cout << "Unknown option: " << Option << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (Argc - ArgBegin < 1) {
     /// Arg0: ./ssvm
     /// Arg1: wasm file
     /// Arg2...: inputs
-    std::cout << "Usage: ./ssvm wasm_file.wasm [args...]" << std::endl;
+    std::cout << "Usage: ./ssvm [-O0|-O1|-O2|-O3] [--generic-cpu] "
+                 "[--compile-threads=N] [--speculate] wasm_file.wasm [args...]"
+              << std::endl;
     return 0;
   }
 
-  std::string InputPath(Argv[1]);
-  SSVM::VM::Configure Conf;
-  Conf.addVMType(SSVM::VM::Configure::VMType::Wasi);
+  std::string InputPath(Argv[ArgBegin]);
 
   SSVM::Compiler::Compiler Compiler(Conf);
 
@@ -59,11 +91,12 @@ int main(int Argc, char *Argv[]) {
       Compiler.getEnvironment<SSVM::VM::WasiEnvironment>(
           SSVM::VM::Configure::VMType::Wasi);
   std::vector<std::string> &CmdArgsVec = Env->getCmdArgs();
-  for (int I = 1; I < Argc; I++) {
+  for (int I = ArgBegin; I < Argc; I++) {
     CmdArgsVec.push_back(std::string(Argv[I]));
   }
 
   Compiler.setPath(InputPath);
+  Compiler.setCacheEnabled(true);
 
   if (Compiler.compile() != SSVM::Compiler::ErrCode::Success) {
     return EXIT_FAILURE;
@@ -85,5 +118,10 @@ int main(int Argc, char *Argv[]) {
 
   Library.execute();
 
+  std::cerr << "=== Compile statistics ===\n"
+            << "Compile wall time: " << Compiler.getCompileWallTime()
+            << " us\n"
+            << "Compile CPU time: " << Compiler.getCompileCPUTime() << " us\n";
+
   return EXIT_SUCCESS;
 }
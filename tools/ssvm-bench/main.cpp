@@ -0,0 +1,522 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "evmc/evmc.hpp"
+#include "expvm/configure.h"
+#include "expvm/vm.h"
+#include "host/ethereum/eeimodule.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+#include "support/hexstr.h"
+#include "support/log.h"
+#include "support/time.h"
+#include "vm/configure.h"
+#include "vm/vm.h"
+
+#ifdef SSVM_BENCH_COMPILER
+#include "compiler/compiler.h"
+#include "compiler/library.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = SSVM::Support::TickClock;
+
+/// Host modules imported by workload.
+enum class HostKind { None, Wasi, Ewasm };
+
+/// Type of the value returned by workload.
+enum class ResultKind { None, I32, I64 };
+
+/// Workload run by every engine.
+struct Workload {
+  const char *Name;
+  const char *File;
+  const char *Func;
+  std::optional<uint32_t> Arg;
+  HostKind Host;
+  ResultKind Result;
+};
+
+/// Curated workloads. Sources of the hand written ones are next to the wasm
+/// files, and ERC20 is the runtime code of `test/evmc/erc20.h`.
+const Workload Workloads[] = {
+    {"compute", "compute.wasm", "run", 200000, HostKind::None,
+     ResultKind::I64},
+    {"memory", "memory.wasm", "run", 8, HostKind::None, ResultKind::I64},
+    {"fibonacci", "fibonacci.wasm", "run", 22, HostKind::None,
+     ResultKind::I32},
+    {"indirect", "indirect.wasm", "run", 200000, HostKind::None,
+     ResultKind::I32},
+    {"wasi", "wasi.wasm", "run", 20000, HostKind::Wasi, ResultKind::I32},
+    {"erc20", "erc20.wasm", "main", std::nullopt, HostKind::Ewasm,
+     ResultKind::None},
+};
+
+/// ERC20 call of `balanceOf(0x7fffffff)` sent by 0x7fffffff.
+const char *ERC20Sender = "000000000000000000000000000000007fffffff";
+const char *ERC20CallData =
+    "70a08231"
+    "000000000000000000000000000000000000000000000000000000007fffffff";
+const int64_t ERC20Gas = 999999;
+
+/// EVMC host keeping storage in memory. Other queries are answered with
+/// empty values.
+class StorageHost : public evmc::Host {
+public:
+  bool account_exists(const evmc::address &) noexcept final { return false; }
+  evmc::bytes32 get_storage(const evmc::address &,
+                            const evmc::bytes32 &Key) noexcept final {
+    return Storage[Key];
+  }
+  evmc_storage_status set_storage(const evmc::address &,
+                                  const evmc::bytes32 &Key,
+                                  const evmc::bytes32 &Value) noexcept final {
+    evmc::bytes32 &Slot = Storage[Key];
+    const bool Unchanged = Slot == Value;
+    Slot = Value;
+    return Unchanged ? EVMC_STORAGE_UNCHANGED : EVMC_STORAGE_MODIFIED;
+  }
+  evmc::uint256be get_balance(const evmc::address &) noexcept final {
+    return {};
+  }
+  size_t get_code_size(const evmc::address &) noexcept final { return 0; }
+  evmc::bytes32 get_code_hash(const evmc::address &) noexcept final {
+    return {};
+  }
+  size_t copy_code(const evmc::address &, size_t, uint8_t *,
+                   size_t) noexcept final {
+    return 0;
+  }
+  void selfdestruct(const evmc::address &,
+                    const evmc::address &) noexcept final {}
+  evmc::result call(const evmc_message &Msg) noexcept final {
+    return {EVMC_REVERT, Msg.gas, nullptr, 0};
+  }
+  evmc_tx_context get_tx_context() noexcept final { return {}; }
+  evmc::bytes32 get_block_hash(int64_t) noexcept final { return {}; }
+  void emit_log(const evmc::address &, const uint8_t *, size_t,
+                const evmc::bytes32[], size_t) noexcept final {}
+
+private:
+  std::map<evmc::bytes32, evmc::bytes32> Storage;
+};
+
+/// EVMC message of the ERC20 call.
+struct ERC20Message {
+  ERC20Message() {
+    SSVM::Support::convertHexStrToBytes(ERC20CallData, CallData);
+    std::vector<uint8_t> Sender;
+    SSVM::Support::convertHexStrToBytes(ERC20Sender, Sender);
+    std::copy_n(Sender.begin(), 20, Msg.sender.bytes);
+    Msg.kind = EVMC_CALL;
+    Msg.gas = ERC20Gas;
+    Msg.input_data = CallData.data();
+    Msg.input_size = CallData.size();
+  }
+  std::vector<uint8_t> CallData;
+  evmc_message Msg{};
+};
+
+/// Elapsed nanoseconds of phases in one repetition, in execution order.
+using Sample = std::vector<std::pair<const char *, uint64_t>>;
+
+/// Result of one repetition. Value is the returned value of workload in
+/// bits, for checking engines agree.
+struct RunResult {
+  bool Success = false;
+  Sample Phases;
+  uint64_t Value = 0;
+};
+
+/// Get the returned value in bits by the result type of workload.
+uint64_t getResultBits(const Workload &W,
+                       const std::vector<SSVM::ValVariant> &Rets) {
+  if (Rets.empty()) {
+    return 0;
+  }
+  switch (W.Result) {
+  case ResultKind::I32:
+    return SSVM::retrieveValue<uint32_t>(Rets.front());
+  case ResultKind::I64:
+    return SSVM::retrieveValue<uint64_t>(Rets.front());
+  default:
+    return 0;
+  }
+}
+
+/// Measure the phase until now from the start ticks, and restart.
+void lap(Sample &Phases, const char *Name, uint64_t &Start) {
+  const uint64_t Now = Clock::now();
+  Phases.emplace_back(Name, Clock::toNanoseconds(Now - Start));
+  Start = Clock::now();
+}
+
+/// Interpreter in `ExpVM` with the given engine.
+RunResult runInterpreter(const Workload &W, const SSVM::Bytes &Code,
+                         StorageHost &Host,
+                         const SSVM::ExpVM::Configure::EngineType Engine) {
+  using namespace SSVM::ExpVM;
+  Configure Conf;
+  Conf.setEngineType(Engine);
+  if (W.Host == HostKind::Wasi) {
+    Conf.addVMType(Configure::VMType::Wasi);
+  } else if (W.Host == HostKind::Ewasm) {
+    Conf.addVMType(Configure::VMType::Ewasm);
+  }
+  VM EVM(Conf);
+  ERC20Message Message;
+  if (W.Host == HostKind::Ewasm) {
+    auto &Env = dynamic_cast<SSVM::Host::EEIModule *>(
+                    EVM.getImportModule(Configure::VMType::Ewasm))
+                    ->getEnv();
+    Env.setEVMCContext(&Host);
+    Env.setEVMCMessage(&Message.Msg);
+    EVM.getMeasurement().getCostLimit() = ERC20Gas;
+  }
+  std::vector<SSVM::ValVariant> Params;
+  if (W.Arg) {
+    Params.emplace_back(*W.Arg);
+  }
+
+  RunResult Res;
+  uint64_t Start = Clock::now();
+  if (!EVM.loadWasm(Code)) {
+    return Res;
+  }
+  lap(Res.Phases, "load", Start);
+  if (!EVM.validate()) {
+    return Res;
+  }
+  lap(Res.Phases, "validate", Start);
+  if (!EVM.instantiate()) {
+    return Res;
+  }
+  lap(Res.Phases, "instantiate", Start);
+  auto Rets = EVM.execute(W.Func, Params);
+  if (!Rets) {
+    return Res;
+  }
+  lap(Res.Phases, "execute", Start);
+  Res.Value = getResultBits(W, *Rets);
+  Res.Success = true;
+  return Res;
+}
+
+/// Legacy `VM` running on `Executor`.
+RunResult runExecutor(const Workload &W, const SSVM::Bytes &Code,
+                      StorageHost &Host) {
+  using namespace SSVM::VM;
+  Configure Conf;
+  if (W.Host == HostKind::Wasi) {
+    Conf.addVMType(Configure::VMType::Wasi);
+  } else if (W.Host == HostKind::Ewasm) {
+    Conf.addVMType(Configure::VMType::Ewasm);
+  }
+  VM EVM(Conf);
+  ERC20Message Message;
+  if (W.Host == HostKind::Ewasm) {
+    auto *Env = EVM.getEnvironment<EVMEnvironment>(Configure::VMType::Ewasm);
+    Env->setEVMCContext(&Host);
+    Env->setEVMCMessage(&Message.Msg);
+    EVM.setCostLimit(ERC20Gas);
+  }
+  EVM.setCode(Code);
+  EVM.initVMEnv();
+  if (W.Arg) {
+    EVM.appendArgument(*W.Arg);
+  }
+
+  RunResult Res;
+  uint64_t Start = Clock::now();
+  if (EVM.loadWasm() != ErrCode::Success) {
+    return Res;
+  }
+  lap(Res.Phases, "load", Start);
+  if (EVM.validate() != ErrCode::Success) {
+    return Res;
+  }
+  lap(Res.Phases, "validate", Start);
+  EVM.setEntryFuncName(W.Func);
+  if (EVM.instantiate() != ErrCode::Success) {
+    return Res;
+  }
+  lap(Res.Phases, "instantiate", Start);
+  if (EVM.runWasm() != ErrCode::Success) {
+    return Res;
+  }
+  lap(Res.Phases, "execute", Start);
+  std::vector<SSVM::Executor::Value> Rets;
+  EVM.getReturnValue(Rets);
+  Res.Value = getResultBits(W, Rets);
+  EVM.cleanup();
+  Res.Success = true;
+  return Res;
+}
+
+#ifdef SSVM_BENCH_COMPILER
+/// `Compiler::Library` compiled by JIT. Loading and validation are parts of
+/// compilation, so they are not measured separately.
+RunResult runCompiler(const Workload &W, const SSVM::Bytes &Code,
+                      StorageHost &Host) {
+  using namespace SSVM::VM;
+  Configure Conf;
+  if (W.Host == HostKind::Wasi) {
+    Conf.addVMType(Configure::VMType::Wasi);
+  } else if (W.Host == HostKind::Ewasm) {
+    Conf.addVMType(Configure::VMType::Ewasm);
+  }
+  SSVM::Compiler::Compiler Compiler(Conf);
+  ERC20Message Message;
+  if (W.Host == HostKind::Ewasm) {
+    auto *Env =
+        Compiler.getEnvironment<EVMEnvironment>(Configure::VMType::Ewasm);
+    Env->setEVMCContext(&Host);
+    Env->setEVMCMessage(&Message.Msg);
+  }
+  Compiler.setCode(Code);
+
+  RunResult Res;
+  uint64_t Start = Clock::now();
+  if (Compiler.compile() != SSVM::Compiler::ErrCode::Success) {
+    return Res;
+  }
+  lap(Res.Phases, "compile", Start);
+  auto &Lib = Compiler.getLibrary();
+  if (W.Host == HostKind::Ewasm) {
+    Lib.setCostLimit(ERC20Gas);
+  }
+  if (W.Arg) {
+    Lib.appendArgument(*W.Arg);
+  }
+  Start = Clock::now();
+  if (const auto Status = Lib.execute(W.Func);
+      Status != SSVM::Compiler::ErrCode::Success &&
+      Status != SSVM::Compiler::ErrCode::Terminated) {
+    return Res;
+  }
+  lap(Res.Phases, "execute", Start);
+  Res.Value = getResultBits(W, Lib.getReturnValue());
+  Res.Success = true;
+  return Res;
+}
+#endif
+
+/// Engines in report order.
+struct Engine {
+  const char *Name;
+  RunResult (*Run)(const Workload &, const SSVM::Bytes &, StorageHost &);
+};
+
+const Engine Engines[] = {
+    {"interpreter-ast",
+     [](const Workload &W, const SSVM::Bytes &Code, StorageHost &Host) {
+       return runInterpreter(W, Code, Host,
+                             SSVM::ExpVM::Configure::EngineType::AST);
+     }},
+    {"interpreter-flat",
+     [](const Workload &W, const SSVM::Bytes &Code, StorageHost &Host) {
+       return runInterpreter(W, Code, Host,
+                             SSVM::ExpVM::Configure::EngineType::Flat);
+     }},
+    {"interpreter-tiered",
+     [](const Workload &W, const SSVM::Bytes &Code, StorageHost &Host) {
+       return runInterpreter(W, Code, Host,
+                             SSVM::ExpVM::Configure::EngineType::Tiered);
+     }},
+    {"executor", runExecutor},
+#ifdef SSVM_BENCH_COMPILER
+    {"compiler", runCompiler},
+#endif
+};
+
+/// Check the name is selected by comma separated list. Empty list selects
+/// all.
+bool isSelected(const std::string &List, const std::string &Name) {
+  if (List.empty()) {
+    return true;
+  }
+  std::istringstream SS(List);
+  std::string Item;
+  while (std::getline(SS, Item, ',')) {
+    if (Item == Name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Write summary of samples in nanoseconds: minimum, maximum, mean, median,
+/// and sample standard deviation.
+template <typename WriterT>
+void writeSummary(WriterT &Writer, std::vector<uint64_t> Samples) {
+  std::sort(Samples.begin(), Samples.end());
+  const size_t N = Samples.size();
+  double Mean = 0.0;
+  for (const uint64_t S : Samples) {
+    Mean += static_cast<double>(S);
+  }
+  Mean /= static_cast<double>(N);
+  double Var = 0.0;
+  for (const uint64_t S : Samples) {
+    Var += (static_cast<double>(S) - Mean) * (static_cast<double>(S) - Mean);
+  }
+  const double StdDev =
+      N > 1 ? std::sqrt(Var / static_cast<double>(N - 1)) : 0.0;
+  const double Median =
+      N % 2 == 1 ? static_cast<double>(Samples[N / 2])
+                 : (static_cast<double>(Samples[N / 2 - 1]) +
+                    static_cast<double>(Samples[N / 2])) /
+                       2.0;
+
+  Writer.StartObject();
+  Writer.Key("min");
+  Writer.Uint64(Samples.front());
+  Writer.Key("max");
+  Writer.Uint64(Samples.back());
+  Writer.Key("mean");
+  Writer.Double(Mean);
+  Writer.Key("median");
+  Writer.Double(Median);
+  Writer.Key("stddev");
+  Writer.Double(StdDev);
+  Writer.Key("samples");
+  Writer.StartArray();
+  for (const uint64_t S : Samples) {
+    Writer.Uint64(S);
+  }
+  Writer.EndArray();
+  Writer.EndObject();
+}
+
+} // namespace
+
+int main(int Argc, char *Argv[]) {
+  /// Options: --repeat=N for measured repetitions, --warmup=N for discarded
+  /// repetitions before them, --engine=LIST and --workload=LIST for comma
+  /// separated names to run, and --output=FILE for writing JSON report to
+  /// file instead of stdout.
+  uint32_t Repeat = 10, Warmup = 1;
+  std::string EngineList, WorkloadList, OutputPath;
+  int ArgBegin = 1;
+  for (; ArgBegin < Argc && Argv[ArgBegin][0] == '-'; ++ArgBegin) {
+    const std::string Option(Argv[ArgBegin]);
+    if (Option.rfind("--repeat=", 0) == 0) {
+      Repeat = static_cast<uint32_t>(
+          std::strtoul(Option.c_str() + 9, nullptr, 10));
+    } else if (Option.rfind("--warmup=", 0) == 0) {
+      Warmup = static_cast<uint32_t>(
+          std::strtoul(Option.c_str() + 9, nullptr, 10));
+    } else if (Option.rfind("--engine=", 0) == 0) {
+      EngineList = Option.substr(9);
+    } else if (Option.rfind("--workload=", 0) == 0) {
+      WorkloadList = Option.substr(11);
+    } else if (Option.rfind("--output=", 0) == 0) {
+      OutputPath = Option.substr(9);
+    } else {
+      std::cout << "Unknown option: " << Option << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (Argc - ArgBegin > 1 || Repeat == 0) {
+    std::cout << "Usage: ./ssvm-bench [--repeat=N] [--warmup=N] "
+                 "[--engine=LIST] [--workload=LIST] [--output=FILE] "
+                 "[workload_dir]"
+              << std::endl;
+    return 0;
+  }
+  const std::string Dir(ArgBegin < Argc ? Argv[ArgBegin] : "workloads");
+  /// Logs are disabled, since executor reports statistics of every run in
+  /// info level, which mixes into the report and the measured time. Failures
+  /// are reported in the results.
+  el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Enabled, "false");
+
+  rapidjson::StringBuffer StrBuf;
+  rapidjson::PrettyWriter<rapidjson::StringBuffer> Writer(StrBuf);
+  Writer.StartObject();
+  Writer.Key("repeat");
+  Writer.Uint(Repeat);
+  Writer.Key("warmup");
+  Writer.Uint(Warmup);
+  Writer.Key("unit");
+  Writer.String("ns");
+  Writer.Key("results");
+  Writer.StartArray();
+  bool AllSuccess = true;
+  for (const auto &W : Workloads) {
+    if (!isSelected(WorkloadList, W.Name)) {
+      continue;
+    }
+    std::ifstream File(Dir + "/" + W.File, std::ios::binary);
+    const SSVM::Bytes Code(std::istreambuf_iterator<char>(File), {});
+    for (const auto &E : Engines) {
+      if (!isSelected(EngineList, E.Name)) {
+        continue;
+      }
+      std::cerr << W.Name << " on " << E.Name << std::endl;
+
+      /// Phase samples by name in execution order.
+      std::vector<std::pair<const char *, std::vector<uint64_t>>> Phases;
+      RunResult Res;
+      for (uint32_t I = 0; I < Warmup + Repeat; ++I) {
+        StorageHost Host;
+        Res = E.Run(W, Code, Host);
+        if (!Res.Success) {
+          break;
+        }
+        if (I < Warmup) {
+          continue;
+        }
+        for (size_t J = 0; J < Res.Phases.size(); ++J) {
+          if (J == Phases.size()) {
+            Phases.emplace_back(Res.Phases[J].first, std::vector<uint64_t>());
+          }
+          Phases[J].second.push_back(Res.Phases[J].second);
+        }
+      }
+
+      Writer.StartObject();
+      Writer.Key("workload");
+      Writer.String(W.Name);
+      Writer.Key("engine");
+      Writer.String(E.Name);
+      Writer.Key("success");
+      Writer.Bool(Res.Success);
+      if (Res.Success) {
+        if (W.Result != ResultKind::None) {
+          Writer.Key("result");
+          Writer.Uint64(Res.Value);
+        }
+        Writer.Key("phases");
+        Writer.StartObject();
+        for (const auto &[Name, Samples] : Phases) {
+          Writer.Key(Name);
+          writeSummary(Writer, Samples);
+        }
+        Writer.EndObject();
+      } else {
+        AllSuccess = false;
+      }
+      Writer.EndObject();
+    }
+  }
+  Writer.EndArray();
+  Writer.EndObject();
+
+  if (OutputPath.empty()) {
+    std::cout << StrBuf.GetString() << std::endl;
+  } else {
+    std::ofstream(OutputPath) << StrBuf.GetString() << std::endl;
+  }
+  return AllSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,18 @@
+(module
+ (export "run" (func $run))
+ (func $run (param $n i32) (result i64)
+  (local $x i64)
+  (local.set $x (i64.const 88172645463325252))
+  (block $done
+   (loop $loop
+    (br_if $done (i32.eqz (local.get $n)))
+    (local.set $x (i64.xor (local.get $x) (i64.shl (local.get $x) (i64.const 13))))
+    (local.set $x (i64.xor (local.get $x) (i64.shr_u (local.get $x) (i64.const 7))))
+    (local.set $x (i64.xor (local.get $x) (i64.shl (local.get $x) (i64.const 17))))
+    (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+    (br $loop)
+   )
+  )
+  (local.get $x)
+ )
+)
@@ -0,0 +1,12 @@
+(module
+ (export "run" (func $fib))
+ (func $fib (param $n i32) (result i32)
+  (if (i32.lt_s (local.get $n) (i32.const 2))
+   (return (i32.const 1))
+  )
+  (i32.add
+   (call $fib (i32.sub (local.get $n) (i32.const 2)))
+   (call $fib (i32.sub (local.get $n) (i32.const 1)))
+  )
+ )
+)
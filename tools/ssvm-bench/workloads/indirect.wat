@@ -0,0 +1,24 @@
+(module
+ (type $op (func (param i32) (result i32)))
+ (table 4 funcref)
+ (elem (i32.const 0) $inc $dbl $mix $dec)
+ (export "run" (func $run))
+ (func $run (param $n i32) (result i32)
+  (local $acc i32)
+  (block $done
+   (loop $loop
+    (br_if $done (i32.eqz (local.get $n)))
+    (local.set $acc
+     (call_indirect (type $op) (local.get $acc)
+      (i32.and (local.get $n) (i32.const 3))))
+    (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+    (br $loop)
+   )
+  )
+  (local.get $acc)
+ )
+ (func $inc (type $op) (i32.add (local.get 0) (i32.const 1)))
+ (func $dbl (type $op) (i32.shl (local.get 0) (i32.const 1)))
+ (func $mix (type $op) (i32.xor (local.get 0) (i32.const 0x5bd1e995)))
+ (func $dec (type $op) (i32.sub (local.get 0) (i32.const 3)))
+)
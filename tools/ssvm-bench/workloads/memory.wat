@@ -0,0 +1,23 @@
+(module
+ (memory 1)
+ (export "run" (func $run))
+ (func $run (param $n i32) (result i64)
+  (local $i i32)
+  (local $sum i64)
+  (block $done
+   (loop $pass
+    (br_if $done (i32.eqz (local.get $n)))
+    (local.set $i (i32.const 0))
+    (loop $word
+     (i32.store (local.get $i) (i32.add (i32.load (local.get $i)) (local.get $i)))
+     (local.set $sum (i64.add (local.get $sum) (i64.extend_i32_u (i32.load (local.get $i)))))
+     (local.set $i (i32.add (local.get $i) (i32.const 4)))
+     (br_if $word (i32.lt_u (local.get $i) (i32.const 65536)))
+    )
+    (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+    (br $pass)
+   )
+  )
+  (local.get $sum)
+ )
+)
@@ -0,0 +1,24 @@
+(module
+ (import "wasi_unstable" "fd_write"
+  (func $fd_write (param i32 i32 i32 i32) (result i32)))
+ (memory 1)
+ (export "memory" (memory 0))
+ (export "run" (func $run))
+ ;; One empty iovec at address 0, and the written count at address 8.
+ (func $run (param $n i32) (result i32)
+  (local $err i32)
+  (i32.store (i32.const 0) (i32.const 16))
+  (i32.store (i32.const 4) (i32.const 0))
+  (block $done
+   (loop $loop
+    (br_if $done (i32.eqz (local.get $n)))
+    (local.set $err
+     (i32.or (local.get $err)
+      (call $fd_write (i32.const 1) (i32.const 0) (i32.const 1) (i32.const 8))))
+    (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+    (br $loop)
+   )
+  )
+  (local.get $err)
+ )
+)
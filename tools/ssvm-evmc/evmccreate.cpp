@@ -4,11 +4,160 @@
 #include "expvm/configure.h"
 #include "expvm/vm.h"
 #include "host/ethereum/eeimodule.h"
+#include "loader/loader.h"
 #include "support/hexstr.h"
 #include "support/log.h"
+#include "validator/validator.h"
+
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 namespace {
 
+/// Validated module cached by code.
+struct CachedModule {
+  size_t Hash;
+  /// Code is referenced by the module, so it is destroyed after the module.
+  std::vector<uint8_t> Code;
+  std::unique_ptr<SSVM::AST::Module> Module;
+};
+
+/// VM with ewasm configuration which can be reused between calls.
+struct PooledVM {
+  static SSVM::ExpVM::Configure makeConfigure() {
+    SSVM::ExpVM::Configure Conf;
+    Conf.addVMType(SSVM::ExpVM::Configure::VMType::Ewasm);
+    return Conf;
+  }
+
+  PooledVM() : Conf(makeConfigure()), EVM(Conf) {}
+
+  /// Reset the instantiated module and measurement. Host modules are kept.
+  void reset() {
+    EVM.cleanup();
+    EVM.getMeasurement().getCostSum() = 0;
+  }
+
+  SSVM::ExpVM::Configure Conf;
+  SSVM::ExpVM::VM EVM;
+};
+
+/// EVMC instance with validated module cache and VM pool.
+///
+/// Modules are keyed by the hash of code and evicted in LRU order. VMs are
+/// acquired for every call, so nested calls from the host get their own VMs.
+struct SSVMInstance : public evmc_instance {
+  SSVMInstance(const evmc_instance &Base) : evmc_instance(Base) {}
+
+  /// Get validated module of code. Returns nullptr if the code is invalid.
+  std::shared_ptr<const CachedModule> getModule(const uint8_t *Code,
+                                                const size_t Size) {
+    const std::string_view Key(reinterpret_cast<const char *>(Code), Size);
+    const size_t Hash = std::hash<std::string_view>{}(Key);
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (auto It = Index.find(Hash); It != Index.end()) {
+        const auto &Entry = *It->second;
+        if (Entry->Code.size() == Size &&
+            std::equal(Entry->Code.begin(), Entry->Code.end(), Code)) {
+          LRU.splice(LRU.begin(), LRU, It->second);
+          ++Hits;
+          return Entry;
+        }
+      }
+      ++Misses;
+    }
+
+    /// Load and validate the module without holding the lock.
+    auto Entry = std::make_shared<CachedModule>();
+    Entry->Hash = Hash;
+    Entry->Code.assign(Code, Code + Size);
+    SSVM::Loader::Loader WasmLoader;
+    SSVM::Validator::Validator WasmValidator;
+    if (auto Res = WasmLoader.parseModule(
+            SSVM::Span<const SSVM::Byte>(Entry->Code))) {
+      Entry->Module = std::move(*Res);
+    } else {
+      return nullptr;
+    }
+    if (!WasmValidator.validate(*Entry->Module)) {
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (auto It = Index.find(Hash); It != Index.end()) {
+      LRU.erase(It->second);
+      Index.erase(It);
+    }
+    if (CacheCapacity > 0) {
+      LRU.push_front(Entry);
+      Index.emplace(Hash, LRU.begin());
+      while (LRU.size() > CacheCapacity) {
+        Index.erase(LRU.back()->Hash);
+        LRU.pop_back();
+      }
+    }
+    return Entry;
+  }
+
+  /// Get a VM from pool or create a new one.
+  std::unique_ptr<PooledVM> acquireVM() {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (!Pool.empty()) {
+        auto VM = std::move(Pool.back());
+        Pool.pop_back();
+        return VM;
+      }
+    }
+    return std::make_unique<PooledVM>();
+  }
+
+  /// Reset the VM and put it back to pool.
+  void releaseVM(std::unique_ptr<PooledVM> VM) {
+    VM->reset();
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (Pool.size() < PoolCapacity) {
+      Pool.push_back(std::move(VM));
+    }
+  }
+
+  /// Set the capacity of module cache and evict modules if exceeded.
+  void setCacheCapacity(const size_t Capacity) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    CacheCapacity = Capacity;
+    while (LRU.size() > CacheCapacity) {
+      Index.erase(LRU.back()->Hash);
+      LRU.pop_back();
+    }
+  }
+
+  /// Set the capacity of idle VMs in pool.
+  void setPoolCapacity(const size_t Capacity) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    PoolCapacity = Capacity;
+    if (Pool.size() > PoolCapacity) {
+      Pool.resize(PoolCapacity);
+    }
+  }
+
+  std::mutex Mutex;
+  /// Module cache in LRU order, the most recently used one at front.
+  std::list<std::shared_ptr<const CachedModule>> LRU;
+  std::unordered_map<size_t,
+                     std::list<std::shared_ptr<const CachedModule>>::iterator>
+      Index;
+  size_t CacheCapacity = 64;
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+  /// Idle VMs.
+  std::vector<std::unique_ptr<PooledVM>> Pool;
+  size_t PoolCapacity = 16;
+};
+
 static bool isWasmBinary(std::vector<uint8_t> &Code) {
   return Code.size() >= 8 && Code[0] == 0 && Code[1] == 'a' && Code[2] == 's' &&
          Code[3] == 'm';
@@ -18,7 +167,29 @@ static evmc_capabilities_flagset get_capabilities(struct evmc_instance *vm) {
   return EVMC_CAPABILITY_EWASM;
 }
 
-static void destroy(struct evmc_instance *vm) { return; }
+static void destroy(struct evmc_instance *vm) {
+  delete static_cast<SSVMInstance *>(vm);
+}
+
+static enum evmc_set_option_result
+set_option(struct evmc_instance *vm, char const *name, char const *value) {
+  auto &Instance = *static_cast<SSVMInstance *>(vm);
+  const std::string_view Name(name);
+  char *End = nullptr;
+  const unsigned long long Val = std::strtoull(value, &End, 10);
+  if (Name != "cache-size" && Name != "pool-size") {
+    return EVMC_SET_OPTION_INVALID_NAME;
+  }
+  if (End == value || *End != '\0') {
+    return EVMC_SET_OPTION_INVALID_VALUE;
+  }
+  if (Name == "cache-size") {
+    Instance.setCacheCapacity(Val);
+  } else {
+    Instance.setPoolCapacity(Val);
+  }
+  return EVMC_SET_OPTION_SUCCESS;
+}
 
 static void release(const struct evmc_result *result) {
   if (result->output_data != nullptr) {
@@ -33,6 +204,7 @@ static struct evmc_result execute(struct evmc_instance *vm,
                                   const struct evmc_message *msg,
                                   uint8_t const *code, size_t code_size) {
   SSVM::Log::setErrorLoggingLevel();
+  auto &Instance = *static_cast<SSVMInstance *>(vm);
   // Prepare EVMC result
   struct evmc_result result;
   result.status_code = EVMC_SUCCESS;
@@ -42,23 +214,19 @@ static struct evmc_result execute(struct evmc_instance *vm,
   result.release = ::release;
   result.create_address = {};
 
-  /// Create VM with ewasm configuration.
-  SSVM::ExpVM::Configure Conf;
-  Conf.addVMType(SSVM::ExpVM::Configure::VMType::Ewasm);
-  SSVM::ExpVM::VM EVM(Conf);
+  /// Get validated module from cache and VM with ewasm configuration from
+  /// pool.
+  const auto Cached = Instance.getModule(code, code_size);
+  auto Slot = Instance.acquireVM();
+  SSVM::ExpVM::VM &EVM = Slot->EVM;
 
   /// Set data from message.
-  std::vector<uint8_t> Code(code, code + code_size);
   SSVM::Host::EEIModule &EEIObj = *dynamic_cast<SSVM::Host::EEIModule *>(
       EVM.getImportModule(SSVM::ExpVM::Configure::VMType::Ewasm));
   SSVM::Host::EVMEnvironment &EEIEnv = EEIObj.getEnv();
   EEIEnv.setEVMCContext(context);
   EEIEnv.setEVMCMessage(msg);
   EEIEnv.setEVMCCode(code, code_size);
-  if (msg->input_size > 0) {
-    EEIEnv.getCallData() = std::vector<uint8_t>(
-        msg->input_data, msg->input_data + msg->input_size);
-  }
   EVM.getMeasurement().getCostLimit() = msg->gas;
 
   /// Debug log.
@@ -68,14 +236,13 @@ static struct evmc_result execute(struct evmc_instance *vm,
   LOG(DEBUG) << "Caller: " << EEIEnv.getCallerStr();
   LOG(DEBUG) << "CallValue: " << EEIEnv.getCallValueStr();
 
-  /// Load, validate, and instantiate code.
-  if (result.status_code == EVMC_SUCCESS && !EVM.loadWasm(Code)) {
-    result.status_code = EVMC_FAILURE;
-  }
-  if (result.status_code == EVMC_SUCCESS && !EVM.validate()) {
+  /// Instantiate the loaded and validated code.
+  if (result.status_code == EVMC_SUCCESS && !Cached) {
     result.status_code = EVMC_FAILURE;
   }
-  if (result.status_code == EVMC_SUCCESS && !EVM.instantiate()) {
+  if (result.status_code == EVMC_SUCCESS &&
+      !EVM.instantiate(std::shared_ptr<const SSVM::AST::Module>(
+          Cached, Cached->Module.get()))) {
     result.status_code = EVMC_FAILURE;
   }
 
@@ -109,7 +276,8 @@ static struct evmc_result execute(struct evmc_instance *vm,
   if (isWasmBinary(ReturnData) && msg->kind == EVMC_CREATE &&
       result.status_code != EVMC_REVERT) {
     SSVM::Loader::Loader WasmLoader;
-    if (auto Res = WasmLoader.parseModule(ReturnData)) {
+    if (auto Res = WasmLoader.parseModule(
+            SSVM::Span<const SSVM::Byte>(ReturnData))) {
       if ((*Res)->getStartSection() != nullptr) {
         result.status_code = EVMC_FAILURE;
       }
@@ -132,18 +300,31 @@ static struct evmc_result execute(struct evmc_instance *vm,
   LOG(DEBUG) << "gas_left: " << result.gas_left;
   LOG(DEBUG) << "output_size: " << result.output_size;
 
+  /// Reset VM before the cached module may be released.
+  Instance.releaseVM(std::move(Slot));
   return result;
 }
 
 } // namespace
 
 extern "C" EVMC_EXPORT struct evmc_instance *evmc_create() EVMC_NOEXCEPT {
-  static evmc_instance vm = {
+  static const evmc_instance vm = {
       EVMC_ABI_VERSION,   "ssvm",  "0.4.0",
       ::destroy, // destroy
       ::execute, // execute
       ::get_capabilities, nullptr,
+      ::set_option, // set_option
   };
 
-  return &vm;
+  return new SSVMInstance(vm);
+}
+
+/// Get the hit and miss counters of validated module cache.
+extern "C" EVMC_EXPORT void
+ssvm_evmc_get_cache_stats(struct evmc_instance *vm, uint64_t *hits,
+                          uint64_t *misses) EVMC_NOEXCEPT {
+  auto &Instance = *static_cast<SSVMInstance *>(vm);
+  std::lock_guard<std::mutex> Lock(Instance.Mutex);
+  *hits = Instance.Hits;
+  *misses = Instance.Misses;
 }
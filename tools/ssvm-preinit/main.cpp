@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "expvm/configure.h"
+#include "expvm/snapshot.h"
+#include "expvm/vm.h"
+#include "host/wasi/wasimodule.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main(int Argc, char *Argv[]) {
+  /// Options: --init=FUNC runs FUNC as the initialization function instead
+  /// of `_initialize`.
+  std::string InitFunc = "_initialize";
+  if (Argc > 1 && std::strncmp(Argv[1], "--init=", 7) == 0) {
+    InitFunc = Argv[1] + 7;
+    --Argc;
+    ++Argv;
+  }
+  if (Argc < 3) {
+    /// Arg0: ./ssvm-preinit
+    /// Arg1: wasm file
+    /// Arg2: output image file
+    std::cout << "Usage: ./ssvm-preinit [--init=FUNC] wasm_file.wasm "
+                 "image_file"
+              << std::endl;
+    return 0;
+  }
+
+  /// Instantiate the module and run the initialization function.
+  std::string InputPath(Argv[1]);
+  std::string ImagePath(Argv[2]);
+  SSVM::ExpVM::Configure Conf;
+  Conf.addVMType(SSVM::ExpVM::Configure::VMType::Wasi);
+  Conf.setModuleHash(true);
+  SSVM::ExpVM::VM VM(Conf);
+  SSVM::Host::WasiModule *WasiMod = dynamic_cast<SSVM::Host::WasiModule *>(
+      VM.getImportModule(SSVM::ExpVM::Configure::VMType::Wasi));
+  WasiMod->getEnv().getCmdArgs().push_back(InputPath);
+
+  SSVM::Expect<void> Res = VM.loadWasm(InputPath);
+  if (Res) {
+    Res = VM.validate();
+  }
+  if (Res) {
+    Res = VM.instantiate();
+  }
+  if (Res) {
+    /// Exiting in the initialization is not a failure.
+    if (auto ExecRes = VM.execute(InitFunc);
+        !ExecRes && ExecRes.error() != SSVM::ErrCode::Terminated) {
+      Res = SSVM::Unexpect(ExecRes);
+    }
+  }
+
+  /// Write the states of module as the image with mapped runs.
+  SSVM::ExpVM::Snapshot Image;
+  if (Res) {
+    Res = Image.scan(VM.getStoreManager());
+  }
+  if (Res) {
+    Res = Image.write(ImagePath, true);
+  }
+  if (!Res) {
+    const uint32_t Err = static_cast<uint32_t>(Res.error());
+    std::cout << " Failed. Code : " << Err << std::endl;
+    return Err;
+  }
+  std::cout << " Image written: " << ImagePath << std::endl;
+  return 0;
+}
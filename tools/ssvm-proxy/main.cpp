@@ -1,17 +1,40 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "proxy/cmdparser.h"
+#include "proxy/daemon.h"
 #include "proxy/proxy.h"
 #include "vm/configure.h"
 #include "vm/result.h"
 #include "vm/vm.h"
 
+#include <algorithm>
+#include <csignal>
 #include <cstdio>
 #include <cstring>
+#include <thread>
+
+namespace {
+SSVM::Proxy::Daemon *RunningDaemon = nullptr;
+void stopDaemon(int) { RunningDaemon->stop(); }
+} // namespace
 
 int main(int Argc, char *Argv[]) {
   SSVM::Proxy::CmdParser Cmd;
   Cmd.parseCommandLine(Argc, Argv);
 
+  /// Daemon mode: serve requests on socket until interrupted.
+  if (!Cmd.getSocketPath().empty()) {
+    uint32_t Workers = Cmd.getWorkerCount();
+    if (Workers == 0) {
+      Workers = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    SSVM::Proxy::Daemon Daemon(Cmd.getSocketPath(), Workers,
+                               Cmd.getWasmPath(), Cmd.getWasmRoot());
+    RunningDaemon = &Daemon;
+    std::signal(SIGINT, stopDaemon);
+    std::signal(SIGTERM, stopDaemon);
+    return Daemon.run() ? 0 : 1;
+  }
+
   SSVM::Proxy::Proxy VMProxy;
   VMProxy.setInputJSONPath(Cmd.getInputJSONPath());
   VMProxy.setOutputJSONPath(Cmd.getOutputJSONPath());
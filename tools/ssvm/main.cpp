@@ -3,22 +3,47 @@
 #include "expvm/configure.h"
 #include "expvm/vm.h"
 
+#include <cstring>
 #include <iostream>
 
 int main(int Argc, char *Argv[]) {
+  /// Options: --profile=PATH writes the profile into PATH.json and
+  /// PATH.folded, --image=PATH restores the pre-initialized image written by
+  /// `ssvm-preinit` before invoking, and --lazy decodes and validates function
+  /// bodies on their first calls.
+  std::string ProfilePath, ImagePath;
+  bool Lazy = false;
+  for (; Argc > 1 && std::strncmp(Argv[1], "--", 2) == 0; --Argc, ++Argv) {
+    if (std::strncmp(Argv[1], "--profile=", 10) == 0) {
+      ProfilePath = Argv[1] + 10;
+    } else if (std::strncmp(Argv[1], "--image=", 8) == 0) {
+      ImagePath = Argv[1] + 8;
+    } else if (std::strcmp(Argv[1], "--lazy") == 0) {
+      Lazy = true;
+    } else {
+      break;
+    }
+  }
   if (Argc < 3) {
     /// Arg0: ./ssvm
     /// Arg1: wasm file
     /// Arg2: invoke function name
     /// Arg3...: inputs
-    std::cout << "Usage: ./ssvm wasm_file.wasm func_name [args...]"
+    std::cout << "Usage: ./ssvm [--profile=PATH] [--image=PATH] [--lazy] "
+                 "wasm_file.wasm func_name [args...]"
               << std::endl;
     return 0;
   }
 
   std::string InputPath(Argv[1]);
   SSVM::ExpVM::Configure Conf;
+  Conf.setLazyFunctionBody(Lazy);
+  /// The image is bound to the module by its digest.
+  Conf.setModuleHash(!ImagePath.empty());
   SSVM::ExpVM::VM VM(Conf);
+  if (!ProfilePath.empty()) {
+    VM.getMeasurement().enableProfile(ProfilePath);
+  }
 
   /// Parameters and return values.
   std::vector<SSVM::ValVariant> Params, Results;
@@ -27,7 +52,26 @@ int main(int Argc, char *Argv[]) {
   for (int I = 3; I < Argc; I++) {
     Params.push_back(static_cast<uint32_t>(std::stoul(Argv[I])));
   }
-  if (auto Res = VM.runWasmFile(InputPath, Argv[2], Params)) {
+  auto Run = [&]() -> SSVM::Expect<std::vector<SSVM::ValVariant>> {
+    if (ImagePath.empty()) {
+      return VM.runWasmFile(InputPath, Argv[2], Params);
+    }
+    SSVM::Expect<void> Res = VM.loadWasm(InputPath);
+    if (Res) {
+      Res = VM.validate();
+    }
+    if (Res) {
+      Res = VM.instantiate();
+    }
+    if (Res) {
+      Res = VM.loadImage(ImagePath);
+    }
+    if (!Res) {
+      return SSVM::Unexpect(Res);
+    }
+    return VM.execute(Argv[2], Params);
+  };
+  if (auto Res = Run()) {
     Results = *Res;
     for (auto &It : Results) {
       std::cout << " Return value: " << std::get<uint32_t>(It) << std::endl;